@@ -0,0 +1,264 @@
+#include "availabilityIndex.h"
+#include "platform.h"
+
+#include <limits.h>
+
+// Higher battery first, then lower cost, then lower handle so the order never depends on history
+static int Better(const AvailabilityEntry* a, const AvailabilityEntry* b) {
+	if (a->battery != b->battery) {
+		return a->battery > b->battery;
+	}
+	if (a->cost != b->cost) {
+		return a->cost < b->cost;
+	}
+	return a->handle < b->handle;
+}
+
+static void PlaceInHeap(AvailabilityIndex* index, AvailabilityHeap* heap, int position, const AvailabilityEntry* entry) {
+	heap->entries[position] = *entry;
+	index->positions[entry->handle] = position;
+}
+
+// Returns the position the entry ends at
+static int SiftUp(AvailabilityIndex* index, AvailabilityHeap* heap, int position) {
+	AvailabilityEntry entry = heap->entries[position];
+	while (position > 0) {
+		int parent = (position - 1) / 2;
+		if (!Better(&entry, &heap->entries[parent])) {
+			break;
+		}
+		PlaceInHeap(index, heap, position, &heap->entries[parent]);
+		position = parent;
+	}
+	PlaceInHeap(index, heap, position, &entry);
+	return position;
+}
+
+static void SiftDown(AvailabilityIndex* index, AvailabilityHeap* heap, int position) {
+	AvailabilityEntry entry = heap->entries[position];
+	for (;;) {
+		int best = 2 * position + 1;
+		if (best >= heap->count) {
+			break;
+		}
+		if (best + 1 < heap->count && Better(&heap->entries[best + 1], &heap->entries[best])) {
+			best++;
+		}
+		if (!Better(&heap->entries[best], &entry)) {
+			break;
+		}
+		PlaceInHeap(index, heap, position, &heap->entries[best]);
+		position = best;
+	}
+	PlaceInHeap(index, heap, position, &entry);
+}
+
+static int HeapOf(int type, int locationId) {
+	if (type < 0 || type >= AVAILABILITY_TYPE_COUNT || locationId < 0 || locationId > INT_MAX / AVAILABILITY_TYPE_COUNT - 1) {
+		return AVAILABILITY_UNFILED;
+	}
+	return locationId * AVAILABILITY_TYPE_COUNT + type;
+}
+
+static int ReserveHeaps(AvailabilityIndex* index, int heap) {
+	if (heap < index->heapCount) {
+		return 1;
+	}
+
+	int heapCount = index->heapCount > 0 ? index->heapCount : 16 * AVAILABILITY_TYPE_COUNT;
+	while (heapCount <= heap) {
+		heapCount *= 2;
+	}
+	AvailabilityHeap* heaps = (AvailabilityHeap*)realloc(index->heaps, heapCount * sizeof(AvailabilityHeap));
+	if (heaps == NULL) {
+		return 0;
+	}
+	memset(heaps + index->heapCount, 0, (heapCount - index->heapCount) * sizeof(AvailabilityHeap));
+	index->heaps = heaps;
+	index->heapCount = heapCount;
+	return 1;
+}
+
+int AvailabilityReserve(AvailabilityIndex* index, int capacity) {
+	if (capacity <= index->capacity) {
+		return 1;
+	}
+
+	int* heapOf = (int*)realloc(index->heapOf, capacity * sizeof(int));
+	if (heapOf == NULL) {
+		return 0;
+	}
+	index->heapOf = heapOf;
+
+	int* positions = (int*)realloc(index->positions, capacity * sizeof(int));
+	if (positions == NULL) {
+		return 0;
+	}
+	index->positions = positions;
+
+	for (int handle = index->capacity; handle < capacity; handle++) {
+		index->heapOf[handle] = AVAILABILITY_UNFILED;
+	}
+	index->capacity = capacity;
+	return 1;
+}
+
+void AvailabilityRemove(AvailabilityIndex* index, int handle) {
+	if (index->heapOf[handle] == AVAILABILITY_UNFILED) {
+		return;
+	}
+
+	AvailabilityHeap* heap = &index->heaps[index->heapOf[handle]];
+	int position = index->positions[handle];
+	const AvailabilityEntry* last = &heap->entries[--heap->count];
+	index->heapOf[handle] = AVAILABILITY_UNFILED;
+	if (last->handle != handle) {
+		PlaceInHeap(index, heap, position, last);
+		SiftDown(index, heap, SiftUp(index, heap, position));
+	}
+}
+
+int AvailabilityFile(AvailabilityIndex* index, int handle, int type, int locationId, float battery, float cost) {
+	int target = HeapOf(type, locationId);
+
+	// Telemetry for a vehicle that stays put only needs it moved inside its heap
+	if (target != AVAILABILITY_UNFILED && index->heapOf[handle] == target) {
+		AvailabilityHeap* heap = &index->heaps[target];
+		AvailabilityEntry* entry = &heap->entries[index->positions[handle]];
+		entry->battery = battery;
+		entry->cost = cost;
+		SiftDown(index, heap, SiftUp(index, heap, index->positions[handle]));
+		return 1;
+	}
+
+	AvailabilityRemove(index, handle);
+	if (target == AVAILABILITY_UNFILED) {
+		return 1;
+	}
+	if (!ReserveHeaps(index, target)) {
+		return 0;
+	}
+
+	AvailabilityHeap* heap = &index->heaps[target];
+	if (heap->count == heap->capacity) {
+		int capacity = heap->capacity > 0 ? heap->capacity * 2 : 4;
+		AvailabilityEntry* entries = (AvailabilityEntry*)realloc(heap->entries, capacity * sizeof(AvailabilityEntry));
+		if (entries == NULL) {
+			return 0;
+		}
+		heap->entries = entries;
+		heap->capacity = capacity;
+	}
+
+	AvailabilityEntry entry = { battery, cost, handle };
+	index->heapOf[handle] = target;
+	PlaceInHeap(index, heap, heap->count++, &entry);
+	SiftUp(index, heap, heap->count - 1);
+	return 1;
+}
+
+void AvailabilityPrefetch(const AvailabilityIndex* index, int handle, int type, int locationId) {
+	int current = index->heapOf[handle];
+	if (current != AVAILABILITY_UNFILED) {
+		const AvailabilityHeap* heap = &index->heaps[current];
+		PLATFORM_PREFETCH(&heap->entries[index->positions[handle]]);
+		PLATFORM_PREFETCH(&heap->entries[heap->count - 1]);
+	}
+	int target = HeapOf(type, locationId);
+	if (target != current && target != AVAILABILITY_UNFILED && target < index->heapCount && index->heaps[target].entries != NULL) {
+		const AvailabilityHeap* heap = &index->heaps[target];
+		PLATFORM_PREFETCH(heap->entries);
+		PLATFORM_PREFETCH(&heap->entries[heap->count]);
+	}
+}
+
+static const AvailabilityHeap* FindHeap(const AvailabilityIndex* index, int type, int locationId) {
+	int heap = HeapOf(type, locationId);
+	if (heap == AVAILABILITY_UNFILED || heap >= index->heapCount || index->heaps[heap].count == 0) {
+		return NULL;
+	}
+	return &index->heaps[heap];
+}
+
+int AvailabilityBest(const AvailabilityIndex* index, int type, int locationId) {
+	const AvailabilityHeap* heap = FindHeap(index, type, locationId);
+	return heap != NULL ? heap->entries[0].handle : -1;
+}
+
+// The frontier holds heap positions whose parents were already taken, best handle first
+static void PushFrontier(const AvailabilityEntry* entries, int* frontier, int* count, int position) {
+	int child = (*count)++;
+	while (child > 0) {
+		int parent = (child - 1) / 2;
+		if (!Better(&entries[position], &entries[frontier[parent]])) {
+			break;
+		}
+		frontier[child] = frontier[parent];
+		child = parent;
+	}
+	frontier[child] = position;
+}
+
+static int PopFrontier(const AvailabilityEntry* entries, int* frontier, int* count) {
+	int top = frontier[0];
+	int moved = frontier[--(*count)];
+	int position = 0;
+	for (;;) {
+		int best = 2 * position + 1;
+		if (best >= *count) {
+			break;
+		}
+		if (best + 1 < *count && Better(&entries[frontier[best + 1]], &entries[frontier[best]])) {
+			best++;
+		}
+		if (!Better(&entries[frontier[best]], &entries[moved])) {
+			break;
+		}
+		frontier[position] = frontier[best];
+		position = best;
+	}
+	if (*count > 0) {
+		frontier[position] = moved;
+	}
+	return top;
+}
+
+int AvailabilityTop(const AvailabilityIndex* index, int type, int locationId, int k, int* handles) {
+	const AvailabilityHeap* heap = FindHeap(index, type, locationId);
+	if (heap == NULL || k <= 0) {
+		return 0;
+	}
+	if (k > heap->count) {
+		k = heap->count;
+	}
+
+	// Every pop adds at most two children, so the frontier never holds more than k + 1 positions
+	int* frontier = (int*)malloc((k + 1) * sizeof(int));
+	if (frontier == NULL) {
+		return 0;
+	}
+	int frontierCount = 0;
+	PushFrontier(heap->entries, frontier, &frontierCount, 0);
+
+	int found = 0;
+	while (found < k) {
+		int position = PopFrontier(heap->entries, frontier, &frontierCount);
+		handles[found++] = heap->entries[position].handle;
+		for (int child = 2 * position + 1; child <= 2 * position + 2 && child < heap->count; child++) {
+			PushFrontier(heap->entries, frontier, &frontierCount, child);
+		}
+	}
+
+	free(frontier);
+	return found;
+}
+
+void AvailabilityFree(AvailabilityIndex* index) {
+	for (int heap = 0; heap < index->heapCount; heap++) {
+		free(index->heaps[heap].entries);
+	}
+	free(index->heaps);
+	free(index->heapOf);
+	free(index->positions);
+	memset(index, 0, sizeof(AvailabilityIndex));
+}
@@ -0,0 +1,129 @@
+/**
+ * @file   availabilityIndex.h
+ * @brief  This file includes the index of the vehicles of every type in every location, best charged first.
+ *
+ * Every (type, location) pair has an indexed binary max-heap of handles
+ * ordered by battery level, then by lower cost. Every handle remembers its
+ * heap and its position inside it, so a vehicle whose battery or location
+ * changes is moved in O(log n) without searching for it. The battery level
+ * and cost are kept next to the handle in the heap, so a sift compares
+ * entries of one array instead of looking up the key of every handle. The best vehicle of a
+ * pair is the root of its heap, and the k best are read in O(k log k) by
+ * walking the heap from the root without changing it.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef AVAILABILITY_INDEX_H
+#define AVAILABILITY_INDEX_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define AVAILABILITY_TYPE_COUNT 8        /**< Vehicle types 0 to AVAILABILITY_TYPE_COUNT - 1 are indexed. */
+#define AVAILABILITY_UNFILED (-1)        /**< Heap stored for handles that are not indexed. */
+
+/**
+ * @brief Vehicle in a heap together with the key it is ordered by.
+ */
+typedef struct AvailabilityEntry {
+	float battery;                  /**< Battery level the handle is ordered by. */
+	float cost;                     /**< Cost used to break ties between equal battery levels. */
+	int handle;                     /**< Handle of the vehicle. */
+} AvailabilityEntry;
+
+/**
+ * @brief Heap of the vehicles of one type in one location.
+ */
+typedef struct AvailabilityHeap {
+	AvailabilityEntry* entries;     /**< Vehicles in heap order, the best one first. */
+	int count;                      /**< Number of vehicles in the heap. */
+	int capacity;                   /**< Size of entries. */
+} AvailabilityHeap;
+
+/**
+ * @brief Heaps of every (type, location) pair together with the position of every handle.
+ */
+typedef struct AvailabilityIndex {
+	AvailabilityHeap* heaps;        /**< Heaps indexed by location * AVAILABILITY_TYPE_COUNT + type. */
+	int heapCount;                  /**< Number of heaps allocated. */
+	int* heapOf;                    /**< Heap each handle is in, AVAILABILITY_UNFILED if none. */
+	int* positions;                 /**< Position of each handle inside its heap. */
+	int capacity;                   /**< Number of handles the per-handle arrays can hold. */
+} AvailabilityIndex;
+
+/**
+ * @brief Makes sure the index can hold a number of handles.
+ *
+ * @param index The index.
+ * @param capacity The required number of handles.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int AvailabilityReserve(AvailabilityIndex* index, int capacity);
+
+/**
+ * @brief Files a handle under its type and location, or moves it after its battery, cost or location changed.
+ *
+ * Handles with a negative location or a type outside the indexed range are kept out of every heap.
+ *
+ * @param index The index.
+ * @param handle The handle, lower than the reserved capacity.
+ * @param type The type of the vehicle.
+ * @param locationId The location of the vehicle.
+ * @param battery The battery level of the vehicle.
+ * @param cost The cost of the vehicle.
+ * @return 1 on success, 0 if memory could not be allocated (the handle is then left unfiled).
+ */
+int AvailabilityFile(AvailabilityIndex* index, int handle, int type, int locationId, float battery, float cost);
+
+/**
+ * @brief Starts loading the heaps an AvailabilityFile of a handle will touch, so a batch of moves overlaps its cache misses.
+ *
+ * @param index The index.
+ * @param handle The handle, lower than the reserved capacity.
+ * @param type The type of the vehicle.
+ * @param locationId The location the handle will be filed under.
+ */
+void AvailabilityPrefetch(const AvailabilityIndex* index, int handle, int type, int locationId);
+
+/**
+ * @brief Takes a handle out of its heap.
+ *
+ * @param index The index.
+ * @param handle The handle.
+ */
+void AvailabilityRemove(AvailabilityIndex* index, int handle);
+
+/**
+ * @brief Gets the best charged vehicle of a type in a location.
+ *
+ * @param index The index.
+ * @param type The type of vehicle.
+ * @param locationId The location.
+ * @return The handle, -1 if there is no such vehicle.
+ */
+int AvailabilityBest(const AvailabilityIndex* index, int type, int locationId);
+
+/**
+ * @brief Gets the best charged vehicles of a type in a location, best first.
+ *
+ * @param index The index.
+ * @param type The type of vehicle.
+ * @param locationId The location.
+ * @param k The number of vehicles wanted.
+ * @param handles Output array with room for k handles.
+ * @return The number of handles written, at most k.
+ */
+int AvailabilityTop(const AvailabilityIndex* index, int type, int locationId, int k, int* handles);
+
+/**
+ * @brief Frees the memory used by the index and leaves it empty.
+ *
+ * @param index The index.
+ */
+void AvailabilityFree(AvailabilityIndex* index);
+
+#endif  // AVAILABILITY_INDEX_H
@@ -0,0 +1,467 @@
+#include "benchmark.h"
+#include "platform.h"
+#include "clients.h"
+#include "managers.h"
+#include "mobility.h"
+#include "locations.h"
+#include "distanceOracle.h"
+#include "telemetry.h"
+
+#define CLIENTS_TXT BENCHMARK_DIRECTORY "/clients.txt"
+#define CLIENTS_BIN BENCHMARK_DIRECTORY "/clients.bin"
+#define MANAGERS_TXT BENCHMARK_DIRECTORY "/managers.txt"
+#define MOBILITIES_TXT BENCHMARK_DIRECTORY "/mobilities.txt"
+#define MOBILITIES_BIN BENCHMARK_DIRECTORY "/mobilities.bin"
+#define TELEMETRY_TXT BENCHMARK_DIRECTORY "/telemetry.txt"
+#define LOCATIONS_TXT BENCHMARK_DIRECTORY "/locations.txt"
+#define ROADS_TXT BENCHMARK_DIRECTORY "/locations_surroundings.txt"
+
+#define FIRST_NIF 100000000             // NIFs are handed out from here so they all have nine digits
+#define NIF_STRIDE 7919                 // Prime that scatters the NIFs over the file
+
+static const char* districts[] = {
+	"Aveiro", "Beja", "Braga", "Braganca", "Castelo Branco", "Coimbra", "Evora", "Faro", "Guarda",
+	"Leiria", "Lisboa", "Portalegre", "Porto", "Santarem", "Setubal", "Viana do Castelo", "Vila Real", "Viseu"
+};
+#define DISTRICT_COUNT ((int)(sizeof(districts) / sizeof(districts[0])))
+
+typedef struct BenchmarkRun {
+	const BenchmarkOptions* options;
+	BenchmarkResult results[BENCHMARK_MAX_RESULTS];
+	int resultCount;
+	unsigned long long random;      // State of the xorshift generator
+} BenchmarkRun;
+
+void InitBenchmarkOptions(BenchmarkOptions* options) {
+	options->records = 100000;
+	options->managers = 1000;
+	options->nodes = 10000;
+	options->shape = BenchmarkGrid;
+	options->format = BenchmarkCsv;
+	options->seed = 1;
+	options->output = NULL;
+	options->keepFiles = 0;
+}
+
+static unsigned long long NextRandom(unsigned long long* state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+static int RandomBelow(unsigned long long* state, int limit) {
+	return (int)(NextRandom(state) % (unsigned long long)limit);
+}
+
+static unsigned long long SeedRandom(unsigned int seed) {
+	return 0x9E3779B97F4A7C15ULL ^ ((unsigned long long)seed << 1);
+}
+
+// Every index gets a distinct NIF, in an order unrelated to the file order
+static int GetNif(int index, int count) {
+	int stride = count % NIF_STRIDE == 0 ? NIF_STRIDE + 2 : NIF_STRIDE;
+	return FIRST_NIF + (int)(((long long)index * stride) % count);
+}
+
+static int WriteClients(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(CLIENTS_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	for (int i = 0; i < options->records; i++) {
+		fprintf(file, "%d, %d.%02d, Client %d, Rua %d, %s\n", GetNif(i, options->records), RandomBelow(random, 1000),
+			RandomBelow(random, 100), i, RandomBelow(random, 1000) + 1, districts[RandomBelow(random, DISTRICT_COUNT)]);
+	}
+	return fclose(file) == 0;
+}
+
+static int WriteManagers(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(MANAGERS_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	for (int i = 0; i < options->managers; i++) {
+		fprintf(file, "%d, Manager %d, %s\n", GetNif(i, options->managers), i, districts[RandomBelow(random, DISTRICT_COUNT)]);
+	}
+	return fclose(file) == 0;
+}
+
+static int WriteMobilities(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(MOBILITIES_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	for (int id = 1; id <= options->records; id++) {
+		int type = RandomBelow(random, 4) + 1;
+		fprintf(file, "%d,%d,%d.0,%d.0,%d.0,%d.5,%d,%d,%d\n", id, type, RandomBelow(random, 101), RandomBelow(random, 20) + 1,
+			type == 3 ? 200 : 100, RandomBelow(random, 3) + 1, 15 + RandomBelow(random, 90), 20 + RandomBelow(random, 130),
+			RandomBelow(random, options->nodes) + 1);
+	}
+	return fclose(file) == 0;
+}
+
+// Reports of random vehicles with a clock that runs forward and some reports late; most only carry the battery level
+static int WriteTelemetry(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(TELEMETRY_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	long long updates = (long long)options->records * BENCHMARK_TELEMETRY_UPDATES;
+	for (long long i = 0; i < updates; i++) {
+		int id = RandomBelow(random, options->records) + 1;
+		long long timestamp = i - RandomBelow(random, 1000);
+		switch (RandomBelow(random, 8)) {
+		case 0:
+			fprintf(file, "%d,,%d,%lld\n", id, RandomBelow(random, options->nodes) + 1, timestamp);
+			break;
+		case 1:
+			fprintf(file, "%d,%d.0,%d,%lld\n", id, RandomBelow(random, 101), RandomBelow(random, options->nodes) + 1, timestamp);
+			break;
+		default:
+			fprintf(file, "%d,%d.0,,%lld\n", id, RandomBelow(random, 101), timestamp);
+			break;
+		}
+	}
+	return fclose(file) == 0;
+}
+
+static int WriteLocations(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(LOCATIONS_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	for (int id = 1; id <= options->nodes; id++) {
+		fprintf(file, "%d,%s,///place%d.road%d.point%d\n", id, districts[RandomBelow(random, DISTRICT_COUNT)], id,
+			RandomBelow(random, 1000), RandomBelow(random, 1000));
+	}
+	return fclose(file) == 0;
+}
+
+// Locations are numbered from 1, like the ones in Data
+static int WriteRoads(const BenchmarkOptions* options, unsigned long long* random) {
+	FILE* file = fopen(ROADS_TXT, "w");
+	if (file == NULL) {
+		return 0;
+	}
+
+	int nodes = options->nodes;
+	if (options->shape == BenchmarkGrid) {
+		int side = 1;
+		while ((long long)side * side < nodes) {
+			side++;
+		}
+		for (int cell = 0; cell < nodes; cell++) {
+			if ((cell + 1) % side != 0 && cell + 1 < nodes) {
+				fprintf(file, "%d,%d,%d\n", cell + 1, cell + 2, 10 + RandomBelow(random, 90));
+			}
+			if (cell + side < nodes) {
+				fprintf(file, "%d,%d,%d\n", cell + 1, cell + side + 1, 10 + RandomBelow(random, 90));
+			}
+		}
+	}
+	else {
+		// A random tree keeps every location reachable, the extra roads add cycles and one-way streets
+		for (int id = 2; id <= nodes; id++) {
+			fprintf(file, "%d,%d,%d\n", id, RandomBelow(random, id - 1) + 1, 10 + RandomBelow(random, 490));
+		}
+		for (int road = 0; road < nodes; road++) {
+			int origin = RandomBelow(random, nodes) + 1;
+			int destination = RandomBelow(random, nodes) + 1;
+			if (origin != destination) {
+				fprintf(file, "%d,%d,%d,%d\n", origin, destination, 10 + RandomBelow(random, 490), RandomBelow(random, 5) == 0);
+			}
+		}
+	}
+	return fclose(file) == 0;
+}
+
+int GenerateBenchmarkData(const BenchmarkOptions* options) {
+	unsigned long long random = SeedRandom(options->seed);
+
+	if (!PlatformCreateDirectory(BENCHMARK_DIRECTORY)) {
+		fprintf(stderr, "Could not create %s.\n", BENCHMARK_DIRECTORY);
+		return 0;
+	}
+	if (!WriteClients(options, &random) || !WriteManagers(options, &random) || !WriteMobilities(options, &random) ||
+		!WriteTelemetry(options, &random) || !WriteLocations(options, &random) || !WriteRoads(options, &random)) {
+		fprintf(stderr, "Could not write the benchmark data to %s.\n", BENCHMARK_DIRECTORY);
+		return 0;
+	}
+	return 1;
+}
+
+static void Record(BenchmarkRun* run, const char* name, long long size, long long operations, double seconds) {
+	if (run->resultCount == BENCHMARK_MAX_RESULTS) {
+		return;
+	}
+	BenchmarkResult* result = &run->results[run->resultCount++];
+	result->name = name;
+	result->size = size;
+	result->operations = operations;
+	result->seconds = seconds;
+	fprintf(stderr, "  %-32s %12lld ops %10.4f s\n", name, operations, seconds);
+}
+
+static ClientNode* ShuffleClients(ClientNode* head, int count, unsigned long long* random) {
+	ClientNode** nodes = (ClientNode**)malloc(count * sizeof(ClientNode*));
+	if (nodes == NULL || count < 2) {
+		free(nodes);
+		return head;
+	}
+
+	int found = 0;
+	for (ClientNode* current = head; current != NULL && found < count; current = current->next) {
+		nodes[found++] = current;
+	}
+	for (int i = found - 1; i > 0; i--) {
+		int other = RandomBelow(random, i + 1);
+		ClientNode* swap = nodes[i];
+		nodes[i] = nodes[other];
+		nodes[other] = swap;
+	}
+	for (int i = 0; i + 1 < found; i++) {
+		nodes[i]->next = nodes[i + 1];
+	}
+	nodes[found - 1]->next = NULL;
+
+	head = nodes[0];
+	free(nodes);
+	return head;
+}
+
+static int BenchmarkClients(BenchmarkRun* run) {
+	int records = run->options->records;
+
+	double started = PlatformGetTime();
+	ClientNode* clients = LoadClientsFromTextFile(CLIENTS_TXT);
+	Record(run, "LoadClientsFromTextFile", records, records, PlatformGetTime() - started);
+	if (clients == NULL) {
+		return 0;
+	}
+
+	started = PlatformGetTime();
+	SaveClientsToBinaryFile(clients, CLIENTS_BIN);
+	Record(run, "SaveClientsToBinaryFile", records, records, PlatformGetTime() - started);
+	FreeClients(clients);
+
+	started = PlatformGetTime();
+	clients = LoadClients(CLIENTS_BIN, CLIENTS_TXT);
+	Record(run, "LoadClients", records, records, PlatformGetTime() - started);
+	if (clients == NULL) {
+		return 0;
+	}
+
+	// The NIFs are formatted before the clock starts so only the search is timed
+	char (*nifs)[NIF_SIZE] = (char(*)[NIF_SIZE])malloc((size_t)BENCHMARK_HASH_LOOKUPS * NIF_SIZE);
+	if (nifs != NULL) {
+		for (int i = 0; i < BENCHMARK_HASH_LOOKUPS; i++) {
+			char nif[16];
+			snprintf(nif, sizeof(nif), "%d", GetNif(RandomBelow(&run->random, records), records));
+			memcpy(nifs[i], nif, NIF_SIZE);
+		}
+		int hits = 0;
+		started = PlatformGetTime();
+		for (int i = 0; i < BENCHMARK_HASH_LOOKUPS; i++) {
+			hits += FindClientByNif(clients, nifs[i]) != NULL;
+		}
+		Record(run, "FindClientByNif", records, BENCHMARK_HASH_LOOKUPS, PlatformGetTime() - started);
+		free(nifs);
+		if (hits != BENCHMARK_HASH_LOOKUPS) {
+			fprintf(stderr, "FindClientByNif missed %d clients.\n", BENCHMARK_HASH_LOOKUPS - hits);
+		}
+	}
+
+	clients = ShuffleClients(clients, records, &run->random);
+	started = PlatformGetTime();
+	clients = SortClients(clients);
+	Record(run, "SortClients", records, records, PlatformGetTime() - started);
+
+	FreeClients(clients);
+	return 1;
+}
+
+static int BenchmarkManagers(BenchmarkRun* run) {
+	int managers = run->options->managers;
+
+	double started = PlatformGetTime();
+	ManagerNode* head = LoadManagersFromTextFile(MANAGERS_TXT);
+	Record(run, "LoadManagersFromTextFile", managers, managers, PlatformGetTime() - started);
+
+	int ok = head != NULL || managers == 0;
+	FreeManagers(head);
+	return ok;
+}
+
+static int ApplyTelemetryBatch(const MobilityStatus* statuses, int count, void* context) {
+	UpdateMobilityStatuses((MobilityTable*)context, statuses, count);
+	return 1;
+}
+
+static int BenchmarkMobilities(BenchmarkRun* run) {
+	int records = run->options->records;
+
+	double started = PlatformGetTime();
+	MobilityTable* table = LoadMobilitiesFromTextFile(MOBILITIES_TXT);
+	Record(run, "LoadMobilitiesFromTextFile", records, records, PlatformGetTime() - started);
+	if (table == NULL) {
+		return 0;
+	}
+
+	started = PlatformGetTime();
+	SaveMobilitiesToBinaryFile(table, MOBILITIES_BIN);
+	Record(run, "SaveMobilitiesToBinaryFile", records, records, PlatformGetTime() - started);
+	FreeMobilities(table);
+
+	started = PlatformGetTime();
+	table = LoadMobilities(MOBILITIES_BIN, MOBILITIES_TXT);
+	Record(run, "LoadMobilities", records, records, PlatformGetTime() - started);
+	if (table == NULL) {
+		return 0;
+	}
+
+	int hits = 0;
+	started = PlatformGetTime();
+	for (int i = 0; i < BENCHMARK_HASH_LOOKUPS; i++) {
+		hits += FindMobilityById(table, RandomBelow(&run->random, records) + 1) != INVALID_MOBILITY_HANDLE;
+	}
+	Record(run, "FindMobilityById", records, BENCHMARK_HASH_LOOKUPS, PlatformGetTime() - started);
+	if (hits != BENCHMARK_HASH_LOOKUPS) {
+		fprintf(stderr, "FindMobilityById missed %d vehicles.\n", BENCHMARK_HASH_LOOKUPS - hits);
+	}
+
+	TelemetryOptions options;
+	TelemetryStats stats;
+	InitTelemetryOptions(&options);
+	int ok = IngestTelemetry(table, TELEMETRY_TXT, &options, ApplyTelemetryBatch, table, &stats);
+	Record(run, "IngestTelemetry", records, stats.read, stats.seconds);
+
+	FreeMobilities(table);
+	return ok;
+}
+
+static int BenchmarkRoutes(BenchmarkRun* run) {
+	int nodes = run->options->nodes;
+
+	double started = PlatformGetTime();
+	LocationNode* locations = LoadLocationsFromTextFile(LOCATIONS_TXT);
+	Record(run, "LoadLocationsFromTextFile", nodes, nodes, PlatformGetTime() - started);
+
+	started = PlatformGetTime();
+	LocationSurroundingsNode* roads = LoadLocationSurroundingsFromTextFile(ROADS_TXT);
+	double loaded = PlatformGetTime() - started;
+	long long roadCount = 0;
+	for (LocationSurroundingsNode* road = roads; road != NULL; road = road->next) {
+		roadCount++;
+	}
+	Record(run, "LoadLocationSurroundingsFromTextFile", nodes, roadCount, loaded);
+
+	started = PlatformGetTime();
+	RoadGraph* graph = BuildRoadGraph(roads);
+	Record(run, "BuildRoadGraph", nodes, roadCount, PlatformGetTime() - started);
+
+	int ok = graph != NULL;
+	if (ok) {
+		started = PlatformGetTime();
+		for (int i = 0; i < BENCHMARK_ROUTE_SOURCES; i++) {
+			FreeShortestPaths(FindShortestPaths(graph, RandomBelow(&run->random, nodes) + 1));
+		}
+		Record(run, "FindShortestPaths", nodes, BENCHMARK_ROUTE_SOURCES, PlatformGetTime() - started);
+
+		if (nodes <= BENCHMARK_ORACLE_MAX_NODES) {
+			started = PlatformGetTime();
+			DistanceOracle* oracle = BuildDistanceOracle(graph);
+			Record(run, "BuildDistanceOracle", nodes, 1, PlatformGetTime() - started);
+			FreeDistanceOracle(oracle);
+		}
+	}
+
+	FreeRoadGraph(graph);
+	FreeLocationSurroundings(roads);
+	FreeLocations(locations);
+	return ok;
+}
+
+static void WriteResults(const BenchmarkRun* run, FILE* file) {
+	const BenchmarkOptions* options = run->options;
+
+	if (options->format == BenchmarkCsv) {
+		fprintf(file, "benchmark,size,operations,seconds,ns_per_op\n");
+		for (int i = 0; i < run->resultCount; i++) {
+			const BenchmarkResult* result = &run->results[i];
+			fprintf(file, "%s,%lld,%lld,%.6f,%.1f\n", result->name, result->size, result->operations, result->seconds,
+				result->operations > 0 ? result->seconds * 1e9 / result->operations : 0.0);
+		}
+		return;
+	}
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"build\": \"%s %s\",\n", __DATE__, __TIME__);
+	fprintf(file, "  \"records\": %d,\n  \"managers\": %d,\n  \"nodes\": %d,\n", options->records, options->managers, options->nodes);
+	fprintf(file, "  \"shape\": \"%s\",\n  \"seed\": %u,\n", options->shape == BenchmarkGrid ? "grid" : "random", options->seed);
+	fprintf(file, "  \"results\": [\n");
+	for (int i = 0; i < run->resultCount; i++) {
+		const BenchmarkResult* result = &run->results[i];
+		fprintf(file, "    { \"benchmark\": \"%s\", \"size\": %lld, \"operations\": %lld, \"seconds\": %.6f, \"nsPerOp\": %.1f }%s\n",
+			result->name, result->size, result->operations, result->seconds,
+			result->operations > 0 ? result->seconds * 1e9 / result->operations : 0.0,
+			i + 1 < run->resultCount ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+}
+
+static void RemoveBenchmarkData(void) {
+	remove(CLIENTS_TXT);
+	remove(CLIENTS_BIN);
+	remove(MANAGERS_TXT);
+	remove(MOBILITIES_TXT);
+	remove(MOBILITIES_BIN);
+	remove(TELEMETRY_TXT);
+	remove(LOCATIONS_TXT);
+	remove(ROADS_TXT);
+	// Left in place if anything else was put there
+	PlatformRemoveDirectory(BENCHMARK_DIRECTORY);
+}
+
+int RunBenchmarks(const BenchmarkOptions* options) {
+	BenchmarkRun run;
+	memset(&run, 0, sizeof(BenchmarkRun));
+	run.options = options;
+	run.random = SeedRandom(options->seed + 1);
+
+	if (options->records < 1 || options->nodes < 2 || options->managers < 0) {
+		fprintf(stderr, "The benchmark needs at least 1 record and 2 locations.\n");
+		return 0;
+	}
+
+	fprintf(stderr, "Generating %d clients, %d managers, %d vehicles and a %s network of %d locations in %s...\n",
+		options->records, options->managers, options->records, options->shape == BenchmarkGrid ? "grid" : "random",
+		options->nodes, BENCHMARK_DIRECTORY);
+	double started = PlatformGetTime();
+	if (!GenerateBenchmarkData(options)) {
+		return 0;
+	}
+	fprintf(stderr, "Generated in %.2f s.\n", PlatformGetTime() - started);
+
+	int ok = BenchmarkClients(&run) && BenchmarkManagers(&run) && BenchmarkMobilities(&run) && BenchmarkRoutes(&run);
+	if (!ok) {
+		fprintf(stderr, "The benchmark data could not be loaded.\n");
+	}
+
+	FILE* file = options->output != NULL ? fopen(options->output, "w") : stdout;
+	if (file == NULL) {
+		fprintf(stderr, "Could not write the results to %s.\n", options->output);
+		ok = 0;
+	}
+	else {
+		WriteResults(&run, file);
+		if (file != stdout) {
+			fclose(file);
+		}
+	}
+
+	if (!options->keepFiles) {
+		RemoveBenchmarkData();
+	}
+	return ok;
+}
@@ -0,0 +1,96 @@
+/**
+ * @file   benchmark.h
+ * @brief  This file includes the benchmark suite and the synthetic data it runs on.
+ *
+ * The generator writes clients, managers, vehicles, vehicle telemetry,
+ * locations and a road network of any size in the same text formats as the
+ * files under Data, so the real loaders read them. The suite then times the
+ * loaders, the binary snapshots, the lookups, the sort, the telemetry
+ * ingestion and the routing on that data and writes one row per measurement
+ * as CSV or JSON, which can be kept and compared between versions.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define BENCHMARK_DIRECTORY "Data/Benchmark"        /**< Directory the synthetic files are written to. */
+#define BENCHMARK_HASH_LOOKUPS 1000000              /**< Lookups timed on the indexed searches. */
+#define BENCHMARK_TELEMETRY_UPDATES 4               /**< Telemetry reports generated per vehicle. */
+#define BENCHMARK_ROUTE_SOURCES 10                  /**< Start locations timed on the shortest path search. */
+#define BENCHMARK_ORACLE_MAX_NODES 4096             /**< Largest network the distance table is built for. */
+#define BENCHMARK_MAX_RESULTS 32                    /**< Measurements a run can hold. */
+
+/**
+ * @brief Shapes of the synthetic road network.
+ */
+typedef enum {
+	BenchmarkGrid,                  /**< Square grid of two-way roads between neighbouring locations. */
+	BenchmarkRandom                 /**< Random spanning tree plus as many random roads, some of them one-way. */
+} BenchmarkGraphShape;
+
+/**
+ * @brief Formats of the results.
+ */
+typedef enum {
+	BenchmarkCsv,                   /**< One header line and one line per measurement. */
+	BenchmarkJson                   /**< One object with the settings and an array of measurements. */
+} BenchmarkFormat;
+
+/**
+ * @brief Sizes and settings of a benchmark run.
+ */
+typedef struct BenchmarkOptions {
+	int records;                    /**< Number of clients and of vehicles. */
+	int managers;                   /**< Number of managers. */
+	int nodes;                      /**< Number of locations. */
+	BenchmarkGraphShape shape;      /**< Shape of the road network. */
+	BenchmarkFormat format;         /**< Format of the results. */
+	unsigned int seed;              /**< Seed of the generator, the same seed gives the same files. */
+	const char* output;             /**< File the results are written to, NULL for the standard output. */
+	int keepFiles;                  /**< 1 to leave the synthetic files in BENCHMARK_DIRECTORY afterwards. */
+} BenchmarkOptions;
+
+/**
+ * @brief One measurement.
+ */
+typedef struct BenchmarkResult {
+	const char* name;               /**< Function measured. */
+	long long size;                 /**< Number of records or locations it ran on. */
+	long long operations;           /**< Number of calls, or of records for loaders and savers. */
+	double seconds;                 /**< Wall time of all operations. */
+} BenchmarkResult;
+
+/**
+ * @brief Fills options with the default sizes: 100000 records, 1000 managers and a 10000-location grid.
+ *
+ * @param options The options.
+ */
+void InitBenchmarkOptions(BenchmarkOptions* options);
+
+/**
+ * @brief Writes the synthetic text files into BENCHMARK_DIRECTORY.
+ *
+ * @param options The sizes and seed.
+ * @return 1 on success, 0 if a file could not be written.
+ */
+int GenerateBenchmarkData(const BenchmarkOptions* options);
+
+/**
+ * @brief Generates the data, runs every measurement and writes the results.
+ *
+ * Progress goes to stderr so the results can be redirected on their own.
+ *
+ * @param options The sizes, seed and output.
+ * @return 1 on success, 0 if the data could not be generated or loaded.
+ */
+int RunBenchmarks(const BenchmarkOptions* options);
+
+#endif  // BENCHMARK_H
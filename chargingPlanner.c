@@ -0,0 +1,493 @@
+#include "chargingPlanner.h"
+#include "chargingTour.h"
+#include "metrics.h"
+
+typedef struct Candidate {
+	MobilityHandle handle;
+	int location;
+	int weight;
+	long long nearestTruck;         // Distance from the closest truck, the sort key
+} Candidate;
+
+typedef struct RouteBuilder {
+	int stopCapacity;
+	int pickupCapacity;
+	unsigned char* present;         // 1 for every location already on the route
+} RouteBuilder;
+
+typedef struct RouteSearch {
+	const DistanceOracle* distances;
+	TruckRoute* routes;
+	double deadline;
+} RouteSearch;
+
+// Unreachable legs keep their INT_MAX length, which no sum of real legs can beat
+static long long Leg(const DistanceOracle* distances, int from, int to) {
+	return GetOracleDistance(distances, from, to);
+}
+
+static int Reserve(void** array, int* capacity, int needed, size_t size) {
+	if (needed <= *capacity) {
+		return 1;
+	}
+	int newCapacity = *capacity > 0 ? *capacity * 2 : 8;
+	while (newCapacity < needed) {
+		newCapacity *= 2;
+	}
+	void* grown = realloc(*array, newCapacity * size);
+	if (grown == NULL) {
+		return 0;
+	}
+	*array = grown;
+	*capacity = newCapacity;
+	return 1;
+}
+
+static int CompareCandidates(const void* a, const void* b) {
+	const Candidate* first = (const Candidate*)a;
+	const Candidate* second = (const Candidate*)b;
+	if (first->nearestTruck != second->nearestTruck) {
+		return first->nearestTruck > second->nearestTruck ? -1 : 1;
+	}
+	return first->handle - second->handle;
+}
+
+static long long RouteLength(const DistanceOracle* distances, const TruckRoute* route) {
+	long long length = 0;
+	int previous = route->depot;
+	for (int i = 0; i < route->stopCount; i++) {
+		length += Leg(distances, previous, route->stops[i]);
+		previous = route->stops[i];
+	}
+	return length + Leg(distances, previous, route->depot);
+}
+
+// Cheapest place for a new stop at location; returns the insertion index or -1 if the truck cannot reach it
+static int CheapestInsertion(const DistanceOracle* distances, const TruckRoute* route, int location, long long* cost) {
+	int bestPosition = -1;
+	long long best = 0;
+	for (int position = 0; position <= route->stopCount; position++) {
+		int previous = position == 0 ? route->depot : route->stops[position - 1];
+		int next = position == route->stopCount ? route->depot : route->stops[position];
+		long long there = Leg(distances, previous, location);
+		long long back = Leg(distances, location, next);
+		if (there == UNREACHABLE_DISTANCE || back == UNREACHABLE_DISTANCE) {
+			continue;
+		}
+		long long delta = there + back - Leg(distances, previous, next);
+		if (bestPosition < 0 || delta < best) {
+			best = delta;
+			bestPosition = position;
+		}
+	}
+	*cost = best;
+	return bestPosition;
+}
+
+static int AssignCandidate(const DistanceOracle* distances, ChargingPlan* plan, RouteBuilder* builders, const Candidate* candidate) {
+	int bestRoute = -1;
+	int bestPosition = -1;
+	long long best = 0;
+
+	for (int r = 0; r < plan->routeCount; r++) {
+		TruckRoute* route = &plan->routes[r];
+		if (route->load + candidate->weight > route->capacity) {
+			continue;
+		}
+		// A truck already stopping there takes the vehicle for free
+		if (candidate->location == route->depot || builders[r].present[candidate->location]) {
+			bestRoute = r;
+			bestPosition = -1;
+			break;
+		}
+		long long cost;
+		int position = CheapestInsertion(distances, route, candidate->location, &cost);
+		if (position >= 0 && (bestRoute < 0 || cost < best)) {
+			best = cost;
+			bestRoute = r;
+			bestPosition = position;
+		}
+	}
+	if (bestRoute < 0) {
+		return 0;
+	}
+
+	TruckRoute* route = &plan->routes[bestRoute];
+	RouteBuilder* builder = &builders[bestRoute];
+	if (!Reserve((void**)&route->pickups, &builder->pickupCapacity, route->pickupCount + 1, sizeof(MobilityHandle))) {
+		return 0;
+	}
+	if (bestPosition >= 0) {
+		if (!Reserve((void**)&route->stops, &builder->stopCapacity, route->stopCount + 1, sizeof(int))) {
+			return 0;
+		}
+		memmove(&route->stops[bestPosition + 1], &route->stops[bestPosition], (route->stopCount - bestPosition) * sizeof(int));
+		route->stops[bestPosition] = candidate->location;
+		route->stopCount++;
+		builder->present[candidate->location] = 1;
+	}
+	route->pickups[route->pickupCount++] = candidate->handle;
+	route->load += candidate->weight;
+	return 1;
+}
+
+// forward[k] is the length of tour[0..k] and backward[k] the length of the same legs driven the other way
+static void ComputePrefixLengths(const DistanceOracle* distances, const int* tour, int length, long long* forward, long long* backward) {
+	forward[0] = 0;
+	backward[0] = 0;
+	for (int k = 1; k < length; k++) {
+		forward[k] = forward[k - 1] + Leg(distances, tour[k - 1], tour[k]);
+		backward[k] = backward[k - 1] + Leg(distances, tour[k], tour[k - 1]);
+	}
+}
+
+// Reverses tour[i..j] when it shortens the tour; roads can be one-way, so the reversed legs are priced too
+static int TwoOptPass(const DistanceOracle* distances, int* tour, int stopCount, long long* forward, long long* backward, double deadline) {
+	int improvements = 0;
+	ComputePrefixLengths(distances, tour, stopCount + 2, forward, backward);
+	for (int i = 1; i < stopCount; i++) {
+		if (PlatformGetTime() > deadline) {
+			break;
+		}
+		for (int j = i + 1; j <= stopCount; j++) {
+			long long before = Leg(distances, tour[i - 1], tour[i]) + Leg(distances, tour[j], tour[j + 1]) + forward[j] - forward[i];
+			long long after = Leg(distances, tour[i - 1], tour[j]) + Leg(distances, tour[i], tour[j + 1]) + backward[j] - backward[i];
+			if (after < before) {
+				for (int a = i, b = j; a < b; a++, b--) {
+					int swap = tour[a];
+					tour[a] = tour[b];
+					tour[b] = swap;
+				}
+				ComputePrefixLengths(distances, tour, stopCount + 2, forward, backward);
+				improvements++;
+			}
+		}
+	}
+	return improvements;
+}
+
+// Moves the segment tour[i..i+length-1] so it follows tour[edge]
+static void MoveSegment(int* tour, int i, int length, int edge) {
+	int segment[3];
+	memcpy(segment, &tour[i], length * sizeof(int));
+	if (edge < i) {
+		memmove(&tour[edge + 1 + length], &tour[edge + 1], (i - edge - 1) * sizeof(int));
+		memcpy(&tour[edge + 1], segment, length * sizeof(int));
+	}
+	else {
+		memmove(&tour[i], &tour[i + length], (edge - i - length + 1) * sizeof(int));
+		memcpy(&tour[edge - length + 1], segment, length * sizeof(int));
+	}
+}
+
+// Moves runs of one to three stops elsewhere in the tour, keeping their direction
+static int OrOptPass(const DistanceOracle* distances, int* tour, int stopCount, double deadline) {
+	int improvements = 0;
+	for (int length = 1; length <= 3 && length < stopCount; length++) {
+		for (int i = 1; i + length - 1 <= stopCount; i++) {
+			if (PlatformGetTime() > deadline) {
+				return improvements;
+			}
+			int first = tour[i];
+			int last = tour[i + length - 1];
+			long long removed = Leg(distances, tour[i - 1], first) + Leg(distances, last, tour[i + length]) -
+				Leg(distances, tour[i - 1], tour[i + length]);
+
+			int bestEdge = -1;
+			long long best = removed;
+			for (int edge = 0; edge <= stopCount; edge++) {
+				if (edge >= i - 1 && edge <= i + length - 1) {
+					continue;
+				}
+				long long added = Leg(distances, tour[edge], first) + Leg(distances, last, tour[edge + 1]) -
+					Leg(distances, tour[edge], tour[edge + 1]);
+				if (added < best) {
+					best = added;
+					bestEdge = edge;
+				}
+			}
+			if (bestEdge >= 0) {
+				MoveSegment(tour, i, length, bestEdge);
+				improvements++;
+			}
+		}
+	}
+	return improvements;
+}
+
+static void ImproveWithLocalSearch(const DistanceOracle* distances, TruckRoute* route, double deadline) {
+	int n = route->stopCount;
+	int* tour = (int*)malloc((n + 2) * sizeof(int));
+	long long* forward = (long long*)malloc((n + 2) * sizeof(long long));
+	long long* backward = (long long*)malloc((n + 2) * sizeof(long long));
+	if (tour == NULL || forward == NULL || backward == NULL) {
+		free(tour);
+		free(forward);
+		free(backward);
+		return;
+	}
+
+	tour[0] = route->depot;
+	memcpy(&tour[1], route->stops, n * sizeof(int));
+	tour[n + 1] = route->depot;
+
+	int improved;
+	do {
+		improved = OrOptPass(distances, tour, n, deadline);
+		improved += TwoOptPass(distances, tour, n, forward, backward, deadline);
+		route->improvements += improved;
+	} while (improved > 0 && PlatformGetTime() <= deadline);
+
+	memcpy(route->stops, &tour[1], n * sizeof(int));
+	free(tour);
+	free(forward);
+	free(backward);
+}
+
+static void ImproveRoute(int index, void* context) {
+	RouteSearch* search = (RouteSearch*)context;
+	TruckRoute* route = &search->routes[index];
+	if (route->stopCount < 2) {
+		return;
+	}
+
+	if (route->stopCount <= CHARGING_PLAN_EXACT_STOPS) {
+		ChargingTour* tour = SolveChargingTour(search->distances, route->depot, route->stops, route->stopCount);
+		if (tour != NULL && tour->stopCount == route->stopCount + 1) {
+			if (memcmp(route->stops, &tour->order[1], route->stopCount * sizeof(int)) != 0) {
+				memcpy(route->stops, &tour->order[1], route->stopCount * sizeof(int));
+				route->improvements++;
+			}
+			FreeChargingTour(tour);
+			return;
+		}
+		FreeChargingTour(tour);
+	}
+
+	ImproveWithLocalSearch(search->distances, route, search->deadline);
+}
+
+// Sorts the pickups of a route by the position of their stop, depot first
+static void SortPickupsByStop(const MobilityTable* vehicles, TruckRoute* route, int* positions) {
+	MobilityHandle* sorted = (MobilityHandle*)malloc(route->pickupCount * sizeof(MobilityHandle) + 1);
+	int* counts = (int*)calloc(route->stopCount + 2, sizeof(int));
+	if (sorted == NULL || counts == NULL) {
+		free(sorted);
+		free(counts);
+		return;
+	}
+
+	for (int i = 0; i < route->stopCount; i++) {
+		positions[route->stops[i]] = i + 1;
+	}
+	positions[route->depot] = 0;
+	for (int p = 0; p < route->pickupCount; p++) {
+		counts[positions[vehicles->records[route->pickups[p]].locationId] + 1]++;
+	}
+	for (int i = 1; i <= route->stopCount + 1; i++) {
+		counts[i] += counts[i - 1];
+	}
+	for (int p = 0; p < route->pickupCount; p++) {
+		sorted[counts[positions[vehicles->records[route->pickups[p]].locationId]]++] = route->pickups[p];
+	}
+
+	memcpy(route->pickups, sorted, route->pickupCount * sizeof(MobilityHandle));
+	free(sorted);
+	free(counts);
+}
+
+void InitChargingPlanOptions(ChargingPlanOptions* options) {
+	options->batteryThreshold = CHARGING_PLAN_BATTERY_THRESHOLD;
+	options->timeBudget = CHARGING_PLAN_TIME_BUDGET;
+}
+
+static int CreateRoutes(const MobilityTable* vehicles, ChargingPlan* plan) {
+	const FleetColumns* columns = &vehicles->columns;
+	for (int slot = 0; slot < columns->count; slot++) {
+		plan->routeCount += columns->type[slot] == Trucks;
+	}
+	plan->routes = (TruckRoute*)calloc(plan->routeCount + 1, sizeof(TruckRoute));
+	if (plan->routes == NULL) {
+		return 0;
+	}
+
+	int r = 0;
+	for (int slot = 0; slot < columns->count; slot++) {
+		if (columns->type[slot] == Trucks) {
+			plan->routes[r].truck = slot;
+			plan->routes[r].depot = columns->locationId[slot];
+			plan->routes[r].capacity = columns->maxTransportWeight[slot];
+			r++;
+		}
+	}
+	return 1;
+}
+
+static Candidate* CollectCandidates(const MobilityTable* vehicles, const DistanceOracle* distances, const ChargingPlan* plan,
+	float batteryThreshold, int* count) {
+	const FleetColumns* columns = &vehicles->columns;
+	int* indices = (int*)malloc((columns->count + 1) * sizeof(int));
+	Candidate* candidates = (Candidate*)malloc((columns->count + 1) * sizeof(Candidate));
+	if (indices == NULL || candidates == NULL) {
+		free(indices);
+		free(candidates);
+		return NULL;
+	}
+
+	FleetFilter lowBattery = { FLEET_TYPE_BIT(Bicycles) | FLEET_TYPE_BIT(Scooters), batteryThreshold, FLEET_ANY_LOCATION };
+	*count = FleetSelectIndices(columns, &lowBattery, indices);
+	for (int i = 0; i < *count; i++) {
+		Candidate* candidate = &candidates[i];
+		candidate->handle = indices[i];
+		candidate->location = columns->locationId[indices[i]];
+		candidate->weight = columns->vehicleWeight[indices[i]];
+		candidate->nearestTruck = UNREACHABLE_DISTANCE;
+		for (int r = 0; r < plan->routeCount; r++) {
+			long long there = Leg(distances, plan->routes[r].depot, candidate->location);
+			long long back = Leg(distances, candidate->location, plan->routes[r].depot);
+			if (there != UNREACHABLE_DISTANCE && back != UNREACHABLE_DISTANCE && there + back < candidate->nearestTruck) {
+				candidate->nearestTruck = there + back;
+			}
+		}
+	}
+
+	// Farthest first: remote vehicles are placed while the trucks still have room, nearby ones fill the gaps
+	qsort(candidates, *count, sizeof(Candidate), CompareCandidates);
+	free(indices);
+	return candidates;
+}
+
+static void FreeBuilders(RouteBuilder* builders, int count) {
+	if (builders == NULL) {
+		return;
+	}
+	for (int r = 0; r < count; r++) {
+		free(builders[r].present);
+	}
+	free(builders);
+}
+
+ChargingPlan* PlanChargingRoutes(const MobilityTable* vehicles, const DistanceOracle* distances, const ChargingPlanOptions* options) {
+	METRICS_START(started);
+	double start = PlatformGetTime();
+	ChargingPlanOptions defaults;
+	if (options == NULL) {
+		InitChargingPlanOptions(&defaults);
+		options = &defaults;
+	}
+	if (vehicles == NULL || distances == NULL) {
+		METRICS_STOP(MetricPlanChargingRoutes, started);
+		return NULL;
+	}
+
+	ChargingPlan* plan = (ChargingPlan*)calloc(1, sizeof(ChargingPlan));
+	if (plan == NULL) {
+		METRICS_STOP(MetricPlanChargingRoutes, started);
+		return NULL;
+	}
+	int candidateCount = 0;
+	Candidate* candidates = NULL;
+	RouteBuilder* builders = NULL;
+	int ok = CreateRoutes(vehicles, plan);
+	if (ok) {
+		candidates = CollectCandidates(vehicles, distances, plan, options->batteryThreshold, &candidateCount);
+		builders = (RouteBuilder*)calloc(plan->routeCount + 1, sizeof(RouteBuilder));
+		plan->unassigned = (MobilityHandle*)malloc((candidateCount + 1) * sizeof(MobilityHandle));
+		ok = candidates != NULL && builders != NULL && plan->unassigned != NULL;
+	}
+	for (int r = 0; ok && r < plan->routeCount; r++) {
+		builders[r].present = (unsigned char*)calloc(distances->nodeCount + 1, 1);
+		ok = builders[r].present != NULL;
+	}
+	if (!ok) {
+		free(candidates);
+		FreeBuilders(builders, plan->routeCount);
+		FreeChargingPlan(plan);
+		METRICS_STOP(MetricPlanChargingRoutes, started);
+		return NULL;
+	}
+
+	for (int i = 0; i < candidateCount; i++) {
+		int reachable = candidates[i].nearestTruck != UNREACHABLE_DISTANCE &&
+			candidates[i].location >= 0 && candidates[i].location < distances->nodeCount;
+		if (!reachable || !AssignCandidate(distances, plan, builders, &candidates[i])) {
+			plan->unassigned[plan->unassignedCount++] = candidates[i].handle;
+		}
+	}
+	free(candidates);
+	FreeBuilders(builders, plan->routeCount);
+
+	for (int r = 0; r < plan->routeCount; r++) {
+		plan->constructionDistance += RouteLength(distances, &plan->routes[r]);
+	}
+
+	RouteSearch search = { distances, plan->routes, PlatformGetTime() + options->timeBudget };
+	PlatformParallelFor(plan->routeCount, ImproveRoute, &search);
+
+	int* positions = (int*)malloc((distances->nodeCount + 1) * sizeof(int));
+	for (int r = 0; r < plan->routeCount; r++) {
+		TruckRoute* route = &plan->routes[r];
+		long long length = RouteLength(distances, route);
+		route->distance = length > UNREACHABLE_DISTANCE ? UNREACHABLE_DISTANCE : (int)length;
+		plan->totalDistance += length;
+		if (positions != NULL) {
+			SortPickupsByStop(vehicles, route, positions);
+		}
+	}
+	free(positions);
+
+	plan->elapsed = PlatformGetTime() - start;
+	METRICS_STOP(MetricPlanChargingRoutes, started);
+	return plan;
+}
+
+int ApplyChargingPlan(MobilityTable* vehicles, const ChargingPlan* plan) {
+	int charged = 0;
+	for (int r = 0; r < plan->routeCount; r++) {
+		const TruckRoute* route = &plan->routes[r];
+		for (int p = 0; p < route->pickupCount; p++) {
+			const Mobility* current = GetMobility(vehicles, route->pickups[p]);
+			if (current == NULL) {
+				continue;
+			}
+			Mobility updated = *current;
+			updated.battery_level = 100;
+			UpdateMobilityByHandle(vehicles, route->pickups[p], updated);
+			charged++;
+		}
+	}
+	return charged;
+}
+
+void PrintChargingPlan(const MobilityTable* vehicles, const ChargingPlan* plan) {
+	int collected = 0;
+	for (int r = 0; r < plan->routeCount; r++) {
+		const TruckRoute* route = &plan->routes[r];
+		collected += route->pickupCount;
+		printf("Truck %d from location %d: %d vehicles, %d/%d kg, %d km\n", vehicles->records[route->truck].id,
+			route->depot, route->pickupCount, route->load, route->capacity, route->distance);
+		if (route->stopCount > 0) {
+			printf("  %d", route->depot);
+			for (int i = 0; i < route->stopCount; i++) {
+				printf(" -> %d", route->stops[i]);
+			}
+			printf(" -> %d\n", route->depot);
+		}
+	}
+	printf("Vehicles collected: %d, left behind: %d\n", collected, plan->unassignedCount);
+	printf("Total distance: %lld km (%lld km before improving)\n", plan->totalDistance, plan->constructionDistance);
+	printf("Planned in %.3f s\n", plan->elapsed);
+}
+
+void FreeChargingPlan(ChargingPlan* plan) {
+	if (plan == NULL) {
+		return;
+	}
+	for (int r = 0; r < plan->routeCount; r++) {
+		free(plan->routes[r].stops);
+		free(plan->routes[r].pickups);
+	}
+	free(plan->routes);
+	free(plan->unassigned);
+	free(plan);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file   chargingPlanner.h
+ * @brief  This file includes the planner that shares the low-battery vehicles between the charging trucks.
+ *
+ * Every truck leaves its own location, collects bicycles and scooters whose
+ * battery is low without going over its maxTransportWeight, and returns. The
+ * routes are built by cheapest insertion, taking the vehicles farthest from
+ * any truck first, and then shortened by 2-opt and or-opt moves until no move
+ * helps or the time budget runs out. Once the vehicles are shared out the
+ * routes are independent, so each truck's route is improved on its own thread;
+ * routes with only a few stops are solved exactly with SolveChargingTour.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef CHARGING_PLANNER_H
+#define CHARGING_PLANNER_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "mobility.h"
+#include "distanceOracle.h"
+
+#define CHARGING_PLAN_BATTERY_THRESHOLD 50.0f  /**< Vehicles with less battery than this are collected. */
+#define CHARGING_PLAN_TIME_BUDGET 2.0          /**< Default wall-clock seconds for improving the routes. */
+#define CHARGING_PLAN_EXACT_STOPS 12           /**< Routes with up to this many stops are solved exactly. */
+
+/**
+ * @brief Settings of the planner.
+ */
+typedef struct ChargingPlanOptions {
+	float batteryThreshold;         /**< Vehicles with less battery than this are collected. */
+	double timeBudget;              /**< Wall-clock seconds allowed for improving the routes. */
+} ChargingPlanOptions;
+
+/**
+ * @brief Route of one truck.
+ */
+typedef struct TruckRoute {
+	MobilityHandle truck;           /**< Handle of the truck. */
+	int depot;                      /**< Location where the truck starts and ends. */
+	int capacity;                   /**< maxTransportWeight of the truck. */
+	int load;                       /**< Weight of the vehicles collected. */
+	int stopCount;                  /**< Number of stops, the depot not included. */
+	int* stops;                     /**< Location ids in visiting order. */
+	int pickupCount;                /**< Number of vehicles collected. */
+	MobilityHandle* pickups;        /**< Vehicles collected, in the order of their stops. */
+	int distance;                   /**< Length of the route including the way back. */
+	int improvements;               /**< Moves that shortened the route. */
+} TruckRoute;
+
+/**
+ * @brief Routes of every truck.
+ */
+typedef struct ChargingPlan {
+	int routeCount;                 /**< Number of trucks. */
+	TruckRoute* routes;             /**< One route per truck. */
+	int unassignedCount;            /**< Number of vehicles no truck could take. */
+	MobilityHandle* unassigned;     /**< Vehicles no truck could reach or carry. */
+	long long constructionDistance; /**< Total length of the routes before they were improved. */
+	long long totalDistance;        /**< Total length of the routes. */
+	double elapsed;                 /**< Seconds spent planning. */
+} ChargingPlan;
+
+/**
+ * @brief Fills the options with the default settings.
+ *
+ * @param options The options.
+ */
+void InitChargingPlanOptions(ChargingPlanOptions* options);
+
+/**
+ * @brief Plans the routes of every truck.
+ *
+ * @param vehicles The table of vehicles.
+ * @param distances The distances between every pair of locations.
+ * @param options The settings, NULL for the defaults.
+ * @return The plan, to be freed with FreeChargingPlan. If memory could not be allocated, returns NULL.
+ */
+ChargingPlan* PlanChargingRoutes(const MobilityTable* vehicles, const DistanceOracle* distances, const ChargingPlanOptions* options);
+
+/**
+ * @brief Charges every vehicle collected by a plan.
+ *
+ * @param vehicles The table of vehicles the plan was made for.
+ * @param plan The plan.
+ * @return The number of vehicles charged.
+ */
+int ApplyChargingPlan(MobilityTable* vehicles, const ChargingPlan* plan);
+
+/**
+ * @brief Prints the routes of a plan.
+ *
+ * @param vehicles The table of vehicles the plan was made for.
+ * @param plan The plan.
+ */
+void PrintChargingPlan(const MobilityTable* vehicles, const ChargingPlan* plan);
+
+/**
+ * @brief Frees a plan.
+ *
+ * @param plan The plan.
+ */
+void FreeChargingPlan(ChargingPlan* plan);
+
+#endif  // CHARGING_PLANNER_H
@@ -0,0 +1,198 @@
+#include "chargingTour.h"
+#include "metrics.h"
+
+// Masks of one subset size handed to a thread at a time
+#define CHARGING_TOUR_BLOCK_MASKS (1 << 14)
+
+// Cost of paths that do not exist; two of them still add up without overflowing
+#define TOUR_INFINITY (INT_MAX / 2)
+
+typedef struct HeldKarp {
+	int stopCount;
+	const int* distances;           // (stopCount + 1)^2, row and column 0 are the start
+	int* costs;                     // costs[mask * stopCount + end]: shortest path from the start through mask ending at end
+	int subsetSize;                 // Size of the subsets being solved
+	unsigned int maskCount;
+} HeldKarp;
+
+static int CountBits(unsigned int mask) {
+	int count = 0;
+	for (; mask != 0; mask &= mask - 1) {
+		count++;
+	}
+	return count;
+}
+
+// Best stop to come from when reaching end after visiting before; the row of before is contiguous
+static int BestPrevious(const HeldKarp* dp, unsigned int before, int end, int* cost) {
+	int n = dp->stopCount;
+	const int* row = dp->costs + (size_t)before * n;
+	int best = TOUR_INFINITY;
+	int bestPrevious = 0;
+	for (int previous = 0; previous < n; previous++) {
+		int through = row[previous] + dp->distances[(previous + 1) * (n + 1) + end + 1];
+		if (through < best) {
+			best = through;
+			bestPrevious = previous;
+		}
+	}
+	*cost = best;
+	return bestPrevious;
+}
+
+static void SolveSubsetBlock(int block, void* context) {
+	HeldKarp* dp = (HeldKarp*)context;
+	int n = dp->stopCount;
+	unsigned int first = (unsigned int)block * CHARGING_TOUR_BLOCK_MASKS;
+	unsigned int last = first + CHARGING_TOUR_BLOCK_MASKS < dp->maskCount ? first + CHARGING_TOUR_BLOCK_MASKS : dp->maskCount;
+
+	for (unsigned int mask = first; mask < last; mask++) {
+		if (CountBits(mask) != dp->subsetSize) {
+			continue;
+		}
+		// Ends outside the mask are written too, so later layers can scan whole rows without checking membership
+		int* row = dp->costs + (size_t)mask * n;
+		for (int end = 0; end < n; end++) {
+			row[end] = TOUR_INFINITY;
+			if (mask & (1u << end)) {
+				BestPrevious(dp, mask & ~(1u << end), end, &row[end]);
+			}
+		}
+	}
+}
+
+size_t GetChargingTourMemory(int stopCount) {
+	if (stopCount < 0 || stopCount > CHARGING_TOUR_MAX_STOPS) {
+		return 0;
+	}
+	size_t costs = ((size_t)1 << stopCount) * stopCount * sizeof(int);
+	size_t matrix = (size_t)(stopCount + 1) * (stopCount + 1) * sizeof(int);
+	return costs + matrix;
+}
+
+static ChargingTour* CreateTour(int stopCount) {
+	ChargingTour* tour = (ChargingTour*)calloc(1, sizeof(ChargingTour));
+	if (tour == NULL) {
+		return NULL;
+	}
+	tour->order = (int*)malloc((stopCount + 1) * sizeof(int));
+	if (tour->order == NULL) {
+		free(tour);
+		return NULL;
+	}
+	tour->memoryUsed = GetChargingTourMemory(stopCount);
+	return tour;
+}
+
+ChargingTour* SolveChargingTour(const DistanceOracle* oracle, int startLocation, const int* stops, int stopCount) {
+	METRICS_START(started);
+	if (oracle == NULL || stopCount < 0 || stopCount > CHARGING_TOUR_MAX_STOPS) {
+		METRICS_STOP(MetricSolveChargingTour, started);
+		return NULL;
+	}
+
+	ChargingTour* tour = CreateTour(stopCount);
+	if (tour == NULL) {
+		METRICS_STOP(MetricSolveChargingTour, started);
+		return NULL;
+	}
+	tour->order[0] = startLocation;
+	if (stopCount == 0) {
+		tour->stopCount = 1;
+		tour->cost = 0;
+		METRICS_STOP(MetricSolveChargingTour, started);
+		return tour;
+	}
+
+	// Compact matrix of the stops only, so the inner loop never touches the full oracle
+	int n = stopCount;
+	int* distances = (int*)malloc((size_t)(n + 1) * (n + 1) * sizeof(int));
+	int* costs = (int*)malloc(((size_t)1 << n) * n * sizeof(int));
+	if (distances == NULL || costs == NULL) {
+		free(distances);
+		free(costs);
+		FreeChargingTour(tour);
+		METRICS_STOP(MetricSolveChargingTour, started);
+		return NULL;
+	}
+	for (int i = 0; i <= n; i++) {
+		int from = i == 0 ? startLocation : stops[i - 1];
+		for (int j = 0; j <= n; j++) {
+			int to = j == 0 ? startLocation : stops[j - 1];
+			int distance = GetOracleDistance(oracle, from, to);
+			distances[i * (n + 1) + j] = distance >= TOUR_INFINITY ? TOUR_INFINITY : distance;
+		}
+	}
+
+	for (int end = 0; end < n; end++) {
+		int* row = costs + ((size_t)1 << end) * n;
+		for (int other = 0; other < n; other++) {
+			row[other] = other == end ? distances[end + 1] : TOUR_INFINITY;
+		}
+	}
+
+	HeldKarp dp = { n, distances, costs, 0, 1u << n };
+	int blocks = (int)((dp.maskCount + CHARGING_TOUR_BLOCK_MASKS - 1) / CHARGING_TOUR_BLOCK_MASKS);
+	for (int size = 2; size <= n; size++) {
+		dp.subsetSize = size;
+		PlatformParallelFor(blocks, SolveSubsetBlock, &dp);
+	}
+
+	unsigned int all = dp.maskCount - 1;
+	int best = TOUR_INFINITY;
+	int end = 0;
+	for (int last = 0; last < n; last++) {
+		int cost = costs[(size_t)all * n + last] + distances[(last + 1) * (n + 1)];
+		if (cost < best) {
+			best = cost;
+			end = last;
+		}
+	}
+
+	// No predecessor table is kept: each step back is found again from the costs, in O(n)
+	tour->cost = UNREACHABLE_DISTANCE;
+	if (best < TOUR_INFINITY) {
+		tour->cost = best;
+		tour->stopCount = n + 1;
+		unsigned int mask = all;
+		for (int position = n; position >= 1; position--) {
+			tour->order[position] = stops[end];
+			mask &= ~(1u << end);
+			if (mask != 0) {
+				int cost;
+				end = BestPrevious(&dp, mask, end, &cost);
+			}
+		}
+	}
+
+	free(distances);
+	free(costs);
+	METRICS_STOP(MetricSolveChargingTour, started);
+	return tour;
+}
+
+void PrintChargingTour(const ChargingTour* tour) {
+	if (tour == NULL) {
+		return;
+	}
+	if (tour->stopCount == 0) {
+		printf("No tour reaches every stop.\n");
+	}
+	else {
+		printf("Tour:");
+		for (int i = 0; i < tour->stopCount; i++) {
+			printf(" %d ->", tour->order[i]);
+		}
+		printf(" %d\n", tour->order[0]);
+		printf("Distance: %d\n", tour->cost);
+	}
+	printf("Solver memory: %.1f MiB\n", tour->memoryUsed / (1024.0 * 1024.0));
+}
+
+void FreeChargingTour(ChargingTour* tour) {
+	if (tour == NULL) {
+		return;
+	}
+	free(tour->order);
+	free(tour);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file   chargingTour.h
+ * @brief  This file includes the exact solver for the tour of the charging truck.
+ *
+ * The truck leaves a start location, visits every stop once and returns. The
+ * shortest such tour is found with the Held-Karp dynamic programme over
+ * subsets of stops, in O(2^n n^2) time instead of the O(n!) of trying every
+ * order. Subsets with the same number of stops only depend on the previous
+ * size, so each size is split across every processor. The tables grow as
+ * 2^n n, which is what limits the exact solver to a few dozen stops;
+ * GetChargingTourMemory tells how much a given number of stops needs.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef CHARGING_TOUR_H
+#define CHARGING_TOUR_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "distanceOracle.h"
+
+#define CHARGING_TOUR_MAX_STOPS 25        /**< Most stops the exact solver accepts, not counting the start. */
+
+/**
+ * @brief Shortest tour from a start location through every stop and back.
+ */
+typedef struct ChargingTour {
+	int stopCount;                  /**< Number of locations in order, start included; 0 if no tour exists. */
+	int* order;                     /**< Location IDs in visiting order, beginning with the start. */
+	int cost;                       /**< Length of the tour including the way back, UNREACHABLE_DISTANCE if no tour exists. */
+	size_t memoryUsed;              /**< Bytes used by the solver tables. */
+} ChargingTour;
+
+/**
+ * @brief Gets the number of bytes the solver needs for a number of stops.
+ *
+ * @param stopCount The number of stops, not counting the start.
+ * @return The size of the tables in bytes, 0 if stopCount is larger than CHARGING_TOUR_MAX_STOPS.
+ */
+size_t GetChargingTourMemory(int stopCount);
+
+/**
+ * @brief Finds the shortest tour from a start location through every stop and back.
+ *
+ * @param oracle The distances between every pair of locations.
+ * @param startLocation The start location id.
+ * @param stops The ids of the locations to visit, without repetitions or the start.
+ * @param stopCount The number of stops, at most CHARGING_TOUR_MAX_STOPS.
+ * @return The tour, to be freed with FreeChargingTour. If there are too many stops or memory could not be allocated, returns NULL.
+ */
+ChargingTour* SolveChargingTour(const DistanceOracle* oracle, int startLocation, const int* stops, int stopCount);
+
+/**
+ * @brief Prints the visiting order, length and memory use of a tour.
+ *
+ * @param tour The tour.
+ */
+void PrintChargingTour(const ChargingTour* tour);
+
+/**
+ * @brief Frees a tour.
+ *
+ * @param tour The tour.
+ */
+void FreeChargingTour(ChargingTour* tour);
+
+#endif  // CHARGING_TOUR_H
@@ -1,20 +1,97 @@
 // clients.c
 #include "clients.h"
+#include "nifIndex.h"
+#include "nameIndex.h"
+#include "collation.h"
+#include "utilis.h"
+#include "snapshot.h"
+#include "csvReader.h"
+#include "nodePool.h"
+#include "metrics.h"
 
-#define MAX_LINE_LENGTH 256
+#include <stddef.h>
 
-ClientNode* AddClient(ClientNode* head, Client newClient) {
-	ClientNode* newNode = (ClientNode*)malloc(sizeof(ClientNode));
-	newNode->client = newClient;
+
+static void GetClientKey(const void* value, const char** key, const char** nif) {
+	const ClientNode* node = (const ClientNode*)value;
+	*key = node->sortKey;
+	*nif = node->client.nif;
+}
+
+static NifIndex clientIndex;
+static NameIndex clientNames = NAME_INDEX_INITIALIZER(GetClientKey);
+static NodePool clientPool = NODE_POOL_INITIALIZER("Client nodes", ClientNode);
+static StringArena clientStrings;
+
+typedef struct ClientRecordCursor {
+	ClientNode* node;               // Next node when saving a list
+	const Client* next;             // Next client when saving an array
+	const Client* end;              // End of the array
+	StringTable strings;            // Strings of every client, collected before writing
+	ClientRecord record;            // Record handed to the snapshot writer
+} ClientRecordCursor;
+
+// Replaces the strings of a client with their copies in the arena of the list
+static int InternClientStrings(Client* client) {
+	const char* name = client->name != NULL ? client->name : "";
+	const char* address = client->address != NULL ? client->address : "";
+	client->name = InternString(&clientStrings, name, strlen(name));
+	client->address = InternString(&clientStrings, address, strlen(address));
+	return client->name != NULL && client->address != NULL;
+}
+
+// Builds the collation key of a name in the arena of the list; names are seldom shared, so keys are copied, not interned
+static const char* MakeClientSortKey(const char* name) {
+	char buffer[COLLATION_BUFFER];
+	size_t length;
+	char* key = BuildCollationKey(name, COLLATION_ALL_LEVELS, buffer, sizeof(buffer), &length);
+	if (key == NULL) {
+		return NULL;
+	}
+	const char* copy = CopyString(&clientStrings, key, length);
+	if (key != buffer) {
+		free(key);
+	}
+	return copy;
+}
+
+static ClientNode* CreateClientNode(Client client) {
+	// The first client with a NIF keeps it; a second one would leave the first reachable only through the list
+	if (NifIndexFind(&clientIndex, client.nif) != NULL || !InternClientStrings(&client)) {
+		return NULL;
+	}
+	const char* sortKey = MakeClientSortKey(client.name);
+	if (sortKey == NULL) {
+		return NULL;
+	}
+	ClientNode* newNode = (ClientNode*)PoolAlloc(&clientPool);
+	if (newNode == NULL) {
+		return NULL;
+	}
+	newNode->client = client;
+	newNode->sortKey = sortKey;
 	newNode->next = NULL;
+	if (!NifIndexInsert(&clientIndex, client.nif, newNode)) {
+		PoolFree(&clientPool, newNode);
+		return NULL;
+	}
+	return newNode;
+}
 
-	if (head == NULL || strcmp(newClient.name, head->client.name) < 0) {
+// Orders by the collation key of the name, then by NIF so clients with the same name have a fixed place in the index
+static int CompareClients(const ClientNode* a, const ClientNode* b) {
+	int order = strcmp(a->sortKey, b->sortKey);
+	return order != 0 ? order : strncmp(a->client.nif, b->client.nif, NIF_SIZE);
+}
+
+static ClientNode* InsertClientNode(ClientNode* head, ClientNode* newNode) {
+	if (head == NULL || CompareClients(newNode, head) < 0) {
 		newNode->next = head;
 		head = newNode;
 	}
 	else {
 		ClientNode* current = head;
-		while (current->next != NULL && strcmp(newClient.name, current->next->client.name) > 0) {
+		while (current->next != NULL && CompareClients(newNode, current->next) > 0) {
 			current = current->next;
 		}
 		newNode->next = current->next;
@@ -24,71 +101,369 @@ ClientNode* AddClient(ClientNode* head, Client newClient) {
 	return head;
 }
 
-/**/
+// Links a node after the one the name index puts before it; the list is always in the order of the index
+static ClientNode* LinkClientNode(ClientNode* head, ClientNode* newNode) {
+	ClientNode* previous = (ClientNode*)NameIndexPrevious(&clientNames, newNode->sortKey, newNode->client.nif);
+	if (previous == NULL) {
+		newNode->next = head;
+		return newNode;
+	}
+	newNode->next = previous->next;
+	previous->next = newNode;
+	return head;
+}
+
+// Finds the node before target through the name index, walking the list only if it was reordered by hand
+static ClientNode* FindPreviousClient(ClientNode* head, ClientNode* target) {
+	ClientNode* previous = (ClientNode*)NameIndexPrevious(&clientNames, target->sortKey, target->client.nif);
+	if (previous == NULL ? head == target : previous->next == target) {
+		return previous;
+	}
+
+	previous = head;
+	while (previous != NULL && previous->next != target) {
+		previous = previous->next;
+	}
+	return previous;
+}
+
+static ClientNode* UnlinkClientNode(ClientNode* head, ClientNode* target) {
+	ClientNode* previous = FindPreviousClient(head, target);
+	if (previous != NULL) {
+		previous->next = target->next;
+	}
+	else if (head == target) {
+		head = target->next;
+	}
+	return head;
+}
+
+// Sorts the nodes by collation key and links them in that order in a single pass
+static ClientNode* LinkSortedClients(ClientNode** nodes, size_t count) {
+	if (count == 0) {
+		return NULL;
+	}
+
+	if (!NameIndexSort(&clientNames, (void**)nodes, count)) {
+		ClientNode* sorted = NULL;
+		for (size_t i = 0; i < count; i++) {
+			sorted = InsertClientNode(sorted, nodes[i]);
+		}
+		return sorted;
+	}
+
+	for (size_t i = 0; i + 1 < count; i++) {
+		nodes[i]->next = nodes[i + 1];
+	}
+	nodes[count - 1]->next = NULL;
+	return nodes[0];
+}
+
+// Links the nodes of a bulk load and builds the name index from their sorted order
+static ClientNode* LinkLoadedClients(ClientNode** nodes, size_t count) {
+	ClientNode* head = LinkSortedClients(nodes, count);
+	NameIndexBuild(&clientNames, (void* const*)nodes, count);
+	return head;
+}
+
+// Returns 0 if memory ran out; the NIF must not be in the list yet
+static int AppendClientNode(ClientNode*** nodes, size_t* count, size_t* capacity, Client client) {
+	if (*count == *capacity) {
+		size_t newCapacity = *capacity == 0 ? 1024 : *capacity * 2;
+		ClientNode** grown = (ClientNode**)realloc(*nodes, newCapacity * sizeof(ClientNode*));
+		if (grown == NULL) {
+			return 0;
+		}
+		*nodes = grown;
+		*capacity = newCapacity;
+	}
+	ClientNode* newNode = CreateClientNode(client);
+	if (newNode == NULL) {
+		return 0;
+	}
+	(*nodes)[(*count)++] = newNode;
+	return 1;
+}
+
+// A partial list would be saved over the complete one later, so nothing of a failed load is kept
+static ClientNode* AbandonClientLoad(ClientNode** nodes, const char* filename) {
+	fprintf(stderr, "%s: out of memory, no clients were loaded\n", filename);
+	free(nodes);
+	FreeClients(NULL);
+	return NULL;
+}
+
+ClientNode* AddClient(ClientNode* head, Client newClient) {
+	ClientNode* newNode = CreateClientNode(newClient);
+	if (newNode == NULL) {
+		return head;
+	}
+	NameIndexInsert(&clientNames, newNode);
+	return LinkClientNode(head, newNode);
+}
+
 ClientNode* SortClients(ClientNode* head) {
-	ClientNode* sorted = NULL;
-	ClientNode* current = head;
-	while (current != NULL) {
-		ClientNode* next = current->next;
-		sorted = AddClient(sorted, current->client);
-		free(current);
-		current = next;
+	size_t count = 0;
+	for (ClientNode* current = head; current != NULL; current = current->next) {
+		count++;
+	}
+	if (count < 2) {
+		return head;
+	}
+
+	ClientNode** nodes = (ClientNode**)malloc(count * sizeof(ClientNode*));
+	if (nodes == NULL) {
+		return head;
 	}
-	return sorted;
+
+	size_t i = 0;
+	for (ClientNode* current = head; current != NULL; current = current->next) {
+		nodes[i++] = current;
+	}
+
+	head = LinkSortedClients(nodes, count);
+	free(nodes);
+	return head;
 }
 
 ClientNode* LoadClientsFromTextFile(const char* filename) {
-	FILE* file = fopen(filename, "r");
-	if (file == NULL) {
+	METRICS_START(started);
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		METRICS_STOP(MetricLoadClientsText, started);
 		return NULL;
 	}
 
-	ClientNode* head = NULL;
-	Client newClient;
-	while (fscanf(file, "%[^,],%lf,%[^,],%[^\n]\n", newClient.nif, &newClient.balance, newClient.name, newClient.address) == 4) {
-		head = AddClient(head, newClient);
+	ClientNode** nodes = NULL;
+	size_t count = 0, capacity = 0;
+	int fields;
+	while ((fields = ReadCsvRecord(&reader, 4)) > 0) {
+		if (fields != 4) {
+			ReportCsvError(&reader, "expected 4 fields: nif, balance, name, address");
+			continue;
+		}
+
+		Client newClient;
+		char name[MIN_LENGHT], address[MAX_LENGHT];
+		memset(&newClient, 0, sizeof(Client));
+		if (!CopyCsvString(&reader.fields[0], newClient.nif, NIF_SIZE) ||
+			!ParseCsvDouble(&reader.fields[1], &newClient.balance) ||
+			!CopyCsvString(&reader.fields[2], name, MIN_LENGHT) ||
+			!CopyCsvString(&reader.fields[3], address, MAX_LENGHT)) {
+			ReportCsvError(&reader, "invalid client record");
+			continue;
+		}
+		if (NifIndexFind(&clientIndex, newClient.nif) != NULL) {
+			ReportCsvError(&reader, "duplicate NIF, the first client with it is kept");
+			continue;
+		}
+		newClient.name = name;
+		newClient.address = address;
+		if (!AppendClientNode(&nodes, &count, &capacity, newClient)) {
+			CloseCsvReader(&reader);
+			METRICS_STOP(MetricLoadClientsText, started);
+			return AbandonClientLoad(nodes, filename);
+		}
 	}
+	CloseCsvReader(&reader);
 
-	fclose(file);
+	ClientNode* head = LinkLoadedClients(nodes, count);
+	free(nodes);
+	METRICS_STOP(MetricLoadClientsText, started);
 	return head;
 }
 
+static const Client* NextCursorClient(ClientRecordCursor* cursor) {
+	if (cursor->node != NULL) {
+		const Client* client = &cursor->node->client;
+		cursor->node = cursor->node->next;
+		return client;
+	}
+	return cursor->next != cursor->end ? cursor->next++ : NULL;
+}
+
+// The strings are all in the table already, so looking them up again cannot fail
+static const void* NextClientRecord(void* context) {
+	ClientRecordCursor* cursor = (ClientRecordCursor*)context;
+	const Client* client = NextCursorClient(cursor);
+	if (client == NULL) {
+		return NULL;
+	}
+
+	memset(&cursor->record, 0, sizeof(ClientRecord));
+	memcpy(cursor->record.nif, client->nif, NIF_SIZE);
+	cursor->record.balance = client->balance;
+	AddTableString(&cursor->strings, client->name, &cursor->record.name);
+	AddTableString(&cursor->strings, client->address, &cursor->record.address);
+	return &cursor->record;
+}
+
+// Collects the strings before the file is touched, so running out of memory leaves the old snapshot in place
+static int WriteClientSnapshot(ClientRecordCursor* cursor, const char* filename, unsigned long long journalSequence) {
+	ClientRecordCursor collect = *cursor;
+	const Client* client;
+	StringRef ref;
+	int ok = 1;
+	while (ok && (client = NextCursorClient(&collect)) != NULL) {
+		ok = AddTableString(&cursor->strings, client->name, &ref) && AddTableString(&cursor->strings, client->address, &ref);
+	}
+
+	ok = ok && WriteSnapshot(filename, SnapshotClients, sizeof(ClientRecord), journalSequence, NextClientRecord, cursor, &cursor->strings);
+	FreeStringTable(&cursor->strings);
+	return ok;
+}
+
 void SaveClientsToBinaryFile(ClientNode* head, const char* filename) {
-	FILE* file = fopen(filename, "wb");
-	if (file == NULL) {
-		return;
+	METRICS_START(started);
+	ClientRecordCursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.node = head;
+	WriteClientSnapshot(&cursor, filename, 0);
+	METRICS_STOP(MetricSaveClients, started);
+}
+
+int SaveClientArray(const Client* clients, size_t count, const char* filename, unsigned long long journalSequence) {
+	ClientRecordCursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.next = clients;
+	cursor.end = clients + count;
+	return WriteClientSnapshot(&cursor, filename, journalSequence);
+}
+
+size_t PackClient(const Client* client, unsigned char* buffer, size_t size) {
+	size_t nameSize = strlen(client->name) + 1;
+	size_t addressSize = strlen(client->address) + 1;
+	size_t packedSize = sizeof(ClientRecord) + nameSize + addressSize;
+	if (packedSize > size) {
+		return 0;
 	}
 
-	ClientNode* current = head;
-	while (current != NULL) {
-		fwrite(&(current->client), sizeof(Client), 1, file);
-		current = current->next;
+	ClientRecord record;
+	memset(&record, 0, sizeof(record));
+	memcpy(record.nif, client->nif, NIF_SIZE);
+	record.balance = client->balance;
+	record.name.offset = 0;
+	record.name.length = (unsigned int)(nameSize - 1);
+	record.address.offset = (unsigned int)nameSize;
+	record.address.length = (unsigned int)(addressSize - 1);
+
+	memcpy(buffer, &record, sizeof(record));
+	memcpy(buffer + sizeof(record), client->name, nameSize);
+	memcpy(buffer + sizeof(record) + nameSize, client->address, addressSize);
+	return packedSize;
+}
+
+static int UnpackLegacyClient(const unsigned char* data, Client* client) {
+	const char* name = (const char*)data + offsetof(LegacyClient, name);
+	const char* address = (const char*)data + offsetof(LegacyClient, address);
+	if (memchr(name, '\0', MIN_LENGHT) == NULL || memchr(address, '\0', MAX_LENGHT) == NULL) {
+		return 0;
 	}
 
-	fclose(file);
+	memcpy(client->nif, data + offsetof(LegacyClient, nif), NIF_SIZE);
+	client->nif[NIF_SIZE - 1] = '\0';
+	memcpy(&client->balance, data + offsetof(LegacyClient, balance), sizeof(double));
+	client->name = name;
+	client->address = address;
+	return 1;
 }
 
-ClientNode* LoadClientsFromBinaryFile(const char* filename) {
-	FILE* file = fopen(filename, "rb");
-	if (file == NULL) {
+// Fills a client from a record whose strings are in the given block
+static int UnpackClientRecord(const unsigned char* data, const char* strings, size_t stringSize, Client* client) {
+	ClientRecord record;
+	memcpy(&record, data, sizeof(record));
+
+	client->name = ResolveStringRef(strings, stringSize, record.name);
+	client->address = ResolveStringRef(strings, stringSize, record.address);
+	if (client->name == NULL || client->address == NULL) {
+		return 0;
+	}
+	memcpy(client->nif, record.nif, NIF_SIZE);
+	client->nif[NIF_SIZE - 1] = '\0';
+	client->balance = record.balance;
+	return 1;
+}
+
+int UnpackClient(const void* data, size_t size, unsigned int version, Client* client) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	if (version < 2) {
+		return size == sizeof(LegacyClient) && UnpackLegacyClient(bytes, client);
+	}
+	return size > sizeof(ClientRecord) &&
+		UnpackClientRecord(bytes, (const char*)bytes + sizeof(ClientRecord), size - sizeof(ClientRecord), client);
+}
+
+// Sets failed when memory ran out, rather than when there was nothing to load
+static ClientNode* ReadClientsSnapshot(const char* filename, int* failed) {
+	METRICS_START(started);
+	Snapshot snapshot;
+	SnapshotStatus status = OpenSnapshot(&snapshot, filename, SnapshotClients, sizeof(ClientRecord));
+	if (status == SnapshotMissing) {
+		METRICS_STOP(MetricLoadClientsBinary, started);
 		return NULL;
 	}
 
-	ClientNode* head = NULL;
-	Client temp;
+	// Anything but a current snapshot is read again with the fixed layout of the older versions
+	int legacy = status != SnapshotOk;
+	if (legacy) {
+		CloseSnapshot(&snapshot);
+		status = OpenSnapshot(&snapshot, filename, SnapshotClients, sizeof(LegacyClient));
+		if (status == SnapshotMissing) {
+			METRICS_STOP(MetricLoadClientsBinary, started);
+			return NULL;
+		}
+	}
 
-	while (fread(&temp, sizeof(Client), 1, file) == 1) {
-		head = AddClient(head, temp);
+	size_t records = status == SnapshotInvalid ? 0 : snapshot.recordCount;
+	size_t count = 0, capacity = records + 1;
+	ClientNode** nodes = (ClientNode**)malloc(capacity * sizeof(ClientNode*));
+	if (nodes == NULL) {
+		CloseSnapshot(&snapshot);
+		METRICS_STOP(MetricLoadClientsBinary, started);
+		*failed = 1;
+		return AbandonClientLoad(nodes, filename);
 	}
 
-	fclose(file);
+	for (size_t i = 0; i < records; i++) {
+		const unsigned char* record = (const unsigned char*)GetSnapshotRecord(&snapshot, i);
+		Client client;
+		int valid = legacy ? UnpackLegacyClient(record, &client) :
+			UnpackClientRecord(record, snapshot.strings, snapshot.stringSize, &client);
+		if (valid && NifIndexFind(&clientIndex, client.nif) == NULL && !AppendClientNode(&nodes, &count, &capacity, client)) {
+			CloseSnapshot(&snapshot);
+			METRICS_STOP(MetricLoadClientsBinary, started);
+			*failed = 1;
+			return AbandonClientLoad(nodes, filename);
+		}
+	}
+	unsigned long long journalSequence = snapshot.journalSequence;
+	CloseSnapshot(&snapshot);
+
+	ClientNode* head = LinkLoadedClients(nodes, count);
+	free(nodes);
+
+	// Rewrite files from older versions in the current format, still covering the journal operations they did
+	if (legacy && status != SnapshotInvalid && head != NULL) {
+		ClientRecordCursor cursor;
+		memset(&cursor, 0, sizeof(cursor));
+		cursor.node = head;
+		WriteClientSnapshot(&cursor, filename, journalSequence);
+	}
+	METRICS_STOP(MetricLoadClientsBinary, started);
 	return head;
 }
 
+ClientNode* LoadClientsFromBinaryFile(const char* filename) {
+	int failed = 0;
+	return ReadClientsSnapshot(filename, &failed);
+}
+
 ClientNode* LoadClients(const char* binFilename, const char* txtFilename) {
-	ClientNode* head = LoadClientsFromBinaryFile(binFilename);
+	int failed = 0;
+	ClientNode* head = ReadClientsSnapshot(binFilename, &failed);
 
-	if (head == NULL) {
+	// The text file is older than the snapshot, so it only stands in for a snapshot that is missing or empty
+	if (head == NULL && !failed) {
 		head = LoadClientsFromTextFile(txtFilename);
 	}
 
@@ -96,60 +471,96 @@ ClientNode* LoadClients(const char* binFilename, const char* txtFilename) {
 }
 
 void FreeClients(ClientNode* head) {
-	ClientNode* temp;
-
-	while (head != NULL)
-	{
-		temp = head;
-		head = head->next;
-		free(temp);
-	}
+	(void)head;
+	PoolRelease(&clientPool);
+	NifIndexClear(&clientIndex);
+	NameIndexClear(&clientNames);
+	ReleaseStringArena(&clientStrings);
 }
 
 ClientNode* DeleteClient(ClientNode* head, char* nif) {
+	METRICS_START(started);
 	if (head == NULL) {
+		METRICS_STOP(MetricDeleteClient, started);
 		return NULL;
 	}
 
-	if (strcmp(head->client.nif, nif) == 0) {
-		ClientNode* nextNode = head->next;
-		free(head);
-		return nextNode;
-	}
-
-	ClientNode* current = head;
-	while (current->next != NULL && strcmp(current->next->client.nif, nif) != 0) {
-		current = current->next;
+	ClientNode* target = (ClientNode*)NifIndexFind(&clientIndex, nif);
+	if (target == NULL) {
+		METRICS_STOP(MetricDeleteClient, started);
+		return head;
 	}
 
-	if (current->next == NULL) {
+	// A node that is not in this list stays indexed
+	ClientNode* previous = FindPreviousClient(head, target);
+	if (previous == NULL && head != target) {
+		METRICS_STOP(MetricDeleteClient, started);
 		return head;
 	}
 
-	ClientNode* nextNode = current->next->next;
-	free(current->next);
-	current->next = nextNode;
+	NifIndexRemove(&clientIndex, nif);
+	NameIndexRemove(&clientNames, target);
+	if (previous == NULL) {
+		head = target->next;
+	}
+	else {
+		previous->next = target->next;
+	}
+	PoolFree(&clientPool, target);
+	METRICS_STOP(MetricDeleteClient, started);
 	return head;
 }
 
-void UpdateClient(ClientNode* head, char* nif, Client updatedClient) {
-	ClientNode* current = head;
-	while (current != NULL && strcmp(current->client.nif, nif) != 0) {
-		current = current->next;
+ClientNode* UpdateClient(ClientNode* head, char* nif, Client updatedClient) {
+	METRICS_START(started);
+	ClientNode* current = FindClientByNif(head, nif);
+	int renamed = current != NULL && strncmp(current->client.nif, updatedClient.nif, NIF_SIZE) != 0;
+	if (current == NULL || (renamed && NifIndexFind(&clientIndex, updatedClient.nif) != NULL) || !InternClientStrings(&updatedClient)) {
+		METRICS_STOP(MetricUpdateClient, started);
+		return head;
+	}
+	// Interned names are equal only if they are the same string; a new name gets a key of its own
+	const char* sortKey = current->client.name == updatedClient.name ? current->sortKey : MakeClientSortKey(updatedClient.name);
+	if (sortKey == NULL) {
+		METRICS_STOP(MetricUpdateClient, started);
+		return head;
+	}
+
+	int moved = current->sortKey != sortKey || renamed;
+	if (moved) {
+		head = UnlinkClientNode(head, current);
+		NameIndexRemove(&clientNames, current);
 	}
 
-	if (current != NULL) {
-		current->client = updatedClient;
+	if (renamed) {
+		NifIndexRemove(&clientIndex, current->client.nif);
+		NifIndexInsert(&clientIndex, updatedClient.nif, current);
 	}
+	current->client = updatedClient;
+	current->sortKey = sortKey;
+
+	if (moved) {
+		NameIndexInsert(&clientNames, current);
+		head = LinkClientNode(head, current);
+	}
+	METRICS_STOP(MetricUpdateClient, started);
+	return head;
+}
+
+size_t FindClientsByName(ClientNode* head, const NameQuery* query, NameCursor* cursor, ClientNode** page, size_t pageSize) {
+	METRICS_START(started);
+	size_t count = head == NULL ? 0 : NameIndexPage(&clientNames, query, cursor, (void**)page, pageSize);
+	METRICS_STOP(MetricFindClientsByName, started);
+	return count;
 }
 
 ClientNode* FindClientByNif(ClientNode* head, char* nif) {
-	ClientNode* current = head;
-	while (current != NULL) {
-		if (strcmp(current->client.nif, nif) == 0) {
-			return current;
-		}
-		current = current->next;
+	METRICS_START(started);
+	if (head == NULL) {
+		METRICS_STOP(MetricFindClient, started);
+		return NULL;
 	}
-	return NULL;
+	ClientNode* found = (ClientNode*)NifIndexFind(&clientIndex, nif);
+	METRICS_STOP(MetricFindClient, started);
+	return found;
 }
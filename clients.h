@@ -12,18 +12,51 @@
 #pragma warning(disable:4996)
 
 #include "headers.h"
+#include "stringArena.h"
+#include "nameIndex.h"
 
 #define NIF_SIZE 10  /**< NIF size constant. */
+#define CLIENT_PACKED_MAX (sizeof(ClientRecord) + MIN_LENGHT + MAX_LENGHT)  /**< Largest client written by PackClient. */
+
+struct DataStore;
 
  /**
   * @brief Struct that represents a client.
+  *
+  * The strings of the clients in the list are interned: they live in the
+  * string arena of the list until FreeClients, and equal strings are shared.
+  * A Client passed to AddClient or UpdateClient may point anywhere, the
+  * strings are interned then.
   */
 typedef struct Client {
+	char nif[NIF_SIZE];               /**< Client's NIF. */
+	double balance;                   /**< Client's balance. */
+	const char* name;                 /**< Client's name. */
+	const char* address;              /**< Client's address. */
+} Client;
+
+/**
+ * @brief Client as stored in snapshots and in the journal.
+ *
+ * The strings are references into the block that follows the records of a
+ * snapshot, or into the bytes that follow the record in a journal entry.
+ */
+typedef struct ClientRecord {
+	char nif[NIF_SIZE];               /**< Client's NIF. */
+	double balance;                   /**< Client's balance. */
+	StringRef name;                   /**< Client's name. */
+	StringRef address;                /**< Client's address. */
+} ClientRecord;
+
+/**
+ * @brief Client as stored by snapshot version 1 and by the headerless files before it.
+ */
+typedef struct LegacyClient {
 	char nif[NIF_SIZE];               /**< Client's NIF. */
 	double balance;                   /**< Client's balance. */
 	char name[MIN_LENGHT];            /**< Client's name. */
 	char address[MAX_LENGHT];         /**< Client's address. */
-} Client;
+} LegacyClient;
 
 /**
  * @brief Node for linked list of Client struct.
@@ -31,11 +64,17 @@ typedef struct Client {
 typedef struct ClientNode {
 	Client client;                    /**< Client data for the node. */
 	struct ClientNode* next;          /**< Pointer to the next node in the list. */
+	const char* sortKey;              /**< Collation key of the name, in the string arena of the list. */
 } ClientNode;
 
 /**
  * @brief Adds a new client node to the list.
  *
+ * The list is kept ordered by the collation key of the name (see
+ * collation.h), then NIF; the name index finds the place
+ * of the new node without walking the list. A client whose NIF is already
+ * in the list is not added.
+ *
  * @param head The head of the list.
  * @param newClient The new Client data to be added.
  * @return A pointer to the new head of the list.
@@ -45,6 +84,9 @@ ClientNode* AddClient(ClientNode* head, Client newClient);
 /**
  * @brief Sorts the client nodes in the list.
  *
+ * The nodes are ordered like AddClient orders them, by comparing the
+ * collation keys built when they were added.
+ *
  * @param head The head of the list.
  * @return A pointer to the new head of the sorted list.
  */
@@ -54,15 +96,61 @@ ClientNode* SortClients(ClientNode* head);
  * @brief Loads client data from a text file into a linked list.
  *
  * @param filename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case no client is kept.
  */
 ClientNode* LoadClientsFromTextFile(const char* filename);
 
+/**
+ * @brief Saves client data from a linked list into a binary snapshot file.
+ *
+ * @param head The head of the list.
+ * @param filename The name of the binary file.
+ */
+void SaveClientsToBinaryFile(ClientNode* head, const char* filename);
+
+/**
+ * @brief Saves an array of clients into a binary snapshot file.
+ *
+ * @param clients The clients.
+ * @param count The number of clients.
+ * @param filename The name of the binary file.
+ * @param journalSequence The last journal operation included in the clients, 0 if unknown.
+ * @return 1 on success, 0 on failure.
+ */
+int SaveClientArray(const Client* clients, size_t count, const char* filename, unsigned long long journalSequence);
+
+/**
+ * @brief Packs a client into the layout stored in the journal.
+ *
+ * The packed client is a ClientRecord followed by its strings, which the
+ * record references by their offset from the end of the record.
+ *
+ * @param client The client.
+ * @param buffer Receives the packed client.
+ * @param size The size of buffer; CLIENT_PACKED_MAX always fits clients whose strings respect the usual limits.
+ * @return The size of the packed client, 0 if it does not fit.
+ */
+size_t PackClient(const Client* client, unsigned char* buffer, size_t size);
+
+/**
+ * @brief Reads back a client packed by PackClient, or stored in the fixed layout of snapshot version 1.
+ *
+ * @param data The packed client.
+ * @param size The size of the packed client.
+ * @param version The snapshot version whose layout the client has.
+ * @param client Receives the client, whose strings point into data.
+ * @return 1 on success, 0 if the data is not a valid client.
+ */
+int UnpackClient(const void* data, size_t size, unsigned int version, Client* client);
+
 /**
  * @brief Loads client data from a binary file into a linked list.
  *
+ * Headerless files and snapshots of version 1, which stored the strings in
+ * fixed-size arrays, are accepted and rewritten in the current format.
+ *
  * @param filename The name of the binary file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case no client is kept.
  */
 ClientNode* LoadClientsFromBinaryFile(const char* filename);
 
@@ -71,13 +159,16 @@ ClientNode* LoadClientsFromBinaryFile(const char* filename);
  *
  * @param binFilename The name of the binary file.
  * @param txtFilename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case the text file is not tried.
  */
 ClientNode* LoadClients(const char* binFilename, const char* txtFilename);
 
 /**
  * @brief Frees all the memory allocated for the linked list of Client.
  *
+ * Every client node lives in the same pool, and every string in the same
+ * arena, which are released at once.
+ *
  * @param head The head of the list.
  */
 void FreeClients(ClientNode* head);
@@ -94,11 +185,15 @@ ClientNode* DeleteClient(ClientNode* head, char* nif);
 /**
  * @brief Updates a client node in the list.
  *
+ * A client whose name or NIF changes is moved to its new place in the list.
+ * Changing the NIF to one another client has leaves the list as it was.
+ *
  * @param head The head of the list.
  * @param nif The NIF of the Client data to be updated.
  * @param updatedClient The updated Client data.
+ * @return A pointer to the new head of the list.
  */
-void UpdateClient(ClientNode* head, char* nif, Client updatedClient);
+ClientNode* UpdateClient(ClientNode* head, char* nif, Client updatedClient);
 
 /**
  * @brief Finds a client node in the list by its NIF.
@@ -109,14 +204,28 @@ void UpdateClient(ClientNode* head, char* nif, Client updatedClient);
  */
 ClientNode* FindClientByNif(ClientNode* head, char* nif);
 
+/**
+ * @brief Reads the next page of clients, in the order of the list, without walking the clients before it.
+ *
+ * The cursor keeps pointing into the strings of the list, so it must not be
+ * used after FreeClients.
+ *
+ * @param head The head of the list.
+ * @param query The names to read: a prefix, which ignores accents and case, a range or both. NULL for every client.
+ * @param cursor Where the previous page ended, zeroed for the first page; updated to where this one ends.
+ * @param page Receives the clients.
+ * @param pageSize The maximum number of clients to read.
+ * @return The number of clients read, 0 once there are no more.
+ */
+size_t FindClientsByName(ClientNode* head, const NameQuery* query, NameCursor* cursor, ClientNode** page, size_t pageSize);
+
 /**
  * @brief Displays the client menu.
  *
- * @param clients The list of clients.
+ * @param store The data store holding the list of clients.
  * @param loggedClient The client that is currently logged in.
- * @param binFilename The name of the binary file.
  */
-void ClientMenu(ClientNode* clients, ClientNode** loggedClient, const char* binFilename);
+void ClientMenu(struct DataStore* store, ClientNode** loggedClient);
 
 /**
  * @brief Prints the information of a specific client.
@@ -135,10 +244,11 @@ void PrintAllClients(ClientNode* head);
 /**
  * @brief Updates the information of a specific client.
  *
+ * The change is appended to the journal instead of rewriting the client file.
+ *
  * @param loggedClient The client whose information will be updated.
- * @param head The head of the list.
- * @param binFilename The name of the binary file.
+ * @param store The data store holding the list of clients.
  */
-void UpdateClientInfo(ClientNode** loggedClient, ClientNode* head, const char* binFilename);
+void UpdateClientInfo(ClientNode** loggedClient, struct DataStore* store);
 
 #endif  // CLIENTS_H
@@ -0,0 +1,198 @@
+#include "collation.h"
+
+#define LEVEL_SEPARATOR 1                   // Ends a level; lower than every weight so a shorter level sorts first
+#define SPACE_WEIGHT 2                      // Spaces and control characters
+#define SYMBOL_WEIGHT 0x24                  // First of the Latin-1 symbols, after the ASCII punctuation
+#define DIGIT_WEIGHT 0x45                   // '0'; the digits follow in order
+#define LETTER_WEIGHT 0x4F                  // 'a'; the letters follow in order
+#define THORN_WEIGHT (LETTER_WEIGHT + 26)   // þ sorts after z
+#define OTHER_WEIGHT (THORN_WEIGHT + 1)     // Followed by three bytes of the code point, always 0x80 or higher
+
+#define LETTER(c) (LETTER_WEIGHT + (c) - 'a')
+
+enum {
+	ACCENT_NONE = 2,
+	ACCENT_ACUTE,
+	ACCENT_GRAVE,
+	ACCENT_CIRCUMFLEX,
+	ACCENT_RING,
+	ACCENT_DIAERESIS,
+	ACCENT_TILDE,
+	ACCENT_CEDILLA,
+	ACCENT_STROKE
+};
+
+enum {
+	CASE_LOWER = 2,
+	CASE_UPPER,
+	CASE_LOWER_VARIANT,                     // ª, º, æ and ß: after the plain letters they stand for
+	CASE_UPPER_VARIANT
+};
+
+typedef struct LatinLetter {
+	unsigned char primary;                  // Weight of the letter
+	unsigned char expansion;                // Weight of a second letter it stands for, 0 if none
+	unsigned char accent;
+} LatinLetter;
+
+// U+00C0 to U+00DF; the lowercase letters are 0x20 higher, except ÷ and ÿ
+static const LatinLetter latinLetters[32] = {
+	{ LETTER('a'), 0, ACCENT_GRAVE },       { LETTER('a'), 0, ACCENT_ACUTE },       { LETTER('a'), 0, ACCENT_CIRCUMFLEX },
+	{ LETTER('a'), 0, ACCENT_TILDE },       { LETTER('a'), 0, ACCENT_DIAERESIS },   { LETTER('a'), 0, ACCENT_RING },
+	{ LETTER('a'), LETTER('e'), ACCENT_NONE }, { LETTER('c'), 0, ACCENT_CEDILLA },  { LETTER('e'), 0, ACCENT_GRAVE },
+	{ LETTER('e'), 0, ACCENT_ACUTE },       { LETTER('e'), 0, ACCENT_CIRCUMFLEX },  { LETTER('e'), 0, ACCENT_DIAERESIS },
+	{ LETTER('i'), 0, ACCENT_GRAVE },       { LETTER('i'), 0, ACCENT_ACUTE },       { LETTER('i'), 0, ACCENT_CIRCUMFLEX },
+	{ LETTER('i'), 0, ACCENT_DIAERESIS },   { LETTER('d'), 0, ACCENT_STROKE },      { LETTER('n'), 0, ACCENT_TILDE },
+	{ LETTER('o'), 0, ACCENT_GRAVE },       { LETTER('o'), 0, ACCENT_ACUTE },       { LETTER('o'), 0, ACCENT_CIRCUMFLEX },
+	{ LETTER('o'), 0, ACCENT_TILDE },       { LETTER('o'), 0, ACCENT_DIAERESIS },   { SYMBOL_WEIGHT + 31, 0, ACCENT_NONE },
+	{ LETTER('o'), 0, ACCENT_STROKE },      { LETTER('u'), 0, ACCENT_GRAVE },       { LETTER('u'), 0, ACCENT_ACUTE },
+	{ LETTER('u'), 0, ACCENT_CIRCUMFLEX },  { LETTER('u'), 0, ACCENT_DIAERESIS },   { LETTER('y'), 0, ACCENT_ACUTE },
+	{ THORN_WEIGHT, 0, ACCENT_NONE },       { LETTER('s'), LETTER('s'), ACCENT_NONE }
+};
+
+// Reads one character, taking a byte that does not start valid UTF-8 as Latin-1
+static unsigned int NextCharacter(const unsigned char** text) {
+	const unsigned char* current = *text;
+	unsigned int character = current[0];
+	int extra = character >= 0xF0 && character < 0xF5 ? 3 : character >= 0xE0 && character < 0xF0 ? 2 : character >= 0xC2 && character < 0xE0 ? 1 : 0;
+
+	unsigned int decoded = character & (0x3F >> extra);
+	int i = 1;
+	for (; i <= extra && (current[i] & 0xC0) == 0x80; i++) {
+		decoded = (decoded << 6) | (current[i] & 0x3F);
+	}
+	if (extra == 0 || i <= extra || (extra == 2 && decoded < 0x800) || (extra == 3 && (decoded < 0x10000 || decoded > 0x10FFFF))) {
+		*text = current + 1;
+		return character;
+	}
+	*text = current + extra + 1;
+	return decoded;
+}
+
+// Weight of a space, a control character or ASCII punctuation, in ASCII order
+static unsigned char PunctuationWeight(unsigned int character) {
+	if (character <= ' ' || character == 0x7F) {
+		return SPACE_WEIGHT;
+	}
+	if (character <= '/') {
+		return (unsigned char)(SPACE_WEIGHT + 1 + character - '!');
+	}
+	if (character <= '@') {
+		return (unsigned char)(SPACE_WEIGHT + 16 + character - ':');
+	}
+	if (character <= '`') {
+		return (unsigned char)(SPACE_WEIGHT + 23 + character - '[');
+	}
+	return (unsigned char)(SPACE_WEIGHT + 29 + character - '{');
+}
+
+char* BuildCollationKey(const char* text, int levels, char* buffer, size_t size, size_t* length) {
+	size_t textLength = strlen(text);
+	char* key = buffer;
+	if (key == NULL || size < COLLATION_KEY_SIZE(textLength)) {
+		key = (char*)malloc(COLLATION_KEY_SIZE(textLength));
+		if (key == NULL) {
+			return NULL;
+		}
+	}
+
+	// Every level gets up to two bytes per byte of text; the lower levels are built further on and moved back at the end
+	unsigned char* primary = (unsigned char*)key;
+	unsigned char* accents = primary + textLength * 2 + 1;
+	unsigned char* cases = accents + textLength * 2 + 1;
+	size_t count = 0;
+	size_t accentCount = 0;
+	size_t caseCount = 0;
+
+	const unsigned char* current = (const unsigned char*)text;
+	while (*current != '\0') {
+		unsigned int character = NextCharacter(&current);
+		unsigned char weights[4] = { 0 };
+		int weightCount = 1;
+		unsigned char accent = ACCENT_NONE;
+		unsigned char letterCase = CASE_LOWER;
+
+		if (character >= 'a' && character <= 'z') {
+			weights[0] = (unsigned char)LETTER(character);
+		}
+		else if (character >= 'A' && character <= 'Z') {
+			weights[0] = (unsigned char)LETTER(character - 'A' + 'a');
+			letterCase = CASE_UPPER;
+		}
+		else if (character >= '0' && character <= '9') {
+			weights[0] = (unsigned char)(DIGIT_WEIGHT + character - '0');
+		}
+		else if (character < 0x80) {
+			weights[0] = PunctuationWeight(character);
+		}
+		else if (character == 0xAA || character == 0xBA) {
+			weights[0] = (unsigned char)(character == 0xAA ? LETTER('a') : LETTER('o'));
+			letterCase = CASE_LOWER_VARIANT;
+		}
+		else if (character <= 0xA0) {
+			weights[0] = SPACE_WEIGHT;
+		}
+		else if (character < 0xC0) {
+			weights[0] = (unsigned char)(SYMBOL_WEIGHT + character - 0xA1);
+		}
+		else if (character == 0xF7) {
+			weights[0] = SYMBOL_WEIGHT + 32;
+		}
+		else if (character == 0xFF) {
+			weights[0] = (unsigned char)LETTER('y');
+			accent = ACCENT_DIAERESIS;
+		}
+		else if (character <= 0xFF) {
+			const LatinLetter* letter = &latinLetters[character & 0x1F];
+			int upper = character < 0xE0 && character != 0xDF;
+			weights[0] = letter->primary;
+			accent = letter->accent;
+			if (letter->expansion != 0) {
+				weights[weightCount++] = letter->expansion;
+				letterCase = upper ? CASE_UPPER_VARIANT : CASE_LOWER_VARIANT;
+			}
+			else if (upper && character != 0xD7) {
+				letterCase = CASE_UPPER;
+			}
+		}
+		else {
+			weights[0] = OTHER_WEIGHT;
+			weights[1] = (unsigned char)(0x80 | ((character >> 14) & 0x7F));
+			weights[2] = (unsigned char)(0x80 | ((character >> 7) & 0x7F));
+			weights[3] = (unsigned char)(0x80 | (character & 0x7F));
+			weightCount = 4;
+		}
+
+		// One accent and one case per primary byte, so keys with equal letters have lower levels of equal length
+		for (int i = 0; i < weightCount; i++) {
+			primary[count++] = weights[i];
+			accents[accentCount++] = i == 0 ? accent : ACCENT_NONE;
+			cases[caseCount++] = letterCase;
+		}
+	}
+
+	// Trailing plain accents and lowercase add nothing to the order, and most names are left with no lower levels at all
+	while (accentCount > 0 && accents[accentCount - 1] == ACCENT_NONE) {
+		accentCount--;
+	}
+	while (caseCount > 0 && cases[caseCount - 1] == CASE_LOWER) {
+		caseCount--;
+	}
+
+	if (levels > COLLATION_PRIMARY && (accentCount > 0 || caseCount > 0)) {
+		primary[count++] = LEVEL_SEPARATOR;
+		memmove(primary + count, accents, accentCount);
+		count += accentCount;
+		if (caseCount > 0) {
+			primary[count++] = LEVEL_SEPARATOR;
+			memmove(primary + count, cases, caseCount);
+			count += caseCount;
+		}
+	}
+	primary[count] = '\0';
+
+	if (length != NULL) {
+		*length = count;
+	}
+	return key;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file   collation.h
+ * @brief  This file includes the collation keys clients and managers are sorted by.
+ *
+ * Names are UTF-8 and Portuguese: "Álvaro", "João" and "Conceição" must sort
+ * next to "Alvaro", "Joao" and "Conceicao", which strcmp on their bytes does
+ * not do. A collation key turns a name into bytes whose plain byte order is
+ * the order of the names, so it is built once per record and every later
+ * comparison is a byte comparison, with no decoding.
+ *
+ * A key has three levels, each compared only when the ones before are equal:
+ * the letters without accents or case (a, c, e, i, o, u with any accent and
+ * ç are their plain letters), then the accents (none, acute, grave,
+ * circumflex, ring, diaeresis, tilde, cedilla), then the case, lower first.
+ * Spaces and punctuation sort before digits, digits before letters, and
+ * characters outside Latin-1 after them by code point. Bytes that are not
+ * valid UTF-8 are read as Latin-1, so older files still sort sensibly.
+ *
+ * Keys never hold a zero byte, so they are null-terminated strings that can
+ * be kept in a string arena and compared with strcmp, which orders them as
+ * memcmp would. The primary level alone is a prefix of the whole key, so a
+ * search by prefix that ignores accents and case is a byte prefix match.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef COLLATION_H
+#define COLLATION_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define COLLATION_PRIMARY 1                 /**< Only the letters, for searches that ignore accents and case. */
+#define COLLATION_ALL_LEVELS 3              /**< Letters, accents and case, for sorting. */
+#define COLLATION_BUFFER 256                /**< Buffer that holds the key of most names without allocating. */
+
+/**
+ * @brief Gets the bytes a key of a string of the given length may need, terminator included.
+ */
+#define COLLATION_KEY_SIZE(length) ((length) * 6 + 3)
+
+/**
+ * @brief Builds the collation key of a string.
+ *
+ * @param text The null-terminated UTF-8 string.
+ * @param levels COLLATION_PRIMARY or COLLATION_ALL_LEVELS.
+ * @param buffer Where to build the key if it is large enough.
+ * @param size The size of the buffer in bytes.
+ * @param length Receives the length of the key, without the terminator. May be NULL.
+ * @return The key: buffer if COLLATION_KEY_SIZE(strlen(text)) fits in it, else a copy allocated with malloc that the caller frees. NULL if memory could not be allocated.
+ */
+char* BuildCollationKey(const char* text, int levels, char* buffer, size_t size, size_t* length);
+
+#endif  // COLLATION_H
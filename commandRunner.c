@@ -0,0 +1,642 @@
+#include "commandRunner.h"
+#include "csvReader.h"
+#include "platform.h"
+
+#include <stdarg.h>
+
+#define COMMAND_MAX_FIELDS 10           // Fields after the name of the longest command (add-mobility)
+
+typedef struct CommandSpec {
+	const char* name;               // Name the command is written with
+	int fields;                     // Number of fields after the name
+	int optional;                   // Fields at the end that may be left out
+	int readOnly;                   // 1 when the command never changes the stores
+} CommandSpec;
+
+static const CommandSpec commandSpecs[CommandKindCount] = {
+	{ "add-client", 4, 0, 0 },
+	{ "update-client", 4, 0, 0 },
+	{ "delete-client", 1, 0, 0 },
+	{ "find-client", 1, 0, 1 },
+	{ "add-manager", 3, 0, 0 },
+	{ "update-manager", 3, 0, 0 },
+	{ "delete-manager", 1, 0, 0 },
+	{ "find-manager", 1, 0, 1 },
+	{ "add-mobility", 9, 0, 0 },
+	{ "update-mobility", 9, 0, 0 },
+	{ "delete-mobility", 1, 0, 0 },
+	{ "find-mobility", 1, 0, 1 },
+	{ "best-mobility", 2, 1, 1 },
+	{ "distance", 2, 0, 1 },
+	{ "route", 2, 0, 1 },
+	{ "reserve-vehicle", 2, 0, 1 },
+	{ "cancel-reservation", 2, 0, 1 },
+	{ "start-rental", 2, 0, 1 },
+	{ "end-rental", 2, 0, 1 },
+	{ "settle-rentals", 0, 0, 0 },
+	{ "invalid", 0, 0, 1 }
+};
+
+// Latencies of every command of one kind run by the batch
+typedef struct CommandTimings {
+	int count;                      // Commands run
+	int failed;                     // Commands that failed
+	double total;                   // Sum of the latencies in seconds
+	double* latencies;              // Latency of every command, sorted once the batch ends
+	int capacity;                   // Size of latencies
+} CommandTimings;
+
+const char* GetCommandName(CommandKind kind) {
+	if (kind < 0 || kind >= CommandKindCount) {
+		kind = CommandInvalid;
+	}
+	return commandSpecs[kind].name;
+}
+
+int IsReadOnlyCommand(CommandKind kind) {
+	if (kind < 0 || kind >= CommandKindCount) {
+		kind = CommandInvalid;
+	}
+	return commandSpecs[kind].readOnly;
+}
+
+static int Reply(char* reply, size_t replySize, int ok, const char* format, ...) {
+	int written = snprintf(reply, replySize, ok ? "OK" : "ERR");
+	if (format != NULL && written >= 0 && (size_t)written + 1 < replySize) {
+		reply[written++] = ' ';
+		va_list arguments;
+		va_start(arguments, format);
+		vsnprintf(reply + written, replySize - written, format, arguments);
+		va_end(arguments);
+	}
+	return ok;
+}
+
+static CommandKind FindCommandKind(const CsvField* name) {
+	for (int kind = 0; kind < CommandInvalid; kind++) {
+		if (strlen(commandSpecs[kind].name) == name->length && memcmp(commandSpecs[kind].name, name->text, name->length) == 0) {
+			return (CommandKind)kind;
+		}
+	}
+	return CommandInvalid;
+}
+
+CommandKind GetCommandKind(const char* line, size_t length) {
+	CsvField fields[2];
+	SplitCsvLine(line, length, 2, fields);
+	return FindCommandKind(&fields[0]);
+}
+
+static int ParseNif(const CsvField* field, char* nif) {
+	return field->length > 0 && CopyCsvString(field, nif, NIF_SIZE);
+}
+
+// The strings are copied to the buffers of the caller, the store interns them
+static int ParseClient(const CsvField* fields, Client* client, char* name, char* address) {
+	memset(client, 0, sizeof(Client));
+	client->name = name;
+	client->address = address;
+	return ParseNif(&fields[0], client->nif) &&
+		ParseCsvDouble(&fields[1], &client->balance) &&
+		CopyCsvString(&fields[2], name, MIN_LENGHT) &&
+		CopyCsvString(&fields[3], address, MAX_LENGHT);
+}
+
+static int ParseManager(const CsvField* fields, Manager* manager, char* name, char* department) {
+	memset(manager, 0, sizeof(Manager));
+	manager->name = name;
+	manager->departmentLocation = department;
+	return ParseNif(&fields[0], manager->nif) &&
+		CopyCsvString(&fields[1], name, MIN_LENGHT) &&
+		CopyCsvString(&fields[2], department, MIN_LENGHT);
+}
+
+static int ParseMobility(const CsvField* fields, Mobility* mobility) {
+	int type;
+	if (!ParseCsvInt(&fields[0], &mobility->id) ||
+		!ParseCsvInt(&fields[1], &type) ||
+		!ParseCsvFloat(&fields[2], &mobility->battery_level) ||
+		!ParseCsvFloat(&fields[3], &mobility->cost) ||
+		!ParseCsvFloat(&fields[4], &mobility->batteryCapacity) ||
+		!ParseCsvFloat(&fields[5], &mobility->energyCostWPerKm) ||
+		!ParseCsvInt(&fields[6], &mobility->vehicleWeight) ||
+		!ParseCsvInt(&fields[7], &mobility->maxTransportWeight) ||
+		!ParseCsvInt(&fields[8], &mobility->locationId)) {
+		return 0;
+	}
+	mobility->type = (VehicleType)type;
+	return 1;
+}
+
+static RentalEngine* PeekRentals(CommandContext* context) {
+	return (RentalEngine*)PlatformAtomicLoadPointer((void* volatile*)&context->rentals);
+}
+
+// Rental commands run alongside each other, so two may create the engine at once; the one that loses frees its copy
+static RentalEngine* GetRentals(CommandContext* context) {
+	RentalEngine* engine = PeekRentals(context);
+	if (engine != NULL) {
+		return engine;
+	}
+	engine = CreateRentalEngine(GetStoreMobilities(context->store), context->store->clients);
+	if (engine == NULL) {
+		return NULL;
+	}
+	RentalEngine* installed = (RentalEngine*)PlatformAtomicCompareExchangePointer((void* volatile*)&context->rentals, NULL, engine);
+	if (installed != NULL) {
+		FreeRentalEngine(engine);
+		return installed;
+	}
+	return engine;
+}
+
+static int SettleRentals(CommandContext* context) {
+	return context->rentals == NULL || SettleRentalBalances(context->rentals, context->store) >= 0;
+}
+
+// Changes to the stores run alone, so they update the engine in place. Without memory to follow one the engine is
+// settled and dropped, and the next rental command builds a new one from the stores.
+static void FollowRentals(CommandContext* context, int followed) {
+	if (!followed) {
+		SettleRentals(context);
+		FreeRentalEngine(context->rentals);
+		context->rentals = NULL;
+	}
+}
+
+static int RunClientCommand(CommandContext* context, CommandKind kind, const CsvField* fields, char* reply, size_t replySize) {
+	DataStore* store = context->store;
+	Client client;
+	char nif[NIF_SIZE], name[MIN_LENGHT], address[MAX_LENGHT];
+
+	if (kind == CommandAddClient || kind == CommandUpdateClient) {
+		if (!ParseClient(fields, &client, name, address)) {
+			return Reply(reply, replySize, 0, "invalid client record");
+		}
+		strcpy(nif, client.nif);
+	}
+	else if (!ParseNif(&fields[0], nif)) {
+		return Reply(reply, replySize, 0, "invalid NIF");
+	}
+
+	ClientNode* existing = FindClientByNif(store->clients, nif);
+	if (kind == CommandAddClient) {
+		if (existing != NULL) {
+			return Reply(reply, replySize, 0, "client %s already exists", nif);
+		}
+		if (!StoreAddClient(store, client)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			FollowRentals(context, AddRentalAccount(context->rentals, &client));
+		}
+		return Reply(reply, replySize, 1, NULL);
+	}
+	if (existing == NULL) {
+		return Reply(reply, replySize, 0, "client %s not found", nif);
+	}
+
+	switch (kind) {
+	case CommandUpdateClient:
+		// The balance given replaces the one the rentals left, so that one is saved first
+		if (context->rentals != NULL && !SettleRentalAccount(context->rentals, store, nif)) {
+			return Reply(reply, replySize, 0, "could not save the rental balance");
+		}
+		if (!StoreUpdateClient(store, nif, client)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			FollowRentals(context, UpdateRentalAccount(context->rentals, nif, &client));
+		}
+		return Reply(reply, replySize, 1, NULL);
+	case CommandDeleteClient:
+		if (!StoreDeleteClient(store, nif)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			RemoveRentalAccount(context->rentals, nif);
+		}
+		return Reply(reply, replySize, 1, NULL);
+	default: {
+		double balance = existing->client.balance;
+		RentalEngine* rentals = PeekRentals(context);
+		int account = rentals != NULL ? FindRentalAccount(rentals, nif) : -1;
+		if (account >= 0) {
+			balance = GetRentalBalance(rentals, account);
+		}
+		return Reply(reply, replySize, 1, "%s, %.2f, %s, %s", existing->client.nif, balance,
+			existing->client.name, existing->client.address);
+	}
+	}
+}
+
+static int RunManagerCommand(CommandContext* context, CommandKind kind, const CsvField* fields, char* reply, size_t replySize) {
+	DataStore* store = context->store;
+	Manager manager;
+	char nif[NIF_SIZE], name[MIN_LENGHT], department[MIN_LENGHT];
+
+	if (kind == CommandAddManager || kind == CommandUpdateManager) {
+		if (!ParseManager(fields, &manager, name, department)) {
+			return Reply(reply, replySize, 0, "invalid manager record");
+		}
+		strcpy(nif, manager.nif);
+	}
+	else if (!ParseNif(&fields[0], nif)) {
+		return Reply(reply, replySize, 0, "invalid NIF");
+	}
+
+	ManagerNode* existing = FindManagerByNif(store->managers, nif);
+	if (kind == CommandAddManager) {
+		if (existing != NULL) {
+			return Reply(reply, replySize, 0, "manager %s already exists", nif);
+		}
+		return StoreAddManager(store, manager) ? Reply(reply, replySize, 1, NULL) : Reply(reply, replySize, 0, "could not save the change");
+	}
+	if (existing == NULL) {
+		return Reply(reply, replySize, 0, "manager %s not found", nif);
+	}
+
+	switch (kind) {
+	case CommandUpdateManager:
+		return StoreUpdateManager(store, nif, manager) ? Reply(reply, replySize, 1, NULL) : Reply(reply, replySize, 0, "could not save the change");
+	case CommandDeleteManager:
+		return StoreDeleteManager(store, nif) ? Reply(reply, replySize, 1, NULL) : Reply(reply, replySize, 0, "could not save the change");
+	default:
+		return Reply(reply, replySize, 1, "%s, %s, %s", existing->manager.nif, existing->manager.name, existing->manager.departmentLocation);
+	}
+}
+
+static int RunMobilityCommand(CommandContext* context, CommandKind kind, const CsvField* fields, char* reply, size_t replySize) {
+	DataStore* store = context->store;
+	Mobility mobility;
+	int id;
+
+	if (kind == CommandAddMobility || kind == CommandUpdateMobility) {
+		if (!ParseMobility(fields, &mobility)) {
+			return Reply(reply, replySize, 0, "invalid mobility record");
+		}
+		id = mobility.id;
+	}
+	else if (!ParseCsvInt(&fields[0], &id)) {
+		return Reply(reply, replySize, 0, "invalid vehicle id");
+	}
+
+	MobilityTable* vehicles = GetStoreMobilities(store);
+	MobilityHandle handle = FindMobilityById(vehicles, id);
+	if (kind == CommandAddMobility) {
+		if (handle != INVALID_MOBILITY_HANDLE) {
+			return Reply(reply, replySize, 0, "vehicle %d already exists", id);
+		}
+		if (!StoreAddMobility(store, mobility)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			handle = FindMobilityById(vehicles, id);
+			FollowRentals(context, SetRentalVehicle(context->rentals, handle, GetMobility(vehicles, handle)));
+		}
+		return Reply(reply, replySize, 1, NULL);
+	}
+	if (handle == INVALID_MOBILITY_HANDLE) {
+		return Reply(reply, replySize, 0, "vehicle %d not found", id);
+	}
+
+	switch (kind) {
+	case CommandUpdateMobility:
+		if (!StoreUpdateMobility(store, id, mobility)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			FollowRentals(context, SetRentalVehicle(context->rentals, handle, GetMobility(vehicles, handle)));
+		}
+		return Reply(reply, replySize, 1, NULL);
+	case CommandDeleteMobility:
+		if (!StoreDeleteMobility(store, id)) {
+			return Reply(reply, replySize, 0, "could not save the change");
+		}
+		if (context->rentals != NULL) {
+			RetireRentalVehicle(context->rentals, handle);
+		}
+		return Reply(reply, replySize, 1, NULL);
+	default: {
+		const Mobility* found = GetMobility(vehicles, handle);
+		return Reply(reply, replySize, 1, "%d, %d, %.1f, %.1f, %.1f, %.1f, %d, %d, %d", found->id, (int)found->type,
+			found->battery_level, found->cost, found->batteryCapacity, found->energyCostWPerKm,
+			found->vehicleWeight, found->maxTransportWeight, found->locationId);
+	}
+	}
+}
+
+// One vehicle when k is left out, else the k with the most battery; every one is written as id (battery%)
+static int RunBestMobilityCommand(CommandContext* context, int fieldCount, const CsvField* fields, char* reply, size_t replySize) {
+	int type, locationId;
+	int k = 1;
+	if (!ParseCsvInt(&fields[0], &type) || type < 0) {
+		return Reply(reply, replySize, 0, "invalid vehicle type");
+	}
+	if (!ParseCsvInt(&fields[1], &locationId)) {
+		return Reply(reply, replySize, 0, "invalid location id");
+	}
+	if (fieldCount > 2 && (!ParseCsvInt(&fields[2], &k) || k < 1 || k > COMMAND_MAX_BEST_VEHICLES)) {
+		return Reply(reply, replySize, 0, "k must be between 1 and %d", COMMAND_MAX_BEST_VEHICLES);
+	}
+
+	MobilityTable* vehicles = GetStoreMobilities(context->store);
+	MobilityHandle handles[COMMAND_MAX_BEST_VEHICLES];
+	int found;
+	if (fieldCount > 2) {
+		found = FindTopMobilities(vehicles, (VehicleType)type, locationId, k, handles);
+	}
+	else {
+		handles[0] = FindBestMobility(vehicles, (VehicleType)type, locationId);
+		found = handles[0] != INVALID_MOBILITY_HANDLE;
+	}
+	if (found == 0) {
+		return Reply(reply, replySize, 0, "no vehicle of type %d in location %d", type, locationId);
+	}
+
+	Reply(reply, replySize, 1, NULL);
+	size_t written = strlen(reply);
+	for (int i = 0; i < found && written + 32 < replySize; i++) {
+		const Mobility* mobility = GetMobility(vehicles, handles[i]);
+		written += snprintf(reply + written, replySize - written, "%s%d (%.1f%%)", i == 0 ? " " : ", ", mobility->id, mobility->battery_level);
+	}
+	return 1;
+}
+
+static int RunRouteCommand(CommandContext* context, CommandKind kind, const CsvField* fields, char* reply, size_t replySize) {
+	int origin, destination;
+	if (!ParseCsvInt(&fields[0], &origin) || !ParseCsvInt(&fields[1], &destination)) {
+		return Reply(reply, replySize, 0, "invalid location id");
+	}
+
+	// Distances come from the precomputed table when there is one, routes always need a search
+	if (kind == CommandDistance && context->distances != NULL) {
+		int distance = GetOracleDistance(context->distances, origin, destination);
+		if (distance == UNREACHABLE_DISTANCE) {
+			return Reply(reply, replySize, 0, "no route from %d to %d", origin, destination);
+		}
+		return Reply(reply, replySize, 1, "%d", distance);
+	}
+	if (context->roads == NULL) {
+		return Reply(reply, replySize, 0, "the road network is not loaded");
+	}
+
+	ShortestPaths* paths = FindShortestPaths(context->roads, origin);
+	if (paths == NULL || destination < 0 || destination >= paths->nodeCount || paths->distance[destination] == UNREACHABLE_DISTANCE) {
+		FreeShortestPaths(paths);
+		return Reply(reply, replySize, 0, "no route from %d to %d", origin, destination);
+	}
+
+	int distance = paths->distance[destination];
+	if (kind == CommandDistance) {
+		FreeShortestPaths(paths);
+		return Reply(reply, replySize, 1, "%d", distance);
+	}
+
+	int* path = (int*)malloc(paths->nodeCount * sizeof(int));
+	if (path == NULL) {
+		FreeShortestPaths(paths);
+		return Reply(reply, replySize, 0, "out of memory");
+	}
+	int length = GetShortestPath(paths, destination, path, paths->nodeCount);
+	FreeShortestPaths(paths);
+
+	// The reply holds the distance and the locations of the route, cut short on very long routes
+	Reply(reply, replySize, 1, "%d", distance);
+	size_t written = strlen(reply);
+	for (int i = 0; i < length && written + 16 < replySize; i++) {
+		if (i == COMMAND_MAX_ROUTE_PRINTED) {
+			snprintf(reply + written, replySize - written, " ...");
+			break;
+		}
+		written += snprintf(reply + written, replySize - written, " %d", path[i]);
+	}
+	free(path);
+	return 1;
+}
+
+static int RunRentalCommand(CommandContext* context, CommandKind kind, const CsvField* fields, char* reply, size_t replySize) {
+	if (kind == CommandSettleRentals) {
+		int updated = context->rentals != NULL ? SettleRentalBalances(context->rentals, context->store) : 0;
+		return updated >= 0 ? Reply(reply, replySize, 1, "%d", updated) : Reply(reply, replySize, 0, "could not save the change");
+	}
+
+	char nif[NIF_SIZE];
+	int id;
+	if (!ParseNif(&fields[0], nif)) {
+		return Reply(reply, replySize, 0, "invalid NIF");
+	}
+	if (!ParseCsvInt(&fields[1], &id)) {
+		return Reply(reply, replySize, 0, "invalid vehicle id");
+	}
+
+	RentalEngine* engine = GetRentals(context);
+	if (engine == NULL) {
+		return Reply(reply, replySize, 0, "out of memory");
+	}
+	int account = FindRentalAccount(engine, nif);
+	if (account < 0) {
+		return Reply(reply, replySize, 0, "client %s not found", nif);
+	}
+	MobilityHandle vehicle = FindMobilityById(GetStoreMobilities(context->store), id);
+	if (vehicle == INVALID_MOBILITY_HANDLE) {
+		return Reply(reply, replySize, 0, "vehicle %d not found", id);
+	}
+
+	RentalResult result;
+	const char* needed;
+	switch (kind) {
+	case CommandReserveVehicle:
+		result = ReserveVehicle(engine, account, vehicle);
+		needed = "available";
+		break;
+	case CommandCancelReservation:
+		result = CancelReservation(engine, account, vehicle);
+		needed = "reserved";
+		break;
+	case CommandStartRental:
+		result = StartRental(engine, account, vehicle);
+		needed = "reserved";
+		break;
+	default:
+		result = EndRental(engine, account, vehicle);
+		needed = "in use";
+		break;
+	}
+
+	// A successful rental replies with the balance left
+	switch (result) {
+	case RentalOk:
+		return Reply(reply, replySize, 1, "%.2f", GetRentalBalance(engine, account));
+	case RentalUnavailable:
+		return Reply(reply, replySize, 0, "vehicle %d is not %s", id, needed);
+	case RentalNotHolder:
+		return Reply(reply, replySize, 0, "vehicle %d is held by another client", id);
+	case RentalInsufficientFunds:
+		return Reply(reply, replySize, 0, "the balance of %s does not cover the fare", nif);
+	default:
+		return Reply(reply, replySize, 0, "vehicle %d cannot be rented", id);
+	}
+}
+
+int ExecuteCommand(CommandContext* context, const char* line, size_t length, CommandKind* kind, char* reply, size_t replySize) {
+	CsvField fields[COMMAND_MAX_FIELDS + 1];
+
+	CommandKind found = GetCommandKind(line, length);
+	if (kind != NULL) {
+		*kind = found;
+	}
+	if (found == CommandInvalid) {
+		SplitCsvLine(line, length, 2, fields);
+		return Reply(reply, replySize, 0, "unknown command \"%.*s\"", (int)(fields[0].length < 40 ? fields[0].length : 40), fields[0].text);
+	}
+
+	int expected = commandSpecs[found].fields;
+	int optional = commandSpecs[found].optional;
+	int fieldCount = SplitCsvLine(line, length, expected + optional + 1, fields);
+	if (fieldCount < expected + 1 || fieldCount > expected + optional + 1) {
+		if (optional > 0) {
+			return Reply(reply, replySize, 0, "%s expects %d to %d fields", commandSpecs[found].name, expected, expected + optional);
+		}
+		return Reply(reply, replySize, 0, "%s expects %d fields", commandSpecs[found].name, expected);
+	}
+
+	switch (found) {
+	case CommandAddClient:
+	case CommandUpdateClient:
+	case CommandDeleteClient:
+	case CommandFindClient:
+		return RunClientCommand(context, found, fields + 1, reply, replySize);
+	case CommandAddManager:
+	case CommandUpdateManager:
+	case CommandDeleteManager:
+	case CommandFindManager:
+		return RunManagerCommand(context, found, fields + 1, reply, replySize);
+	case CommandAddMobility:
+	case CommandUpdateMobility:
+	case CommandDeleteMobility:
+	case CommandFindMobility:
+		return RunMobilityCommand(context, found, fields + 1, reply, replySize);
+	case CommandBestMobility:
+		return RunBestMobilityCommand(context, fieldCount - 1, fields + 1, reply, replySize);
+	case CommandReserveVehicle:
+	case CommandCancelReservation:
+	case CommandStartRental:
+	case CommandEndRental:
+	case CommandSettleRentals:
+		return RunRentalCommand(context, found, fields + 1, reply, replySize);
+	default:
+		return RunRouteCommand(context, found, fields + 1, reply, replySize);
+	}
+}
+
+int CloseCommandContext(CommandContext* context) {
+	int settled = SettleRentals(context);
+	FreeRentalEngine(context->rentals);
+	context->rentals = NULL;
+	return settled;
+}
+
+static void RecordLatency(CommandTimings* timings, int ok, double latency) {
+	timings->count++;
+	timings->failed += !ok;
+	timings->total += latency;
+
+	// Without memory for more samples the percentiles are taken from the ones kept so far
+	int samples = timings->count - 1;
+	if (samples == timings->capacity) {
+		int capacity = timings->capacity > 0 ? timings->capacity * 2 : 1024;
+		double* latencies = (double*)realloc(timings->latencies, capacity * sizeof(double));
+		if (latencies == NULL) {
+			return;
+		}
+		timings->latencies = latencies;
+		timings->capacity = capacity;
+	}
+	if (samples < timings->capacity) {
+		timings->latencies[samples] = latency;
+	}
+}
+
+static int CompareLatencies(const void* a, const void* b) {
+	double first = *(const double*)a;
+	double second = *(const double*)b;
+	return (first > second) - (first < second);
+}
+
+static void PrintCommandSummary(CommandTimings* timings, double elapsed) {
+	int total = 0;
+	int failed = 0;
+
+	printf("\n%-18s %10s %8s %10s %10s %10s %10s\n", "Command", "Count", "Failed", "Mean us", "p50 us", "p99 us", "Max us");
+	for (int kind = 0; kind < CommandKindCount; kind++) {
+		CommandTimings* current = &timings[kind];
+		if (current->count == 0) {
+			continue;
+		}
+
+		int samples = current->count < current->capacity ? current->count : current->capacity;
+		if (samples == 0) {
+			continue;
+		}
+		qsort(current->latencies, samples, sizeof(double), CompareLatencies);
+		printf("%-18s %10d %8d %10.2f %10.2f %10.2f %10.2f\n", commandSpecs[kind].name, current->count, current->failed,
+			current->total / current->count * 1e6,
+			current->latencies[(samples - 1) / 2] * 1e6,
+			current->latencies[(int)((samples - 1) * 0.99)] * 1e6,
+			current->latencies[samples - 1] * 1e6);
+		total += current->count;
+		failed += current->failed;
+	}
+
+	printf("\n%d commands (%d failed) in %.3f s: %.0f ops/s\n", total, failed, elapsed, elapsed > 0 ? total / elapsed : 0.0);
+}
+
+int RunCommandBatch(CommandContext* context, const char* filename, int echo) {
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		printf("Could not open the command file %s.\n", filename);
+		return -1;
+	}
+
+	CommandTimings timings[CommandKindCount];
+	memset(timings, 0, sizeof(timings));
+	char reply[COMMAND_REPLY_SIZE];
+	const char* line;
+	size_t length;
+	double started = PlatformGetTime();
+
+	while (ReadCsvLine(&reader, &line, &length)) {
+		// Lines starting with # are comments
+		while (length > 0 && (*line == ' ' || *line == '\t')) {
+			line++;
+			length--;
+		}
+		if (*line == '#') {
+			continue;
+		}
+
+		CommandKind kind;
+		double commandStarted = PlatformGetTime();
+		int ok = ExecuteCommand(context, line, length, &kind, reply, sizeof(reply));
+		RecordLatency(&timings[kind], ok, PlatformGetTime() - commandStarted);
+
+		if (echo) {
+			printf("%s\n", reply);
+		}
+		else if (!ok) {
+			ReportCsvError(&reader, reply);
+		}
+	}
+
+	double elapsed = PlatformGetTime() - started;
+	PrintCommandSummary(timings, elapsed);
+
+	int failed = 0;
+	for (int kind = 0; kind < CommandKindCount; kind++) {
+		failed += timings[kind].failed;
+		free(timings[kind].latencies);
+	}
+	CloseCsvReader(&reader);
+	return failed;
+}
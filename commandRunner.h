@@ -0,0 +1,143 @@
+/**
+ * @file   commandRunner.h
+ * @brief  This file includes the text commands that drive the stores without the menus.
+ *
+ * Every command is one line of comma-separated fields, its name first, in the
+ * same layout as the data files (for example
+ * "add-client, 123456789, 50.0, Ana, Rua do Sol"). ExecuteCommand runs one
+ * line against the data store and the road network and writes a one-line
+ * reply, so the same dispatcher serves scripts and any other front end. The
+ * batch runner feeds it a file or the standard input, times every command and
+ * prints the latency of every kind of command and the throughput at the end.
+ *
+ * Rental commands go through the rental engine, created from the store by the
+ * first of them. They only touch the engine, which takes no locks, so they
+ * run alongside queries. The balances they take are written back to the
+ * clients before that client is updated, on settle-rentals and when the context
+ * is closed. A change to a client or vehicle is passed on to the engine,
+ * which only touches the account or slot it concerns.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef COMMAND_RUNNER_H
+#define COMMAND_RUNNER_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "dataStore.h"
+#include "locations.h"
+#include "distanceOracle.h"
+#include "rentalEngine.h"
+
+#define COMMAND_REPLY_SIZE 512          /**< Size of a reply buffer that holds any reply. */
+#define COMMAND_MAX_ROUTE_PRINTED 32    /**< Locations of a route written in a reply before it is cut short. */
+#define COMMAND_MAX_BEST_VEHICLES 16    /**< Most vehicles best-mobility lists in one reply. */
+
+/**
+ * @brief Kinds of command.
+ */
+typedef enum {
+	CommandAddClient,               /**< add-client, nif, balance, name, address */
+	CommandUpdateClient,            /**< update-client, nif, balance, name, address */
+	CommandDeleteClient,            /**< delete-client, nif */
+	CommandFindClient,              /**< find-client, nif */
+	CommandAddManager,              /**< add-manager, nif, name, department */
+	CommandUpdateManager,           /**< update-manager, nif, name, department */
+	CommandDeleteManager,           /**< delete-manager, nif */
+	CommandFindManager,             /**< find-manager, nif */
+	CommandAddMobility,             /**< add-mobility, id, type, battery, cost, capacity, energy, weight, max weight, location */
+	CommandUpdateMobility,          /**< update-mobility, id, type, battery, cost, capacity, energy, weight, max weight, location */
+	CommandDeleteMobility,          /**< delete-mobility, id */
+	CommandFindMobility,            /**< find-mobility, id */
+	CommandBestMobility,            /**< best-mobility, type, location[, k] */
+	CommandDistance,                /**< distance, origin, destination */
+	CommandRoute,                   /**< route, origin, destination */
+	CommandReserveVehicle,          /**< reserve-vehicle, nif, vehicle id */
+	CommandCancelReservation,       /**< cancel-reservation, nif, vehicle id */
+	CommandStartRental,             /**< start-rental, nif, vehicle id */
+	CommandEndRental,               /**< end-rental, nif, vehicle id */
+	CommandSettleRentals,           /**< settle-rentals */
+	CommandInvalid,                 /**< A line that is not a known command. */
+	CommandKindCount                /**< Number of kinds, not a command. */
+} CommandKind;
+
+/**
+ * @brief Everything a command may read or change.
+ */
+typedef struct CommandContext {
+	DataStore* store;                       /**< Clients, managers and vehicles. */
+	const RoadGraph* roads;                 /**< Road network, NULL when it was not loaded. */
+	const DistanceOracle* distances;        /**< Distances between locations, NULL when they are not cached. */
+	RentalEngine* volatile rentals;         /**< Rentals of the vehicles and clients of the store, NULL until the first rental command. */
+} CommandContext;
+
+/**
+ * @brief Gets the name a kind of command is written with.
+ *
+ * @param kind The kind of command.
+ * @return The name, "invalid" for CommandInvalid.
+ */
+const char* GetCommandName(CommandKind kind);
+
+/**
+ * @brief Finds the kind of a command from its name, without checking its fields.
+ *
+ * @param line The command (not null-terminated), without the newline.
+ * @param length The number of characters of the command.
+ * @return The kind, CommandInvalid if the name is unknown.
+ */
+CommandKind GetCommandKind(const char* line, size_t length);
+
+/**
+ * @brief Tells whether a kind of command only reads the stores.
+ *
+ * Read-only commands may run on several threads at once; every other command
+ * needs the stores to itself. Reserving, cancelling, starting and ending a
+ * rental count as read-only: they only change the rental engine.
+ *
+ * @param kind The kind of command.
+ * @return 1 if the command never changes the stores, 0 otherwise.
+ */
+int IsReadOnlyCommand(CommandKind kind);
+
+/**
+ * @brief Runs one command.
+ *
+ * The reply starts with "OK" followed by the result of a query, or with "ERR"
+ * followed by the reason the command failed.
+ *
+ * @param context The stores the command runs against.
+ * @param line The command (not null-terminated), without the newline.
+ * @param length The number of characters of the command.
+ * @param kind Receives the kind of the command. May be NULL.
+ * @param reply Buffer that receives the reply.
+ * @param replySize The size of the reply buffer, COMMAND_REPLY_SIZE is always enough.
+ * @return 1 if the command succeeded, 0 otherwise.
+ */
+int ExecuteCommand(CommandContext* context, const char* line, size_t length, CommandKind* kind, char* reply, size_t replySize);
+
+/**
+ * @brief Writes the balances taken by rentals back to the clients and frees the rental engine.
+ *
+ * Reservations and rides in progress are not kept.
+ *
+ * @param context The stores the commands ran against.
+ * @return 1 if the balances were saved, 0 otherwise.
+ */
+int CloseCommandContext(CommandContext* context);
+
+/**
+ * @brief Runs every command of a file and prints the latency of each kind of command and the throughput.
+ *
+ * @param context The stores the commands run against.
+ * @param filename The file with one command per line, CSV_STANDARD_INPUT for the standard input.
+ * @param echo 1 to print the reply of every command, 0 to print only the summary.
+ * @return The number of commands that failed, -1 if the file could not be read.
+ */
+int RunCommandBatch(CommandContext* context, const char* filename, int echo);
+
+#endif  // COMMAND_RUNNER_H
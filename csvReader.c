@@ -0,0 +1,332 @@
+#include "csvReader.h"
+#include "platform.h"
+
+#define MAX_EXACT_POWER 22
+#define MAX_MANTISSA_DIGITS 19
+
+static const double powersOfTen[MAX_EXACT_POWER + 1] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int IsBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+int OpenCsvStream(CsvReader* reader, FILE* file, const char* filename) {
+	memset(reader, 0, sizeof(CsvReader));
+
+	reader->buffer = (char*)malloc(CSV_BLOCK_SIZE);
+	if (reader->buffer == NULL) {
+		return 0;
+	}
+
+	reader->file = file;
+	reader->filename = filename;
+	reader->capacity = CSV_BLOCK_SIZE;
+	reader->stream = PlatformIsStream(file);
+	return 1;
+}
+
+int OpenCsvReader(CsvReader* reader, const char* filename) {
+	FILE* file = strcmp(filename, CSV_STANDARD_INPUT) == 0 ? stdin : fopen(filename, "rb");
+	if (file == NULL) {
+		memset(reader, 0, sizeof(CsvReader));
+		return 0;
+	}
+	if (!OpenCsvStream(reader, file, filename)) {
+		if (file != stdin) {
+			fclose(file);
+		}
+		return 0;
+	}
+	return 1;
+}
+
+// Moves the unread bytes to the front of the buffer and reads the next block after them.
+// A stream is only waited on until the deadline, and then CSV_TIMED_OUT is returned.
+static int Refill(CsvReader* reader, double deadline) {
+	size_t pending = reader->end - reader->start;
+
+	if (reader->start > 0) {
+		memmove(reader->buffer, reader->buffer + reader->start, pending);
+		reader->start = 0;
+		reader->end = pending;
+	}
+	else if (reader->end == reader->capacity) {
+		// A single line is longer than the buffer
+		char* grown = (char*)realloc(reader->buffer, reader->capacity * 2);
+		if (grown == NULL) {
+			reader->eof = 1;
+			return 0;
+		}
+		reader->buffer = grown;
+		reader->capacity *= 2;
+	}
+
+	size_t read;
+	if (reader->stream) {
+		// Past the deadline the stream is only checked, so lines that already arrived are still read
+		if (deadline >= 0.0) {
+			double left = deadline - PlatformGetTime();
+			if (!PlatformWaitForInput(reader->file, left > 0.0 ? left : 0.0)) {
+				return CSV_TIMED_OUT;
+			}
+		}
+		read = PlatformReadStream(reader->file, reader->buffer + reader->end, reader->capacity - reader->end);
+	}
+	else {
+		read = fread(reader->buffer + reader->end, 1, reader->capacity - reader->end, reader->file);
+	}
+	reader->end += read;
+	if (read == 0) {
+		reader->eof = 1;
+	}
+	return read > 0;
+}
+
+int SplitCsvLine(const char* text, size_t length, int maxFields, CsvField* fields) {
+	const char* textEnd = text + length;
+	int fieldCount = 0;
+
+	if (maxFields > CSV_MAX_FIELDS) {
+		maxFields = CSV_MAX_FIELDS;
+	}
+
+	while (1) {
+		const char* fieldEnd = textEnd;
+		if (fieldCount + 1 < maxFields) {
+			const char* comma = (const char*)memchr(text, ',', textEnd - text);
+			if (comma != NULL) {
+				fieldEnd = comma;
+			}
+		}
+
+		const char* first = text;
+		const char* last = fieldEnd;
+		while (first < last && IsBlank(*first)) {
+			first++;
+		}
+		while (last > first && IsBlank(last[-1])) {
+			last--;
+		}
+
+		CsvField* field = &fields[fieldCount++];
+		field->text = first;
+		field->length = (size_t)(last - first);
+
+		if (fieldEnd == textEnd) {
+			return fieldCount;
+		}
+		text = fieldEnd + 1;
+	}
+}
+
+static int ReadLineBefore(CsvReader* reader, const char** text, size_t* length, double deadline) {
+	while (1) {
+		char* lineStart = reader->buffer + reader->start;
+		char* newline = (char*)memchr(lineStart, '\n', reader->end - reader->start);
+		char* lineEnd;
+
+		if (newline == NULL) {
+			if (!reader->eof) {
+				if (Refill(reader, deadline) == CSV_TIMED_OUT) {
+					return CSV_TIMED_OUT;
+				}
+				continue;
+			}
+			if (reader->start == reader->end) {
+				return 0;
+			}
+			// Last line of a file that does not end with a newline
+			lineEnd = reader->buffer + reader->end;
+			reader->start = reader->end;
+		}
+		else {
+			lineEnd = newline;
+			reader->start = (size_t)(newline - reader->buffer) + 1;
+		}
+
+		reader->line++;
+
+		// Skip the UTF-8 byte order mark some editors put at the start of the file
+		if (reader->line == 1 && lineEnd - lineStart >= 3 && memcmp(lineStart, "\xEF\xBB\xBF", 3) == 0) {
+			lineStart += 3;
+		}
+
+		const char* first = lineStart;
+		while (first < lineEnd && IsBlank(*first)) {
+			first++;
+		}
+		if (first == lineEnd) {
+			continue;
+		}
+
+		*text = lineStart;
+		*length = (size_t)(lineEnd - lineStart);
+		return 1;
+	}
+}
+
+int ReadCsvLine(CsvReader* reader, const char** text, size_t* length) {
+	return ReadLineBefore(reader, text, length, CSV_NO_DEADLINE);
+}
+
+int ReadCsvRecordBefore(CsvReader* reader, int maxFields, double deadline) {
+	const char* text;
+	size_t length;
+
+	int read = ReadLineBefore(reader, &text, &length, deadline);
+	if (read != 1) {
+		return read;
+	}
+	reader->fieldCount = SplitCsvLine(text, length, maxFields, reader->fields);
+	return reader->fieldCount;
+}
+
+int ReadCsvRecord(CsvReader* reader, int maxFields) {
+	return ReadCsvRecordBefore(reader, maxFields, CSV_NO_DEADLINE);
+}
+
+void ReportCsvError(CsvReader* reader, const char* message) {
+	reader->errors++;
+	fprintf(stderr, "%s:%ld: %s\n", reader->filename, reader->line, message);
+}
+
+void CloseCsvReader(CsvReader* reader) {
+	if (reader->file != NULL && reader->file != stdin) {
+		fclose(reader->file);
+	}
+	free(reader->buffer);
+	memset(reader, 0, sizeof(CsvReader));
+}
+
+int ParseCsvInt(const CsvField* field, int* value) {
+	const char* text = field->text;
+	const char* end = text + field->length;
+	int negative = 0;
+
+	if (text < end && (*text == '-' || *text == '+')) {
+		negative = *text == '-';
+		text++;
+	}
+	if (text == end) {
+		return 0;
+	}
+
+	long long result = 0;
+	for (; text < end; text++) {
+		if (*text < '0' || *text > '9') {
+			return 0;
+		}
+		result = result * 10 + (*text - '0');
+		if (result > 2147483648LL) {
+			return 0;
+		}
+	}
+
+	if (negative) {
+		result = -result;
+	}
+	if (result > 2147483647LL) {
+		return 0;
+	}
+
+	*value = (int)result;
+	return 1;
+}
+
+int ParseCsvDouble(const CsvField* field, double* value) {
+	const char* text = field->text;
+	const char* end = text + field->length;
+	int negative = 0;
+
+	if (text < end && (*text == '-' || *text == '+')) {
+		negative = *text == '-';
+		text++;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int significant = 0;
+	int exponent = 0;
+
+	for (; text < end && *text >= '0' && *text <= '9'; text++, digits++) {
+		if (significant < MAX_MANTISSA_DIGITS) {
+			mantissa = mantissa * 10 + (unsigned long long)(*text - '0');
+			significant += mantissa != 0;
+		}
+		else {
+			exponent++;
+		}
+	}
+
+	if (text < end && *text == '.') {
+		for (text++; text < end && *text >= '0' && *text <= '9'; text++, digits++) {
+			if (significant < MAX_MANTISSA_DIGITS) {
+				mantissa = mantissa * 10 + (unsigned long long)(*text - '0');
+				significant += mantissa != 0;
+				exponent--;
+			}
+		}
+	}
+
+	if (digits == 0) {
+		return 0;
+	}
+
+	if (text < end && (*text == 'e' || *text == 'E')) {
+		int exponentNegative = 0;
+		int exponentValue = 0;
+		text++;
+		if (text < end && (*text == '-' || *text == '+')) {
+			exponentNegative = *text == '-';
+			text++;
+		}
+		if (text == end) {
+			return 0;
+		}
+		for (; text < end && *text >= '0' && *text <= '9'; text++) {
+			if (exponentValue < 10000) {
+				exponentValue = exponentValue * 10 + (*text - '0');
+			}
+		}
+		exponent += exponentNegative ? -exponentValue : exponentValue;
+	}
+
+	if (text != end) {
+		return 0;
+	}
+
+	double result = (double)mantissa;
+	while (exponent > MAX_EXACT_POWER) {
+		result *= powersOfTen[MAX_EXACT_POWER];
+		exponent -= MAX_EXACT_POWER;
+	}
+	while (exponent < -MAX_EXACT_POWER) {
+		result /= powersOfTen[MAX_EXACT_POWER];
+		exponent += MAX_EXACT_POWER;
+	}
+	result = exponent >= 0 ? result * powersOfTen[exponent] : result / powersOfTen[-exponent];
+
+	*value = negative ? -result : result;
+	return 1;
+}
+
+int ParseCsvFloat(const CsvField* field, float* value) {
+	double result;
+	if (!ParseCsvDouble(field, &result)) {
+		return 0;
+	}
+	*value = (float)result;
+	return 1;
+}
+
+int CopyCsvString(const CsvField* field, char* destination, size_t size) {
+	if (field->length >= size) {
+		return 0;
+	}
+	memcpy(destination, field->text, field->length);
+	destination[field->length] = '\0';
+	return 1;
+}
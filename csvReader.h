@@ -0,0 +1,177 @@
+/**
+ * @file   csvReader.h
+ * @brief  This file includes the buffered tokenizer used by every text file loader.
+ *
+ * The reader pulls the file in large blocks, splits each line on commas,
+ * trims the blanks around every field and exposes the fields as slices of its
+ * buffer, so loaders never copy or rescan a line. Numbers are parsed by hand
+ * from those slices and malformed lines are reported with their line number.
+ *
+ * Pipes and terminals are read as their bytes arrive instead of a block at a
+ * time, so a line is handed over as soon as it is complete, and a read can
+ * give up at a deadline when no whole line arrives in time.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef CSV_READER_H
+#define CSV_READER_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define CSV_BLOCK_SIZE (1 << 20)    /**< Number of bytes read from the file at a time. */
+#define CSV_MAX_FIELDS 16           /**< Maximum number of fields of a record. */
+#define CSV_STANDARD_INPUT "-"      /**< File name that makes a reader read the standard input. */
+#define CSV_TIMED_OUT (-1)          /**< Returned by ReadCsvRecordBefore when no whole line arrived in time. */
+#define CSV_NO_DEADLINE (-1.0)      /**< Deadline of a read that waits for ever. */
+
+/**
+ * @brief Field of a record, a slice of the reader buffer.
+ */
+typedef struct CsvField {
+	const char* text;               /**< First character of the field (not null-terminated). */
+	size_t length;                  /**< Number of characters of the field. */
+} CsvField;
+
+/**
+ * @brief Buffered reader of comma-separated text files.
+ */
+typedef struct CsvReader {
+	FILE* file;                     /**< File being read. */
+	const char* filename;           /**< Name of the file, used in error messages. */
+	char* buffer;                   /**< Block buffer. */
+	size_t capacity;                /**< Size of the buffer. */
+	size_t start;                   /**< Offset of the first unread byte in the buffer. */
+	size_t end;                     /**< Offset one past the last valid byte in the buffer. */
+	int eof;                        /**< 1 once the whole file was read into the buffer. */
+	int stream;                     /**< 1 for a pipe or terminal, read as its bytes arrive. */
+	long line;                      /**< Line number of the current record. */
+	int errors;                     /**< Number of lines reported as invalid. */
+	int fieldCount;                 /**< Number of fields of the current record. */
+	CsvField fields[CSV_MAX_FIELDS];  /**< Fields of the current record. */
+} CsvReader;
+
+/**
+ * @brief Opens a text file for reading.
+ *
+ * @param reader The reader to initialize.
+ * @param filename The name of the file, CSV_STANDARD_INPUT for the standard input.
+ * @return 1 on success, 0 if the file could not be opened.
+ */
+int OpenCsvReader(CsvReader* reader, const char* filename);
+
+/**
+ * @brief Starts reading a file that is already open.
+ *
+ * @param reader The reader to initialize.
+ * @param file The file, closed by CloseCsvReader unless it is stdin.
+ * @param filename The name used in error messages.
+ * @return 1 on success, 0 if memory could not be allocated; the file is left open.
+ */
+int OpenCsvStream(CsvReader* reader, FILE* file, const char* filename);
+
+/**
+ * @brief Reads the next non-empty line without splitting it.
+ *
+ * @param reader The reader.
+ * @param text Receives the first character of the line (not null-terminated), valid until the next read.
+ * @param length Receives the number of characters of the line, without the newline.
+ * @return 1 if a line was read, 0 at the end of the file.
+ */
+int ReadCsvLine(CsvReader* reader, const char** text, size_t* length);
+
+/**
+ * @brief Splits a line into trimmed fields.
+ *
+ * The last field takes the rest of the line, commas included.
+ *
+ * @param text The line.
+ * @param length The number of characters of the line.
+ * @param maxFields Maximum number of fields to split the line into, at most CSV_MAX_FIELDS.
+ * @param fields Output array with room for maxFields fields.
+ * @return The number of fields, at least 1.
+ */
+int SplitCsvLine(const char* text, size_t length, int maxFields, CsvField* fields);
+
+/**
+ * @brief Reads the next non-empty line and splits it into fields.
+ *
+ * The last field takes the rest of the line, commas included, so free-text
+ * columns such as addresses can hold commas.
+ *
+ * @param reader The reader.
+ * @param maxFields Maximum number of fields to split the line into.
+ * @return The number of fields of the record, or 0 at the end of the file.
+ */
+int ReadCsvRecord(CsvReader* reader, int maxFields);
+
+/**
+ * @brief Reads the next record like ReadCsvRecord, waiting on a pipe or terminal only until a deadline.
+ *
+ * Files on disk never time out. The part of a line received before the
+ * deadline is kept for the next read.
+ *
+ * @param reader The reader.
+ * @param maxFields Maximum number of fields to split the line into.
+ * @param deadline The latest PlatformGetTime to wait until, CSV_NO_DEADLINE to wait for ever.
+ * @return The number of fields of the record, 0 at the end of the file, or CSV_TIMED_OUT.
+ */
+int ReadCsvRecordBefore(CsvReader* reader, int maxFields, double deadline);
+
+/**
+ * @brief Reports the current line as invalid on stderr.
+ *
+ * @param reader The reader.
+ * @param message Description of the problem.
+ */
+void ReportCsvError(CsvReader* reader, const char* message);
+
+/**
+ * @brief Closes the file and frees the buffer of the reader.
+ *
+ * @param reader The reader.
+ */
+void CloseCsvReader(CsvReader* reader);
+
+/**
+ * @brief Parses a field as a decimal integer.
+ *
+ * @param field The field.
+ * @param value Where to store the parsed value.
+ * @return 1 if the whole field is a valid integer, 0 otherwise.
+ */
+int ParseCsvInt(const CsvField* field, int* value);
+
+/**
+ * @brief Parses a field as a decimal number with optional fraction and exponent.
+ *
+ * @param field The field.
+ * @param value Where to store the parsed value.
+ * @return 1 if the whole field is a valid number, 0 otherwise.
+ */
+int ParseCsvDouble(const CsvField* field, double* value);
+
+/**
+ * @brief Parses a field as a single-precision decimal number.
+ *
+ * @param field The field.
+ * @param value Where to store the parsed value.
+ * @return 1 if the whole field is a valid number, 0 otherwise.
+ */
+int ParseCsvFloat(const CsvField* field, float* value);
+
+/**
+ * @brief Copies a field into a null-terminated string.
+ *
+ * @param field The field.
+ * @param destination The destination buffer.
+ * @param size The size of the destination buffer.
+ * @return 1 if the field fits, 0 if it is too long (nothing is copied).
+ */
+int CopyCsvString(const CsvField* field, char* destination, size_t size);
+
+#endif  // CSV_READER_H
@@ -0,0 +1,579 @@
+#include "dataStore.h"
+#include "nodePool.h"
+
+typedef struct RecordCursor {
+	const unsigned char* next;
+	const unsigned char* end;
+	size_t recordSize;
+} RecordCursor;
+
+static const void* NextCopiedRecord(void* context) {
+	RecordCursor* cursor = (RecordCursor*)context;
+	if (cursor->next == cursor->end) {
+		return NULL;
+	}
+
+	const void* record = cursor->next;
+	cursor->next += cursor->recordSize;
+	return record;
+}
+
+static int WriteCopiedSnapshot(const char* filename, SnapshotRecordType recordType, const void* records,
+	size_t count, size_t recordSize, unsigned long long sequence) {
+	RecordCursor cursor = { (const unsigned char*)records, (const unsigned char*)records + count * recordSize, recordSize };
+	return WriteSnapshot(filename, recordType, recordSize, sequence, NextCopiedRecord, &cursor, NULL);
+}
+
+static int RunCompaction(void* argument) {
+	DataStoreCompaction* compaction = (DataStoreCompaction*)argument;
+
+	// The copied records point to strings of the arenas, which only grow until the store is closed
+	int ok = SaveClientArray(compaction->clients, compaction->clientCount, BIN_CLIENT_FILENAME, compaction->sequence);
+	ok = ok && SaveManagerArray(compaction->managers, compaction->managerCount, BIN_MANAGER_FILENAME, compaction->sequence);
+	ok = ok && WriteCopiedSnapshot(BIN_MOBILITY_FILENAME, SnapshotMobilities, compaction->mobilities,
+		compaction->mobilityCount, sizeof(Mobility), compaction->sequence);
+
+	// The journal can only lose the operations once every snapshot holds them
+	return ok && CompactJournal(compaction->journal, compaction->sequence);
+}
+
+static void FinishCompaction(DataStore* store) {
+	DataStoreCompaction* compaction = store->compaction;
+	if (compaction == NULL) {
+		return;
+	}
+
+	if (!PlatformJoinThread(compaction->thread)) {
+		fprintf(stderr, "Could not write the snapshots, the journal was kept.\n");
+	}
+	free(compaction->clients);
+	free(compaction->managers);
+	free(compaction->mobilities);
+	free(compaction);
+	store->compaction = NULL;
+}
+
+static int CopyRecords(DataStore* store, DataStoreCompaction* compaction) {
+	size_t count = 0;
+	for (ClientNode* current = store->clients; current != NULL; current = current->next) {
+		count++;
+	}
+	compaction->clients = (Client*)malloc((count + 1) * sizeof(Client));
+	if (compaction->clients == NULL) {
+		return 0;
+	}
+	for (ClientNode* current = store->clients; current != NULL; current = current->next) {
+		compaction->clients[compaction->clientCount++] = current->client;
+	}
+
+	count = 0;
+	for (ManagerNode* current = store->managers; current != NULL; current = current->next) {
+		count++;
+	}
+	compaction->managers = (Manager*)malloc((count + 1) * sizeof(Manager));
+	if (compaction->managers == NULL) {
+		return 0;
+	}
+	for (ManagerNode* current = store->managers; current != NULL; current = current->next) {
+		compaction->managers[compaction->managerCount++] = current->manager;
+	}
+
+	MobilityTable* table = store->mobilities;
+	compaction->mobilities = (Mobility*)malloc(((table != NULL ? table->count : 0) + 1) * sizeof(Mobility));
+	if (compaction->mobilities == NULL) {
+		return 0;
+	}
+	for (MobilityHandle handle = 0; table != NULL && handle < table->slotCount; handle++) {
+		if (table->used[handle]) {
+			compaction->mobilities[compaction->mobilityCount++] = table->records[handle];
+		}
+	}
+	return 1;
+}
+
+int CompactDataStore(DataStore* store) {
+	FinishCompaction(store);
+	GetStoreMobilities(store);
+
+	DataStoreCompaction* compaction = (DataStoreCompaction*)calloc(1, sizeof(DataStoreCompaction));
+	if (compaction == NULL) {
+		return 0;
+	}
+	compaction->journal = &store->journal;
+	compaction->sequence = GetLastJournalSequence(&store->journal);
+
+	if (CopyRecords(store, compaction)) {
+		compaction->thread = PlatformStartThread(RunCompaction, compaction);
+	}
+	if (compaction->thread == NULL) {
+		free(compaction->clients);
+		free(compaction->managers);
+		free(compaction->mobilities);
+		free(compaction);
+		return 0;
+	}
+
+	store->compaction = compaction;
+	return 1;
+}
+
+// Waits until the operation is on disk and compacts the journal once it grows too large
+static int Commit(DataStore* store, unsigned long long sequence) {
+	if (sequence == 0 || !WaitForJournal(&store->journal, sequence)) {
+		return 0;
+	}
+
+	// The next compaction waits for another threshold of changes, so a slow one is only joined then
+	unsigned long long size = GetJournalSize(&store->journal);
+	if (size >= store->compactAt) {
+		CompactDataStore(store);
+		store->compactAt = size + DATA_STORE_COMPACT_THRESHOLD;
+	}
+	return 1;
+}
+
+// Returns 0 if the operation does not fit the list, which leaves it unchanged; an add never replaces and an
+// update never takes the NIF of another client. Replay relies on the sequences to skip what the snapshot holds.
+static int ApplyClient(DataStore* store, JournalOperation operation, char* nif, const Client* client) {
+	ClientNode* current = FindClientByNif(store->clients, nif);
+	if (operation == JournalDelete) {
+		if (current == NULL) {
+			return 0;
+		}
+		store->clients = DeleteClient(store->clients, nif);
+		return 1;
+	}
+
+	if (operation == JournalAdd) {
+		if (current != NULL) {
+			return 0;
+		}
+		store->clients = AddClient(store->clients, *client);
+		return FindClientByNif(store->clients, (char*)client->nif) != NULL;
+	}
+
+	if (current == NULL || (strncmp(nif, client->nif, NIF_SIZE) != 0 && FindClientByNif(store->clients, (char*)client->nif) != NULL)) {
+		return 0;
+	}
+	store->clients = UpdateClient(store->clients, nif, *client);
+	// The node keeps its old values if memory ran out
+	return FindClientByNif(store->clients, (char*)client->nif) == current &&
+		strcmp(current->client.name, client->name) == 0 && strcmp(current->client.address, client->address) == 0;
+}
+
+static int ApplyManager(DataStore* store, JournalOperation operation, char* nif, const Manager* manager) {
+	ManagerNode* current = FindManagerByNif(store->managers, nif);
+	if (operation == JournalDelete) {
+		if (current == NULL) {
+			return 0;
+		}
+		store->managers = DeleteManager(store->managers, nif);
+		return 1;
+	}
+
+	if (operation == JournalAdd) {
+		if (current != NULL) {
+			return 0;
+		}
+		store->managers = AddManager(store->managers, *manager);
+		return FindManagerByNif(store->managers, (char*)manager->nif) != NULL;
+	}
+
+	if (current == NULL || (strncmp(nif, manager->nif, NIF_SIZE) != 0 && FindManagerByNif(store->managers, (char*)manager->nif) != NULL)) {
+		return 0;
+	}
+	store->managers = UpdateManager(store->managers, nif, *manager);
+	// The node keeps its old values if memory ran out
+	return FindManagerByNif(store->managers, (char*)manager->nif) == current &&
+		strcmp(current->manager.name, manager->name) == 0 && strcmp(current->manager.departmentLocation, manager->departmentLocation) == 0;
+}
+
+static int ApplyMobility(DataStore* store, JournalOperation operation, int id, const Mobility* mobility) {
+	if (operation == JournalDelete) {
+		return store->mobilities != NULL && DeleteMobility(store->mobilities, id);
+	}
+	if (operation == JournalStatus) {
+		MobilityStatus status = { FindMobilityById(store->mobilities, id), mobility->battery_level, mobility->locationId };
+		return UpdateMobilityStatuses(store->mobilities, &status, 1) == 1;
+	}
+
+	if (store->mobilities == NULL) {
+		store->mobilities = CreateMobilityTable(MOBILITY_TABLE_MIN_CAPACITY);
+		if (store->mobilities == NULL) {
+			return 0;
+		}
+	}
+
+	MobilityHandle handle = FindMobilityById(store->mobilities, id);
+	if (handle == INVALID_MOBILITY_HANDLE) {
+		handle = FindMobilityById(store->mobilities, mobility->id);
+	}
+
+	if (handle != INVALID_MOBILITY_HANDLE) {
+		UpdateMobilityByHandle(store->mobilities, handle, *mobility);
+		return 1;
+	}
+	return AddMobility(store->mobilities, *mobility) != INVALID_MOBILITY_HANDLE;
+}
+
+// Keeps a vehicle operation until the vehicles it applies to are loaded
+static void DeferVehicle(DataStore* store, JournalOperation operation, int id, const Mobility* mobility) {
+	if (store->deferredCount == store->deferredCapacity) {
+		size_t capacity = store->deferredCapacity == 0 ? 64 : store->deferredCapacity * 2;
+		DataStoreDeferredVehicle* deferred = (DataStoreDeferredVehicle*)realloc(store->deferred,
+			capacity * sizeof(DataStoreDeferredVehicle));
+		if (deferred == NULL) {
+			return;
+		}
+		store->deferred = deferred;
+		store->deferredCapacity = capacity;
+	}
+
+	DataStoreDeferredVehicle* target = &store->deferred[store->deferredCount++];
+	target->operation = operation;
+	target->id = id;
+	if (mobility != NULL) {
+		target->mobility = *mobility;
+	}
+}
+
+// Replays the statuses of a JournalStatus record one vehicle at a time, so they can be deferred like any other operation
+static void ApplyStatusRecord(DataStore* store, const JournalEntry* entry) {
+	int count;
+	memcpy(&count, entry->key, sizeof(count));
+	if (count <= 0 || entry->recordSize != (size_t)count * sizeof(DataStoreStatusRecord)) {
+		return;
+	}
+
+	const DataStoreStatusRecord* records = (const DataStoreStatusRecord*)entry->record;
+	Mobility mobility;
+	memset(&mobility, 0, sizeof(mobility));
+	for (int i = 0; i < count; i++) {
+		mobility.battery_level = records[i].battery;
+		mobility.locationId = records[i].locationId;
+		if (store->vehiclesPending) {
+			DeferVehicle(store, JournalStatus, records[i].id, &mobility);
+		}
+		else {
+			ApplyMobility(store, JournalStatus, records[i].id, &mobility);
+		}
+	}
+}
+
+static void ApplyJournalEntry(const JournalEntry* entry, void* context) {
+	DataStore* store = (DataStore*)context;
+	int deleting = entry->operation == JournalDelete;
+	Client client;
+	Manager manager;
+
+	switch (entry->recordType) {
+	case SnapshotClients:
+		if (entry->sequence > store->clientSequence &&
+			(deleting || UnpackClient(entry->record, entry->recordSize, entry->version, &client))) {
+			char nif[NIF_SIZE];
+			memcpy(nif, entry->key, NIF_SIZE);
+			nif[NIF_SIZE - 1] = '\0';
+			ApplyClient(store, entry->operation, nif, deleting ? NULL : &client);
+		}
+		break;
+	case SnapshotManagers:
+		if (entry->sequence > store->managerSequence &&
+			(deleting || UnpackManager(entry->record, entry->recordSize, entry->version, &manager))) {
+			char nif[NIF_SIZE];
+			memcpy(nif, entry->key, NIF_SIZE);
+			nif[NIF_SIZE - 1] = '\0';
+			ApplyManager(store, entry->operation, nif, deleting ? NULL : &manager);
+		}
+		break;
+	case SnapshotMobilities:
+		if (entry->sequence > store->mobilitySequence && entry->operation == JournalStatus) {
+			ApplyStatusRecord(store, entry);
+		}
+		else if (entry->sequence > store->mobilitySequence && (deleting || entry->recordSize == sizeof(Mobility))) {
+			int id;
+			memcpy(&id, entry->key, sizeof(id));
+			if (store->vehiclesPending) {
+				DeferVehicle(store, entry->operation, id, (const Mobility*)entry->record);
+			}
+			else {
+				ApplyMobility(store, entry->operation, id, (const Mobility*)entry->record);
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static int LoadClientsInBackground(void* argument) {
+	DataStore* store = (DataStore*)argument;
+	double started = PlatformGetTime();
+	store->clients = LoadClients(BIN_CLIENT_FILENAME, TXT_CLIENT_FILENAME);
+	store->startup.clientSeconds = PlatformGetTime() - started;
+	return 1;
+}
+
+static int LoadVehiclesInBackground(void* argument) {
+	DataStoreVehicleLoad* load = (DataStoreVehicleLoad*)argument;
+	double started = PlatformGetTime();
+	load->table = LoadMobilities(BIN_MOBILITY_FILENAME, TXT_MOBILITY_FILENAME);
+	load->seconds = PlatformGetTime() - started;
+	PlatformAtomicAdd(&load->done, 1);
+	return 1;
+}
+
+// Without a thread to spare the vehicles are simply loaded on demand
+static void StartVehicleLoad(DataStore* store) {
+	DataStoreVehicleLoad* load = (DataStoreVehicleLoad*)calloc(1, sizeof(DataStoreVehicleLoad));
+	if (load == NULL) {
+		return;
+	}
+	load->thread = PlatformStartThread(LoadVehiclesInBackground, load);
+	if (load->thread == NULL) {
+		free(load);
+		return;
+	}
+	store->vehicleLoad = load;
+}
+
+MobilityTable* GetStoreMobilities(DataStore* store) {
+	if (!store->vehiclesPending) {
+		return store->mobilities;
+	}
+
+	double started = PlatformGetTime();
+	DataStoreVehicleLoad* load = store->vehicleLoad;
+	if (load != NULL) {
+		PlatformJoinThread(load->thread);
+		store->startup.vehicleWaitSeconds = PlatformGetTime() - started;
+		store->startup.vehicleSeconds = load->seconds;
+		store->mobilities = load->table;
+		store->vehicleLoad = NULL;
+		free(load);
+	}
+	else {
+		store->mobilities = LoadMobilities(BIN_MOBILITY_FILENAME, TXT_MOBILITY_FILENAME);
+		store->startup.vehicleSeconds = PlatformGetTime() - started;
+	}
+	store->vehiclesPending = 0;
+
+	for (size_t i = 0; i < store->deferredCount; i++) {
+		DataStoreDeferredVehicle* deferred = &store->deferred[i];
+		ApplyMobility(store, deferred->operation, deferred->id, deferred->operation == JournalDelete ? NULL : &deferred->mobility);
+	}
+	store->startup.deferredVehicles = store->deferredCount;
+	free(store->deferred);
+	store->deferred = NULL;
+	store->deferredCount = 0;
+	store->deferredCapacity = 0;
+	return store->mobilities;
+}
+
+int OpenDataStore(DataStore* store, DataStoreVehicleLoading vehicles) {
+	memset(store, 0, sizeof(DataStore));
+	double opened = PlatformGetTime();
+
+	store->vehiclesPending = 1;
+	if (vehicles == DataStoreVehiclesInBackground) {
+		StartVehicleLoad(store);
+	}
+	PlatformThread* clientLoader = PlatformStartThread(LoadClientsInBackground, store);
+	if (clientLoader == NULL) {
+		LoadClientsInBackground(store);
+	}
+
+	double started = PlatformGetTime();
+	store->managers = LoadManagers(BIN_MANAGER_FILENAME, TXT_MANAGER_FILENAME);
+	store->startup.managerSeconds = PlatformGetTime() - started;
+	if (clientLoader != NULL) {
+		PlatformJoinThread(clientLoader);
+	}
+
+	store->clientSequence = ReadSnapshotSequence(BIN_CLIENT_FILENAME, SnapshotClients);
+	store->managerSequence = ReadSnapshotSequence(BIN_MANAGER_FILENAME, SnapshotManagers);
+	store->mobilitySequence = ReadSnapshotSequence(BIN_MOBILITY_FILENAME, SnapshotMobilities);
+
+	unsigned long long snapshotSequence = store->clientSequence;
+	if (store->managerSequence > snapshotSequence) {
+		snapshotSequence = store->managerSequence;
+	}
+	if (store->mobilitySequence > snapshotSequence) {
+		snapshotSequence = store->mobilitySequence;
+	}
+
+	store->compactAt = DATA_STORE_COMPACT_THRESHOLD;
+	started = PlatformGetTime();
+	int ok = OpenJournal(&store->journal, JOURNAL_FILENAME, snapshotSequence, ApplyJournalEntry, store);
+	store->startup.journalSeconds = PlatformGetTime() - started;
+	store->startup.openSeconds = PlatformGetTime() - opened;
+	return ok;
+}
+
+void PrintStartupReport(const DataStore* store, FILE* output) {
+	const DataStoreStartup* startup = &store->startup;
+	fprintf(output, "%-28s %10.1f ms\n", "Clients (own thread)", startup->clientSeconds * 1000.0);
+	fprintf(output, "%-28s %10.1f ms\n", "Managers", startup->managerSeconds * 1000.0);
+	fprintf(output, "%-28s %10.1f ms\n", "Journal replay", startup->journalSeconds * 1000.0);
+	fprintf(output, "%-28s %10.1f ms\n", "Data store open", startup->openSeconds * 1000.0);
+	if (!store->vehiclesPending) {
+		fprintf(output, "%-28s %10.1f ms, waited %.1f ms, %zu journal operations deferred\n", "Vehicles",
+			startup->vehicleSeconds * 1000.0, startup->vehicleWaitSeconds * 1000.0, startup->deferredVehicles);
+	}
+	else if (store->vehicleLoad != NULL) {
+		fprintf(output, "%-28s %13s\n", "Vehicles", store->vehicleLoad->done ? "loaded, unused" : "loading");
+	}
+	else {
+		fprintf(output, "%-28s %13s\n", "Vehicles", "on first use");
+	}
+	PrintNodePoolStats(output);
+}
+
+int StoreAddClient(DataStore* store, Client newClient) {
+	unsigned char packed[CLIENT_PACKED_MAX];
+	size_t packedSize = PackClient(&newClient, packed, sizeof(packed));
+	if (packedSize == 0) {
+		return 0;
+	}
+	if (!ApplyClient(store, JournalAdd, newClient.nif, &newClient)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotClients, JournalAdd,
+		newClient.nif, NIF_SIZE, packed, packedSize));
+}
+
+int StoreUpdateClient(DataStore* store, char* nif, Client updatedClient) {
+	return Commit(store, StoreUpdateClientNoWait(store, nif, updatedClient));
+}
+
+unsigned long long StoreUpdateClientNoWait(DataStore* store, char* nif, Client updatedClient) {
+	char key[NIF_SIZE];
+	strncpy(key, nif, NIF_SIZE - 1);
+	key[NIF_SIZE - 1] = '\0';
+
+	unsigned char packed[CLIENT_PACKED_MAX];
+	size_t packedSize = PackClient(&updatedClient, packed, sizeof(packed));
+	if (packedSize == 0 || !ApplyClient(store, JournalUpdate, key, &updatedClient)) {
+		return 0;
+	}
+	return AppendToJournal(&store->journal, SnapshotClients, JournalUpdate, key, NIF_SIZE, packed, packedSize);
+}
+
+int StoreWaitForChanges(DataStore* store, unsigned long long sequence) {
+	return Commit(store, sequence);
+}
+
+int StoreDeleteClient(DataStore* store, char* nif) {
+	char key[NIF_SIZE];
+	strncpy(key, nif, NIF_SIZE - 1);
+	key[NIF_SIZE - 1] = '\0';
+
+	if (!ApplyClient(store, JournalDelete, key, NULL)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotClients, JournalDelete, key, NIF_SIZE, NULL, 0));
+}
+
+int StoreAddManager(DataStore* store, Manager newManager) {
+	unsigned char packed[MANAGER_PACKED_MAX];
+	size_t packedSize = PackManager(&newManager, packed, sizeof(packed));
+	if (packedSize == 0) {
+		return 0;
+	}
+	if (!ApplyManager(store, JournalAdd, newManager.nif, &newManager)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotManagers, JournalAdd,
+		newManager.nif, NIF_SIZE, packed, packedSize));
+}
+
+int StoreUpdateManager(DataStore* store, char* nif, Manager updatedManager) {
+	char key[NIF_SIZE];
+	strncpy(key, nif, NIF_SIZE - 1);
+	key[NIF_SIZE - 1] = '\0';
+
+	unsigned char packed[MANAGER_PACKED_MAX];
+	size_t packedSize = PackManager(&updatedManager, packed, sizeof(packed));
+	if (packedSize == 0 || !ApplyManager(store, JournalUpdate, key, &updatedManager)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotManagers, JournalUpdate,
+		key, NIF_SIZE, packed, packedSize));
+}
+
+int StoreDeleteManager(DataStore* store, char* nif) {
+	char key[NIF_SIZE];
+	strncpy(key, nif, NIF_SIZE - 1);
+	key[NIF_SIZE - 1] = '\0';
+
+	if (!ApplyManager(store, JournalDelete, key, NULL)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotManagers, JournalDelete, key, NIF_SIZE, NULL, 0));
+}
+
+int StoreAddMobility(DataStore* store, Mobility newMobility) {
+	GetStoreMobilities(store);
+	if (!ApplyMobility(store, JournalAdd, newMobility.id, &newMobility)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotMobilities, JournalAdd,
+		&newMobility.id, sizeof(int), &newMobility, sizeof(Mobility)));
+}
+
+int StoreUpdateMobility(DataStore* store, int id, Mobility updatedMobility) {
+	if (FindMobilityById(GetStoreMobilities(store), id) == INVALID_MOBILITY_HANDLE) {
+		return 0;
+	}
+	ApplyMobility(store, JournalUpdate, id, &updatedMobility);
+	return Commit(store, AppendToJournal(&store->journal, SnapshotMobilities, JournalUpdate,
+		&id, sizeof(int), &updatedMobility, sizeof(Mobility)));
+}
+
+int StoreUpdateMobilityStatuses(DataStore* store, const MobilityStatus* statuses, int count) {
+	MobilityTable* table = GetStoreMobilities(store);
+	DataStoreStatusRecord* records = (DataStoreStatusRecord*)malloc(((size_t)count + 1) * sizeof(DataStoreStatusRecord));
+	if (records == NULL) {
+		return 0;
+	}
+
+	int recordCount = 0;
+	for (int i = 0; i < count; i++) {
+		const Mobility* mobility = GetMobility(table, statuses[i].handle);
+		if (mobility != NULL) {
+			records[recordCount].id = mobility->id;
+			records[recordCount].battery = statuses[i].battery;
+			records[recordCount].locationId = statuses[i].locationId;
+			recordCount++;
+		}
+	}
+	UpdateMobilityStatuses(table, statuses, count);
+
+	int saved = recordCount == 0 || Commit(store, AppendToJournal(&store->journal, SnapshotMobilities, JournalStatus,
+		&recordCount, sizeof(int), records, recordCount * sizeof(DataStoreStatusRecord)));
+	free(records);
+	return saved;
+}
+
+int StoreDeleteMobility(DataStore* store, int id) {
+	GetStoreMobilities(store);
+	if (!ApplyMobility(store, JournalDelete, id, NULL)) {
+		return 0;
+	}
+	return Commit(store, AppendToJournal(&store->journal, SnapshotMobilities, JournalDelete, &id, sizeof(int), NULL, 0));
+}
+
+void CloseDataStore(DataStore* store) {
+	FinishCompaction(store);
+	if (store->vehicleLoad != NULL) {
+		PlatformJoinThread(store->vehicleLoad->thread);
+		FreeMobilities(store->vehicleLoad->table);
+		free(store->vehicleLoad);
+	}
+	free(store->deferred);
+	CloseJournal(&store->journal);
+
+	FreeClients(store->clients);
+	FreeManagers(store->managers);
+	FreeMobilities(store->mobilities);
+	memset(store, 0, sizeof(DataStore));
+}
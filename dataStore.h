@@ -0,0 +1,285 @@
+/**
+ * @file   dataStore.h
+ * @brief  This file includes the data store that keeps the lists in memory in sync with the disk.
+ *
+ * The store loads the client, manager and vehicle snapshots, replays the
+ * journal on top of them and routes every later change through the journal,
+ * so an edit costs one appended record instead of a rewrite of the whole data
+ * file. Once the journal grows past DATA_STORE_COMPACT_THRESHOLD the records
+ * are copied and written to fresh snapshots by a background thread, after
+ * which the journal is cut down to the operations made in the meantime.
+ *
+ * Opening the store loads the clients and the managers on two threads at
+ * once, since logging in needs both. The vehicles are loaded the first time
+ * they are used, or on a background thread that the first use waits for, and
+ * journal operations on vehicles read before then are kept aside and applied
+ * once they are loaded.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef DATA_STORE_H
+#define DATA_STORE_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "clients.h"
+#include "managers.h"
+#include "mobility.h"
+#include "journal.h"
+
+#define DATA_STORE_COMPACT_THRESHOLD (4 * 1024 * 1024)  /**< Journal size in bytes that triggers a compaction. */
+
+/**
+ * @brief Copy of the records being written to the snapshots by the compaction thread.
+ */
+typedef struct DataStoreCompaction {
+	Journal* journal;               /**< Journal to cut down once the snapshots are written. */
+	unsigned long long sequence;    /**< Last journal operation included in the copy. */
+	Client* clients;                /**< Copy of the clients. */
+	size_t clientCount;             /**< Number of clients. */
+	Manager* managers;              /**< Copy of the managers. */
+	size_t managerCount;            /**< Number of managers. */
+	Mobility* mobilities;           /**< Copy of the vehicles. */
+	size_t mobilityCount;           /**< Number of vehicles. */
+	PlatformThread* thread;         /**< Thread writing the snapshots. */
+} DataStoreCompaction;
+
+/**
+ * @brief When the vehicles are loaded.
+ */
+typedef enum {
+	DataStoreVehiclesOnDemand,      /**< By the first call to GetStoreMobilities; never if nothing uses them. */
+	DataStoreVehiclesInBackground   /**< By a thread started when the store opens, waited for by the first use. */
+} DataStoreVehicleLoading;
+
+/**
+ * @brief Vehicle snapshot being loaded by a background thread.
+ */
+typedef struct DataStoreVehicleLoad {
+	MobilityTable* table;           /**< Vehicles loaded, NULL if there were none. */
+	double seconds;                 /**< Time the load took. */
+	volatile long done;             /**< 1 once the thread has finished. */
+	PlatformThread* thread;         /**< Thread loading the vehicles. */
+} DataStoreVehicleLoad;
+
+/**
+ * @brief Status of one vehicle in a JournalStatus record.
+ */
+typedef struct DataStoreStatusRecord {
+	int id;                         /**< ID of the vehicle. */
+	float battery;                  /**< New battery level. */
+	int locationId;                 /**< New location. */
+} DataStoreStatusRecord;
+
+/**
+ * @brief Journal operation on a vehicle read while the vehicles were still loading.
+ */
+typedef struct DataStoreDeferredVehicle {
+	JournalOperation operation;     /**< Kind of change; a JournalStatus record is kept as one JournalStatus per vehicle. */
+	int id;                         /**< ID the operation applies to. */
+	Mobility mobility;              /**< New value of the vehicle, only the battery and location for statuses, unused for deletes. */
+} DataStoreDeferredVehicle;
+
+/**
+ * @brief Time spent opening the store, for the startup report.
+ */
+typedef struct DataStoreStartup {
+	double clientSeconds;           /**< Loading the clients, on their own thread. */
+	double managerSeconds;          /**< Loading the managers, on the opening thread. */
+	double journalSeconds;          /**< Replaying the journal. */
+	double openSeconds;             /**< Whole of OpenDataStore. */
+	double vehicleSeconds;          /**< Loading the vehicles, 0 until they are loaded. */
+	double vehicleWaitSeconds;      /**< Time the first use of the vehicles waited for the background load. */
+	size_t deferredVehicles;        /**< Journal operations on vehicles applied once they were loaded. */
+} DataStoreStartup;
+
+/**
+ * @brief Clients, managers and vehicles together with their journal.
+ */
+typedef struct DataStore {
+	ClientNode* clients;            /**< List of clients. */
+	ManagerNode* managers;          /**< List of managers. */
+	MobilityTable* mobilities;      /**< Table of vehicles, NULL while there are none; read it through GetStoreMobilities. */
+	Journal journal;                /**< Journal of the changes made since the snapshots. */
+	unsigned long long clientSequence;    /**< Last journal operation included in the client snapshot. */
+	unsigned long long managerSequence;   /**< Last journal operation included in the manager snapshot. */
+	unsigned long long mobilitySequence;  /**< Last journal operation included in the vehicle snapshot. */
+	DataStoreCompaction* compaction;      /**< Last compaction started, NULL once it was joined. */
+	unsigned long long compactAt;         /**< Journal size that starts the next compaction. */
+	int vehiclesPending;                  /**< 1 until the vehicles are in mobilities. */
+	DataStoreVehicleLoad* vehicleLoad;    /**< Background load of the vehicles, NULL once it was joined or if there is none. */
+	DataStoreDeferredVehicle* deferred;   /**< Journal operations on vehicles waiting for the load. */
+	size_t deferredCount;                 /**< Number of deferred operations. */
+	size_t deferredCapacity;              /**< Capacity of deferred. */
+	DataStoreStartup startup;             /**< Time spent opening the store. */
+} DataStore;
+
+/**
+ * @brief Loads the clients and managers in parallel and replays the journal on top of them.
+ *
+ * @param store The store to initialize.
+ * @param vehicles When the vehicles are loaded.
+ * @return 1 on success, 0 if the journal could not be opened.
+ */
+int OpenDataStore(DataStore* store, DataStoreVehicleLoading vehicles);
+
+/**
+ * @brief Gets the vehicles, loading them or waiting for the background load the first time.
+ *
+ * The first call changes the store, so it must not race with other users of
+ * the store; call it before the store is shared between threads.
+ *
+ * @param store The store.
+ * @return The table of vehicles, NULL while there are none.
+ */
+MobilityTable* GetStoreMobilities(DataStore* store);
+
+/**
+ * @brief Prints how long every part of opening the store took and what the node pools hold.
+ *
+ * @param store The store.
+ * @param output The stream to print to.
+ */
+void PrintStartupReport(const DataStore* store, FILE* output);
+
+/**
+ * @brief Adds a client and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param newClient The new Client data to be added.
+ * @return 1 if the change was saved, 0 if a client already has the NIF or the change could not be saved.
+ */
+int StoreAddClient(DataStore* store, Client newClient);
+
+/**
+ * @brief Updates a client and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param nif The NIF of the Client data to be updated.
+ * @param updatedClient The updated Client data.
+ * @return 1 if the change was saved, 0 if the client was not found, its new NIF belongs to another client or the change could not be saved.
+ */
+int StoreUpdateClient(DataStore* store, char* nif, Client updatedClient);
+
+/**
+ * @brief Updates a client like StoreUpdateClient, but returns once the change is in the journal buffer.
+ *
+ * Many changes made this way are put on disk together by one StoreWaitForChanges.
+ *
+ * @param store The store.
+ * @param nif The NIF of the Client data to be updated.
+ * @param updatedClient The updated Client data.
+ * @return The journal sequence of the change, 0 if it was refused or could not be saved.
+ */
+unsigned long long StoreUpdateClientNoWait(DataStore* store, char* nif, Client updatedClient);
+
+/**
+ * @brief Waits until every change up to a journal sequence is on disk.
+ *
+ * @param store The store.
+ * @param sequence The sequence returned for the last of the changes.
+ * @return 1 if the changes are on disk, 0 otherwise.
+ */
+int StoreWaitForChanges(DataStore* store, unsigned long long sequence);
+
+/**
+ * @brief Deletes a client and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param nif The NIF of the Client data to be deleted.
+ * @return 1 if the change was saved, 0 if the client was not found or the change could not be saved.
+ */
+int StoreDeleteClient(DataStore* store, char* nif);
+
+/**
+ * @brief Adds a manager and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param newManager The new Manager data to be added.
+ * @return 1 if the change was saved, 0 if a manager already has the NIF or the change could not be saved.
+ */
+int StoreAddManager(DataStore* store, Manager newManager);
+
+/**
+ * @brief Updates a manager and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param nif The NIF of the Manager data to be updated.
+ * @param updatedManager The updated Manager data.
+ * @return 1 if the change was saved, 0 if the manager was not found, its new NIF belongs to another manager or the change could not be saved.
+ */
+int StoreUpdateManager(DataStore* store, char* nif, Manager updatedManager);
+
+/**
+ * @brief Deletes a manager and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param nif The NIF of the Manager data to be deleted.
+ * @return 1 if the change was saved, 0 if the manager was not found or the change could not be saved.
+ */
+int StoreDeleteManager(DataStore* store, char* nif);
+
+/**
+ * @brief Adds a vehicle and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param newMobility The new Mobility data to be added.
+ * @return 1 if the change was saved, 0 otherwise.
+ */
+int StoreAddMobility(DataStore* store, Mobility newMobility);
+
+/**
+ * @brief Updates a vehicle and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param id The ID of the Mobility data to be updated.
+ * @param updatedMobility The updated Mobility data.
+ * @return 1 if the change was saved, 0 if the vehicle was not found or the change could not be saved.
+ */
+int StoreUpdateMobility(DataStore* store, int id, Mobility updatedMobility);
+
+/**
+ * @brief Sets the battery level and location of many vehicles and waits until the change is on disk.
+ *
+ * The whole batch is journaled as a single record holding only the changed
+ * fields, so a telemetry batch costs one append and one flush.
+ *
+ * @param store The store.
+ * @param statuses The new statuses, at most one per vehicle, with handles of GetStoreMobilities.
+ * @param count The number of statuses.
+ * @return 1 if the change was saved, 0 if memory could not be allocated or the change could not be saved.
+ */
+int StoreUpdateMobilityStatuses(DataStore* store, const MobilityStatus* statuses, int count);
+
+/**
+ * @brief Deletes a vehicle and waits until the change is on disk.
+ *
+ * @param store The store.
+ * @param id The ID of the Mobility data to be deleted.
+ * @return 1 if the change was saved, 0 if the vehicle was not found or the change could not be saved.
+ */
+int StoreDeleteMobility(DataStore* store, int id);
+
+/**
+ * @brief Starts writing fresh snapshots in the background.
+ *
+ * The records are copied on the calling thread, so later changes do not race
+ * with the writer. If a previous compaction is still running, waits for it first.
+ *
+ * @param store The store.
+ * @return 1 if the compaction was started, 0 otherwise.
+ */
+int CompactDataStore(DataStore* store);
+
+/**
+ * @brief Waits for a running compaction, closes the journal and frees every list.
+ *
+ * @param store The store.
+ */
+void CloseDataStore(DataStore* store);
+
+#endif  // DATA_STORE_H
@@ -0,0 +1,266 @@
+#include "distanceOracle.h"
+#include "metrics.h"
+
+// Large enough for any road, small enough that adding two never overflows
+#define ORACLE_INFINITY (INT_MAX / 2)
+
+typedef struct FloydLoop {
+	int* distances;
+	int size;
+	int blocks;
+	int pivot;
+} FloydLoop;
+
+typedef struct DijkstraLoop {
+	const RoadGraph* graph;
+	int* distances;
+	int failed;
+} DijkstraLoop;
+
+// Relaxes tile (row, column) through the locations of tile pivot, one pivot location at a time
+static void RelaxTile(int* distances, int size, int row, int column, int pivot) {
+	int firstRow = row * DISTANCE_ORACLE_BLOCK;
+	int firstColumn = column * DISTANCE_ORACLE_BLOCK;
+	int firstPivot = pivot * DISTANCE_ORACLE_BLOCK;
+
+	for (int k = firstPivot; k < firstPivot + DISTANCE_ORACLE_BLOCK; k++) {
+		const int* fromPivot = distances + (size_t)k * size + firstColumn;
+		for (int i = firstRow; i < firstRow + DISTANCE_ORACLE_BLOCK; i++) {
+			int toPivot = distances[(size_t)i * size + k];
+			if (toPivot >= ORACLE_INFINITY) {
+				continue;
+			}
+			int* target = distances + (size_t)i * size + firstColumn;
+			for (int j = 0; j < DISTANCE_ORACLE_BLOCK; j++) {
+				int through = toPivot + fromPivot[j];
+				target[j] = through < target[j] ? through : target[j];
+			}
+		}
+	}
+}
+
+// Tiles in the pivot row and the pivot column only depend on the pivot tile
+static void RelaxPivotCross(int index, void* context) {
+	FloydLoop* loop = (FloydLoop*)context;
+	if (index < loop->blocks) {
+		if (index != loop->pivot) {
+			RelaxTile(loop->distances, loop->size, loop->pivot, index, loop->pivot);
+		}
+	}
+	else if (index - loop->blocks != loop->pivot) {
+		RelaxTile(loop->distances, loop->size, index - loop->blocks, loop->pivot, loop->pivot);
+	}
+}
+
+// The remaining tiles only depend on the pivot row and column, so each tile row is independent
+static void RelaxTileRow(int row, void* context) {
+	FloydLoop* loop = (FloydLoop*)context;
+	if (row == loop->pivot) {
+		return;
+	}
+	for (int column = 0; column < loop->blocks; column++) {
+		if (column != loop->pivot) {
+			RelaxTile(loop->distances, loop->size, row, column, loop->pivot);
+		}
+	}
+}
+
+// Blocked Floyd-Warshall on a matrix padded to whole tiles, so every tile stays in cache while it is relaxed
+static int ComputeWithFloydWarshall(const RoadGraph* graph, int* result) {
+	int nodeCount = graph->nodeCount;
+	int blocks = (nodeCount + DISTANCE_ORACLE_BLOCK - 1) / DISTANCE_ORACLE_BLOCK;
+	int size = blocks * DISTANCE_ORACLE_BLOCK;
+
+	int* distances = (int*)malloc((size_t)size * size * sizeof(int));
+	if (distances == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < (size_t)size * size; i++) {
+		distances[i] = ORACLE_INFINITY;
+	}
+	for (int i = 0; i < size; i++) {
+		distances[(size_t)i * size + i] = 0;
+	}
+	for (int origin = 0; origin < nodeCount; origin++) {
+		for (int edge = graph->offsets[origin]; edge < graph->offsets[origin + 1]; edge++) {
+			int* distance = &distances[(size_t)origin * size + graph->targets[edge]];
+			if (graph->weights[edge] < *distance) {
+				*distance = graph->weights[edge];
+			}
+		}
+	}
+
+	FloydLoop loop = { distances, size, blocks, 0 };
+	for (int pivot = 0; pivot < blocks; pivot++) {
+		loop.pivot = pivot;
+		RelaxTile(distances, size, pivot, pivot, pivot);
+		PlatformParallelFor(2 * blocks, RelaxPivotCross, &loop);
+		PlatformParallelFor(blocks, RelaxTileRow, &loop);
+	}
+
+	for (int i = 0; i < nodeCount; i++) {
+		for (int j = 0; j < nodeCount; j++) {
+			int distance = distances[(size_t)i * size + j];
+			result[(size_t)i * nodeCount + j] = distance >= ORACLE_INFINITY ? UNREACHABLE_DISTANCE : distance;
+		}
+	}
+
+	free(distances);
+	return 1;
+}
+
+static void SearchFromLocation(int source, void* context) {
+	DijkstraLoop* loop = (DijkstraLoop*)context;
+	if (!FindDistancesFrom(loop->graph, source, loop->distances + (size_t)source * loop->graph->nodeCount)) {
+		loop->failed = 1;
+	}
+}
+
+static int ComputeWithDijkstra(const RoadGraph* graph, int* result) {
+	DijkstraLoop loop = { graph, result, 0 };
+	PlatformParallelFor(graph->nodeCount, SearchFromLocation, &loop);
+	return !loop.failed;
+}
+
+DistanceOracle* BuildDistanceOracle(const RoadGraph* graph) {
+	METRICS_START(started);
+	if (graph == NULL || graph->nodeCount > DISTANCE_ORACLE_MAX_NODES) {
+		METRICS_STOP(MetricBuildDistanceOracle, started);
+		return NULL;
+	}
+
+	DistanceOracle* oracle = (DistanceOracle*)calloc(1, sizeof(DistanceOracle));
+	if (oracle == NULL) {
+		METRICS_STOP(MetricBuildDistanceOracle, started);
+		return NULL;
+	}
+	oracle->nodeCount = graph->nodeCount;
+	oracle->fingerprint = GetRoadGraphFingerprint(graph);
+	oracle->ownedDistances = (int*)malloc(((size_t)graph->nodeCount * graph->nodeCount + 1) * sizeof(int));
+	if (oracle->ownedDistances == NULL) {
+		free(oracle);
+		METRICS_STOP(MetricBuildDistanceOracle, started);
+		return NULL;
+	}
+
+	int ok = graph->nodeCount <= DISTANCE_ORACLE_FLOYD_MAX_NODES
+		? ComputeWithFloydWarshall(graph, oracle->ownedDistances)
+		: ComputeWithDijkstra(graph, oracle->ownedDistances);
+	if (!ok) {
+		FreeDistanceOracle(oracle);
+		METRICS_STOP(MetricBuildDistanceOracle, started);
+		return NULL;
+	}
+
+	oracle->distances = oracle->ownedDistances;
+	METRICS_STOP(MetricBuildDistanceOracle, started);
+	return oracle;
+}
+
+int SaveDistanceOracle(const DistanceOracle* oracle, const char* filename) {
+	METRICS_START(started);
+	char tempFilename[FILENAME_MAX];
+	if (snprintf(tempFilename, sizeof(tempFilename), "%s.tmp", filename) >= (int)sizeof(tempFilename)) {
+		METRICS_STOP(MetricSaveDistanceOracle, started);
+		return 0;
+	}
+
+	FILE* file = fopen(tempFilename, "wb");
+	if (file == NULL) {
+		METRICS_STOP(MetricSaveDistanceOracle, started);
+		return 0;
+	}
+
+	DistanceOracleHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, DISTANCE_ORACLE_MAGIC, sizeof(header.magic));
+	header.version = DISTANCE_ORACLE_VERSION;
+	header.headerSize = DISTANCE_ORACLE_HEADER_SIZE;
+	header.nodeCount = (unsigned int)oracle->nodeCount;
+	header.fingerprint = oracle->fingerprint;
+
+	size_t cells = (size_t)oracle->nodeCount * oracle->nodeCount;
+	int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(oracle->distances, sizeof(int), cells, file) == cells;
+	ok = ok && PlatformSyncFile(file);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok || !PlatformReplaceFile(tempFilename, filename)) {
+		remove(tempFilename);
+		METRICS_STOP(MetricSaveDistanceOracle, started);
+		return 0;
+	}
+	METRICS_STOP(MetricSaveDistanceOracle, started);
+	return 1;
+}
+
+static DistanceOracle* MapDistanceOracle(const RoadGraph* graph, const char* filename) {
+	DistanceOracle* oracle = (DistanceOracle*)calloc(1, sizeof(DistanceOracle));
+	if (oracle == NULL) {
+		return NULL;
+	}
+	if (!PlatformMapFile(filename, &oracle->mapping)) {
+		free(oracle);
+		return NULL;
+	}
+
+	DistanceOracleHeader header;
+	size_t cells = (size_t)graph->nodeCount * graph->nodeCount;
+	int valid = oracle->mapping.size >= sizeof(header);
+	if (valid) {
+		memcpy(&header, oracle->mapping.data, sizeof(header));
+		valid = memcmp(header.magic, DISTANCE_ORACLE_MAGIC, sizeof(header.magic)) == 0 &&
+			header.version == DISTANCE_ORACLE_VERSION && header.headerSize == DISTANCE_ORACLE_HEADER_SIZE &&
+			header.nodeCount == (unsigned int)graph->nodeCount &&
+			header.fingerprint == GetRoadGraphFingerprint(graph) &&
+			oracle->mapping.size == DISTANCE_ORACLE_HEADER_SIZE + cells * sizeof(int);
+	}
+	if (!valid) {
+		FreeDistanceOracle(oracle);
+		return NULL;
+	}
+
+	oracle->nodeCount = graph->nodeCount;
+	oracle->fingerprint = header.fingerprint;
+	oracle->distances = (const int*)(oracle->mapping.data + DISTANCE_ORACLE_HEADER_SIZE);
+	return oracle;
+}
+
+DistanceOracle* LoadDistanceOracle(const RoadGraph* graph, const char* filename) {
+	METRICS_START(started);
+	if (graph == NULL) {
+		METRICS_STOP(MetricLoadDistanceOracle, started);
+		return NULL;
+	}
+
+	DistanceOracle* oracle = MapDistanceOracle(graph, filename);
+	if (oracle != NULL) {
+		METRICS_STOP(MetricLoadDistanceOracle, started);
+		return oracle;
+	}
+
+	// Missing, corrupt or computed for other roads
+	oracle = BuildDistanceOracle(graph);
+	if (oracle != NULL) {
+		SaveDistanceOracle(oracle, filename);
+	}
+	METRICS_STOP(MetricLoadDistanceOracle, started);
+	return oracle;
+}
+
+int GetOracleDistance(const DistanceOracle* oracle, int origin, int destination) {
+	if (oracle == NULL || origin < 0 || destination < 0 || origin >= oracle->nodeCount || destination >= oracle->nodeCount) {
+		return UNREACHABLE_DISTANCE;
+	}
+	return oracle->distances[(size_t)origin * oracle->nodeCount + destination];
+}
+
+void FreeDistanceOracle(DistanceOracle* oracle) {
+	if (oracle == NULL) {
+		return;
+	}
+	free(oracle->ownedDistances);
+	PlatformUnmapFile(&oracle->mapping);
+	free(oracle);
+}
@@ -0,0 +1,100 @@
+/**
+ * @file   distanceOracle.h
+ * @brief  This file includes the precomputed table of distances between every pair of locations.
+ *
+ * The oracle answers origin to destination distance queries in O(1) from a
+ * row-major matrix. Small graphs are solved with a blocked Floyd-Warshall,
+ * larger ones with one Dijkstra search per location run on every processor.
+ * The table is cached on disk together with the fingerprint of the road graph
+ * it was computed from; the cache is mapped straight into memory when the
+ * fingerprint still matches and recomputed as soon as any road changes.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef DISTANCE_ORACLE_H
+#define DISTANCE_ORACLE_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "platform.h"
+#include "locations.h"
+
+#define DISTANCE_ORACLE_MAGIC "MMDISTNC"        /**< Magic string at the start of the cache file. */
+#define DISTANCE_ORACLE_VERSION 1               /**< Current version of the cache file. */
+#define DISTANCE_ORACLE_HEADER_SIZE 64          /**< Size of the header, also the offset of the matrix. */
+#define DISTANCE_ORACLE_MAX_NODES 16384         /**< Largest graph the oracle is built for (1 GiB matrix). */
+#define DISTANCE_ORACLE_FLOYD_MAX_NODES 128     /**< Graphs up to this size use Floyd-Warshall, larger ones Dijkstra. */
+#define DISTANCE_ORACLE_BLOCK 64                /**< Side of the tiles of the blocked Floyd-Warshall. */
+
+/**
+ * @brief Header at the start of the cache file.
+ */
+typedef struct DistanceOracleHeader {
+	char magic[8];                  /**< DISTANCE_ORACLE_MAGIC. */
+	unsigned int version;           /**< DISTANCE_ORACLE_VERSION. */
+	unsigned int headerSize;        /**< Offset of the matrix. */
+	unsigned int nodeCount;         /**< Number of rows and columns of the matrix. */
+	unsigned int reserved;          /**< Always zero. */
+	unsigned long long fingerprint; /**< GetRoadGraphFingerprint of the graph the matrix was computed from. */
+	unsigned char padding[DISTANCE_ORACLE_HEADER_SIZE - 32];  /**< Pads the header to DISTANCE_ORACLE_HEADER_SIZE. */
+} DistanceOracleHeader;
+
+/**
+ * @brief Distances between every pair of locations.
+ */
+typedef struct DistanceOracle {
+	int nodeCount;                  /**< Number of rows and columns, indexed by location ID. */
+	unsigned long long fingerprint; /**< Fingerprint of the graph the distances belong to. */
+	const int* distances;           /**< Row-major matrix, UNREACHABLE_DISTANCE where there is no path. */
+	int* ownedDistances;            /**< The matrix when it was computed, NULL when it is mapped from the cache. */
+	PlatformFileMapping mapping;    /**< Mapping of the cache file when the matrix was loaded from it. */
+} DistanceOracle;
+
+/**
+ * @brief Computes the distances between every pair of locations of a graph.
+ *
+ * @param graph The road graph.
+ * @return The oracle. If the graph has more than DISTANCE_ORACLE_MAX_NODES locations or memory could not be allocated, returns NULL.
+ */
+DistanceOracle* BuildDistanceOracle(const RoadGraph* graph);
+
+/**
+ * @brief Saves an oracle to a cache file.
+ *
+ * @param oracle The oracle.
+ * @param filename The name of the file.
+ * @return 1 on success, 0 on failure.
+ */
+int SaveDistanceOracle(const DistanceOracle* oracle, const char* filename);
+
+/**
+ * @brief Loads the oracle of a graph from its cache file, rebuilding the cache if it is missing or stale.
+ *
+ * @param graph The road graph.
+ * @param filename The name of the cache file.
+ * @return The oracle. If it could not be loaded or built, returns NULL.
+ */
+DistanceOracle* LoadDistanceOracle(const RoadGraph* graph, const char* filename);
+
+/**
+ * @brief Gets the shortest distance between two locations.
+ *
+ * @param oracle The oracle.
+ * @param origin The origin location id.
+ * @param destination The destination location id.
+ * @return The distance, or UNREACHABLE_DISTANCE if there is no path or an id is out of range.
+ */
+int GetOracleDistance(const DistanceOracle* oracle, int origin, int destination);
+
+/**
+ * @brief Frees an oracle and unmaps its cache file.
+ *
+ * @param oracle The oracle.
+ */
+void FreeDistanceOracle(DistanceOracle* oracle);
+
+#endif  // DISTANCE_ORACLE_H
@@ -0,0 +1,124 @@
+#include "districtIndex.h"
+#include "platform.h"
+
+int DistrictReserve(DistrictIndex* index, int capacity) {
+	if (capacity <= index->capacity) {
+		return 1;
+	}
+
+	int* locations = (int*)realloc(index->locations, capacity * sizeof(int));
+	if (locations == NULL) {
+		return 0;
+	}
+	index->locations = locations;
+
+	int* positions = (int*)realloc(index->positions, capacity * sizeof(int));
+	if (positions == NULL) {
+		return 0;
+	}
+	index->positions = positions;
+
+	for (int handle = index->capacity; handle < capacity; handle++) {
+		index->locations[handle] = DISTRICT_UNFILED;
+		index->positions[handle] = 0;
+	}
+	index->capacity = capacity;
+	return 1;
+}
+
+static int ReserveBuckets(DistrictIndex* index, int locationId) {
+	if (locationId < index->bucketCount) {
+		return 1;
+	}
+
+	int bucketCount = index->bucketCount > 0 ? index->bucketCount : 16;
+	while (bucketCount <= locationId) {
+		bucketCount *= 2;
+	}
+	DistrictBucket* buckets = (DistrictBucket*)realloc(index->buckets, bucketCount * sizeof(DistrictBucket));
+	if (buckets == NULL) {
+		return 0;
+	}
+	memset(buckets + index->bucketCount, 0, (bucketCount - index->bucketCount) * sizeof(DistrictBucket));
+	index->buckets = buckets;
+	index->bucketCount = bucketCount;
+	return 1;
+}
+
+void DistrictRemove(DistrictIndex* index, int handle) {
+	int locationId = index->locations[handle];
+	if (locationId == DISTRICT_UNFILED) {
+		return;
+	}
+
+	DistrictBucket* bucket = &index->buckets[locationId];
+	int position = index->positions[handle];
+	int last = bucket->handles[--bucket->count];
+	bucket->handles[position] = last;
+	index->positions[last] = position;
+	index->locations[handle] = DISTRICT_UNFILED;
+}
+
+int DistrictFile(DistrictIndex* index, int handle, int locationId) {
+	if (index->locations[handle] == locationId) {
+		return 1;
+	}
+	DistrictRemove(index, handle);
+	if (locationId < 0) {
+		return 1;
+	}
+	if (!ReserveBuckets(index, locationId)) {
+		return 0;
+	}
+
+	DistrictBucket* bucket = &index->buckets[locationId];
+	if (bucket->count == bucket->capacity) {
+		int capacity = bucket->capacity > 0 ? bucket->capacity * 2 : 4;
+		int* handles = (int*)realloc(bucket->handles, capacity * sizeof(int));
+		if (handles == NULL) {
+			return 0;
+		}
+		bucket->handles = handles;
+		bucket->capacity = capacity;
+	}
+
+	index->positions[handle] = bucket->count;
+	index->locations[handle] = locationId;
+	bucket->handles[bucket->count++] = handle;
+	return 1;
+}
+
+void DistrictPrefetch(const DistrictIndex* index, int handle, int locationId) {
+	int current = index->locations[handle];
+	if (current == locationId) {
+		return;
+	}
+	if (current != DISTRICT_UNFILED) {
+		const DistrictBucket* bucket = &index->buckets[current];
+		PLATFORM_PREFETCH(&bucket->handles[index->positions[handle]]);
+		PLATFORM_PREFETCH(&bucket->handles[bucket->count - 1]);
+	}
+	if (locationId >= 0 && locationId < index->bucketCount && index->buckets[locationId].handles != NULL) {
+		const DistrictBucket* bucket = &index->buckets[locationId];
+		PLATFORM_PREFETCH(&bucket->handles[bucket->count]);
+	}
+}
+
+const int* DistrictHandles(const DistrictIndex* index, int locationId, int* count) {
+	if (locationId < 0 || locationId >= index->bucketCount || index->buckets[locationId].count == 0) {
+		*count = 0;
+		return NULL;
+	}
+	*count = index->buckets[locationId].count;
+	return index->buckets[locationId].handles;
+}
+
+void DistrictFree(DistrictIndex* index) {
+	for (int locationId = 0; locationId < index->bucketCount; locationId++) {
+		free(index->buckets[locationId].handles);
+	}
+	free(index->buckets);
+	free(index->locations);
+	free(index->positions);
+	memset(index, 0, sizeof(DistrictIndex));
+}
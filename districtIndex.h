@@ -0,0 +1,102 @@
+/**
+ * @file   districtIndex.h
+ * @brief  This file includes the index of the vehicles parked in every location.
+ *
+ * Every location has a bucket holding the handles of its vehicles, and every
+ * handle remembers its position inside its bucket. Filing a vehicle appends
+ * it to a bucket and removing it moves the last handle of the bucket into the
+ * gap, so adding, deleting and relocating a vehicle are O(1) and listing the
+ * vehicles of a location costs only as much as there are vehicles there.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef DISTRICT_INDEX_H
+#define DISTRICT_INDEX_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define DISTRICT_UNFILED (-1)       /**< Location stored for handles that are not in any bucket. */
+
+/**
+ * @brief Handles of the vehicles in one location.
+ */
+typedef struct DistrictBucket {
+	int* handles;                   /**< Handles in no particular order. */
+	int count;                      /**< Number of handles in the bucket. */
+	int capacity;                   /**< Size of handles. */
+} DistrictBucket;
+
+/**
+ * @brief Buckets of every location together with the position of every handle.
+ */
+typedef struct DistrictIndex {
+	DistrictBucket* buckets;        /**< Buckets indexed by location ID. */
+	int bucketCount;                /**< Number of buckets (highest location ID filed plus one). */
+	int* locations;                 /**< Location each handle is filed under, DISTRICT_UNFILED if none. */
+	int* positions;                 /**< Position of each handle inside its bucket. */
+	int capacity;                   /**< Number of handles the per-handle arrays can hold. */
+} DistrictIndex;
+
+/**
+ * @brief Makes sure the index can hold a number of handles.
+ *
+ * @param index The index.
+ * @param capacity The required number of handles.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int DistrictReserve(DistrictIndex* index, int capacity);
+
+/**
+ * @brief Files a handle under a location, moving it out of its previous location if needed.
+ *
+ * Handles with a negative location are kept out of every bucket.
+ *
+ * @param index The index.
+ * @param handle The handle, lower than the reserved capacity.
+ * @param locationId The location of the vehicle.
+ * @return 1 on success, 0 if memory could not be allocated (the handle is then left unfiled).
+ */
+int DistrictFile(DistrictIndex* index, int handle, int locationId);
+
+/**
+ * @brief Starts loading the buckets a DistrictFile of a handle will touch, so a batch of moves overlaps its cache misses.
+ *
+ * @param index The index.
+ * @param handle The handle, lower than the reserved capacity.
+ * @param locationId The location the handle will be filed under.
+ */
+void DistrictPrefetch(const DistrictIndex* index, int handle, int locationId);
+
+/**
+ * @brief Takes a handle out of its bucket.
+ *
+ * @param index The index.
+ * @param handle The handle.
+ */
+void DistrictRemove(DistrictIndex* index, int handle);
+
+/**
+ * @brief Gets the handles of the vehicles in a location.
+ *
+ * The array is only valid until the index changes.
+ *
+ * @param index The index.
+ * @param locationId The location.
+ * @param count Receives the number of handles.
+ * @return The handles, NULL if the location has none.
+ */
+const int* DistrictHandles(const DistrictIndex* index, int locationId, int* count);
+
+/**
+ * @brief Frees the memory used by the index and leaves it empty.
+ *
+ * @param index The index.
+ */
+void DistrictFree(DistrictIndex* index);
+
+#endif  // DISTRICT_INDEX_H
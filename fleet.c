@@ -0,0 +1,261 @@
+#include "fleet.h"
+#include "mobility.h"
+
+#if defined(FLEET_FORCE_SCALAR)
+#define FLEET_KERNEL_SCALAR
+#elif defined(__AVX2__)
+#define FLEET_KERNEL_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLEET_KERNEL_SSE2
+#include <emmintrin.h>
+#else
+#define FLEET_KERNEL_SCALAR
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+static void* AlignedAlloc(size_t size) {
+#ifdef _MSC_VER
+	return _aligned_malloc(size, FLEET_ALIGNMENT);
+#else
+	void* memory = NULL;
+	return posix_memalign(&memory, FLEET_ALIGNMENT, size) == 0 ? memory : NULL;
+#endif
+}
+
+static void AlignedFree(void* memory) {
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+static int CountTrailingZeros(unsigned int bits) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, bits);
+	return (int)index;
+#else
+	return __builtin_ctz(bits);
+#endif
+}
+
+static int CountBits(unsigned int bits) {
+	bits = bits - ((bits >> 1) & 0x55555555u);
+	bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+	return (int)((((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+}
+
+static int GrowColumn(void** column, int count, int capacity, size_t elementSize) {
+	void* grown = AlignedAlloc(capacity * elementSize);
+	if (grown == NULL) {
+		return 0;
+	}
+	if (*column != NULL) {
+		memcpy(grown, *column, count * elementSize);
+		AlignedFree(*column);
+	}
+	*column = grown;
+	return 1;
+}
+
+int FleetReserve(FleetColumns* columns, int capacity) {
+	if (capacity <= columns->capacity) {
+		return 1;
+	}
+
+	// Round up to whole bitmap words so the kernels never need a partial vector load
+	capacity = (capacity + 31) & ~31;
+
+	int count = columns->count;
+	if (!GrowColumn((void**)&columns->id, count, capacity, sizeof(int)) ||
+		!GrowColumn((void**)&columns->type, count, capacity, sizeof(int)) ||
+		!GrowColumn((void**)&columns->batteryLevel, count, capacity, sizeof(float)) ||
+		!GrowColumn((void**)&columns->cost, count, capacity, sizeof(float)) ||
+		!GrowColumn((void**)&columns->batteryCapacity, count, capacity, sizeof(float)) ||
+		!GrowColumn((void**)&columns->energyCostWPerKm, count, capacity, sizeof(float)) ||
+		!GrowColumn((void**)&columns->vehicleWeight, count, capacity, sizeof(int)) ||
+		!GrowColumn((void**)&columns->maxTransportWeight, count, capacity, sizeof(int)) ||
+		!GrowColumn((void**)&columns->locationId, count, capacity, sizeof(int))) {
+		return 0;
+	}
+
+	for (int slot = count; slot < capacity; slot++) {
+		columns->type[slot] = FLEET_FREE_SLOT;
+	}
+	columns->capacity = capacity;
+	return 1;
+}
+
+void FleetSetSlot(FleetColumns* columns, int slot, const Mobility* mobility) {
+	columns->id[slot] = mobility->id;
+	columns->type[slot] = (int)mobility->type;
+	columns->batteryLevel[slot] = mobility->battery_level;
+	columns->cost[slot] = mobility->cost;
+	columns->batteryCapacity[slot] = mobility->batteryCapacity;
+	columns->energyCostWPerKm[slot] = mobility->energyCostWPerKm;
+	columns->vehicleWeight[slot] = mobility->vehicleWeight;
+	columns->maxTransportWeight[slot] = mobility->maxTransportWeight;
+	columns->locationId[slot] = mobility->locationId;
+
+	if (slot >= columns->count) {
+		columns->count = slot + 1;
+	}
+}
+
+void FleetSetStatus(FleetColumns* columns, int slot, float batteryLevel, int locationId) {
+	columns->batteryLevel[slot] = batteryLevel;
+	columns->locationId[slot] = locationId;
+}
+
+void FleetClearSlot(FleetColumns* columns, int slot) {
+	columns->type[slot] = FLEET_FREE_SLOT;
+}
+
+void FleetFree(FleetColumns* columns) {
+	AlignedFree(columns->id);
+	AlignedFree(columns->type);
+	AlignedFree(columns->batteryLevel);
+	AlignedFree(columns->cost);
+	AlignedFree(columns->batteryCapacity);
+	AlignedFree(columns->energyCostWPerKm);
+	AlignedFree(columns->vehicleWeight);
+	AlignedFree(columns->maxTransportWeight);
+	AlignedFree(columns->locationId);
+	memset(columns, 0, sizeof(FleetColumns));
+}
+
+int FleetBitmapWords(const FleetColumns* columns) {
+	return (columns->count + 31) / 32;
+}
+
+static unsigned int MatchWordScalar(const FleetColumns* columns, const FleetFilter* filter, int base, int length) {
+	unsigned int bits = 0;
+
+	for (int i = 0; i < length; i++) {
+		int slot = base + i;
+		int type = columns->type[slot];
+		if (type >= 0 && type < 32 && (filter->typeMask & (1u << type)) &&
+			columns->batteryLevel[slot] < filter->maxBattery &&
+			(filter->locationId == FLEET_ANY_LOCATION || columns->locationId[slot] == filter->locationId)) {
+			bits |= 1u << i;
+		}
+	}
+	return bits;
+}
+
+#if defined(FLEET_KERNEL_AVX2)
+
+static unsigned int MatchWord(const FleetColumns* columns, const FleetFilter* filter, int base) {
+	const __m256i ones = _mm256_set1_epi32(1);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i typeMask = _mm256_set1_epi32((int)filter->typeMask);
+	const __m256 maxBattery = _mm256_set1_ps(filter->maxBattery);
+	const __m256i location = _mm256_set1_epi32(filter->locationId);
+	const int anyLocation = filter->locationId == FLEET_ANY_LOCATION;
+	unsigned int bits = 0;
+
+	for (int lane = 0; lane < 32; lane += 8) {
+		int slot = base + lane;
+		// Shift counts above 31 (free slots are -1) produce 0, so they never match
+		__m256i type = _mm256_load_si256((const __m256i*)(columns->type + slot));
+		__m256i typeMiss = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_sllv_epi32(ones, type), typeMask), zero);
+		__m256 batteryOk = _mm256_cmp_ps(_mm256_load_ps(columns->batteryLevel + slot), maxBattery, _CMP_LT_OQ);
+		__m256i match = _mm256_andnot_si256(typeMiss, _mm256_castps_si256(batteryOk));
+		if (!anyLocation) {
+			__m256i locationId = _mm256_load_si256((const __m256i*)(columns->locationId + slot));
+			match = _mm256_and_si256(match, _mm256_cmpeq_epi32(locationId, location));
+		}
+		bits |= (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(match)) << lane;
+	}
+	return bits;
+}
+
+#elif defined(FLEET_KERNEL_SSE2)
+
+static unsigned int MatchWord(const FleetColumns* columns, const FleetFilter* filter, int base) {
+	const __m128 maxBattery = _mm_set1_ps(filter->maxBattery);
+	const __m128i location = _mm_set1_epi32(filter->locationId);
+	const int anyLocation = filter->locationId == FLEET_ANY_LOCATION;
+	__m128i types[32];
+	int typeCount = 0;
+	unsigned int bits = 0;
+
+	// SSE2 has no per-lane shift, so compare against each accepted type instead
+	for (unsigned int mask = filter->typeMask; mask != 0; mask &= mask - 1) {
+		types[typeCount++] = _mm_set1_epi32(CountTrailingZeros(mask));
+	}
+
+	for (int lane = 0; lane < 32; lane += 4) {
+		int slot = base + lane;
+		__m128i type = _mm_load_si128((const __m128i*)(columns->type + slot));
+		__m128i typeOk = _mm_setzero_si128();
+		for (int t = 0; t < typeCount; t++) {
+			typeOk = _mm_or_si128(typeOk, _mm_cmpeq_epi32(type, types[t]));
+		}
+		__m128 batteryOk = _mm_cmplt_ps(_mm_load_ps(columns->batteryLevel + slot), maxBattery);
+		__m128i match = _mm_and_si128(typeOk, _mm_castps_si128(batteryOk));
+		if (!anyLocation) {
+			__m128i locationId = _mm_load_si128((const __m128i*)(columns->locationId + slot));
+			match = _mm_and_si128(match, _mm_cmpeq_epi32(locationId, location));
+		}
+		bits |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(match)) << lane;
+	}
+	return bits;
+}
+
+#else
+
+static unsigned int MatchWord(const FleetColumns* columns, const FleetFilter* filter, int base) {
+	return MatchWordScalar(columns, filter, base, 32);
+}
+
+#endif
+
+int FleetSelectBitmap(const FleetColumns* columns, const FleetFilter* filter, unsigned int* bitmap) {
+	int selected = 0;
+	int fullWords = columns->count / 32;
+
+	for (int word = 0; word < fullWords; word++) {
+		bitmap[word] = MatchWord(columns, filter, word * 32);
+		selected += CountBits(bitmap[word]);
+	}
+
+	if (columns->count % 32 != 0) {
+		bitmap[fullWords] = MatchWordScalar(columns, filter, fullWords * 32, columns->count % 32);
+		selected += CountBits(bitmap[fullWords]);
+	}
+	return selected;
+}
+
+int FleetSelectIndices(const FleetColumns* columns, const FleetFilter* filter, int* indices) {
+	int selected = 0;
+	int words = FleetBitmapWords(columns);
+
+	for (int word = 0; word < words; word++) {
+		int base = word * 32;
+		unsigned int bits = base + 32 <= columns->count
+			? MatchWord(columns, filter, base)
+			: MatchWordScalar(columns, filter, base, columns->count - base);
+		while (bits != 0) {
+			indices[selected++] = base + CountTrailingZeros(bits);
+			bits &= bits - 1;
+		}
+	}
+	return selected;
+}
+
+const char* FleetKernelName(void) {
+#if defined(FLEET_KERNEL_AVX2)
+	return "avx2";
+#elif defined(FLEET_KERNEL_SSE2)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,137 @@
+/**
+ * @file   fleet.h
+ * @brief  This file includes the columnar fleet view and its scan kernels.
+ *
+ * Every field of the vehicles in a MobilityTable is mirrored in its own
+ * aligned array, indexed by handle, so fleet-wide filters read only the
+ * columns they need and can be vectorized.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define FLEET_ALIGNMENT 32          /**< Alignment in bytes of every column. */
+#define FLEET_FREE_SLOT (-1)        /**< Type stored for slots that hold no vehicle. */
+#define FLEET_ANY_LOCATION (-1)     /**< Location filter value that matches every location. */
+#define FLEET_TYPE_BIT(type) (1u << (type))  /**< Bit of a VehicleType inside FleetFilter.typeMask. */
+
+struct Mobility;
+
+/**
+ * @brief Struct-of-arrays copy of the vehicles of a table.
+ */
+typedef struct FleetColumns {
+	int* id;                        /**< Identifier of each vehicle. */
+	int* type;                      /**< VehicleType of each vehicle, FLEET_FREE_SLOT for free slots. */
+	float* batteryLevel;            /**< Current battery level of each vehicle. */
+	float* cost;                    /**< Cost of each vehicle. */
+	float* batteryCapacity;         /**< Battery capacity of each vehicle. */
+	float* energyCostWPerKm;        /**< Energy cost per kilometer of each vehicle. */
+	int* vehicleWeight;             /**< Weight of each vehicle. */
+	int* maxTransportWeight;        /**< Maximum transport weight of each vehicle. */
+	int* locationId;                /**< Location of each vehicle. */
+	int count;                      /**< Number of slots mirrored in the columns. */
+	int capacity;                   /**< Number of allocated slots in every column. */
+} FleetColumns;
+
+/**
+ * @brief Filter evaluated by the scan kernels.
+ *
+ * A vehicle matches when its type is in typeMask, its battery level is lower
+ * than maxBattery and it is in locationId (or locationId is FLEET_ANY_LOCATION).
+ */
+typedef struct FleetFilter {
+	unsigned int typeMask;          /**< Accepted types, built with FLEET_TYPE_BIT. */
+	float maxBattery;               /**< Exclusive upper bound for the battery level. */
+	int locationId;                 /**< Required location or FLEET_ANY_LOCATION. */
+} FleetFilter;
+
+/**
+ * @brief Makes sure the columns can hold a number of slots.
+ *
+ * @param columns The columns.
+ * @param capacity The required number of slots.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int FleetReserve(FleetColumns* columns, int capacity);
+
+/**
+ * @brief Copies a vehicle into a slot of the columns.
+ *
+ * @param columns The columns.
+ * @param slot The slot (handle) of the vehicle. Must be lower than the capacity.
+ * @param mobility The vehicle data.
+ */
+void FleetSetSlot(FleetColumns* columns, int slot, const struct Mobility* mobility);
+
+/**
+ * @brief Sets the battery level and location of a slot that holds a vehicle.
+ *
+ * @param columns The columns.
+ * @param slot The slot (handle) of the vehicle.
+ * @param batteryLevel The new battery level.
+ * @param locationId The new location.
+ */
+void FleetSetStatus(FleetColumns* columns, int slot, float batteryLevel, int locationId);
+
+/**
+ * @brief Marks a slot as free so no filter matches it.
+ *
+ * @param columns The columns.
+ * @param slot The slot to clear.
+ */
+void FleetClearSlot(FleetColumns* columns, int slot);
+
+/**
+ * @brief Frees the memory used by the columns and leaves them empty.
+ *
+ * @param columns The columns.
+ */
+void FleetFree(FleetColumns* columns);
+
+/**
+ * @brief Gets the number of 32-bit words of a selection bitmap for the columns.
+ *
+ * @param columns The columns.
+ * @return The number of words.
+ */
+int FleetBitmapWords(const FleetColumns* columns);
+
+/**
+ * @brief Evaluates a filter over every slot and writes a selection bitmap.
+ *
+ * Bit (slot % 32) of word (slot / 32) is set when the slot matches.
+ *
+ * @param columns The columns.
+ * @param filter The filter.
+ * @param bitmap Output bitmap with at least FleetBitmapWords entries.
+ * @return The number of selected slots.
+ */
+int FleetSelectBitmap(const FleetColumns* columns, const FleetFilter* filter, unsigned int* bitmap);
+
+/**
+ * @brief Evaluates a filter over every slot and writes the matching slots in ascending order.
+ *
+ * @param columns The columns.
+ * @param filter The filter.
+ * @param indices Output array with room for columns->count entries.
+ * @return The number of selected slots.
+ */
+int FleetSelectIndices(const FleetColumns* columns, const FleetFilter* filter, int* indices);
+
+/**
+ * @brief Gets the name of the kernel selected at compile time.
+ *
+ * @return "avx2", "sse2" or "scalar".
+ */
+const char* FleetKernelName(void);
+
+#endif  // FLEET_H
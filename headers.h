@@ -21,4 +21,6 @@
 #define BIN_LOCATION_FILENAME "Data/Locations/locations.bin"
 #define TXT_LOCATION_SURROUNDINGS_FILENAME "Data/Locations/locations_surroundings.txt"
 #define BIN_LOCATION_SURROUNDINGS_FILENAME "Data/Locations/locations_surroundings.bin"
+#define BIN_DISTANCE_FILENAME "Data/Locations/distances.bin"
+#define JOURNAL_FILENAME "Data/journal.log"
 #endif
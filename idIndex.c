@@ -0,0 +1,131 @@
+#include "idIndex.h"
+#include "platform.h"
+
+// Fibonacci hashing: the top bits of the product spread consecutive IDs over the whole table
+static int HomeSlot(const IdIndex* index, int id) {
+	return (int)(((unsigned int)id * 2654435769u) >> index->shift);
+}
+
+static int Resize(IdIndex* index, int newCapacity) {
+	IdIndexEntry* entries = (IdIndexEntry*)malloc(newCapacity * sizeof(IdIndexEntry));
+	if (entries == NULL) {
+		return 0;
+	}
+	for (int slot = 0; slot < newCapacity; slot++) {
+		entries[slot].handle = ID_INDEX_MISSING;
+	}
+
+	IdIndexEntry* oldEntries = index->entries;
+	int oldCapacity = index->capacity;
+	int shift = 32;
+	for (int size = newCapacity; size > 1; size >>= 1) {
+		shift--;
+	}
+	index->entries = entries;
+	index->capacity = newCapacity;
+	index->shift = shift;
+
+	int mask = newCapacity - 1;
+	for (int i = 0; i < oldCapacity; i++) {
+		if (oldEntries[i].handle == ID_INDEX_MISSING) {
+			continue;
+		}
+		int slot = HomeSlot(index, oldEntries[i].id);
+		while (entries[slot].handle != ID_INDEX_MISSING) {
+			slot = (slot + 1) & mask;
+		}
+		entries[slot] = oldEntries[i];
+	}
+	free(oldEntries);
+	return 1;
+}
+
+int IdIndexReserve(IdIndex* index, int count) {
+	// Keep the load factor under 70%
+	if ((long long)count * 10 <= (long long)index->capacity * 7) {
+		return 1;
+	}
+	int newCapacity = index->capacity == 0 ? ID_INDEX_MIN_CAPACITY : index->capacity;
+	while ((long long)count * 10 > (long long)newCapacity * 7) {
+		newCapacity *= 2;
+	}
+	return Resize(index, newCapacity);
+}
+
+int IdIndexInsert(IdIndex* index, int id, int handle) {
+	if (!IdIndexReserve(index, index->count + 1)) {
+		return 0;
+	}
+
+	int mask = index->capacity - 1;
+	int slot = HomeSlot(index, id);
+	while (index->entries[slot].handle != ID_INDEX_MISSING) {
+		if (index->entries[slot].id == id) {
+			index->entries[slot].handle = handle;
+			return 1;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	index->entries[slot].id = id;
+	index->entries[slot].handle = handle;
+	index->count++;
+	return 1;
+}
+
+int IdIndexFind(const IdIndex* index, int id) {
+	if (index->count == 0) {
+		return ID_INDEX_MISSING;
+	}
+
+	int mask = index->capacity - 1;
+	int slot = HomeSlot(index, id);
+	while (index->entries[slot].handle != ID_INDEX_MISSING) {
+		if (index->entries[slot].id == id) {
+			return index->entries[slot].handle;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return ID_INDEX_MISSING;
+}
+
+void IdIndexPrefetch(const IdIndex* index, int id) {
+	if (index->count > 0) {
+		PLATFORM_PREFETCH(&index->entries[HomeSlot(index, id)]);
+	}
+}
+
+void IdIndexRemove(IdIndex* index, int id) {
+	if (index->count == 0) {
+		return;
+	}
+
+	int mask = index->capacity - 1;
+	int slot = HomeSlot(index, id);
+	while (index->entries[slot].handle != ID_INDEX_MISSING && index->entries[slot].id != id) {
+		slot = (slot + 1) & mask;
+	}
+	if (index->entries[slot].handle == ID_INDEX_MISSING) {
+		return;
+	}
+
+	// Move back every later entry of the run that may sit in the gap, so no probe stops short of its key
+	int gap = slot;
+	for (int next = (gap + 1) & mask; index->entries[next].handle != ID_INDEX_MISSING; next = (next + 1) & mask) {
+		int home = HomeSlot(index, index->entries[next].id);
+		if (((next - home) & mask) >= ((next - gap) & mask)) {
+			index->entries[gap] = index->entries[next];
+			gap = next;
+		}
+	}
+	index->entries[gap].handle = ID_INDEX_MISSING;
+	index->count--;
+}
+
+void IdIndexFree(IdIndex* index) {
+	free(index->entries);
+	index->entries = NULL;
+	index->capacity = 0;
+	index->count = 0;
+	index->shift = 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file   idIndex.h
+ * @brief  This file includes the hash index from vehicle IDs to their handles.
+ *
+ * Telemetry and the menus name a vehicle by its ID, which says nothing about
+ * where the vehicle is stored. The index maps every ID to its handle with
+ * open addressing and linear probing over a flat array of (ID, handle)
+ * pairs, so a lookup is a multiplication and usually a single cache line.
+ * Removing an ID shifts the entries that follow it back into the gap instead
+ * of leaving a tombstone, so lookups stay short however many vehicles are
+ * deleted and added back.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef ID_INDEX_H
+#define ID_INDEX_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define ID_INDEX_MISSING (-1)           /**< Handle returned for an ID that is not in the index. */
+#define ID_INDEX_MIN_CAPACITY 64        /**< Initial number of slots of the table. */
+
+/**
+ * @brief Slot of the index.
+ */
+typedef struct IdIndexEntry {
+	int id;                         /**< Key of the entry. */
+	int handle;                     /**< Handle of the vehicle, ID_INDEX_MISSING when the slot is empty. */
+} IdIndexEntry;
+
+/**
+ * @brief Open-addressing hash table from IDs to handles.
+ */
+typedef struct IdIndex {
+	IdIndexEntry* entries;          /**< Slots of the table. */
+	int capacity;                   /**< Number of slots, always a power of two. */
+	int count;                      /**< Number of used slots. */
+	int shift;                      /**< 32 minus the log2 of the capacity, for the multiplicative hash. */
+} IdIndex;
+
+/**
+ * @brief Makes sure the index can hold a number of IDs without growing.
+ *
+ * @param index The index.
+ * @param count The required number of IDs.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int IdIndexReserve(IdIndex* index, int count);
+
+/**
+ * @brief Associates an ID with a handle, replacing the handle it had.
+ *
+ * @param index The index.
+ * @param id The ID.
+ * @param handle The handle, zero or higher.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int IdIndexInsert(IdIndex* index, int id, int handle);
+
+/**
+ * @brief Finds the handle associated with an ID.
+ *
+ * @param index The index.
+ * @param id The ID.
+ * @return The handle. If not found, returns ID_INDEX_MISSING.
+ */
+int IdIndexFind(const IdIndex* index, int id);
+
+/**
+ * @brief Starts loading the slot an ID is looked up in, so a later IdIndexFind does not wait for memory.
+ *
+ * @param index The index.
+ * @param id The ID.
+ */
+void IdIndexPrefetch(const IdIndex* index, int id);
+
+/**
+ * @brief Removes an ID from the index.
+ *
+ * @param index The index.
+ * @param id The ID.
+ */
+void IdIndexRemove(IdIndex* index, int id);
+
+/**
+ * @brief Frees the memory used by the index and leaves it empty.
+ *
+ * @param index The index.
+ */
+void IdIndexFree(IdIndex* index);
+
+#endif  // ID_INDEX_H
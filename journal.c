@@ -0,0 +1,363 @@
+#include "journal.h"
+
+#include <stddef.h>
+
+#define FNV_OFFSET_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define CHECKED_HEADER_OFFSET (2 * sizeof(unsigned int))
+
+static unsigned int HashBytes(unsigned int hash, const unsigned char* data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+// The checksum covers the header from the sequence number on, and the record
+static unsigned int RecordChecksum(const JournalRecordHeader* header, const void* record) {
+	unsigned int hash = HashBytes(FNV_OFFSET_BASIS, (const unsigned char*)header + CHECKED_HEADER_OFFSET,
+		sizeof(JournalRecordHeader) - CHECKED_HEADER_OFFSET);
+	return HashBytes(hash, (const unsigned char*)record, header->recordSize);
+}
+
+static size_t RecordLength(size_t recordSize) {
+	size_t length = sizeof(JournalRecordHeader) + recordSize;
+	return (length + JOURNAL_RECORD_ALIGNMENT - 1) & ~(size_t)(JOURNAL_RECORD_ALIGNMENT - 1);
+}
+
+// Returns the length of the record at offset, or 0 if it is torn or corrupt
+static size_t ReadRecordHeader(const unsigned char* data, size_t size, size_t offset,
+	unsigned long long previousSequence, JournalRecordHeader* header) {
+	if (size - offset < sizeof(JournalRecordHeader)) {
+		return 0;
+	}
+	memcpy(header, data + offset, sizeof(JournalRecordHeader));
+
+	if (header->magic != JOURNAL_RECORD_MAGIC || header->sequence <= previousSequence ||
+		header->recordSize > size - offset - sizeof(JournalRecordHeader)) {
+		return 0;
+	}
+
+	size_t length = RecordLength(header->recordSize);
+	if (length > size - offset) {
+		return 0;
+	}
+	if (RecordChecksum(header, data + offset + sizeof(JournalRecordHeader)) != header->checksum) {
+		return 0;
+	}
+	return length;
+}
+
+// Writes a byte range to "<filename>.tmp" and flushes it to disk
+static int WriteJournalCopy(const char* filename, const unsigned char* data, size_t length, char* tempFilename, size_t tempSize) {
+	if (snprintf(tempFilename, tempSize, "%s.tmp", filename) >= (int)tempSize) {
+		return 0;
+	}
+
+	FILE* file = fopen(tempFilename, "wb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	int ok = length == 0 || fwrite(data, 1, length, file) == length;
+	ok = ok && PlatformSyncFile(file);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok) {
+		remove(tempFilename);
+	}
+	return ok;
+}
+
+// Runs on the flusher thread, which is the only one touching the file
+static int DropOperations(Journal* journal, unsigned long long sequence, unsigned long long* newSize) {
+	fclose(journal->file);
+	journal->file = NULL;
+
+	PlatformFileMapping mapping;
+	int ok = PlatformMapFile(journal->filename, &mapping);
+	char tempFilename[FILENAME_MAX];
+
+	if (ok) {
+		JournalRecordHeader header;
+		unsigned long long previous = 0;
+		size_t first = 0, offset = 0, length;
+
+		while ((length = ReadRecordHeader(mapping.data, mapping.size, offset, previous, &header)) > 0) {
+			previous = header.sequence;
+			offset += length;
+			if (header.sequence <= sequence) {
+				first = offset;
+			}
+		}
+
+		*newSize = offset - first;
+		ok = WriteJournalCopy(journal->filename, mapping.data + first, offset - first, tempFilename, sizeof(tempFilename));
+		PlatformUnmapFile(&mapping);
+		ok = ok && PlatformReplaceFile(tempFilename, journal->filename);
+		if (!ok) {
+			remove(tempFilename);
+		}
+	}
+
+	journal->file = fopen(journal->filename, "ab");
+	return ok && journal->file != NULL;
+}
+
+static int RunFlusher(void* argument) {
+	Journal* journal = (Journal*)argument;
+
+	PlatformLockMutex(journal->mutex);
+	while (1) {
+		while (journal->pendingSize == 0 && !journal->compactRequested && !journal->stopping) {
+			PlatformWaitCondition(journal->pendingChanged, journal->mutex);
+		}
+		if (journal->pendingSize == 0 && !journal->compactRequested) {
+			break;
+		}
+
+		// Take everything appended so far as one batch and let appenders fill the other buffer
+		unsigned char* batch = journal->pending;
+		size_t batchSize = journal->pendingSize;
+		size_t batchCapacity = journal->pendingCapacity;
+		unsigned long long batchSequence = journal->lastSequence;
+		int compact = journal->compactRequested;
+		unsigned long long compactSequence = journal->compactSequence;
+
+		journal->pending = journal->writing;
+		journal->pendingCapacity = journal->writingCapacity;
+		journal->pendingSize = 0;
+		journal->writing = batch;
+		journal->writingCapacity = batchCapacity;
+		PlatformUnlockMutex(journal->mutex);
+
+		int written = 1;
+		if (batchSize > 0) {
+			written = journal->file != NULL && fwrite(batch, 1, batchSize, journal->file) == batchSize &&
+				PlatformSyncFile(journal->file);
+		}
+
+		unsigned long long compactedSize = 0;
+		int compacted = compact && written && DropOperations(journal, compactSequence, &compactedSize);
+
+		PlatformLockMutex(journal->mutex);
+		if (written) {
+			journal->durableSequence = batchSequence;
+			journal->fileSize += batchSize;
+			journal->stats.commits += batchSize > 0;
+		}
+		else {
+			journal->failed = 1;
+		}
+		if (compact) {
+			journal->compactRequested = 0;
+			journal->compactResult = compacted;
+			if (compacted) {
+				journal->fileSize = compactedSize;
+				journal->stats.compactions++;
+			}
+		}
+		if (journal->file == NULL) {
+			journal->failed = 1;
+		}
+		PlatformBroadcastCondition(journal->durableChanged);
+	}
+	PlatformUnlockMutex(journal->mutex);
+	return 0;
+}
+
+static int ReplayJournal(Journal* journal, JournalApply apply, void* context) {
+	PlatformFileMapping mapping;
+	if (!PlatformMapFile(journal->filename, &mapping)) {
+		return 1;
+	}
+
+	JournalRecordHeader header;
+	size_t offset = 0, length;
+
+	while ((length = ReadRecordHeader(mapping.data, mapping.size, offset, journal->lastSequence, &header)) > 0) {
+		const unsigned char* record = mapping.data + offset + sizeof(JournalRecordHeader);
+
+		if (apply != NULL) {
+			JournalEntry entry;
+			entry.sequence = header.sequence;
+			entry.recordType = (SnapshotRecordType)header.recordType;
+			entry.operation = (JournalOperation)header.operation;
+			entry.key = mapping.data + offset + offsetof(JournalRecordHeader, key);
+			entry.record = header.recordSize > 0 ? record : NULL;
+			entry.recordSize = header.recordSize;
+			entry.version = header.version > 0 ? header.version : 1;
+			apply(&entry, context);
+		}
+
+		journal->lastSequence = header.sequence;
+		offset += length;
+	}
+
+	journal->fileSize = offset;
+	if (offset == mapping.size) {
+		PlatformUnmapFile(&mapping);
+		return 1;
+	}
+
+	// Cut off the torn tail, otherwise new records would be appended after it and never replayed
+	fprintf(stderr, "%s: discarding %zu bytes after the last valid record\n", journal->filename, mapping.size - offset);
+	char tempFilename[FILENAME_MAX];
+	int ok = WriteJournalCopy(journal->filename, mapping.data, offset, tempFilename, sizeof(tempFilename));
+	PlatformUnmapFile(&mapping);
+	return ok && PlatformReplaceFile(tempFilename, journal->filename);
+}
+
+int OpenJournal(Journal* journal, const char* filename, unsigned long long snapshotSequence, JournalApply apply, void* context) {
+	memset(journal, 0, sizeof(Journal));
+	journal->filename = filename;
+
+	if (!ReplayJournal(journal, apply, context)) {
+		return 0;
+	}
+
+	// A compacted journal may be empty, numbering must still continue after the snapshots
+	if (journal->lastSequence < snapshotSequence) {
+		journal->lastSequence = snapshotSequence;
+	}
+	journal->durableSequence = journal->lastSequence;
+
+	journal->file = fopen(filename, "ab");
+	journal->mutex = PlatformCreateMutex();
+	journal->pendingChanged = PlatformCreateCondition();
+	journal->durableChanged = PlatformCreateCondition();
+	journal->pending = (unsigned char*)malloc(JOURNAL_INITIAL_BUFFER);
+	journal->writing = (unsigned char*)malloc(JOURNAL_INITIAL_BUFFER);
+	journal->pendingCapacity = JOURNAL_INITIAL_BUFFER;
+	journal->writingCapacity = JOURNAL_INITIAL_BUFFER;
+
+	if (journal->file == NULL || journal->mutex == NULL || journal->pendingChanged == NULL ||
+		journal->durableChanged == NULL || journal->pending == NULL || journal->writing == NULL) {
+		CloseJournal(journal);
+		return 0;
+	}
+
+	journal->flusher = PlatformStartThread(RunFlusher, journal);
+	if (journal->flusher == NULL) {
+		CloseJournal(journal);
+		return 0;
+	}
+	return 1;
+}
+
+unsigned long long AppendToJournal(Journal* journal, SnapshotRecordType recordType, JournalOperation operation,
+	const void* key, size_t keySize, const void* record, size_t recordSize) {
+	JournalRecordHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = JOURNAL_RECORD_MAGIC;
+	header.recordType = (unsigned int)recordType;
+	header.operation = (unsigned int)operation;
+	header.recordSize = record != NULL ? (unsigned int)recordSize : 0;
+	header.version = SNAPSHOT_VERSION;
+	memcpy(header.key, key, keySize < JOURNAL_KEY_SIZE ? keySize : JOURNAL_KEY_SIZE);
+
+	size_t length = RecordLength(header.recordSize);
+
+	PlatformLockMutex(journal->mutex);
+	if (journal->failed || journal->stopping) {
+		PlatformUnlockMutex(journal->mutex);
+		return 0;
+	}
+
+	if (journal->pendingSize + length > journal->pendingCapacity) {
+		size_t newCapacity = journal->pendingCapacity * 2;
+		while (journal->pendingSize + length > newCapacity) {
+			newCapacity *= 2;
+		}
+		unsigned char* grown = (unsigned char*)realloc(journal->pending, newCapacity);
+		if (grown == NULL) {
+			PlatformUnlockMutex(journal->mutex);
+			return 0;
+		}
+		journal->pending = grown;
+		journal->pendingCapacity = newCapacity;
+	}
+
+	header.sequence = ++journal->lastSequence;
+	header.checksum = RecordChecksum(&header, record);
+
+	unsigned char* destination = journal->pending + journal->pendingSize;
+	memcpy(destination, &header, sizeof(header));
+	if (header.recordSize > 0) {
+		memcpy(destination + sizeof(header), record, header.recordSize);
+	}
+	memset(destination + sizeof(header) + header.recordSize, 0, length - sizeof(header) - header.recordSize);
+	journal->pendingSize += length;
+	journal->stats.records++;
+
+	PlatformSignalCondition(journal->pendingChanged);
+	PlatformUnlockMutex(journal->mutex);
+	return header.sequence;
+}
+
+int WaitForJournal(Journal* journal, unsigned long long sequence) {
+	PlatformLockMutex(journal->mutex);
+	while (journal->durableSequence < sequence && !journal->failed) {
+		PlatformWaitCondition(journal->durableChanged, journal->mutex);
+	}
+	int durable = journal->durableSequence >= sequence;
+	PlatformUnlockMutex(journal->mutex);
+	return durable;
+}
+
+int CompactJournal(Journal* journal, unsigned long long sequence) {
+	PlatformLockMutex(journal->mutex);
+	while (journal->compactRequested && !journal->stopping) {
+		PlatformWaitCondition(journal->durableChanged, journal->mutex);
+	}
+	if (journal->stopping || journal->failed) {
+		PlatformUnlockMutex(journal->mutex);
+		return 0;
+	}
+
+	journal->compactRequested = 1;
+	journal->compactSequence = sequence;
+	PlatformSignalCondition(journal->pendingChanged);
+	while (journal->compactRequested) {
+		PlatformWaitCondition(journal->durableChanged, journal->mutex);
+	}
+
+	int result = journal->compactResult;
+	PlatformUnlockMutex(journal->mutex);
+	return result;
+}
+
+unsigned long long GetJournalSize(Journal* journal) {
+	PlatformLockMutex(journal->mutex);
+	unsigned long long size = journal->fileSize + journal->pendingSize;
+	PlatformUnlockMutex(journal->mutex);
+	return size;
+}
+
+unsigned long long GetLastJournalSequence(Journal* journal) {
+	PlatformLockMutex(journal->mutex);
+	unsigned long long sequence = journal->lastSequence;
+	PlatformUnlockMutex(journal->mutex);
+	return sequence;
+}
+
+void CloseJournal(Journal* journal) {
+	if (journal->flusher != NULL) {
+		PlatformLockMutex(journal->mutex);
+		journal->stopping = 1;
+		PlatformSignalCondition(journal->pendingChanged);
+		PlatformUnlockMutex(journal->mutex);
+		PlatformJoinThread(journal->flusher);
+	}
+
+	if (journal->file != NULL) {
+		fclose(journal->file);
+	}
+	PlatformDestroyCondition(journal->durableChanged);
+	PlatformDestroyCondition(journal->pendingChanged);
+	PlatformDestroyMutex(journal->mutex);
+	free(journal->pending);
+	free(journal->writing);
+	memset(journal, 0, sizeof(Journal));
+}
@@ -0,0 +1,189 @@
+/**
+ * @file   journal.h
+ * @brief  This file includes the append-only journal of changes to the data files.
+ *
+ * Every add, update and delete of a client, manager or vehicle, and every
+ * batch of vehicle telemetry, is appended to the journal instead of rewriting
+ * the whole snapshot. Appends only copy the
+ * operation into memory; a background thread writes everything appended since
+ * its last pass with a single write and a single flush to disk (group commit),
+ * so many concurrent edits share one disk flush. On startup the journal is
+ * replayed on top of the snapshots, and once the snapshots are rewritten the
+ * operations they already include are dropped from the journal.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "platform.h"
+#include "snapshot.h"
+
+#define JOURNAL_RECORD_MAGIC 0x4C4E524Au   /**< "JRNL", marks the start of every record. */
+#define JOURNAL_KEY_SIZE 16                /**< Size of the key stored with every record. */
+#define JOURNAL_RECORD_ALIGNMENT 8         /**< Every record starts at a multiple of this value. */
+#define JOURNAL_INITIAL_BUFFER (64 * 1024) /**< Initial size of the buffers of pending records. */
+
+/**
+ * @brief Kind of change recorded in the journal.
+ */
+typedef enum {
+	JournalAdd = 1,                 /**< A record was added. */
+	JournalUpdate = 2,              /**< The record stored under the key was replaced. */
+	JournalDelete = 3,              /**< The record stored under the key was deleted. */
+	JournalStatus = 4               /**< The battery and location of the vehicles in the record were set; the key holds their number. */
+} JournalOperation;
+
+/**
+ * @brief Header written before every journal record.
+ */
+typedef struct JournalRecordHeader {
+	unsigned int magic;             /**< JOURNAL_RECORD_MAGIC. */
+	unsigned int checksum;          /**< FNV-1a of the rest of the header and of the record. */
+	unsigned long long sequence;    /**< Sequence number of the operation, starting at 1. */
+	unsigned int recordType;        /**< SnapshotRecordType of the record. */
+	unsigned int operation;         /**< JournalOperation. */
+	unsigned int recordSize;        /**< Size of the record that follows, 0 for deletes. */
+	unsigned int version;           /**< SNAPSHOT_VERSION the record was written with, 0 before version 2. */
+	unsigned char key[JOURNAL_KEY_SIZE];  /**< NIF or ID the operation applies to, zero-padded. */
+} JournalRecordHeader;
+
+/**
+ * @brief Operation read back from the journal.
+ */
+typedef struct JournalEntry {
+	unsigned long long sequence;    /**< Sequence number of the operation. */
+	SnapshotRecordType recordType;  /**< Type of the record. */
+	JournalOperation operation;     /**< Kind of change. */
+	const unsigned char* key;       /**< Key of the operation, JOURNAL_KEY_SIZE bytes. */
+	const void* record;             /**< New value of the record, NULL for deletes. */
+	size_t recordSize;              /**< Size of the record. */
+	unsigned int version;           /**< Snapshot version whose layout the record has, at least 1. */
+} JournalEntry;
+
+/**
+ * @brief Applies an operation read back from the journal.
+ */
+typedef void (*JournalApply)(const JournalEntry* entry, void* context);
+
+/**
+ * @brief Counters of a journal.
+ */
+typedef struct JournalStats {
+	unsigned long long records;     /**< Operations appended since the journal was opened. */
+	unsigned long long commits;     /**< Flushes to disk, each covering one or more operations. */
+	unsigned long long compactions; /**< Times the journal was cut down after a snapshot. */
+} JournalStats;
+
+/**
+ * @brief Journal open for appending.
+ */
+typedef struct Journal {
+	const char* filename;           /**< Name of the journal file. */
+	FILE* file;                     /**< Journal file, only used by the flusher thread. */
+	PlatformMutex* mutex;           /**< Protects every field below. */
+	PlatformCondition* pendingChanged;   /**< Signaled when there is work for the flusher. */
+	PlatformCondition* durableChanged;   /**< Signaled when the flusher finishes a pass. */
+	PlatformThread* flusher;        /**< Thread that writes and flushes the pending records. */
+	unsigned char* pending;         /**< Records appended but not yet handed to the flusher. */
+	size_t pendingSize;             /**< Bytes used in pending. */
+	size_t pendingCapacity;         /**< Size of pending. */
+	unsigned char* writing;         /**< Records being written by the flusher. */
+	size_t writingCapacity;         /**< Size of writing. */
+	unsigned long long lastSequence;     /**< Sequence number of the last appended operation. */
+	unsigned long long durableSequence;  /**< Last operation known to be on disk. */
+	unsigned long long fileSize;    /**< Bytes in the journal file. */
+	unsigned long long compactSequence;  /**< Operations up to this one are dropped on the next compaction. */
+	int compactRequested;           /**< 1 while a compaction waits for the flusher. */
+	int compactResult;              /**< Result of the last compaction. */
+	int stopping;                   /**< 1 once CloseJournal was called. */
+	int failed;                     /**< 1 once a write failed; later appends are refused. */
+	JournalStats stats;             /**< Counters. */
+} Journal;
+
+/**
+ * @brief Replays a journal file and opens it for appending.
+ *
+ * Every valid operation is passed to apply in order. Replay stops at the
+ * first torn or corrupt record, which is what a crash in the middle of a write
+ * leaves behind, and that tail is cut off before new operations are appended.
+ *
+ * @param journal The journal to initialize.
+ * @param filename The name of the journal file, created if it does not exist.
+ * @param snapshotSequence The highest journal sequence number recorded in the snapshots.
+ * @param apply Function called for every operation in the file, may be NULL.
+ * @param context Context passed to apply.
+ * @return 1 on success, 0 if the file could not be opened or the flusher could not be started.
+ */
+int OpenJournal(Journal* journal, const char* filename, unsigned long long snapshotSequence, JournalApply apply, void* context);
+
+/**
+ * @brief Appends an operation to the journal.
+ *
+ * The operation is only copied into memory; use WaitForJournal to wait until
+ * it is on disk. The record must have the layout of the current
+ * SNAPSHOT_VERSION, which is stored with it.
+ *
+ * @param journal The journal.
+ * @param recordType The type of the record.
+ * @param operation The kind of change.
+ * @param key The NIF or ID the operation applies to.
+ * @param keySize The size of the key, at most JOURNAL_KEY_SIZE.
+ * @param record The new value of the record, NULL for deletes.
+ * @param recordSize The size of the record, 0 for deletes.
+ * @return The sequence number of the operation, or 0 if it could not be appended.
+ */
+unsigned long long AppendToJournal(Journal* journal, SnapshotRecordType recordType, JournalOperation operation,
+	const void* key, size_t keySize, const void* record, size_t recordSize);
+
+/**
+ * @brief Waits until an operation is on disk.
+ *
+ * @param journal The journal.
+ * @param sequence The sequence number returned by AppendToJournal.
+ * @return 1 once the operation is on disk, 0 if writing the journal failed.
+ */
+int WaitForJournal(Journal* journal, unsigned long long sequence);
+
+/**
+ * @brief Drops the operations already included in the snapshots from the journal file.
+ *
+ * The operations after sequence are copied to a new file which replaces the
+ * journal. Appends keep working while the copy runs.
+ *
+ * @param journal The journal.
+ * @param sequence The last operation included in every snapshot.
+ * @return 1 on success, 0 on failure (the journal is left as it was).
+ */
+int CompactJournal(Journal* journal, unsigned long long sequence);
+
+/**
+ * @brief Gets the number of bytes in the journal, including operations not yet on disk.
+ *
+ * @param journal The journal.
+ * @return The size of the journal in bytes.
+ */
+unsigned long long GetJournalSize(Journal* journal);
+
+/**
+ * @brief Gets the sequence number of the last appended operation.
+ *
+ * @param journal The journal.
+ * @return The sequence number, 0 if the journal is empty.
+ */
+unsigned long long GetLastJournalSequence(Journal* journal);
+
+/**
+ * @brief Writes the pending operations, stops the flusher and closes the journal.
+ *
+ * @param journal The journal.
+ */
+void CloseJournal(Journal* journal);
+
+#endif  // JOURNAL_H
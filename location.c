@@ -1,55 +1,119 @@
 #include "locations.h"
 #include "headers.h"
 #include "mobility.h"
+#include "csvReader.h"
+#include "nodePool.h"
+#include "chargingPlanner.h"
+#include "metrics.h"
+#include "stringArena.h"
 
 
+static NodePool locationPool = NODE_POOL_INITIALIZER("Location nodes", LocationNode);
+static NodePool locationSurroundingsPool = NODE_POOL_INITIALIZER("Surroundings nodes", LocationSurroundingsNode);
+static StringArena locationStrings;
+
 LocationNode* AddLocation(LocationNode* head, Location newLocation) {
-	LocationNode* newNode = (LocationNode*)malloc(sizeof(LocationNode));
+	const char* district = newLocation.district != NULL ? newLocation.district : "";
+	const char* geocode = newLocation.geocode != NULL ? newLocation.geocode : "";
+	newLocation.district = InternString(&locationStrings, district, strlen(district));
+	newLocation.geocode = InternString(&locationStrings, geocode, strlen(geocode));
+	if (newLocation.district == NULL || newLocation.geocode == NULL) {
+		return head;
+	}
+
+	LocationNode* newNode = (LocationNode*)PoolAlloc(&locationPool);
+	if (newNode == NULL) {
+		return head;
+	}
 	newNode->location = newLocation;
 	newNode->next = head;
 	return newNode;
 }
 
 LocationSurroundingsNode* AddLocationSurroundings(LocationSurroundingsNode* head, LocationSurroundings newLocationSurroundings) {
-	LocationSurroundingsNode* newNode = (LocationSurroundingsNode*)malloc(sizeof(LocationSurroundingsNode));
+	LocationSurroundingsNode* newNode = (LocationSurroundingsNode*)PoolAlloc(&locationSurroundingsPool);
+	if (newNode == NULL) {
+		return head;
+	}
 	newNode->locationSurroundings = newLocationSurroundings;
 	newNode->next = head;
 	return newNode;
 }
 
+void FreeLocations(LocationNode* head) {
+	(void)head;
+	PoolRelease(&locationPool);
+	ReleaseStringArena(&locationStrings);
+}
+
+void FreeLocationSurroundings(LocationSurroundingsNode* head) {
+	(void)head;
+	PoolRelease(&locationSurroundingsPool);
+}
+
 LocationNode* LoadLocationsFromTextFile(const char* filename) {
-	FILE* file = fopen(filename, "r");
-	if (file == NULL) {
+	METRICS_START(started);
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		METRICS_STOP(MetricLoadLocations, started);
 		return NULL;
 	}
 
 	LocationNode* head = NULL;
-	Location location;
+	int fields;
+
+	while ((fields = ReadCsvRecord(&reader, 3)) > 0) {
+		if (fields != 3) {
+			ReportCsvError(&reader, "expected 3 fields: id, district, geocode");
+			continue;
+		}
 
-	while (fscanf(file, "%d,%[^,],%[^\n]\n", &location.id, location.district, location.geocode) == 3) {
+		Location location;
+		char district[MIN_LENGHT], geocode[MAX_LENGHT];
+		memset(&location, 0, sizeof(Location));
+		if (!ParseCsvInt(&reader.fields[0], &location.id) ||
+			!CopyCsvString(&reader.fields[1], district, MIN_LENGHT) ||
+			!CopyCsvString(&reader.fields[2], geocode, MAX_LENGHT)) {
+			ReportCsvError(&reader, "invalid location record");
+			continue;
+		}
+		location.district = district;
+		location.geocode = geocode;
 		head = AddLocation(head, location);
 	}
 
-	fclose(file);
+	CloseCsvReader(&reader);
+	METRICS_STOP(MetricLoadLocations, started);
 	return head;
 }
 
-
-
 LocationSurroundingsNode* LoadLocationSurroundingsFromTextFile(const char* filename) {
-	FILE* file = fopen(filename, "r");
-	if (file == NULL) {
+	METRICS_START(started);
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		METRICS_STOP(MetricLoadRoads, started);
 		return NULL;
 	}
 
 	LocationSurroundingsNode* head = NULL;
-	LocationSurroundings locationSurroundings;
-
-	while (fscanf(file, "%d,%d,%d\n", &locationSurroundings.originId, &locationSurroundings.destinationId, &locationSurroundings.distance) == 3) {
+	int fields;
+
+	while ((fields = ReadCsvRecord(&reader, 4)) > 0) {
+		LocationSurroundings locationSurroundings;
+		locationSurroundings.oneWay = 0;
+		if (fields < 3 ||
+			!ParseCsvInt(&reader.fields[0], &locationSurroundings.originId) ||
+			!ParseCsvInt(&reader.fields[1], &locationSurroundings.destinationId) ||
+			!ParseCsvInt(&reader.fields[2], &locationSurroundings.distance) ||
+			(fields == 4 && !ParseCsvInt(&reader.fields[3], &locationSurroundings.oneWay))) {
+			ReportCsvError(&reader, "expected 3 integers: origin, destination, distance, and an optional one-way flag");
+			continue;
+		}
 		head = AddLocationSurroundings(head, locationSurroundings);
 	}
 
-	fclose(file);
+	CloseCsvReader(&reader);
+	METRICS_STOP(MetricLoadRoads, started);
 	return head;
 }
 
@@ -67,109 +131,376 @@ void PrintLocationSurroundings(LocationSurroundingsNode* head) {
 }
 
 LocationNode* FindLocationById(LocationNode* head, int id) {
+	METRICS_START(started);
 	LocationNode* current = head;
 	while (current != NULL) {
 		if (current->location.id == id) {
+			METRICS_STOP(MetricFindLocation, started);
 			return current;
 		}
 		current = current->next;
 	}
+	METRICS_STOP(MetricFindLocation, started);
 	return NULL;  // ID no encontrado
 }
 
-int minDistance(int a, int b) { return (a < b) ? a : b; }
+static int* CountingOffsets(int nodeCount) {
+	return (int*)calloc((size_t)nodeCount + 1, sizeof(int));
+}
 
-int firstUnvisited(int* visited, int numDistricts) {
-	for (int i = 0; i < numDistricts; i++)
-		if (!visited[i])
-			return i;
-	return -1;
+// Turns per-node counts stored at offsets[node + 1] into start offsets
+static void PrefixSum(int* offsets, int nodeCount) {
+	for (int i = 0; i < nodeCount; i++) {
+		offsets[i + 1] += offsets[i];
+	}
 }
 
-void findPath(int** graph, int* visited, int currPos, int numDistricts, int count, int cost, int* answer) {
-	if (count == numDistricts && graph[currPos][0]) {
-		*answer = min(*answer, cost + graph[currPos][0]);
-		return;
+static void PlaceEdge(int* cursor, int* endpoints, int* weights, int from, int to, int distance) {
+	int slot = cursor[from]++;
+	endpoints[slot] = to;
+	weights[slot] = distance;
+}
+
+static int IsValidRoad(const LocationSurroundings* road) {
+	return road->originId >= 0 && road->destinationId >= 0 && road->distance >= 0;
+}
+
+RoadGraph* BuildRoadGraph(LocationSurroundingsNode* head) {
+	METRICS_START(started);
+	RoadGraph* graph = (RoadGraph*)calloc(1, sizeof(RoadGraph));
+	if (graph == NULL) {
+		METRICS_STOP(MetricBuildRoadGraph, started);
+		return NULL;
 	}
 
-	for (int i = 0; i < numDistricts; i++) {
-		if (!visited[i] && graph[currPos][i]) {
-			visited[i] = 1;
-			findPath(graph, visited, i, numDistricts, count + 1, cost + graph[currPos][i], answer);
-			visited[i] = 0;
+	for (LocationSurroundingsNode* current = head; current != NULL; current = current->next) {
+		const LocationSurroundings* road = &current->locationSurroundings;
+		if (!IsValidRoad(road)) {
+			continue;
 		}
+		if (road->originId >= graph->nodeCount) {
+			graph->nodeCount = road->originId + 1;
+		}
+		if (road->destinationId >= graph->nodeCount) {
+			graph->nodeCount = road->destinationId + 1;
+		}
+		graph->edgeCount += road->oneWay ? 1 : 2;
 	}
-}
 
-int** ConvertToAdjacencyMatrix(LocationSurroundingsNode* head, int numDistricts) {
-	// Alocar espao para a matriz
-	int** matrix = (int**)malloc(numDistricts * sizeof(int*));
-	for (int i = 0; i < numDistricts; i++) {
-		matrix[i] = (int*)malloc(numDistricts * sizeof(int));
-		// Inicializar todos os valores como infinito
-		for (int j = 0; j < numDistricts; j++) {
-			matrix[i][j] = INT_MAX;
+	graph->offsets = CountingOffsets(graph->nodeCount);
+	graph->reverseOffsets = CountingOffsets(graph->nodeCount);
+	graph->targets = (int*)malloc(((size_t)graph->edgeCount + 1) * sizeof(int));
+	graph->weights = (int*)malloc(((size_t)graph->edgeCount + 1) * sizeof(int));
+	graph->sources = (int*)malloc(((size_t)graph->edgeCount + 1) * sizeof(int));
+	graph->reverseWeights = (int*)malloc(((size_t)graph->edgeCount + 1) * sizeof(int));
+	int* cursor = (int*)malloc(((size_t)graph->nodeCount + 1) * sizeof(int));
+	int* reverseCursor = (int*)malloc(((size_t)graph->nodeCount + 1) * sizeof(int));
+
+	if (graph->offsets == NULL || graph->reverseOffsets == NULL || graph->targets == NULL || graph->weights == NULL ||
+		graph->sources == NULL || graph->reverseWeights == NULL || cursor == NULL || reverseCursor == NULL) {
+		free(cursor);
+		free(reverseCursor);
+		FreeRoadGraph(graph);
+		METRICS_STOP(MetricBuildRoadGraph, started);
+		return NULL;
+	}
+
+	// First pass counts the edges leaving and entering every location
+	for (LocationSurroundingsNode* current = head; current != NULL; current = current->next) {
+		const LocationSurroundings* road = &current->locationSurroundings;
+		if (!IsValidRoad(road)) {
+			continue;
+		}
+		graph->offsets[road->originId + 1]++;
+		graph->reverseOffsets[road->destinationId + 1]++;
+		if (!road->oneWay) {
+			graph->offsets[road->destinationId + 1]++;
+			graph->reverseOffsets[road->originId + 1]++;
+		}
+	}
+	PrefixSum(graph->offsets, graph->nodeCount);
+	PrefixSum(graph->reverseOffsets, graph->nodeCount);
+	memcpy(cursor, graph->offsets, ((size_t)graph->nodeCount + 1) * sizeof(int));
+	memcpy(reverseCursor, graph->reverseOffsets, ((size_t)graph->nodeCount + 1) * sizeof(int));
+
+	// Second pass writes every edge straight into its row
+	for (LocationSurroundingsNode* current = head; current != NULL; current = current->next) {
+		const LocationSurroundings* road = &current->locationSurroundings;
+		if (!IsValidRoad(road)) {
+			continue;
+		}
+		PlaceEdge(cursor, graph->targets, graph->weights, road->originId, road->destinationId, road->distance);
+		PlaceEdge(reverseCursor, graph->sources, graph->reverseWeights, road->destinationId, road->originId, road->distance);
+		if (!road->oneWay) {
+			PlaceEdge(cursor, graph->targets, graph->weights, road->destinationId, road->originId, road->distance);
+			PlaceEdge(reverseCursor, graph->sources, graph->reverseWeights, road->originId, road->destinationId, road->distance);
 		}
 	}
 
-	// Preencher a matriz com as distncias reais
-	LocationSurroundingsNode* current = head;
-	while (current != NULL) {
-		int origin = current->locationSurroundings.originId;
-		int destination = current->locationSurroundings.destinationId;
-		int distance = current->locationSurroundings.distance;
+	free(cursor);
+	free(reverseCursor);
+	METRICS_STOP(MetricBuildRoadGraph, started);
+	return graph;
+}
 
-		// Subtrair 1 porque os IDs comeam em 1, mas os ndices de matriz comeam em 0
-		matrix[origin - 1][destination - 1] = distance;
+size_t GetRoadGraphMemory(const RoadGraph* graph) {
+	if (graph == NULL) {
+		return 0;
+	}
+	return sizeof(RoadGraph) + 2 * ((size_t)graph->nodeCount + 1) * sizeof(int) + 4 * (size_t)graph->edgeCount * sizeof(int);
+}
 
-		current = current->next;
+static unsigned long long HashInts(unsigned long long hash, const int* values, size_t count) {
+	const unsigned char* bytes = (const unsigned char*)values;
+	for (size_t i = 0; i < count * sizeof(int); i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+unsigned long long GetRoadGraphFingerprint(const RoadGraph* graph) {
+	unsigned long long hash = 14695981039346656037ull;
+	if (graph == NULL) {
+		return hash;
 	}
 
-	return matrix;
+	hash = HashInts(hash, &graph->nodeCount, 1);
+	hash = HashInts(hash, &graph->edgeCount, 1);
+	hash = HashInts(hash, graph->offsets, (size_t)graph->nodeCount + 1);
+	hash = HashInts(hash, graph->targets, (size_t)graph->edgeCount);
+	return HashInts(hash, graph->weights, (size_t)graph->edgeCount);
 }
 
+void FreeRoadGraph(RoadGraph* graph) {
+	if (graph == NULL) {
+		return;
+	}
+	free(graph->offsets);
+	free(graph->targets);
+	free(graph->weights);
+	free(graph->reverseOffsets);
+	free(graph->sources);
+	free(graph->reverseWeights);
+	free(graph);
+}
 
-int* FindShortestPath(LocationSurroundingsNode* graph, int startLocation, int numDistricts) {
-	int** adjacencyMatrix = ConvertToAdjacencyMatrix(graph, numDistricts);
+// Binary min-heap of locations ordered by tentative distance. positions[node] is the
+// index of the node in the heap, or -1, so a distance can be lowered in place.
+typedef struct DistanceHeap {
+	int* nodes;
+	int* positions;
+	const int* distance;
+	int size;
+} DistanceHeap;
+
+static void SwapHeapNodes(DistanceHeap* heap, int a, int b) {
+	int node = heap->nodes[a];
+	heap->nodes[a] = heap->nodes[b];
+	heap->nodes[b] = node;
+	heap->positions[heap->nodes[a]] = a;
+	heap->positions[heap->nodes[b]] = b;
+}
 
-	int* visited = calloc(numDistricts, sizeof(int));
-	visited[0] = 1;
+static void SiftUp(DistanceHeap* heap, int index) {
+	while (index > 0) {
+		int parent = (index - 1) / 2;
+		if (heap->distance[heap->nodes[parent]] <= heap->distance[heap->nodes[index]]) {
+			break;
+		}
+		SwapHeapNodes(heap, parent, index);
+		index = parent;
+	}
+}
 
-	int answer = INT_MAX;
-	findPath(adjacencyMatrix, visited, 0, numDistricts, 1, 0, &answer);
+static void SiftDown(DistanceHeap* heap, int index) {
+	while (1) {
+		int smallest = index;
+		int left = 2 * index + 1;
+		int right = left + 1;
 
-	free(visited);
-	for (int i = 0; i < numDistricts; i++)
-		free(adjacencyMatrix[i]);
-	free(adjacencyMatrix);
+		if (left < heap->size && heap->distance[heap->nodes[left]] < heap->distance[heap->nodes[smallest]]) {
+			smallest = left;
+		}
+		if (right < heap->size && heap->distance[heap->nodes[right]] < heap->distance[heap->nodes[smallest]]) {
+			smallest = right;
+		}
+		if (smallest == index) {
+			return;
+		}
+		SwapHeapNodes(heap, smallest, index);
+		index = smallest;
+	}
+}
 
-	return answer;
+// Inserts the node, or moves it up if it is already queued and its distance dropped
+static void PushOrDecrease(DistanceHeap* heap, int node) {
+	if (heap->positions[node] < 0) {
+		heap->nodes[heap->size] = node;
+		heap->positions[node] = heap->size;
+		heap->size++;
+	}
+	SiftUp(heap, heap->positions[node]);
 }
 
-void ChargeVehiclesOnRoute(MobilityNode* head, int numDistricts) {
+static int PopClosest(DistanceHeap* heap) {
+	int node = heap->nodes[0];
+	heap->size--;
+	if (heap->size > 0) {
+		heap->nodes[0] = heap->nodes[heap->size];
+		heap->positions[heap->nodes[0]] = 0;
+		SiftDown(heap, 0);
+	}
+	heap->positions[node] = -1;
+	return node;
+}
 
-	MobilityNode* truck = FindMobilityByType(head, 5);
-	for (int i = 0; i < numDistricts; i++) {
-		int district_id = truck->mobility.locationId;
-		MobilityNode* current = head;
-		while (current != NULL) {
-			if (current->mobility.locationId == district_id &&
-				(current->mobility.type == Bicycles || current->mobility.type == Scooters) &&
-				current->mobility.battery_level < 50) {
-				int weight_to_load = current->mobility.vehicleWeight;
-				if (truck->mobility.maxTransportWeight - weight_to_load >= 0) {
-					truck->mobility.maxTransportWeight -= weight_to_load;
-					current->mobility.battery_level = 100;
-				}
-				else {
-					break;
+void FreeShortestPaths(ShortestPaths* paths) {
+	if (paths == NULL) {
+		return;
+	}
+	free(paths->distance);
+	free(paths->previous);
+	free(paths);
+}
+
+// Dijkstra over one direction of the graph: rows of offsets list the neighbours reached from each location.
+// previous may be NULL when only the distances are needed.
+static void RunDijkstra(int nodeCount, const int* offsets, const int* neighbours, const int* weights, int source,
+	int* distances, int* previous, DistanceHeap* heap) {
+	for (int i = 0; i < nodeCount; i++) {
+		distances[i] = UNREACHABLE_DISTANCE;
+		heap->positions[i] = -1;
+	}
+	if (previous != NULL) {
+		for (int i = 0; i < nodeCount; i++) {
+			previous[i] = -1;
+		}
+	}
+	heap->distance = distances;
+	heap->size = 0;
+
+	distances[source] = 0;
+	PushOrDecrease(heap, source);
+
+	while (heap->size > 0) {
+		int node = PopClosest(heap);
+		int nodeDistance = distances[node];
+
+		for (int edge = offsets[node]; edge < offsets[node + 1]; edge++) {
+			int neighbour = neighbours[edge];
+			int distance = nodeDistance + weights[edge];
+			if (distance < distances[neighbour]) {
+				distances[neighbour] = distance;
+				if (previous != NULL) {
+					previous[neighbour] = node;
 				}
+				PushOrDecrease(heap, neighbour);
 			}
-			current = current->next;
 		}
 	}
 }
 
+static ShortestPaths* SearchGraph(int nodeCount, const int* offsets, const int* neighbours, const int* weights, int source) {
+	if (source < 0 || source >= nodeCount) {
+		return NULL;
+	}
+
+	ShortestPaths* paths = (ShortestPaths*)calloc(1, sizeof(ShortestPaths));
+	DistanceHeap heap = { (int*)malloc(nodeCount * sizeof(int)), (int*)malloc(nodeCount * sizeof(int)), NULL, 0 };
+	if (paths != NULL) {
+		paths->distance = (int*)malloc(nodeCount * sizeof(int));
+		paths->previous = (int*)malloc(nodeCount * sizeof(int));
+	}
+
+	if (paths == NULL || paths->distance == NULL || paths->previous == NULL || heap.nodes == NULL || heap.positions == NULL) {
+		FreeShortestPaths(paths);
+		free(heap.nodes);
+		free(heap.positions);
+		return NULL;
+	}
+
+	paths->source = source;
+	paths->nodeCount = nodeCount;
+	RunDijkstra(nodeCount, offsets, neighbours, weights, source, paths->distance, paths->previous, &heap);
+
+	free(heap.nodes);
+	free(heap.positions);
+	return paths;
+}
+
+ShortestPaths* FindShortestPaths(const RoadGraph* graph, int startLocation) {
+	METRICS_START(started);
+	if (graph == NULL) {
+		METRICS_STOP(MetricFindShortestPaths, started);
+		return NULL;
+	}
+	ShortestPaths* paths = SearchGraph(graph->nodeCount, graph->offsets, graph->targets, graph->weights, startLocation);
+	METRICS_STOP(MetricFindShortestPaths, started);
+	return paths;
+}
+
+ShortestPaths* FindShortestPathsTo(const RoadGraph* graph, int destination) {
+	METRICS_START(started);
+	if (graph == NULL) {
+		METRICS_STOP(MetricFindShortestPathsTo, started);
+		return NULL;
+	}
+	ShortestPaths* paths = SearchGraph(graph->nodeCount, graph->reverseOffsets, graph->sources, graph->reverseWeights, destination);
+	METRICS_STOP(MetricFindShortestPathsTo, started);
+	return paths;
+}
+
+int FindDistancesFrom(const RoadGraph* graph, int startLocation, int* distances) {
+	METRICS_START(started);
+	if (graph == NULL || startLocation < 0 || startLocation >= graph->nodeCount) {
+		METRICS_STOP(MetricFindDistancesFrom, started);
+		return 0;
+	}
+
+	DistanceHeap heap = { (int*)malloc(graph->nodeCount * sizeof(int)), (int*)malloc(graph->nodeCount * sizeof(int)), NULL, 0 };
+	int ok = heap.nodes != NULL && heap.positions != NULL;
+	if (ok) {
+		RunDijkstra(graph->nodeCount, graph->offsets, graph->targets, graph->weights, startLocation, distances, NULL, &heap);
+	}
+
+	free(heap.nodes);
+	free(heap.positions);
+	METRICS_STOP(MetricFindDistancesFrom, started);
+	return ok;
+}
+
+int GetShortestPath(const ShortestPaths* paths, int destination, int* path, int maxLength) {
+	if (paths == NULL || destination < 0 || destination >= paths->nodeCount ||
+		paths->distance[destination] == UNREACHABLE_DISTANCE) {
+		return 0;
+	}
+
+	int length = 0;
+	for (int node = destination; node != -1; node = paths->previous[node]) {
+		length++;
+	}
+	if (length > maxLength) {
+		return length;
+	}
+
+	int index = length;
+	for (int node = destination; node != -1; node = paths->previous[node]) {
+		path[--index] = node;
+	}
+	return length;
+}
+
+int ChargeVehiclesOnRoute(MobilityTable* vehicles, const DistanceOracle* distances) {
+	ChargingPlan* plan = PlanChargingRoutes(vehicles, distances, NULL);
+	if (plan == NULL) {
+		return 0;
+	}
+	int charged = ApplyChargingPlan(vehicles, plan);
+	FreeChargingPlan(plan);
+	return charged;
+}
+
 int GetNumDistricts(LocationNode* head) {
 	int count = 0;
 	LocationNode* current = head;
@@ -181,11 +512,3 @@ int GetNumDistricts(LocationNode* head) {
 
 	return count;
 }
-
-
-void FastestRoute(LocationSurroundingsNode* graph, int startLocation, MobilityNode* vehicles) {
-	int numDistricts = GetNumDistricts(graph);
-	int* route = FindShortestPath(graph, startLocation, numDistricts);
-	ChargeVehiclesOnRoute(vehicles, numDistricts);
-	free(route);
-}
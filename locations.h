@@ -15,13 +15,22 @@
 #include "headers.h"
 #include "mobility.h"
 
+#include <limits.h>
+
+#define UNREACHABLE_DISTANCE INT_MAX  /**< Distance of locations that cannot be reached. */
+
+struct DistanceOracle;
+
  /**
   * @brief Struct that represents a location.
+  *
+  * The strings are interned by AddLocation, so the handful of districts is
+  * stored once for the whole list.
   */
 typedef struct Location {
 	int id;                       /**< Unique identifier for the location. */
-	char district[MIN_LENGHT];    /**< District of the location. */
-	char geocode[MAX_LENGHT];     /**< Geocode of the location. */
+	const char* district;         /**< District of the location. */
+	const char* geocode;          /**< Geocode of the location. */
 } Location;
 
 /**
@@ -39,6 +48,7 @@ typedef struct LocationSurroundings {
 	int originId;                   /**< ID of the origin location. */
 	int destinationId;              /**< ID of the destination location. */
 	int distance;                   /**< Distance from origin to destination. */
+	int oneWay;                     /**< 1 if the road only goes from origin to destination, 0 if it is two-way. */
 } LocationSurroundings;
 
 /**
@@ -49,6 +59,38 @@ typedef struct LocationSurroundingsNode {
 	struct LocationSurroundingsNode* next;     /**< Pointer to the next node in the list. */
 } LocationSurroundingsNode;
 
+/**
+ * @brief Road graph in compressed sparse row form.
+ *
+ * The roads leaving location i are targets[offsets[i]] to targets[offsets[i + 1] - 1],
+ * with the matching lengths in weights. The reverse arrays hold the roads
+ * entering each location in the same layout, for searches that run backwards
+ * from a destination. Locations are indexed by ID, so memory grows with the
+ * number of roads instead of the square of the number of locations.
+ */
+typedef struct RoadGraph {
+	int nodeCount;                  /**< Highest location ID plus one. */
+	int edgeCount;                  /**< Number of directed edges; a two-way road counts twice. */
+	int* offsets;                   /**< nodeCount + 1 row offsets into targets and weights. */
+	int* targets;                   /**< Destination of every edge, grouped by origin. */
+	int* weights;                   /**< Length of every edge in targets. */
+	int* reverseOffsets;            /**< nodeCount + 1 row offsets into sources and reverseWeights. */
+	int* sources;                   /**< Origin of every edge, grouped by destination. */
+	int* reverseWeights;            /**< Length of every edge in sources. */
+} RoadGraph;
+
+/**
+ * @brief Shortest distances from one location to every other location.
+ *
+ * Both arrays are indexed by location ID.
+ */
+typedef struct ShortestPaths {
+	int source;                     /**< ID of the start location. */
+	int nodeCount;                  /**< Number of entries of each array (highest location ID plus one). */
+	int* distance;                  /**< Distance from the source, UNREACHABLE_DISTANCE if there is no path. */
+	int* previous;                  /**< Location before each one on its shortest path, -1 for the source and unreachable locations. */
+} ShortestPaths;
+
 /**
  * @brief Adds a new location node to the list.
  *
@@ -67,6 +109,24 @@ LocationNode* AddLocation(LocationNode* head, Location newLocation);
  */
 LocationSurroundingsNode* AddLocationSurroundings(LocationSurroundingsNode* head, LocationSurroundings newLocationSurroundings);
 
+/**
+ * @brief Frees all the memory allocated for the locations.
+ *
+ * Every location node lives in the same pool, which is released at once.
+ *
+ * @param head The head of the list.
+ */
+void FreeLocations(LocationNode* head);
+
+/**
+ * @brief Frees all the memory allocated for the location surroundings.
+ *
+ * Every surroundings node lives in the same pool, which is released at once.
+ *
+ * @param head The head of the list.
+ */
+void FreeLocationSurroundings(LocationSurroundingsNode* head);
+
 /**
  * @brief Loads location data from a text file into a linked list.
  *
@@ -100,79 +160,112 @@ void PrintLocationSurroundings(LocationSurroundingsNode* head);
 LocationNode* FindLocationById(LocationNode* head, int id);
 
 /**
- * @brief Compares two distances and returns the smallest one.
+ * @brief Builds the compressed road graph from the list of surroundings.
+ *
+ * Roads are counted per location in a first pass and written straight into
+ * their rows in a second one, so the graph takes six allocations whatever its size.
+ *
+ * @param head The head of the location surroundings list.
+ * @return The graph, to be freed with FreeRoadGraph. If memory could not be allocated, returns NULL.
+ */
+RoadGraph* BuildRoadGraph(LocationSurroundingsNode* head);
+
+/**
+ * @brief Gets the number of bytes used by a road graph.
  *
- * @param a The first distance.
- * @param b The second distance.
- * @return The smallest distance.
+ * @param graph The graph.
+ * @return The size of the graph in bytes.
  */
-int MinDistance(int a, int b);
+size_t GetRoadGraphMemory(const RoadGraph* graph);
 
 /**
- * @brief Returns the first unvisited district.
+ * @brief Computes a 64-bit FNV-1a hash of the roads of a graph.
  *
- * @param visited Array of visited status for each district.
- * @param num_districts The total number of districts.
- * @return The first unvisited district. If all are visited, returns -1.
+ * Any added, removed or changed road changes the fingerprint, which is how
+ * data derived from the graph and stored on disk detects that it is stale.
+ *
+ * @param graph The graph.
+ * @return The fingerprint.
  */
-int FirstUnvisited(int* visited, int num_districts);
+unsigned long long GetRoadGraphFingerprint(const RoadGraph* graph);
 
 /**
- * @brief Finds a path in the graph.
+ * @brief Frees a road graph.
  *
- * @param graph The adjacency matrix of the graph.
- * @param visited Array of visited status for each node.
- * @param currPos The current position in the graph.
- * @param num_districts The total number of districts.
- * @param count The current count of visited nodes.
- * @param cost The current cost of the path.
- * @param answer Pointer to the minimal cost found so far.
+ * @param graph The graph.
  */
-void FindPath(int** graph, int* visited, int currPos, int num_districts, int count, int cost, int* answer);
+void FreeRoadGraph(RoadGraph* graph);
 
 /**
- * @brief Finds the shortest path in the graph from a start location.
+ * @brief Finds the shortest distance from a start location to every location with Dijkstra's algorithm.
+ *
+ * Runs in O(E log V) with a binary heap that supports lowering a queued distance.
  *
- * @param graph The linked list of location surroundings.
- * @param start_location The start location id.
- * @param num_districts The total number of districts.
- * @return A pointer to the array containing the shortest path.
+ * @param graph The road graph.
+ * @param startLocation The start location id.
+ * @return The distances and predecessors, to be freed with FreeShortestPaths. If the start location is not in the graph or memory could not be allocated, returns NULL.
  */
-int* FindShortestPath(LocationSurroundingsNode* graph, int start_location, int num_districts);
+ShortestPaths* FindShortestPaths(const RoadGraph* graph, int startLocation);
 
 /**
- * @brief Charges vehicles on the route.
+ * @brief Finds the shortest distance from every location to a destination.
+ *
+ * Searches the reverse graph, so previous[i] is the next location after i on
+ * its way to the destination.
  *
- * @param head The head of the mobility list.
- * @param num_districts The total number of districts.
+ * @param graph The road graph.
+ * @param destination The destination location id.
+ * @return The distances and successors, to be freed with FreeShortestPaths. If the destination is not in the graph or memory could not be allocated, returns NULL.
  */
-void ChargeVehiclesOnRoute(MobilityNode* head, int num_districts);
+ShortestPaths* FindShortestPathsTo(const RoadGraph* graph, int destination);
 
 /**
- * @brief Gets the number of districts.
+ * @brief Finds the shortest distance from a start location to every location, without the paths.
  *
- * @param head The head of the location list.
- * @return The number of districts.
+ * @param graph The road graph.
+ * @param startLocation The start location id.
+ * @param distances Array of graph->nodeCount entries that receives the distances.
+ * @return 1 on success, 0 if the start location is not in the graph or memory could not be allocated.
  */
-int GetNumDistricts(LocationNode* head);
+int FindDistancesFrom(const RoadGraph* graph, int startLocation, int* distances);
 
 /**
- * @brief Finds the fastest route from a start location.
+ * @brief Rebuilds the shortest path from the start location to a destination.
+ *
+ * For results of FindShortestPathsTo the roles are swapped: the path runs
+ * from the searched destination back to the given location.
  *
- * @param graph The linked list of location surroundings.
- * @param start_location The start location id.
- * @param vehicles The head of the mobility list.
+ * @param paths The result of FindShortestPaths.
+ * @param destination The destination location id.
+ * @param path Array that receives the location ids from the start location to the destination.
+ * @param maxLength The size of the path array.
+ * @return The number of locations on the path, 0 if the destination cannot be reached. If it is larger than maxLength, nothing is written.
  */
-void FastestRoute(LocationSurroundingsNode* graph, int start_location, MobilityNode* vehicles);
+int GetShortestPath(const ShortestPaths* paths, int destination, int* path, int maxLength);
 
 /**
- * @brief Converts a linked list of LocationSurroundings into an adjacency matrix.
+ * @brief Frees the result of FindShortestPaths.
  *
- * @param head The head of the location surroundings list.
- * @param numDistricts The total number of districts.
- * @return A pointer to the adjacency matrix.
+ * @param paths The shortest paths.
  */
-int** ConvertToAdjacencyMatrix(LocationSurroundingsNode* head, int numDistricts);
+void FreeShortestPaths(ShortestPaths* paths);
+
+/**
+ * @brief Plans the routes of every truck and charges the low-battery vehicles they collect.
+ *
+ * @param vehicles The table of vehicles.
+ * @param distances The distances between every pair of locations.
+ * @return The number of vehicles charged.
+ */
+int ChargeVehiclesOnRoute(MobilityTable* vehicles, const struct DistanceOracle* distances);
+
+/**
+ * @brief Gets the number of districts.
+ *
+ * @param head The head of the location list.
+ * @return The number of districts.
+ */
+int GetNumDistricts(LocationNode* head);
 
 #endif  // LOCATIONS_H
 
@@ -4,42 +4,228 @@
 #include "mobility.h"
 #include "utilis.h"
 #include "locations.h"
+#include "dataStore.h"
+#include "distanceOracle.h"
+#include "rentalEngine.h"
+#include "commandRunner.h"
+#include "networkServer.h"
+#include "benchmark.h"
+#include "metrics.h"
+#include "telemetry.h"
 
 
-int main() {
+// Road network of the modes that answer route queries, loaded beside the data store
+typedef struct RoadNetwork {
+	LocationNode* locations;
+	LocationSurroundingsNode* surroundings;
+	RoadGraph* roads;
+	DistanceOracle* distances;
+	double seconds;
+} RoadNetwork;
 
-	// Load data from files
-	ClientNode* clients = LoadClients(BIN_CLIENT_FILENAME, TXT_CLIENT_FILENAME);
-	ManagerNode* managers = LoadManagers(BIN_MANAGER_FILENAME, TXT_MANAGER_FILENAME);
-	MobilityNode* mobilities = LoadMobilities(BIN_MOBILITY_FILENAME, TXT_MOBILITY_FILENAME);
-	LocationNode* locations = LoadLocationsFromTextFile(TXT_LOCATION_FILENAME);
-	LocationNode* locations_surroundings = LoadLocationSurroundingsFromTextFile(TXT_LOCATION_SURROUNDINGS_FILENAME);
+static int LoadRoadNetwork(void* argument) {
+	RoadNetwork* network = (RoadNetwork*)argument;
+	double started = PlatformGetTime();
+	network->locations = LoadLocationsFromTextFile(TXT_LOCATION_FILENAME);
+	network->surroundings = LoadLocationSurroundingsFromTextFile(TXT_LOCATION_SURROUNDINGS_FILENAME);
+	network->roads = BuildRoadGraph(network->surroundings);
+	network->distances = LoadDistanceOracle(network->roads, BIN_DISTANCE_FILENAME);
+	network->seconds = PlatformGetTime() - started;
+	return 1;
+}
+
+static void FreeRoadNetwork(RoadNetwork* network) {
+	FreeDistanceOracle(network->distances);
+	FreeRoadGraph(network->roads);
+	FreeLocations(network->locations);
+	FreeLocationSurroundings(network->surroundings);
+}
+
+// Journals every telemetry batch as a single record
+static int ApplyTelemetryBatch(const MobilityStatus* statuses, int count, void* context) {
+	return StoreUpdateMobilityStatuses((DataStore*)context, statuses, count);
+}
+
+int main(int argc, char* argv[]) {
+	double launched = PlatformGetTime();
+	int startupReport = 0;
+
+	// Options placed before any mode: --metrics <file> writes the latency histograms every few seconds,
+	// --startup-report prints how long loading the data took
+	for (;;) {
+		if (argc > 2 && strcmp(argv[1], "--metrics") == 0) {
+			if (StartMetricsDump(argv[2], METRICS_DUMP_INTERVAL)) {
+				atexit(StopMetricsDump);
+			}
+			argv[2] = argv[0];
+			argc -= 2;
+			argv += 2;
+		}
+		else if (argc > 1 && strcmp(argv[1], "--startup-report") == 0) {
+			startupReport = 1;
+			argv[1] = argv[0];
+			argc--;
+			argv++;
+		}
+		else {
+			break;
+		}
+	}
+
+	// Concurrency check of the rental engine: --rental-stress [vehicles] [accounts] [reservations per thread]
+	if (argc > 1 && strcmp(argv[1], "--rental-stress") == 0) {
+		int vehicles = argc > 2 ? atoi(argv[2]) : 10000;
+		int accounts = argc > 3 ? atoi(argv[3]) : 1000;
+		int operations = argc > 4 ? atoi(argv[4]) : 1000000;
+		return RunRentalStress(vehicles, accounts, operations) ? 0 : 1;
+	}
+
+	// Latency check of the telemetry window on a slow pipe: --telemetry-check [window seconds]
+	if (argc > 1 && strcmp(argv[1], "--telemetry-check") == 0) {
+		return RunTelemetryCheck(argc > 2 ? atof(argv[2]) : TELEMETRY_DEFAULT_WINDOW) ? 0 : 1;
+	}
+
+	// Synthetic benchmark: --benchmark [records] [locations] [grid|random] [csv|json] [--keep] [output file]
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+		BenchmarkOptions options;
+		InitBenchmarkOptions(&options);
+		int numbers = 0;
+		for (int i = 2; i < argc; i++) {
+			if (isdigit((unsigned char)argv[i][0])) {
+				if (numbers++ == 0) {
+					options.records = atoi(argv[i]);
+					options.managers = options.records / 100 > 0 ? options.records / 100 : 1;
+				}
+				else {
+					options.nodes = atoi(argv[i]);
+				}
+			}
+			else if (strcmp(argv[i], "grid") == 0 || strcmp(argv[i], "random") == 0) {
+				options.shape = strcmp(argv[i], "grid") == 0 ? BenchmarkGrid : BenchmarkRandom;
+			}
+			else if (strcmp(argv[i], "csv") == 0 || strcmp(argv[i], "json") == 0) {
+				options.format = strcmp(argv[i], "csv") == 0 ? BenchmarkCsv : BenchmarkJson;
+			}
+			else if (strcmp(argv[i], "--keep") == 0) {
+				options.keepFiles = 1;
+			}
+			else {
+				options.output = argv[i];
+			}
+		}
+		return RunBenchmarks(&options) ? 0 : 1;
+	}
+
+	// Load test of a running server: --loadgen <address> <command file> [connections] [requests]
+	if (argc > 3 && strcmp(argv[1], "--loadgen") == 0) {
+		int connections = argc > 4 ? atoi(argv[4]) : 8;
+		int requests = argc > 5 ? atoi(argv[5]) : 100000;
+		return RunLoadGenerator(argv[2], argv[3], connections, requests) ? 0 : 1;
+	}
+
+	// Scripted mode: --batch <file, - for the standard input> [--echo] runs the commands without the menus
+	// Network service: --serve [address] [workers] answers the same commands as the batch mode
+	int batch = argc > 2 && strcmp(argv[1], "--batch") == 0;
+	int serve = argc > 1 && strcmp(argv[1], "--serve") == 0;
+	// Telemetry ingestion: --telemetry <file, - for the standard input> [batch size] applies battery and location reports
+	int telemetry = argc > 2 && strcmp(argv[1], "--telemetry") == 0;
+
+	// Only these two route; the road network loads on its own thread while the data store opens
+	RoadNetwork network;
+	memset(&network, 0, sizeof(RoadNetwork));
+	PlatformThread* roadLoader = NULL;
+	if (batch || serve) {
+		roadLoader = PlatformStartThread(LoadRoadNetwork, &network);
+		if (roadLoader == NULL) {
+			LoadRoadNetwork(&network);
+		}
+	}
+
+	// Load the clients and managers and replay the changes made since the last snapshot
+	DataStore store;
+	int opened = OpenDataStore(&store, batch || serve || telemetry ? DataStoreVehiclesInBackground : DataStoreVehiclesOnDemand);
+	if (roadLoader != NULL) {
+		PlatformJoinThread(roadLoader);
+	}
+	if (!opened) {
+		printf("Could not open the journal %s.\n", JOURNAL_FILENAME);
+		CloseDataStore(&store);
+		FreeRoadNetwork(&network);
+		return 1;
+	}
+
+	if (batch || serve) {
+		GetStoreMobilities(&store);
+		if (startupReport) {
+			PrintStartupReport(&store, stderr);
+			fprintf(stderr, "%-28s %10.1f ms\n", "Road network (own thread)", network.seconds * 1000.0);
+			fprintf(stderr, "%-28s %10.1f ms\n", "Ready", (PlatformGetTime() - launched) * 1000.0);
+		}
+
+		CommandContext context = { &store, network.roads, network.distances, NULL };
+		int ok;
+		if (batch) {
+			int echo = argc > 3 && strcmp(argv[3], "--echo") == 0;
+			ok = RunCommandBatch(&context, argv[2], echo) == 0;
+		}
+		else {
+			const char* address = argc > 2 ? argv[2] : SERVER_DEFAULT_ADDRESS;
+			int workers = argc > 3 ? atoi(argv[3]) : 0;
+			ok = RunServer(&context, address, workers);
+		}
+		ok = CloseCommandContext(&context) && ok;
+		CloseDataStore(&store);
+		FreeRoadNetwork(&network);
+		return ok ? 0 : 1;
+	}
+
+	if (telemetry) {
+		TelemetryOptions options;
+		InitTelemetryOptions(&options);
+		if (argc > 3) {
+			options.batchSize = atoi(argv[3]);
+		}
+		TelemetryStats stats;
+		int ok = IngestTelemetry(GetStoreMobilities(&store), argv[2], &options, ApplyTelemetryBatch, &store, &stats);
+		if (startupReport) {
+			PrintStartupReport(&store, stderr);
+		}
+		PrintTelemetryStats(&stats, stdout);
+		CloseDataStore(&store);
+		return ok ? 0 : 1;
+	}
+
+	// The menus never use the vehicles, so they are only loaded if something asks for them
+	if (startupReport) {
+		PrintStartupReport(&store, stderr);
+		fprintf(stderr, "%-28s %10.1f ms\n", "First prompt", (PlatformGetTime() - launched) * 1000.0);
+	}
 
 	ClientNode* loggedClient = NULL;
 	ManagerNode* loggedManager = NULL;
 
 	char userNIF[NIF_SIZE];
-	Login(clients, managers, &loggedClient, &loggedManager);
+	Login(store.clients, store.managers, &loggedClient, &loggedManager);
 
 	system("cls");
 
 	if (loggedClient == NULL && loggedManager == NULL) {
 		printf("Exiting...\n");
+		CloseDataStore(&store);
 		return 0;
 	}
 	else if (loggedClient != NULL) {
 		printf("Client logged in.\n");
 		system("pause");
-		ClientMenu(clients, &loggedClient, BIN_CLIENT_FILENAME);
+		ClientMenu(&store, &loggedClient);
 	}
 	else if (loggedManager != NULL) {
 		printf("Manager logged in.\n");
 		system("pause");
-		ManagerMenu(managers, clients, &loggedManager);
+		ManagerMenu(store.managers, store.clients);
 	}
 
-	FreeClients(clients);
-	FreeManagers(managers);
+	CloseDataStore(&store);
 
 	return 0;
 }
@@ -1,20 +1,97 @@
 // managers.c
 #include "managers.h"
+#include "nifIndex.h"
+#include "nameIndex.h"
+#include "collation.h"
+#include "utilis.h"
+#include "snapshot.h"
+#include "csvReader.h"
+#include "nodePool.h"
+#include "metrics.h"
 
-#define MAX_LINE_LENGTH 256
+#include <stddef.h>
 
-ManagerNode* AddManager(ManagerNode* head, Manager newManager) {
-	ManagerNode* newNode = (ManagerNode*)malloc(sizeof(ManagerNode));
-	newNode->manager = newManager;
+
+static void GetManagerKey(const void* value, const char** key, const char** nif) {
+	const ManagerNode* node = (const ManagerNode*)value;
+	*key = node->sortKey;
+	*nif = node->manager.nif;
+}
+
+static NifIndex managerIndex;
+static NameIndex managerNames = NAME_INDEX_INITIALIZER(GetManagerKey);
+static NodePool managerPool = NODE_POOL_INITIALIZER("Manager nodes", ManagerNode);
+static StringArena managerStrings;
+
+typedef struct ManagerRecordCursor {
+	ManagerNode* node;              // Next node when saving a list
+	const Manager* next;            // Next manager when saving an array
+	const Manager* end;             // End of the array
+	StringTable strings;            // Strings of every manager, collected before writing
+	ManagerRecord record;           // Record handed to the snapshot writer
+} ManagerRecordCursor;
+
+// Replaces the strings of a manager with their copies in the arena of the list
+static int InternManagerStrings(Manager* manager) {
+	const char* name = manager->name != NULL ? manager->name : "";
+	const char* department = manager->departmentLocation != NULL ? manager->departmentLocation : "";
+	manager->name = InternString(&managerStrings, name, strlen(name));
+	manager->departmentLocation = InternString(&managerStrings, department, strlen(department));
+	return manager->name != NULL && manager->departmentLocation != NULL;
+}
+
+// Builds the collation key of a name in the arena of the list; names are seldom shared, so keys are copied, not interned
+static const char* MakeManagerSortKey(const char* name) {
+	char buffer[COLLATION_BUFFER];
+	size_t length;
+	char* key = BuildCollationKey(name, COLLATION_ALL_LEVELS, buffer, sizeof(buffer), &length);
+	if (key == NULL) {
+		return NULL;
+	}
+	const char* copy = CopyString(&managerStrings, key, length);
+	if (key != buffer) {
+		free(key);
+	}
+	return copy;
+}
+
+static ManagerNode* CreateManagerNode(Manager manager) {
+	// The first manager with a NIF keeps it; a second one would leave the first reachable only through the list
+	if (NifIndexFind(&managerIndex, manager.nif) != NULL || !InternManagerStrings(&manager)) {
+		return NULL;
+	}
+	const char* sortKey = MakeManagerSortKey(manager.name);
+	if (sortKey == NULL) {
+		return NULL;
+	}
+	ManagerNode* newNode = (ManagerNode*)PoolAlloc(&managerPool);
+	if (newNode == NULL) {
+		return NULL;
+	}
+	newNode->manager = manager;
+	newNode->sortKey = sortKey;
 	newNode->next = NULL;
+	if (!NifIndexInsert(&managerIndex, manager.nif, newNode)) {
+		PoolFree(&managerPool, newNode);
+		return NULL;
+	}
+	return newNode;
+}
 
-	if (head == NULL || strcmp(newManager.name, head->manager.name) < 0) {
+// Orders by the collation key of the name, then by NIF so managers with the same name have a fixed place in the index
+static int CompareManagers(const ManagerNode* a, const ManagerNode* b) {
+	int order = strcmp(a->sortKey, b->sortKey);
+	return order != 0 ? order : strncmp(a->manager.nif, b->manager.nif, sizeof(a->manager.nif));
+}
+
+static ManagerNode* InsertManagerNode(ManagerNode* head, ManagerNode* newNode) {
+	if (head == NULL || CompareManagers(newNode, head) < 0) {
 		newNode->next = head;
 		head = newNode;
 	}
 	else {
 		ManagerNode* current = head;
-		while (current->next != NULL && strcmp(newManager.name, current->next->manager.name) > 0) {
+		while (current->next != NULL && CompareManagers(newNode, current->next) > 0) {
 			current = current->next;
 		}
 		newNode->next = current->next;
@@ -24,45 +101,324 @@ ManagerNode* AddManager(ManagerNode* head, Manager newManager) {
 	return head;
 }
 
+// Links a node after the one the name index puts before it; the list is always in the order of the index
+static ManagerNode* LinkManagerNode(ManagerNode* head, ManagerNode* newNode) {
+	ManagerNode* previous = (ManagerNode*)NameIndexPrevious(&managerNames, newNode->sortKey, newNode->manager.nif);
+	if (previous == NULL) {
+		newNode->next = head;
+		return newNode;
+	}
+	newNode->next = previous->next;
+	previous->next = newNode;
+	return head;
+}
+
+// Finds the node before target through the name index, walking the list only if it was reordered by hand
+static ManagerNode* FindPreviousManager(ManagerNode* head, ManagerNode* target) {
+	ManagerNode* previous = (ManagerNode*)NameIndexPrevious(&managerNames, target->sortKey, target->manager.nif);
+	if (previous == NULL ? head == target : previous->next == target) {
+		return previous;
+	}
+
+	previous = head;
+	while (previous != NULL && previous->next != target) {
+		previous = previous->next;
+	}
+	return previous;
+}
+
+static ManagerNode* UnlinkManagerNode(ManagerNode* head, ManagerNode* target) {
+	ManagerNode* previous = FindPreviousManager(head, target);
+	if (previous != NULL) {
+		previous->next = target->next;
+	}
+	else if (head == target) {
+		head = target->next;
+	}
+	return head;
+}
+
+// Sorts the nodes by collation key and links them in that order in a single pass
+static ManagerNode* LinkSortedManagers(ManagerNode** nodes, size_t count) {
+	if (count == 0) {
+		return NULL;
+	}
+
+	if (!NameIndexSort(&managerNames, (void**)nodes, count)) {
+		ManagerNode* sorted = NULL;
+		for (size_t i = 0; i < count; i++) {
+			sorted = InsertManagerNode(sorted, nodes[i]);
+		}
+		return sorted;
+	}
+
+	for (size_t i = 0; i + 1 < count; i++) {
+		nodes[i]->next = nodes[i + 1];
+	}
+	nodes[count - 1]->next = NULL;
+	return nodes[0];
+}
+
+// Returns 0 if memory ran out; the NIF must not be in the list yet
+static int AppendManagerNode(ManagerNode*** nodes, size_t* count, size_t* capacity, Manager manager) {
+	if (*count == *capacity) {
+		size_t newCapacity = *capacity == 0 ? 1024 : *capacity * 2;
+		ManagerNode** grown = (ManagerNode**)realloc(*nodes, newCapacity * sizeof(ManagerNode*));
+		if (grown == NULL) {
+			return 0;
+		}
+		*nodes = grown;
+		*capacity = newCapacity;
+	}
+	ManagerNode* newNode = CreateManagerNode(manager);
+	if (newNode == NULL) {
+		return 0;
+	}
+	(*nodes)[(*count)++] = newNode;
+	return 1;
+}
+
+// A partial list would be saved over the complete one later, so nothing of a failed load is kept
+static ManagerNode* AbandonManagerLoad(ManagerNode** nodes, const char* filename) {
+	fprintf(stderr, "%s: out of memory, no managers were loaded\n", filename);
+	free(nodes);
+	FreeManagers(NULL);
+	return NULL;
+}
+
+// Links the nodes of a bulk load and builds the name index from their sorted order
+static ManagerNode* LinkLoadedManagers(ManagerNode** nodes, size_t count) {
+	ManagerNode* head = LinkSortedManagers(nodes, count);
+	NameIndexBuild(&managerNames, (void* const*)nodes, count);
+	return head;
+}
+
+ManagerNode* AddManager(ManagerNode* head, Manager newManager) {
+	ManagerNode* newNode = CreateManagerNode(newManager);
+	if (newNode == NULL) {
+		return head;
+	}
+	NameIndexInsert(&managerNames, newNode);
+	return LinkManagerNode(head, newNode);
+}
+
 ManagerNode* LoadManagersFromTextFile(const char* filename) {
-	FILE* file = fopen(filename, "r");
-	if (file == NULL) {
+	METRICS_START(started);
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		METRICS_STOP(MetricLoadManagersText, started);
 		return NULL;
 	}
 
-	ManagerNode* head = NULL;
-	Manager newManager;
+	ManagerNode** nodes = NULL;
+	size_t count = 0, capacity = 0;
+	int fields;
+	while ((fields = ReadCsvRecord(&reader, 3)) > 0) {
+		if (fields != 3) {
+			ReportCsvError(&reader, "expected 3 fields: nif, name, department location");
+			continue;
+		}
 
-	while (fscanf(file, "%[^,],%[^,],%[^\n]\n", newManager.nif, newManager.name, newManager.departmentLocation) == 3) {
-		head = AddManager(head, newManager);
+		Manager newManager;
+		char name[MIN_LENGHT], department[MIN_LENGHT];
+		memset(&newManager, 0, sizeof(Manager));
+		if (!CopyCsvString(&reader.fields[0], newManager.nif, sizeof(newManager.nif)) ||
+			!CopyCsvString(&reader.fields[1], name, MIN_LENGHT) ||
+			!CopyCsvString(&reader.fields[2], department, MIN_LENGHT)) {
+			ReportCsvError(&reader, "invalid manager record");
+			continue;
+		}
+		if (NifIndexFind(&managerIndex, newManager.nif) != NULL) {
+			ReportCsvError(&reader, "duplicate NIF, the first manager with it is kept");
+			continue;
+		}
+		newManager.name = name;
+		newManager.departmentLocation = department;
+		if (!AppendManagerNode(&nodes, &count, &capacity, newManager)) {
+			CloseCsvReader(&reader);
+			METRICS_STOP(MetricLoadManagersText, started);
+			return AbandonManagerLoad(nodes, filename);
+		}
 	}
+	CloseCsvReader(&reader);
 
-	fclose(file);
+	ManagerNode* head = LinkLoadedManagers(nodes, count);
+	free(nodes);
+	METRICS_STOP(MetricLoadManagersText, started);
 	return head;
 }
 
 
-ManagerNode* LoadManagersFromBinaryFile(const char* filename) {
-	FILE* file = fopen(filename, "rb");
-	if (file == NULL) {
+static int UnpackLegacyManager(const unsigned char* data, Manager* manager) {
+	const char* name = (const char*)data + offsetof(LegacyManager, name);
+	const char* department = (const char*)data + offsetof(LegacyManager, departmentLocation);
+	if (memchr(name, '\0', MIN_LENGHT) == NULL || memchr(department, '\0', MIN_LENGHT) == NULL) {
+		return 0;
+	}
+
+	memcpy(manager->nif, data + offsetof(LegacyManager, nif), sizeof(manager->nif));
+	manager->nif[sizeof(manager->nif) - 1] = '\0';
+	manager->name = name;
+	manager->departmentLocation = department;
+	return 1;
+}
+
+// Fills a manager from a record whose strings are in the given block
+static int UnpackManagerRecord(const unsigned char* data, const char* strings, size_t stringSize, Manager* manager) {
+	ManagerRecord record;
+	memcpy(&record, data, sizeof(record));
+
+	manager->name = ResolveStringRef(strings, stringSize, record.name);
+	manager->departmentLocation = ResolveStringRef(strings, stringSize, record.departmentLocation);
+	if (manager->name == NULL || manager->departmentLocation == NULL) {
+		return 0;
+	}
+	memcpy(manager->nif, record.nif, sizeof(manager->nif));
+	manager->nif[sizeof(manager->nif) - 1] = '\0';
+	return 1;
+}
+
+size_t PackManager(const Manager* manager, unsigned char* buffer, size_t size) {
+	size_t nameSize = strlen(manager->name) + 1;
+	size_t departmentSize = strlen(manager->departmentLocation) + 1;
+	size_t packedSize = sizeof(ManagerRecord) + nameSize + departmentSize;
+	if (packedSize > size) {
+		return 0;
+	}
+
+	ManagerRecord record;
+	memset(&record, 0, sizeof(record));
+	memcpy(record.nif, manager->nif, sizeof(record.nif));
+	record.name.offset = 0;
+	record.name.length = (unsigned int)(nameSize - 1);
+	record.departmentLocation.offset = (unsigned int)nameSize;
+	record.departmentLocation.length = (unsigned int)(departmentSize - 1);
+
+	memcpy(buffer, &record, sizeof(record));
+	memcpy(buffer + sizeof(record), manager->name, nameSize);
+	memcpy(buffer + sizeof(record) + nameSize, manager->departmentLocation, departmentSize);
+	return packedSize;
+}
+
+int UnpackManager(const void* data, size_t size, unsigned int version, Manager* manager) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	if (version < 2) {
+		return size == sizeof(LegacyManager) && UnpackLegacyManager(bytes, manager);
+	}
+	return size > sizeof(ManagerRecord) &&
+		UnpackManagerRecord(bytes, (const char*)bytes + sizeof(ManagerRecord), size - sizeof(ManagerRecord), manager);
+}
+
+static const Manager* NextCursorManager(ManagerRecordCursor* cursor) {
+	if (cursor->node != NULL) {
+		const Manager* manager = &cursor->node->manager;
+		cursor->node = cursor->node->next;
+		return manager;
+	}
+	return cursor->next != cursor->end ? cursor->next++ : NULL;
+}
+
+// The strings are all in the table already, so looking them up again cannot fail
+static const void* NextManagerRecord(void* context) {
+	ManagerRecordCursor* cursor = (ManagerRecordCursor*)context;
+	const Manager* manager = NextCursorManager(cursor);
+	if (manager == NULL) {
 		return NULL;
 	}
 
-	ManagerNode* head = NULL;
-	Manager temp;
+	memset(&cursor->record, 0, sizeof(ManagerRecord));
+	memcpy(cursor->record.nif, manager->nif, sizeof(cursor->record.nif));
+	AddTableString(&cursor->strings, manager->name, &cursor->record.name);
+	AddTableString(&cursor->strings, manager->departmentLocation, &cursor->record.departmentLocation);
+	return &cursor->record;
+}
 
-	while (fread(&temp, sizeof(Manager), 1, file) == 1) {
-		head = AddManager(head, temp);
+// Collects the strings before the file is touched, so running out of memory leaves the old snapshot in place
+static int WriteManagerSnapshot(ManagerRecordCursor* cursor, const char* filename, unsigned long long journalSequence) {
+	ManagerRecordCursor collect = *cursor;
+	const Manager* manager;
+	StringRef ref;
+	int ok = 1;
+	while (ok && (manager = NextCursorManager(&collect)) != NULL) {
+		ok = AddTableString(&cursor->strings, manager->name, &ref) && AddTableString(&cursor->strings, manager->departmentLocation, &ref);
 	}
 
-	fclose(file);
+	ok = ok && WriteSnapshot(filename, SnapshotManagers, sizeof(ManagerRecord), journalSequence, NextManagerRecord, cursor, &cursor->strings);
+	FreeStringTable(&cursor->strings);
+	return ok;
+}
+
+// Sets failed when memory ran out, rather than when there was nothing to load
+static ManagerNode* ReadManagersSnapshot(const char* filename, int* failed) {
+	METRICS_START(started);
+	Snapshot snapshot;
+	SnapshotStatus status = OpenSnapshot(&snapshot, filename, SnapshotManagers, sizeof(ManagerRecord));
+	if (status == SnapshotMissing) {
+		METRICS_STOP(MetricLoadManagersBinary, started);
+		return NULL;
+	}
+
+	// Anything but a current snapshot is read again with the fixed layout of the older versions
+	int legacy = status != SnapshotOk;
+	if (legacy) {
+		CloseSnapshot(&snapshot);
+		status = OpenSnapshot(&snapshot, filename, SnapshotManagers, sizeof(LegacyManager));
+		if (status == SnapshotMissing) {
+			METRICS_STOP(MetricLoadManagersBinary, started);
+			return NULL;
+		}
+	}
+
+	size_t records = status == SnapshotInvalid ? 0 : snapshot.recordCount;
+	size_t count = 0, capacity = records + 1;
+	ManagerNode** nodes = (ManagerNode**)malloc(capacity * sizeof(ManagerNode*));
+	if (nodes == NULL) {
+		CloseSnapshot(&snapshot);
+		METRICS_STOP(MetricLoadManagersBinary, started);
+		*failed = 1;
+		return AbandonManagerLoad(nodes, filename);
+	}
+
+	for (size_t i = 0; i < records; i++) {
+		const unsigned char* record = (const unsigned char*)GetSnapshotRecord(&snapshot, i);
+		Manager manager;
+		int valid = legacy ? UnpackLegacyManager(record, &manager) :
+			UnpackManagerRecord(record, snapshot.strings, snapshot.stringSize, &manager);
+		if (valid && NifIndexFind(&managerIndex, manager.nif) == NULL && !AppendManagerNode(&nodes, &count, &capacity, manager)) {
+			CloseSnapshot(&snapshot);
+			METRICS_STOP(MetricLoadManagersBinary, started);
+			*failed = 1;
+			return AbandonManagerLoad(nodes, filename);
+		}
+	}
+	unsigned long long journalSequence = snapshot.journalSequence;
+	CloseSnapshot(&snapshot);
+
+	ManagerNode* head = LinkLoadedManagers(nodes, count);
+	free(nodes);
+
+	// Rewrite files from older versions in the current format, still covering the journal operations they did
+	if (legacy && status != SnapshotInvalid && head != NULL) {
+		ManagerRecordCursor cursor;
+		memset(&cursor, 0, sizeof(cursor));
+		cursor.node = head;
+		WriteManagerSnapshot(&cursor, filename, journalSequence);
+	}
+	METRICS_STOP(MetricLoadManagersBinary, started);
 	return head;
 }
 
+ManagerNode* LoadManagersFromBinaryFile(const char* filename) {
+	int failed = 0;
+	return ReadManagersSnapshot(filename, &failed);
+}
+
 ManagerNode* LoadManagers(const char* binFilename, const char* txtFilename) {
-	ManagerNode* head = LoadManagersFromBinaryFile(binFilename);
+	int failed = 0;
+	ManagerNode* head = ReadManagersSnapshot(binFilename, &failed);
 
-	if (head == NULL) {
+	// The text file is older than the snapshot, so it only stands in for a snapshot that is missing or empty
+	if (head == NULL && !failed) {
 		head = LoadManagersFromTextFile(txtFilename);
 	}
 
@@ -71,38 +427,113 @@ ManagerNode* LoadManagers(const char* binFilename, const char* txtFilename) {
 
 // Libera a memria da lista de gestores
 void FreeManagers(ManagerNode* head) {
-	ManagerNode* temp;
+	(void)head;
+	PoolRelease(&managerPool);
+	NifIndexClear(&managerIndex);
+	NameIndexClear(&managerNames);
+	ReleaseStringArena(&managerStrings);
+}
+
+void SaveManagersToFile(const char* filename, ManagerNode* head) {
+	METRICS_START(started);
+	ManagerRecordCursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.node = head;
+	WriteManagerSnapshot(&cursor, filename, 0);
+	METRICS_STOP(MetricSaveManagers, started);
+}
+
+int SaveManagerArray(const Manager* managers, size_t count, const char* filename, unsigned long long journalSequence) {
+	ManagerRecordCursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	cursor.next = managers;
+	cursor.end = managers + count;
+	return WriteManagerSnapshot(&cursor, filename, journalSequence);
+}
+
+ManagerNode* DeleteManager(ManagerNode* head, char* nif) {
+	METRICS_START(started);
+	if (head == NULL) {
+		METRICS_STOP(MetricDeleteManager, started);
+		return NULL;
+	}
+
+	ManagerNode* target = (ManagerNode*)NifIndexFind(&managerIndex, nif);
+	if (target == NULL) {
+		METRICS_STOP(MetricDeleteManager, started);
+		return head;
+	}
 
-	while (head != NULL)
-	{
-		temp = head;
-		head = head->next;
-		free(temp);
+	// A node that is not in this list stays indexed
+	ManagerNode* previous = FindPreviousManager(head, target);
+	if (previous == NULL && head != target) {
+		METRICS_STOP(MetricDeleteManager, started);
+		return head;
 	}
+
+	NifIndexRemove(&managerIndex, nif);
+	NameIndexRemove(&managerNames, target);
+	if (previous == NULL) {
+		head = target->next;
+	}
+	else {
+		previous->next = target->next;
+	}
+	PoolFree(&managerPool, target);
+	METRICS_STOP(MetricDeleteManager, started);
+	return head;
 }
 
-void SaveManagersToFile(const char* filename, ManagerNode* head) {
-	FILE* file = fopen(filename, "wb");
-	if (file == NULL) {
-		return;
+ManagerNode* UpdateManager(ManagerNode* head, char* nif, Manager updatedManager) {
+	METRICS_START(started);
+	ManagerNode* current = FindManagerByNif(head, nif);
+	int renamed = current != NULL && strncmp(current->manager.nif, updatedManager.nif, sizeof(updatedManager.nif)) != 0;
+	if (current == NULL || (renamed && NifIndexFind(&managerIndex, updatedManager.nif) != NULL) || !InternManagerStrings(&updatedManager)) {
+		METRICS_STOP(MetricUpdateManager, started);
+		return head;
+	}
+	// Interned names are equal only if they are the same string; a new name gets a key of its own
+	const char* sortKey = current->manager.name == updatedManager.name ? current->sortKey : MakeManagerSortKey(updatedManager.name);
+	if (sortKey == NULL) {
+		METRICS_STOP(MetricUpdateManager, started);
+		return head;
+	}
+
+	int moved = current->sortKey != sortKey || renamed;
+	if (moved) {
+		head = UnlinkManagerNode(head, current);
+		NameIndexRemove(&managerNames, current);
 	}
 
-	ManagerNode* current = head;
-	while (current != NULL) {
-		fwrite(&(current->manager), sizeof(Manager), 1, file);
-		current = current->next;
+	if (renamed) {
+		NifIndexRemove(&managerIndex, current->manager.nif);
+		NifIndexInsert(&managerIndex, updatedManager.nif, current);
 	}
+	current->manager = updatedManager;
+	current->sortKey = sortKey;
 
-	fclose(file);
+	if (moved) {
+		NameIndexInsert(&managerNames, current);
+		head = LinkManagerNode(head, current);
+	}
+	METRICS_STOP(MetricUpdateManager, started);
+	return head;
+}
+
+size_t FindManagersByName(ManagerNode* head, const NameQuery* query, NameCursor* cursor, ManagerNode** page, size_t pageSize) {
+	METRICS_START(started);
+	size_t count = head == NULL ? 0 : NameIndexPage(&managerNames, query, cursor, (void**)page, pageSize);
+	METRICS_STOP(MetricFindManagersByName, started);
+	return count;
 }
 
 ManagerNode* FindManagerByNif(ManagerNode* head, char* nif) {
-	ManagerNode* current = head;
-	while (current != NULL) {
-		if (strcmp(current->manager.nif, nif) == 0) {
-			return current;
-		}
-		current = current->next;
+	METRICS_START(started);
+	if (head == NULL) {
+		METRICS_STOP(MetricFindManager, started);
+		return NULL;
 	}
-	return NULL;
+	ManagerNode* found = (ManagerNode*)NifIndexFind(&managerIndex, nif);
+	METRICS_STOP(MetricFindManager, started);
+	return found;
 }
\ No newline at end of file
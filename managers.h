@@ -14,15 +14,40 @@
 
 #include "headers.h"
 #include "clients.h"
+#include "stringArena.h"
+#include "nameIndex.h"
+
+#define MANAGER_PACKED_MAX (sizeof(ManagerRecord) + 2 * MIN_LENGHT)  /**< Largest manager written by PackManager. */
 
  /**
   * @brief Struct that represents a manager.
+  *
+  * The strings of the managers in the list are interned, like those of the
+  * clients, so the few department locations are stored once.
   */
 typedef struct Manager {
+	char nif[10];                       /**< Manager's Tax Identification Number (NIF). */
+	const char* name;                   /**< Manager's name. */
+	const char* departmentLocation;     /**< Department location of the manager. */
+} Manager;
+
+/**
+ * @brief Manager as stored in snapshots and in the journal.
+ */
+typedef struct ManagerRecord {
+	char nif[10];                       /**< Manager's Tax Identification Number (NIF). */
+	StringRef name;                     /**< Manager's name. */
+	StringRef departmentLocation;       /**< Department location of the manager. */
+} ManagerRecord;
+
+/**
+ * @brief Manager as stored by snapshot version 1 and by the headerless files before it.
+ */
+typedef struct LegacyManager {
 	char nif[10];                       /**< Manager's Tax Identification Number (NIF). */
 	char name[MIN_LENGHT];              /**< Manager's name. */
 	char departmentLocation[MIN_LENGHT]; /**< Department location of the manager. */
-} Manager;
+} LegacyManager;
 
 /**
  * @brief Node for linked list of Manager struct.
@@ -30,11 +55,17 @@ typedef struct Manager {
 typedef struct ManagerNode {
 	Manager manager;              /**< Manager data for the node. */
 	struct ManagerNode* next;     /**< Pointer to the next node in the list. */
+	const char* sortKey;          /**< Collation key of the name, in the string arena of the list. */
 } ManagerNode;
 
 /**
  * @brief Adds a new manager node to the list.
  *
+ * The list is kept ordered by the collation key of the name (see
+ * collation.h), then NIF; the name index finds the place
+ * of the new node without walking the list. A manager whose NIF is already
+ * in the list is not added.
+ *
  * @param head The head of the list.
  * @param newManager The new Manager data to be added.
  * @return A pointer to the new head of the list.
@@ -45,15 +76,18 @@ ManagerNode* AddManager(ManagerNode* head, Manager newManager);
  * @brief Loads manager data from a text file into a linked list.
  *
  * @param filename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case no manager is kept.
  */
 ManagerNode* LoadManagersFromTextFile(const char* filename);
 
 /**
  * @brief Loads manager data from a binary file into a linked list.
  *
+ * Headerless files and snapshots of version 1, which stored the strings in
+ * fixed-size arrays, are accepted and rewritten in the current format.
+ *
  * @param filename The name of the binary file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case no manager is kept.
  */
 ManagerNode* LoadManagersFromBinaryFile(const char* filename);
 
@@ -62,25 +96,82 @@ ManagerNode* LoadManagersFromBinaryFile(const char* filename);
  *
  * @param binFilename The name of the binary file.
  * @param txtFilename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the head of the created list. NULL if memory ran out, in which case the text file is not tried.
  */
 ManagerNode* LoadManagers(const char* binFilename, const char* txtFilename);
 
 /**
  * @brief Frees the memory occupied by the list of managers.
  *
+ * Every manager node lives in the same pool, and every string in the same
+ * arena, which are released at once.
+ *
  * @param head The head of the list.
  */
 void FreeManagers(ManagerNode* head);
 
 /**
- * @brief Saves manager data from a list into a file.
+ * @brief Saves manager data from a list into a binary snapshot file.
  *
  * @param filename The name of the file.
  * @param head The head of the list.
  */
 void SaveManagersToFile(const char* filename, ManagerNode* head);
 
+/**
+ * @brief Saves an array of managers into a binary snapshot file.
+ *
+ * @param managers The managers.
+ * @param count The number of managers.
+ * @param filename The name of the file.
+ * @param journalSequence The last journal operation included in the managers, 0 if unknown.
+ * @return 1 on success, 0 on failure.
+ */
+int SaveManagerArray(const Manager* managers, size_t count, const char* filename, unsigned long long journalSequence);
+
+/**
+ * @brief Packs a manager into the layout stored in the journal, a ManagerRecord followed by its strings.
+ *
+ * @param manager The manager.
+ * @param buffer Receives the packed manager.
+ * @param size The size of buffer; MANAGER_PACKED_MAX always fits managers whose strings respect the usual limits.
+ * @return The size of the packed manager, 0 if it does not fit.
+ */
+size_t PackManager(const Manager* manager, unsigned char* buffer, size_t size);
+
+/**
+ * @brief Reads back a manager packed by PackManager, or stored in the fixed layout of snapshot version 1.
+ *
+ * @param data The packed manager.
+ * @param size The size of the packed manager.
+ * @param version The snapshot version whose layout the manager has.
+ * @param manager Receives the manager, whose strings point into data.
+ * @return 1 on success, 0 if the data is not a valid manager.
+ */
+int UnpackManager(const void* data, size_t size, unsigned int version, Manager* manager);
+
+/**
+ * @brief Deletes a manager node from the list.
+ *
+ * @param head The head of the list.
+ * @param nif The NIF of the Manager data to be deleted.
+ * @return A pointer to the new head of the list.
+ */
+ManagerNode* DeleteManager(ManagerNode* head, char* nif);
+
+/**
+ * @brief Updates a manager node in the list.
+ *
+ * A manager whose name or NIF changes is moved to its new place in the list.
+ * Changing the NIF to one another manager has leaves the list as it was.
+ *
+ * @param head The head of the list.
+ * @param nif The NIF of the Manager data to be updated.
+ * @param updatedManager The updated Manager data.
+ * @return A pointer to the new head of the list.
+ */
+ManagerNode* UpdateManager(ManagerNode* head, char* nif, Manager updatedManager);
+
 /**
  * @brief Finds a manager node in the list by its NIF.
  *
@@ -90,6 +181,21 @@ void SaveManagersToFile(const char* filename, ManagerNode* head);
  */
 ManagerNode* FindManagerByNif(ManagerNode* head, char* nif);
 
+/**
+ * @brief Reads the next page of managers, in the order of the list, without walking the managers before it.
+ *
+ * The cursor keeps pointing into the strings of the list, so it must not be
+ * used after FreeManagers.
+ *
+ * @param head The head of the list.
+ * @param query The names to read: a prefix, which ignores accents and case, a range or both. NULL for every manager.
+ * @param cursor Where the previous page ended, zeroed for the first page; updated to where this one ends.
+ * @param page Receives the managers.
+ * @param pageSize The maximum number of managers to read.
+ * @return The number of managers read, 0 once there are no more.
+ */
+size_t FindManagersByName(ManagerNode* head, const NameQuery* query, NameCursor* cursor, ManagerNode** page, size_t pageSize);
+
 /**
  * @brief Displays the manager menu.
  *
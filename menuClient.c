@@ -1,6 +1,7 @@
 #include "clients.h"
+#include "dataStore.h"
 
-void ClientMenu(ClientNode* clients, ClientNode** loggedClient, const char* binFilename) {
+void ClientMenu(DataStore* store, ClientNode** loggedClient) {
 	int choice;
 	do {
 		system("cls");
@@ -18,7 +19,7 @@ void ClientMenu(ClientNode* clients, ClientNode** loggedClient, const char* binF
 			break;
 		case 2:
 
-			UpdateClientInfo(loggedClient, clients, binFilename);
+			UpdateClientInfo(loggedClient, store);
 			system("pause");
 			break;
 		case 3:
@@ -57,7 +58,7 @@ void PrintClientInfo(ClientNode** client) {
 
 }
 
-void UpdateClientInfo(ClientNode** loggedClient, ClientNode* head, const char* binFilename) {
+void UpdateClientInfo(ClientNode** loggedClient, DataStore* store) {
 	system("cls");
 	if (loggedClient == NULL || *loggedClient == NULL) {
 		printf("Invalid client.\n");
@@ -68,17 +69,23 @@ void UpdateClientInfo(ClientNode** loggedClient, ClientNode* head, const char* b
 
 	printf("\nEnter new client information:\n");
 	Client updatedClient;
+	char name[MIN_LENGHT], address[MAX_LENGHT];
+	updatedClient.name = name;
+	updatedClient.address = address;
 	printf("Enter new name: ");
-	scanf("%s", updatedClient.name);
+	scanf("%s", name);
 	printf("Enter new NIF: ");
 	scanf("%s", updatedClient.nif);
 	printf("Enter new balance: ");
 	scanf("%lf", &updatedClient.balance);
 	printf("Enter new address: ");
-	scanf("%s", updatedClient.address);
+	scanf("%s", address);
 
-	(*loggedClient)->client = updatedClient;
-
-	SaveClientsToBinaryFile(head, binFilename);
+	if (strcmp(updatedClient.nif, (*loggedClient)->client.nif) != 0 && FindClientByNif(store->clients, updatedClient.nif) != NULL) {
+		printf("The NIF %s belongs to another client.\n", updatedClient.nif);
+	}
+	else if (!StoreUpdateClient(store, (*loggedClient)->client.nif, updatedClient)) {
+		printf("Could not save the changes.\n");
+	}
 }
 
@@ -1,6 +1,40 @@
 #include "managers.h"
 #include "clients.h"
 
+#define CLIENT_PAGE_SIZE 20  // Clients shown at a time by View Clients
+
+// Pages through the clients whose name starts with a prefix, reading only the clients shown
+static void BrowseClients(ClientNode* clients) {
+	char prefix[MIN_LENGHT];
+	printf("Name starts with (* for every client): ");
+	scanf("%49s", prefix);
+
+	NameQuery query = { strcmp(prefix, "*") == 0 ? NULL : prefix, NULL, NULL };
+	NameCursor cursor;
+	memset(&cursor, 0, sizeof(cursor));
+	ClientNode* page[CLIENT_PAGE_SIZE];
+	size_t count;
+	char answer[8];
+
+	while ((count = FindClientsByName(clients, &query, &cursor, page, CLIENT_PAGE_SIZE)) > 0) {
+		for (size_t i = 0; i < count; i++) {
+			printf("NIF: %s, Name: %s, Balance: %.2f, Address: %s\n",
+				page[i]->client.nif, page[i]->client.name, page[i]->client.balance, page[i]->client.address);
+		}
+		if (cursor.done) {
+			break;
+		}
+		printf("Enter n for the next page, anything else to stop: ");
+		scanf("%7s", answer);
+		if (strcmp(answer, "n") != 0) {
+			break;
+		}
+	}
+	if (cursor.key == NULL) {
+		printf("No clients found.\n");
+	}
+}
+
 
 void ManagerMenu(ManagerNode* managers, ClientNode* clients) {
 	int choice;
@@ -25,6 +59,9 @@ void ManagerMenu(ManagerNode* managers, ClientNode* clients) {
 		case 1:
 			PrintAllManagers(managers);
 			break;
+		case 5:
+			BrowseClients(clients);
+			break;
 		default:
 			printf("Invalid choice.\n");
 			break;
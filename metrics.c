@@ -0,0 +1,334 @@
+#include "metrics.h"
+
+static const char* metricNames[MetricCount] = {
+	"load_clients_text", "load_clients_binary", "save_clients", "find_client", "update_client", "delete_client",
+	"find_clients_by_name", "load_managers_text", "load_managers_binary", "save_managers", "find_manager",
+	"update_manager", "delete_manager", "find_managers_by_name",
+	"load_mobilities_text", "load_mobilities_binary", "save_mobilities", "find_mobility_by_id", "find_mobility_by_type",
+	"find_mobilities_by_location", "select_mobilities", "find_best_mobility", "find_top_mobilities", "update_mobility",
+	"update_mobility_statuses", "delete_mobility", "load_locations", "load_roads", "find_location", "build_road_graph",
+	"find_shortest_paths", "find_shortest_paths_to", "find_distances_from", "build_distance_oracle", "load_distance_oracle",
+	"save_distance_oracle", "plan_charging_routes", "solve_charging_tour"
+};
+
+const char* GetMetricName(MetricId metric) {
+	return metric >= 0 && metric < MetricCount ? metricNames[metric] : "unknown";
+}
+
+// Lowest latency, in nanoseconds, that falls in a bucket
+static long long BucketLowerBound(int bucket) {
+	int shift = (bucket >> METRICS_SUB_BUCKET_BITS) - 1;
+	if (shift < 0) {
+		return bucket;
+	}
+	long long mantissa = (bucket & ((1 << METRICS_SUB_BUCKET_BITS) - 1)) + (1 << METRICS_SUB_BUCKET_BITS);
+	return mantissa << shift;
+}
+
+double GetMetricQuantile(const MetricHistogram* histogram, double quantile) {
+	if (histogram->count <= 0) {
+		return 0.0;
+	}
+	double exactRank = quantile * (double)histogram->count;
+	long long rank = (long long)exactRank;
+	if (rank < exactRank || rank < 1) {
+		rank++;
+	}
+	long long seen = 0;
+	for (int bucket = 0; bucket < METRICS_BUCKET_COUNT; bucket++) {
+		seen += histogram->buckets[bucket];
+		if (seen >= rank) {
+			long long lower = BucketLowerBound(bucket);
+			long long upper = bucket + 1 < METRICS_BUCKET_COUNT ? BucketLowerBound(bucket + 1) : lower * 2;
+			return (double)(lower + upper) / 2.0 / 1e9;
+		}
+	}
+	return (double)BucketLowerBound(METRICS_BUCKET_COUNT - 1) / 1e9;
+}
+
+#if METRICS_ENABLED
+
+/**
+ * @brief Histograms written by one thread, or by every thread past METRICS_MAX_SHARDS.
+ */
+typedef struct MetricsShard {
+	MetricHistogram* volatile histograms[MetricCount];      /**< Histogram of every operation, NULL until the operation is first recorded. */
+	volatile long owned;                                    /**< 1 while a running thread records into the shard. */
+} MetricsShard;
+
+static MetricsShard* volatile shards[METRICS_MAX_SHARDS];
+static volatile long shardCount;
+static MetricHistogram overflowHistograms[MetricCount];
+static MetricsShard overflowShard;
+static PLATFORM_THREAD_LOCAL MetricsShard* threadShard;
+
+// Hands the shard of a finishing thread to the next one, keeping what it recorded
+static void ReleaseThreadShard(void) {
+	if (threadShard != NULL && threadShard != &overflowShard) {
+		PlatformAtomicCompareExchange(&threadShard->owned, 1, 0);
+	}
+	threadShard = NULL;
+}
+
+// Gives the calling thread a shard left by a finished thread or a new one, or the shared overflow shard once they run out
+static MetricsShard* GetThreadShard(void) {
+	if (threadShard != NULL) {
+		return threadShard;
+	}
+	int count = shardCount < METRICS_MAX_SHARDS ? (int)shardCount : METRICS_MAX_SHARDS;
+	for (int index = 0; index < count; index++) {
+		MetricsShard* shard = shards[index];
+		if (shard != NULL && shard->owned == 0 && PlatformAtomicCompareExchange(&shard->owned, 0, 1) == 0) {
+			threadShard = shard;
+			return threadShard;
+		}
+	}
+	threadShard = &overflowShard;
+	if (shardCount < METRICS_MAX_SHARDS) {
+		MetricsShard* shard = (MetricsShard*)calloc(1, sizeof(MetricsShard));
+		long index = shard != NULL ? PlatformAtomicAdd(&shardCount, 1) - 1 : METRICS_MAX_SHARDS;
+		if (index < METRICS_MAX_SHARDS) {
+			// Owned before it is published, so no other thread can take it
+			shard->owned = 1;
+			PlatformAtomicCompareExchangePointer((void* volatile*)&shards[index], NULL, shard);
+			PlatformSetThreadExitHandler(ReleaseThreadShard);
+			threadShard = shard;
+		}
+		else {
+			free(shard);
+		}
+	}
+	return threadShard;
+}
+
+static MetricHistogram* GetShardHistogram(MetricsShard* shard, MetricId metric) {
+	if (shard == &overflowShard) {
+		return &overflowHistograms[metric];
+	}
+	if (shard->histograms[metric] == NULL) {
+		MetricHistogram* histogram = (MetricHistogram*)calloc(1, sizeof(MetricHistogram));
+		if (histogram == NULL) {
+			return &overflowHistograms[metric];
+		}
+		shard->histograms[metric] = histogram;
+	}
+	return shard->histograms[metric];
+}
+
+static int FloorLog2(unsigned long long value) {
+	int exponent = 0;
+	for (int step = 32; step > 0; step >>= 1) {
+		if (value >> step) {
+			value >>= step;
+			exponent += step;
+		}
+	}
+	return exponent;
+}
+
+// Log-linear bucket: exact below 2^METRICS_SUB_BUCKET_BITS nanoseconds, then the top bits of the value
+static int GetBucket(long long nanoseconds) {
+	if (nanoseconds < (1 << METRICS_SUB_BUCKET_BITS)) {
+		return nanoseconds < 0 ? 0 : (int)nanoseconds;
+	}
+	int exponent = FloorLog2((unsigned long long)nanoseconds);
+	if (exponent > METRICS_MAX_EXPONENT) {
+		return METRICS_BUCKET_COUNT - 1;
+	}
+	int shift = exponent - METRICS_SUB_BUCKET_BITS;
+	return (shift << METRICS_SUB_BUCKET_BITS) + (int)(nanoseconds >> shift);
+}
+
+void RecordMetric(MetricId metric, double seconds) {
+	if (metric < 0 || metric >= MetricCount) {
+		return;
+	}
+	long long nanoseconds = seconds > 0 ? (long long)(seconds * 1e9) : 0;
+	int bucket = GetBucket(nanoseconds);
+	MetricsShard* shard = GetThreadShard();
+	MetricHistogram* histogram = GetShardHistogram(shard, metric);
+	if (shard == &overflowShard || histogram == &overflowHistograms[metric]) {
+		PlatformAtomicAdd64(&histogram->buckets[bucket], 1);
+		PlatformAtomicAdd64(&histogram->sumNanoseconds, nanoseconds);
+		PlatformAtomicAdd64(&histogram->count, 1);
+	}
+	else {
+		// Only this thread writes the histogram, readers may see it a call behind
+		histogram->buckets[bucket]++;
+		histogram->sumNanoseconds += nanoseconds;
+		histogram->count++;
+	}
+}
+
+static void MergeHistogram(MetricHistogram* merged, MetricHistogram* source) {
+	if (source == NULL) {
+		return;
+	}
+	merged->count += PlatformAtomicLoad64(&source->count);
+	merged->sumNanoseconds += PlatformAtomicLoad64(&source->sumNanoseconds);
+	for (int bucket = 0; bucket < METRICS_BUCKET_COUNT; bucket++) {
+		merged->buckets[bucket] += PlatformAtomicLoad64(&source->buckets[bucket]);
+	}
+}
+
+void ReadMetric(MetricId metric, MetricHistogram* merged) {
+	memset(merged, 0, sizeof(MetricHistogram));
+	if (metric < 0 || metric >= MetricCount) {
+		return;
+	}
+	int count = shardCount < METRICS_MAX_SHARDS ? (int)shardCount : METRICS_MAX_SHARDS;
+	for (int index = 0; index < count; index++) {
+		MetricsShard* shard = shards[index];
+		if (shard != NULL) {
+			MergeHistogram(merged, shard->histograms[metric]);
+		}
+	}
+	MergeHistogram(merged, &overflowHistograms[metric]);
+	// A call counted in its bucket but not yet in count would push a percentile past the end
+	long long total = 0;
+	for (int bucket = 0; bucket < METRICS_BUCKET_COUNT; bucket++) {
+		total += merged->buckets[bucket];
+	}
+	merged->count = total;
+}
+
+#else
+
+void RecordMetric(MetricId metric, double seconds) {
+	(void)metric;
+	(void)seconds;
+}
+
+void ReadMetric(MetricId metric, MetricHistogram* merged) {
+	(void)metric;
+	memset(merged, 0, sizeof(MetricHistogram));
+}
+
+#endif
+
+#define METRICS_HISTOGRAM_NAME "mobility_operation_duration_seconds"
+#define METRICS_QUANTILE_NAME "mobility_operation_latency_seconds"
+
+int WriteMetrics(FILE* file) {
+	static const double quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+	MetricHistogram* histograms = (MetricHistogram*)malloc(MetricCount * sizeof(MetricHistogram));
+	if (histograms == NULL) {
+		return 0;
+	}
+	for (int metric = 0; metric < MetricCount; metric++) {
+		ReadMetric((MetricId)metric, &histograms[metric]);
+	}
+
+	fprintf(file, "# HELP %s Time taken by the instrumented operations.\n", METRICS_HISTOGRAM_NAME);
+	fprintf(file, "# TYPE %s histogram\n", METRICS_HISTOGRAM_NAME);
+	for (int metric = 0; metric < MetricCount; metric++) {
+		const MetricHistogram* histogram = &histograms[metric];
+		if (histogram->count == 0) {
+			continue;
+		}
+		// Every second power of two, from 256 ns; each one is the edge of a bucket, so the counts are exact
+		long long cumulative = 0;
+		int bucket = 0;
+		for (int exponent = 8; exponent <= METRICS_MAX_EXPONENT; exponent += 2) {
+			int end = (exponent - METRICS_SUB_BUCKET_BITS + 1) << METRICS_SUB_BUCKET_BITS;
+			for (; bucket < end; bucket++) {
+				cumulative += histogram->buckets[bucket];
+			}
+			fprintf(file, "%s_bucket{operation=\"%s\",le=\"%.9g\"} %lld\n", METRICS_HISTOGRAM_NAME, metricNames[metric],
+				(double)(1LL << exponent) / 1e9, cumulative);
+		}
+		fprintf(file, "%s_bucket{operation=\"%s\",le=\"+Inf\"} %lld\n", METRICS_HISTOGRAM_NAME, metricNames[metric], histogram->count);
+		fprintf(file, "%s_sum{operation=\"%s\"} %.9f\n", METRICS_HISTOGRAM_NAME, metricNames[metric], histogram->sumNanoseconds / 1e9);
+		fprintf(file, "%s_count{operation=\"%s\"} %lld\n", METRICS_HISTOGRAM_NAME, metricNames[metric], histogram->count);
+	}
+
+	fprintf(file, "# HELP %s Percentiles of the time taken by the instrumented operations.\n", METRICS_QUANTILE_NAME);
+	fprintf(file, "# TYPE %s gauge\n", METRICS_QUANTILE_NAME);
+	for (int metric = 0; metric < MetricCount; metric++) {
+		if (histograms[metric].count == 0) {
+			continue;
+		}
+		for (int i = 0; i < (int)(sizeof(quantiles) / sizeof(quantiles[0])); i++) {
+			fprintf(file, "%s{operation=\"%s\",quantile=\"%g\"} %.9g\n", METRICS_QUANTILE_NAME, metricNames[metric],
+				quantiles[i], GetMetricQuantile(&histograms[metric], quantiles[i]));
+		}
+	}
+	free(histograms);
+	return !ferror(file);
+}
+
+#if METRICS_ENABLED
+
+static PlatformThread* dumpThread;
+static volatile long dumpStopping;
+static char dumpFilename[FILENAME_MAX];
+static int dumpInterval;
+
+// Writes beside the target and renames, so a reader sees the old file or the new one
+static int DumpMetrics(const char* filename) {
+	char temporary[FILENAME_MAX];
+	if (snprintf(temporary, sizeof(temporary), "%s.tmp", filename) >= (int)sizeof(temporary)) {
+		return 0;
+	}
+	FILE* file = fopen(temporary, "w");
+	if (file == NULL) {
+		return 0;
+	}
+	int written = WriteMetrics(file);
+	if (fclose(file) != 0 || !written) {
+		remove(temporary);
+		return 0;
+	}
+	return PlatformReplaceFile(temporary, filename);
+}
+
+static int DumpLoop(void* argument) {
+	(void)argument;
+	int elapsed = 0;
+	while (PlatformAtomicAdd(&dumpStopping, 0) == 0) {
+		PlatformSleep(METRICS_DUMP_SLICE_MS);
+		elapsed += METRICS_DUMP_SLICE_MS;
+		if (elapsed >= dumpInterval * 1000) {
+			DumpMetrics(dumpFilename);
+			elapsed = 0;
+		}
+	}
+	return 0;
+}
+
+int StartMetricsDump(const char* filename, int intervalSeconds) {
+	if (dumpThread != NULL || filename == NULL || strlen(filename) >= FILENAME_MAX) {
+		return 0;
+	}
+	strcpy(dumpFilename, filename);
+	dumpInterval = intervalSeconds > 0 ? intervalSeconds : 1;
+	dumpStopping = 0;
+	dumpThread = PlatformStartThread(DumpLoop, NULL);
+	return dumpThread != NULL;
+}
+
+void StopMetricsDump(void) {
+	if (dumpThread == NULL) {
+		return;
+	}
+	PlatformAtomicAdd(&dumpStopping, 1);
+	PlatformJoinThread(dumpThread);
+	dumpThread = NULL;
+	if (!DumpMetrics(dumpFilename)) {
+		printf("Could not write the metrics to %s\n", dumpFilename);
+	}
+}
+
+#else
+
+int StartMetricsDump(const char* filename, int intervalSeconds) {
+	(void)filename;
+	(void)intervalSeconds;
+	printf("Metrics are disabled in this build\n");
+	return 0;
+}
+
+void StopMetricsDump(void) {
+}
+
+#endif
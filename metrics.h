@@ -0,0 +1,166 @@
+/**
+ * @file   metrics.h
+ * @brief  This file includes the latency histograms kept for the loaders, savers, searches, changes and routing.
+ *
+ * Every instrumented function takes the time on entry and records how long
+ * it ran in a histogram of its own. Every thread records into histograms it
+ * owns, so recording is a few plain additions with no lock and no shared
+ * cache line; readers add the histograms of every thread together. When a
+ * thread finishes, its histograms pass to the next thread that starts. Buckets
+ * are log-linear, sixteen per power of two, so every percentile is within
+ * about 6% of the true value from nanoseconds to minutes. The histograms can
+ * be written in the Prometheus text format, once or periodically by a
+ * background thread.
+ *
+ * Defining METRICS_DISABLED (done in the Release configurations) turns the
+ * instrumentation into nothing, so the measured functions cost exactly what
+ * they did without it.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "platform.h"
+
+#ifdef METRICS_DISABLED
+#define METRICS_ENABLED 0                       /**< Instrumentation compiled out. */
+#else
+#define METRICS_ENABLED 1                       /**< Instrumentation compiled in. */
+#endif
+
+#define METRICS_SUB_BUCKET_BITS 4               /**< Buckets per power of two, as a power of two. */
+#define METRICS_MAX_EXPONENT 40                 /**< Highest power of two of nanoseconds told apart, about 18 minutes. */
+#define METRICS_BUCKET_COUNT ((METRICS_MAX_EXPONENT - METRICS_SUB_BUCKET_BITS + 2) << METRICS_SUB_BUCKET_BITS) /**< Buckets of a histogram. */
+#define METRICS_MAX_SHARDS 64                   /**< Running threads with histograms of their own; a finished thread's set goes to the next one. */
+#define METRICS_DUMP_INTERVAL 10               /**< Seconds between two writes of the metrics file by main. */
+#define METRICS_DUMP_SLICE_MS 100               /**< Longest time the dump thread takes to notice it must stop. */
+
+/**
+ * @brief Operations that are measured.
+ */
+typedef enum {
+	MetricLoadClientsText,          /**< LoadClientsFromTextFile */
+	MetricLoadClientsBinary,        /**< LoadClientsFromBinaryFile */
+	MetricSaveClients,              /**< SaveClientsToBinaryFile */
+	MetricFindClient,               /**< FindClientByNif */
+	MetricUpdateClient,             /**< UpdateClient */
+	MetricDeleteClient,             /**< DeleteClient */
+	MetricFindClientsByName,        /**< FindClientsByName */
+	MetricLoadManagersText,         /**< LoadManagersFromTextFile */
+	MetricLoadManagersBinary,       /**< LoadManagersFromBinaryFile */
+	MetricSaveManagers,             /**< SaveManagersToFile */
+	MetricFindManager,              /**< FindManagerByNif */
+	MetricUpdateManager,            /**< UpdateManager */
+	MetricDeleteManager,            /**< DeleteManager */
+	MetricFindManagersByName,       /**< FindManagersByName */
+	MetricLoadMobilitiesText,       /**< LoadMobilitiesFromTextFile */
+	MetricLoadMobilitiesBinary,     /**< LoadMobilitiesFromBinaryFile */
+	MetricSaveMobilities,           /**< SaveMobilitiesToBinaryFile */
+	MetricFindMobilityById,         /**< FindMobilityById */
+	MetricFindMobilityByType,       /**< FindMobilityByType */
+	MetricFindMobilitiesByLocation, /**< FindMobilitiesByLocation */
+	MetricSelectMobilities,         /**< SelectMobilities */
+	MetricFindBestMobility,         /**< FindBestMobility */
+	MetricFindTopMobilities,        /**< FindTopMobilities */
+	MetricUpdateMobility,           /**< UpdateMobilityByHandle */
+	MetricUpdateMobilityStatuses,   /**< UpdateMobilityStatuses */
+	MetricDeleteMobility,           /**< DeleteMobility */
+	MetricLoadLocations,            /**< LoadLocationsFromTextFile */
+	MetricLoadRoads,                /**< LoadLocationSurroundingsFromTextFile */
+	MetricFindLocation,             /**< FindLocationById */
+	MetricBuildRoadGraph,           /**< BuildRoadGraph */
+	MetricFindShortestPaths,        /**< FindShortestPaths */
+	MetricFindShortestPathsTo,      /**< FindShortestPathsTo */
+	MetricFindDistancesFrom,        /**< FindDistancesFrom */
+	MetricBuildDistanceOracle,      /**< BuildDistanceOracle */
+	MetricLoadDistanceOracle,       /**< LoadDistanceOracle */
+	MetricSaveDistanceOracle,       /**< SaveDistanceOracle */
+	MetricPlanChargingRoutes,       /**< PlanChargingRoutes */
+	MetricSolveChargingTour,        /**< SolveChargingTour */
+	MetricCount                     /**< Number of operations, not an operation. */
+} MetricId;
+
+/**
+ * @brief Latencies of one operation.
+ */
+typedef struct MetricHistogram {
+	volatile long long count;                               /**< Number of calls. */
+	volatile long long sumNanoseconds;                      /**< Total time of all calls. */
+	volatile long long buckets[METRICS_BUCKET_COUNT];       /**< Number of calls that fell in every bucket. */
+} MetricHistogram;
+
+#if METRICS_ENABLED
+#define METRICS_START(started) double started = PlatformGetTime()                   /**< Takes the time an operation starts. */
+#define METRICS_STOP(metric, started) RecordMetric(metric, PlatformGetTime() - (started)) /**< Records an operation started at METRICS_START. */
+#else
+#define METRICS_START(started) ((void)0)
+#define METRICS_STOP(metric, started) ((void)0)
+#endif
+
+/**
+ * @brief Gets the name an operation is written with.
+ *
+ * @param metric The operation.
+ * @return The name, in snake case.
+ */
+const char* GetMetricName(MetricId metric);
+
+/**
+ * @brief Records one call of an operation in the histograms of the calling thread.
+ *
+ * @param metric The operation.
+ * @param seconds How long the call took.
+ */
+void RecordMetric(MetricId metric, double seconds);
+
+/**
+ * @brief Adds the histograms of every thread together.
+ *
+ * Calls recorded while the histograms are read may be counted or not.
+ *
+ * @param metric The operation.
+ * @param merged Receives the latencies of every call of the operation.
+ */
+void ReadMetric(MetricId metric, MetricHistogram* merged);
+
+/**
+ * @brief Estimates a percentile of a histogram.
+ *
+ * @param histogram The histogram.
+ * @param quantile The fraction of calls that were at least as fast, between 0 and 1.
+ * @return The latency in seconds, 0 for an empty histogram.
+ */
+double GetMetricQuantile(const MetricHistogram* histogram, double quantile);
+
+/**
+ * @brief Writes every operation called at least once in the Prometheus text format.
+ *
+ * @param file The file to write to.
+ * @return 1 on success, 0 if the file could not be written.
+ */
+int WriteMetrics(FILE* file);
+
+/**
+ * @brief Starts a thread that rewrites a file with the metrics at a fixed interval.
+ *
+ * The file is replaced whole every time, so a scraper never reads half of it.
+ *
+ * @param filename The file to write.
+ * @param intervalSeconds The time between two writes.
+ * @return 1 on success, 0 if the metrics are compiled out or a dump is already running.
+ */
+int StartMetricsDump(const char* filename, int intervalSeconds);
+
+/**
+ * @brief Stops the dump thread, if one runs, after it writes the file one last time.
+ */
+void StopMetricsDump(void);
+
+#endif  // METRICS_H
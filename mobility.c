@@ -1,150 +1,421 @@
 #include "mobility.h"
 #include "headers.h"
+#include "snapshot.h"
+#include "csvReader.h"
+#include "metrics.h"
+#include "platform.h"
 
-MobilityNode* AddMobility(MobilityNode* head, Mobility newMobility) {
-	MobilityNode* newNode = (MobilityNode*)malloc(sizeof(MobilityNode));
-	newNode->mobility = newMobility;
-	newNode->next = NULL;
+#define STATUS_PREFETCH_DISTANCE 16     // Statuses between the prefetch of the indexes of a vehicle and its update
 
-	if (head == NULL) {
-		head = newNode;
+static int GrowMobilityTable(MobilityTable* table, int minCapacity) {
+	int newCapacity = table->capacity == 0 ? MOBILITY_TABLE_MIN_CAPACITY : table->capacity;
+	while (newCapacity < minCapacity) {
+		newCapacity *= 2;
 	}
-	else {
-		MobilityNode* current = head;
-		while (current->next != NULL) {
-			current = current->next;
-		}
-		current->next = newNode;
+	if (newCapacity == table->capacity) {
+		return 1;
 	}
-	return head;
-}
 
-MobilityNode* DeleteMobility(MobilityNode* head, int id) {
-	if (head == NULL) {
-		return NULL;
+	Mobility* records = (Mobility*)realloc(table->records, newCapacity * sizeof(Mobility));
+	if (records == NULL) {
+		return 0;
+	}
+	table->records = records;
+
+	unsigned char* used = (unsigned char*)realloc(table->used, newCapacity * sizeof(unsigned char));
+	if (used == NULL) {
+		return 0;
 	}
+	memset(used + table->capacity, 0, (newCapacity - table->capacity) * sizeof(unsigned char));
+	table->used = used;
 
-	if (head->mobility.id == id) {
-		MobilityNode* tempNode = head;
-		head = head->next;
-		free(tempNode);
-		return head;
+	MobilityHandle* freeSlots = (MobilityHandle*)realloc(table->freeSlots, newCapacity * sizeof(MobilityHandle));
+	if (freeSlots == NULL) {
+		return 0;
 	}
+	table->freeSlots = freeSlots;
 
-	MobilityNode* current = head;
-	while (current->next != NULL && current->next->mobility.id != id) {
-		current = current->next;
+	if (!FleetReserve(&table->columns, newCapacity) || !DistrictReserve(&table->districts, newCapacity) ||
+		!AvailabilityReserve(&table->availability, newCapacity) || !IdIndexReserve(&table->ids, newCapacity)) {
+		return 0;
 	}
 
-	if (current->next != NULL) {
-		MobilityNode* tempNode = current->next;
-		current->next = current->next->next;
-		free(tempNode);
+	table->capacity = newCapacity;
+	return 1;
+}
+
+MobilityTable* CreateMobilityTable(int initialCapacity) {
+	MobilityTable* table = (MobilityTable*)calloc(1, sizeof(MobilityTable));
+	if (table == NULL) {
+		return NULL;
 	}
 
-	return head;
+	if (!GrowMobilityTable(table, initialCapacity)) {
+		FreeMobilities(table);
+		return NULL;
+	}
+	return table;
 }
 
-void UpdateMobility(MobilityNode* head, int id, Mobility updatedMobility) {
-	MobilityNode* current = head;
-	while (current != NULL) {
-		if (current->mobility.id == id) {
-			current->mobility = updatedMobility;
+// Files a vehicle under its ID unless another vehicle already holds it; the reserve done by GrowMobilityTable means this never allocates
+static void IndexMobilityId(MobilityTable* table, MobilityHandle handle) {
+	int id = table->records[handle].id;
+	if (IdIndexFind(&table->ids, id) != ID_INDEX_MISSING) {
+		table->sharedIds++;
+		return;
+	}
+	IdIndexInsert(&table->ids, id, handle);
+}
+
+// Takes a vehicle out of the ID index, handing its ID to another vehicle that shares it
+static void UnindexMobilityId(MobilityTable* table, MobilityHandle handle) {
+	int id = table->records[handle].id;
+	if (IdIndexFind(&table->ids, id) != handle) {
+		table->sharedIds--;
+		return;
+	}
+	IdIndexRemove(&table->ids, id);
+	if (table->sharedIds == 0) {
+		return;
+	}
+
+	for (MobilityHandle other = 0; other < table->slotCount; other++) {
+		if (other != handle && table->used[other] && table->records[other].id == id) {
+			IdIndexInsert(&table->ids, id, other);
+			table->sharedIds--;
 			return;
 		}
-		current = current->next;
 	}
 }
 
-MobilityNode* FindMobilityById(MobilityNode* head, int id) {
-	MobilityNode* current = head;
-	while (current != NULL) {
-		if (current->mobility.id == id) {
-			return current;
+MobilityHandle AddMobility(MobilityTable* table, Mobility newMobility) {
+	MobilityHandle handle;
+
+	if (table->freeCount > 0) {
+		handle = table->freeSlots[--table->freeCount];
+	}
+	else {
+		if (table->slotCount == table->capacity && !GrowMobilityTable(table, table->slotCount + 1)) {
+			return INVALID_MOBILITY_HANDLE;
 		}
-		current = current->next;
+		handle = table->slotCount++;
 	}
-	return NULL;
+
+	table->records[handle] = newMobility;
+	table->used[handle] = 1;
+	table->count++;
+	IndexMobilityId(table, handle);
+	FleetSetSlot(&table->columns, handle, &newMobility);
+	DistrictFile(&table->districts, handle, newMobility.locationId);
+	AvailabilityFile(&table->availability, handle, newMobility.type, newMobility.locationId, newMobility.battery_level, newMobility.cost);
+	return handle;
+}
+
+int DeleteMobility(MobilityTable* table, int id) {
+	METRICS_START(started);
+	MobilityHandle handle = FindMobilityById(table, id);
+	if (handle == INVALID_MOBILITY_HANDLE) {
+		METRICS_STOP(MetricDeleteMobility, started);
+		return 0;
+	}
+
+	UnindexMobilityId(table, handle);
+	table->used[handle] = 0;
+	FleetClearSlot(&table->columns, handle);
+	DistrictRemove(&table->districts, handle);
+	AvailabilityRemove(&table->availability, handle);
+	table->freeSlots[table->freeCount++] = handle;
+	table->count--;
+	METRICS_STOP(MetricDeleteMobility, started);
+	return 1;
 }
 
-// find mobility by type truck
-MobilityNode* FindMobilityByType(MobilityNode* head, VehicleType type) {
-	MobilityNode* current = head;
-	while (current != NULL) {
-		if (current->mobility.type == type) {
-			return current;
+void UpdateMobility(MobilityTable* table, int id, Mobility updatedMobility) {
+	UpdateMobilityByHandle(table, FindMobilityById(table, id), updatedMobility);
+}
+
+void UpdateMobilityByHandle(MobilityTable* table, MobilityHandle handle, Mobility updatedMobility) {
+	METRICS_START(started);
+	if (!IsValidMobilityHandle(table, handle)) {
+		METRICS_STOP(MetricUpdateMobility, started);
+		return;
+	}
+
+	int idChanged = table->records[handle].id != updatedMobility.id;
+	if (idChanged) {
+		UnindexMobilityId(table, handle);
+	}
+	table->records[handle] = updatedMobility;
+	if (idChanged) {
+		IndexMobilityId(table, handle);
+	}
+	FleetSetSlot(&table->columns, handle, &updatedMobility);
+	DistrictFile(&table->districts, handle, updatedMobility.locationId);
+	AvailabilityFile(&table->availability, handle, updatedMobility.type, updatedMobility.locationId,
+		updatedMobility.battery_level, updatedMobility.cost);
+	METRICS_STOP(MetricUpdateMobility, started);
+}
+
+int UpdateMobilityStatuses(MobilityTable* table, const MobilityStatus* statuses, int count) {
+	METRICS_START(started);
+	int updated = 0;
+	for (int i = 0; i < count; i++) {
+		// The indexes are read well ahead of their update, so the misses of several vehicles are waited for at once
+		if (i + STATUS_PREFETCH_DISTANCE < count && IsValidMobilityHandle(table, statuses[i + STATUS_PREFETCH_DISTANCE].handle)) {
+			const MobilityStatus* ahead = &statuses[i + STATUS_PREFETCH_DISTANCE];
+			PLATFORM_PREFETCH(&table->records[ahead->handle]);
+			DistrictPrefetch(&table->districts, ahead->handle, ahead->locationId);
+			AvailabilityPrefetch(&table->availability, ahead->handle, table->records[ahead->handle].type, ahead->locationId);
 		}
-		current = current->next;
+
+		MobilityHandle handle = statuses[i].handle;
+		if (!IsValidMobilityHandle(table, handle)) {
+			continue;
+		}
+
+		Mobility* mobility = &table->records[handle];
+		mobility->battery_level = statuses[i].battery;
+		mobility->locationId = statuses[i].locationId;
+		FleetSetStatus(&table->columns, handle, statuses[i].battery, statuses[i].locationId);
+		DistrictFile(&table->districts, handle, statuses[i].locationId);
+		AvailabilityFile(&table->availability, handle, mobility->type, statuses[i].locationId, statuses[i].battery, mobility->cost);
+		updated++;
 	}
-	return NULL;
+	METRICS_STOP(MetricUpdateMobilityStatuses, started);
+	return updated;
+}
+
+MobilityHandle FindMobilityById(const MobilityTable* table, int id) {
+	METRICS_START(started);
+	if (table == NULL) {
+		METRICS_STOP(MetricFindMobilityById, started);
+		return INVALID_MOBILITY_HANDLE;
+	}
+
+	int handle = IdIndexFind(&table->ids, id);
+	METRICS_STOP(MetricFindMobilityById, started);
+	return handle == ID_INDEX_MISSING ? INVALID_MOBILITY_HANDLE : handle;
 }
 
+MobilityHandle FindMobilityByType(const MobilityTable* table, VehicleType type) {
+	METRICS_START(started);
+	if (table == NULL) {
+		METRICS_STOP(MetricFindMobilityByType, started);
+		return INVALID_MOBILITY_HANDLE;
+	}
 
+	for (MobilityHandle handle = 0; handle < table->slotCount; handle++) {
+		if (table->used[handle] && table->records[handle].type == type) {
+			METRICS_STOP(MetricFindMobilityByType, started);
+			return handle;
+		}
+	}
+	METRICS_STOP(MetricFindMobilityByType, started);
+	return INVALID_MOBILITY_HANDLE;
+}
 
-MobilityNode* LoadMobilitiesFromTextFile(const char* filename) {
-	FILE* file = fopen(filename, "r");
-	if (file == NULL) {
+const MobilityHandle* FindMobilitiesByLocation(const MobilityTable* table, int locationId, int* count) {
+	METRICS_START(started);
+	if (table == NULL) {
+		*count = 0;
+		METRICS_STOP(MetricFindMobilitiesByLocation, started);
 		return NULL;
 	}
+	const MobilityHandle* handles = DistrictHandles(&table->districts, locationId, count);
+	METRICS_STOP(MetricFindMobilitiesByLocation, started);
+	return handles;
+}
+
+int SelectMobilities(const MobilityTable* table, const FleetFilter* filter, MobilityHandle* handles) {
+	METRICS_START(started);
+	if (table == NULL) {
+		METRICS_STOP(MetricSelectMobilities, started);
+		return 0;
+	}
+	if (filter->locationId == FLEET_ANY_LOCATION) {
+		int found = FleetSelectIndices(&table->columns, filter, handles);
+		METRICS_STOP(MetricSelectMobilities, started);
+		return found;
+	}
 
-	MobilityNode* head = NULL;
-	Mobility newMobility;
-	while (fscanf(file, "%d,%d,%f,%f,%f,%f,%d,%d,%s,%s\n", &newMobility.id, &newMobility.type,
-		&newMobility.battery_level, &newMobility.cost, &newMobility.batteryCapacity,
-		&newMobility.energyCostWPerKm, &newMobility.vehicleWeight, &newMobility.maxTransportWeight,
-		&newMobility.locationId) == 9) {
-		head = AddMobility(head, newMobility);
+	int count;
+	const MobilityHandle* inLocation = FindMobilitiesByLocation(table, filter->locationId, &count);
+	int selected = 0;
+	for (int i = 0; i < count; i++) {
+		const Mobility* mobility = &table->records[inLocation[i]];
+		if (mobility->type >= 0 && mobility->type < 32 && (filter->typeMask & FLEET_TYPE_BIT(mobility->type)) &&
+			mobility->battery_level < filter->maxBattery) {
+			handles[selected++] = inLocation[i];
+		}
 	}
+	METRICS_STOP(MetricSelectMobilities, started);
+	return selected;
+}
 
-	fclose(file);
-	return head;
+MobilityHandle FindBestMobility(const MobilityTable* table, VehicleType type, int locationId) {
+	METRICS_START(started);
+	if (table == NULL) {
+		METRICS_STOP(MetricFindBestMobility, started);
+		return INVALID_MOBILITY_HANDLE;
+	}
+	int handle = AvailabilityBest(&table->availability, type, locationId);
+	METRICS_STOP(MetricFindBestMobility, started);
+	return handle >= 0 ? handle : INVALID_MOBILITY_HANDLE;
 }
 
-void SaveMobilitiesToBinaryFile(MobilityNode* head, const char* filename) {
-	FILE* file = fopen(filename, "wb");
-	if (file == NULL) {
-		return;
+int FindTopMobilities(const MobilityTable* table, VehicleType type, int locationId, int k, MobilityHandle* handles) {
+	METRICS_START(started);
+	if (table == NULL) {
+		METRICS_STOP(MetricFindTopMobilities, started);
+		return 0;
+	}
+	int found = AvailabilityTop(&table->availability, type, locationId, k, handles);
+	METRICS_STOP(MetricFindTopMobilities, started);
+	return found;
+}
+
+int IsValidMobilityHandle(const MobilityTable* table, MobilityHandle handle) {
+	return table != NULL && handle >= 0 && handle < table->slotCount && table->used[handle];
+}
+
+const Mobility* GetMobility(const MobilityTable* table, MobilityHandle handle) {
+	return IsValidMobilityHandle(table, handle) ? &table->records[handle] : NULL;
+}
+
+MobilityTable* LoadMobilitiesFromTextFile(const char* filename) {
+	METRICS_START(started);
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		METRICS_STOP(MetricLoadMobilitiesText, started);
+		return NULL;
+	}
+
+	MobilityTable* table = CreateMobilityTable(MOBILITY_TABLE_MIN_CAPACITY);
+	if (table == NULL) {
+		CloseCsvReader(&reader);
+		METRICS_STOP(MetricLoadMobilitiesText, started);
+		return NULL;
 	}
 
-	MobilityNode* current = head;
-	while (current != NULL) {
-		fwrite(&(current->mobility), sizeof(Mobility), 1, file);
-		current = current->next;
+	int fields;
+	while ((fields = ReadCsvRecord(&reader, 9)) > 0) {
+		if (fields != 9) {
+			ReportCsvError(&reader, "expected 9 fields: id, type, battery, cost, capacity, energy, weight, max weight, location");
+			continue;
+		}
+
+		Mobility newMobility;
+		int type;
+		if (!ParseCsvInt(&reader.fields[0], &newMobility.id) ||
+			!ParseCsvInt(&reader.fields[1], &type) ||
+			!ParseCsvFloat(&reader.fields[2], &newMobility.battery_level) ||
+			!ParseCsvFloat(&reader.fields[3], &newMobility.cost) ||
+			!ParseCsvFloat(&reader.fields[4], &newMobility.batteryCapacity) ||
+			!ParseCsvFloat(&reader.fields[5], &newMobility.energyCostWPerKm) ||
+			!ParseCsvInt(&reader.fields[6], &newMobility.vehicleWeight) ||
+			!ParseCsvInt(&reader.fields[7], &newMobility.maxTransportWeight) ||
+			!ParseCsvInt(&reader.fields[8], &newMobility.locationId)) {
+			ReportCsvError(&reader, "invalid mobility record");
+			continue;
+		}
+		newMobility.type = (VehicleType)type;
+		AddMobility(table, newMobility);
+	}
+
+	CloseCsvReader(&reader);
+
+	if (table->count == 0) {
+		FreeMobilities(table);
+		METRICS_STOP(MetricLoadMobilitiesText, started);
+		return NULL;
 	}
+	METRICS_STOP(MetricLoadMobilitiesText, started);
+	return table;
+}
+
+typedef struct MobilityCursor {
+	const MobilityTable* table;
+	MobilityHandle handle;
+} MobilityCursor;
 
-	fclose(file);
+static const void* NextMobilityRecord(void* context) {
+	MobilityCursor* cursor = (MobilityCursor*)context;
+	while (cursor->handle < cursor->table->slotCount) {
+		MobilityHandle handle = cursor->handle++;
+		if (cursor->table->used[handle]) {
+			return &cursor->table->records[handle];
+		}
+	}
+	return NULL;
 }
 
-MobilityNode* LoadMobilitiesFromBinaryFile(const char* filename) {
-	FILE* file = fopen(filename, "rb");
-	if (file == NULL) {
+static int WriteMobilitySnapshot(const MobilityTable* table, const char* filename, unsigned long long journalSequence) {
+	MobilityCursor cursor = { table, 0 };
+	return WriteSnapshot(filename, SnapshotMobilities, sizeof(Mobility), journalSequence, NextMobilityRecord, &cursor, NULL);
+}
+
+void SaveMobilitiesToBinaryFile(const MobilityTable* table, const char* filename) {
+	METRICS_START(started);
+	WriteMobilitySnapshot(table, filename, 0);
+	METRICS_STOP(MetricSaveMobilities, started);
+}
+
+MobilityTable* LoadMobilitiesFromBinaryFile(const char* filename) {
+	METRICS_START(started);
+	Snapshot snapshot;
+	SnapshotStatus status = OpenSnapshot(&snapshot, filename, SnapshotMobilities, sizeof(Mobility));
+	if (status == SnapshotMissing) {
+		METRICS_STOP(MetricLoadMobilitiesBinary, started);
+		return NULL;
+	}
+	if (status == SnapshotInvalid || snapshot.recordCount == 0) {
+		CloseSnapshot(&snapshot);
+		METRICS_STOP(MetricLoadMobilitiesBinary, started);
 		return NULL;
 	}
 
-	MobilityNode* head = NULL;
-	Mobility tempMobility;
+	MobilityTable* table = CreateMobilityTable((int)snapshot.recordCount);
+	if (table == NULL) {
+		CloseSnapshot(&snapshot);
+		METRICS_STOP(MetricLoadMobilitiesBinary, started);
+		return NULL;
+	}
 
-	while (fread(&tempMobility, sizeof(Mobility), 1, file)) {
-		head = AddMobility(head, tempMobility);
+	for (size_t i = 0; i < snapshot.recordCount; i++) {
+		Mobility mobility;
+		memcpy(&mobility, GetSnapshotRecord(&snapshot, i), sizeof(Mobility));
+		AddMobility(table, mobility);
 	}
+	unsigned long long journalSequence = snapshot.journalSequence;
+	CloseSnapshot(&snapshot);
 
-	fclose(file);
-	return head;
+	// Rewrite files from older versions in the current format, still covering the journal operations they did
+	if (status == SnapshotLegacy) {
+		WriteMobilitySnapshot(table, filename, journalSequence);
+	}
+	METRICS_STOP(MetricLoadMobilitiesBinary, started);
+	return table;
 }
 
-MobilityNode* LoadMobilities(const char* binFilename, const char* txtFilename) {
-	MobilityNode* head = LoadMobilitiesFromBinaryFile(binFilename);
-	if (head == NULL) {
-		head = LoadMobilitiesFromTextFile(txtFilename);
+MobilityTable* LoadMobilities(const char* binFilename, const char* txtFilename) {
+	MobilityTable* table = LoadMobilitiesFromBinaryFile(binFilename);
+	if (table == NULL) {
+		table = LoadMobilitiesFromTextFile(txtFilename);
 	}
-	return head;
+	return table;
 }
 
-void FreeMobilities(MobilityNode* head) {
-	MobilityNode* current = head;
-	while (head != NULL) {
-		current = head;
-		head = head->next;
-		free(current);
+void FreeMobilities(MobilityTable* table) {
+	if (table == NULL) {
+		return;
 	}
+
+	free(table->records);
+	free(table->used);
+	free(table->freeSlots);
+	FleetFree(&table->columns);
+	DistrictFree(&table->districts);
+	AvailabilityFree(&table->availability);
+	IdIndexFree(&table->ids);
+	free(table);
 }
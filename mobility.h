@@ -9,6 +9,10 @@
 #define MOBILITY_H
 
 #include "headers.h"
+#include "fleet.h"
+#include "districtIndex.h"
+#include "availabilityIndex.h"
+#include "idIndex.h"
 
  /**
   * @brief Types of vehicles.
@@ -37,96 +41,240 @@ typedef struct Mobility {
 } Mobility;
 
 /**
- * @brief Node for linked list of Mobility struct.
+ * @brief Stable handle of a vehicle inside a MobilityTable.
+ *
+ * A handle is the slot index of the vehicle and stays valid until the vehicle
+ * is deleted, even when the table grows.
+ */
+typedef int MobilityHandle;
+
+#define INVALID_MOBILITY_HANDLE (-1)     /**< Handle returned when no vehicle is found. */
+#define MOBILITY_TABLE_MIN_CAPACITY 64   /**< Initial number of slots of a table. */
+
+/**
+ * @brief Growable contiguous table of Mobility records.
+ *
+ * Records are stored in a single array so scans are sequential in memory.
+ * Appends are O(1) amortized and deleted slots are kept in a free list and
+ * reused by later appends, so handles of the remaining vehicles never move.
+ * The same records are mirrored column by column in a FleetColumns view used
+ * by the fleet-wide scan kernels, every handle is filed under its location in
+ * a DistrictIndex and under its type and location, best charged first, in an
+ * AvailabilityIndex, and every ID is mapped to its handle in an IdIndex, so
+ * records must only be changed through AddMobility, UpdateMobility,
+ * UpdateMobilityByHandle, UpdateMobilityStatuses and DeleteMobility.
+ */
+typedef struct MobilityTable {
+	Mobility* records;              /**< Records indexed by handle. */
+	unsigned char* used;            /**< 1 when the slot holds a vehicle, 0 when it is free. */
+	MobilityHandle* freeSlots;      /**< Stack of released slots. */
+	int freeCount;                  /**< Number of released slots in the stack. */
+	int slotCount;                  /**< Number of slots handed out so far (live or free). */
+	int capacity;                   /**< Number of allocated slots. */
+	int count;                      /**< Number of live vehicles. */
+	FleetColumns columns;           /**< Columnar copy of the records, indexed by handle. */
+	DistrictIndex districts;        /**< Handles of the vehicles in every location. */
+	AvailabilityIndex availability; /**< Handles of every type in every location, best charged first. */
+	IdIndex ids;                    /**< Handle of every ID; of vehicles sharing an ID, only the one indexed first. */
+	int sharedIds;                  /**< Number of live vehicles left out of ids because another one holds their ID. */
+} MobilityTable;
+
+/**
+ * @brief Battery level and location reported for a vehicle.
+ */
+typedef struct MobilityStatus {
+	MobilityHandle handle;          /**< Handle of the vehicle. */
+	float battery;                  /**< New battery level. */
+	int locationId;                 /**< New location. */
+} MobilityStatus;
+
+/**
+ * @brief Creates an empty mobility table.
+ *
+ * @param initialCapacity The number of slots to reserve up front.
+ * @return A pointer to the new table. If memory could not be allocated, returns NULL.
  */
-typedef struct MobilityNode {
-	Mobility mobility;              /**< Mobility data for the node. */
-	struct MobilityNode* next;      /**< Pointer to the next node in the list. */
-} MobilityNode;
+MobilityTable* CreateMobilityTable(int initialCapacity);
 
 /**
- * @brief Adds a new mobility node to the list.
+ * @brief Adds a new vehicle to the table.
  *
- * @param head The head of the list.
+ * @param table The table.
  * @param newMobility The new Mobility data to be added.
- * @return A pointer to the new head of the list.
+ * @return The handle of the new vehicle. If memory could not be allocated, returns INVALID_MOBILITY_HANDLE.
  */
-MobilityNode* AddMobility(MobilityNode* head, Mobility newMobility);
+MobilityHandle AddMobility(MobilityTable* table, Mobility newMobility);
 
 /**
- * @brief Deletes a mobility node from the list.
+ * @brief Deletes a vehicle from the table and releases its slot.
  *
- * @param head The head of the list.
+ * @param table The table.
  * @param id The ID of the Mobility data to be deleted.
- * @return A pointer to the new head of the list.
+ * @return 1 if the vehicle was deleted, 0 if it was not found.
  */
-MobilityNode* DeleteMobility(MobilityNode* head, int id);
+int DeleteMobility(MobilityTable* table, int id);
 
 /**
- * @brief Updates a mobility node in the list.
+ * @brief Updates a vehicle in the table.
  *
- * @param head The head of the list.
+ * @param table The table.
  * @param id The ID of the Mobility data to be updated.
  * @param updatedMobility The updated Mobility data.
  */
-void UpdateMobility(MobilityNode* head, int id, Mobility updatedMobility);
+void UpdateMobility(MobilityTable* table, int id, Mobility updatedMobility);
 
 /**
- * @brief Finds a mobility node in the list by its ID.
+ * @brief Updates the vehicle stored under a handle.
  *
- * @param head The head of the list.
+ * @param table The table.
+ * @param handle The handle of the vehicle.
+ * @param updatedMobility The updated Mobility data.
+ */
+void UpdateMobilityByHandle(MobilityTable* table, MobilityHandle handle, Mobility updatedMobility);
+
+/**
+ * @brief Sets the battery level and location of many vehicles at once.
+ * Only the two fields, their columns and the location and availability
+ * indexes are touched, so a telemetry batch costs far less than one
+ * UpdateMobilityByHandle per vehicle; the indexes of later statuses are
+ * prefetched while earlier ones are applied, and statuses in handle order
+ * walk the table in memory order. Statuses with invalid handles are skipped.
+ * @param table The table.
+ * @param statuses The new statuses, at most one per vehicle.
+ * @param count The number of statuses.
+ * @return The number of vehicles updated.
+ */
+int UpdateMobilityStatuses(MobilityTable* table, const MobilityStatus* statuses, int count);
+
+/**
+ * @brief Finds a vehicle in the table by its ID.
+ *
+ * @param table The table.
  * @param id The ID of the Mobility data to be found.
- * @return A pointer to the found Mobility node. If not found, returns NULL.
+ * @return The handle of the vehicle. If not found, returns INVALID_MOBILITY_HANDLE.
  */
-MobilityNode* FindMobilityById(MobilityNode* head, int id);
+MobilityHandle FindMobilityById(const MobilityTable* table, int id);
 
 /**
- * @brief Finds a mobility node in the list by its vehicle type.
+ * @brief Finds the first vehicle in the table of a given type.
  *
- * @param head The head of the list.
+ * @param table The table.
  * @param type The VehicleType of the Mobility data to be found.
- * @return A pointer to the found Mobility node. If not found, returns NULL.
+ * @return The handle of the vehicle. If not found, returns INVALID_MOBILITY_HANDLE.
+ */
+MobilityHandle FindMobilityByType(const MobilityTable* table, VehicleType type);
+
+/**
+ * @brief Gets the vehicles in a location without scanning the table.
+ *
+ * The array is in no particular order and is only valid until the next change to the table.
+ *
+ * @param table The table.
+ * @param locationId The location.
+ * @param count Receives the number of vehicles.
+ * @return The handles of the vehicles, NULL if there are none.
  */
-MobilityNode* FindMobilityByType(MobilityNode* head, VehicleType type);
+const MobilityHandle* FindMobilitiesByLocation(const MobilityTable* table, int locationId, int* count);
 
 /**
- * @brief Loads mobility data from a text file into a linked list.
+ * @brief Gets the vehicles that match a filter.
+ *
+ * A filter on one location only visits the vehicles in that location, in no
+ * particular order; other filters scan the whole fleet and return ascending handles.
+ *
+ * @param table The table.
+ * @param filter The filter.
+ * @param handles Output array with room for every vehicle of the table.
+ * @return The number of matching vehicles.
+ */
+int SelectMobilities(const MobilityTable* table, const FleetFilter* filter, MobilityHandle* handles);
+
+/**
+ * @brief Finds the vehicle of a type with the most battery in a location.
+ *
+ * Ties go to the cheaper vehicle. Runs in O(1) from the availability index.
+ *
+ * @param table The table.
+ * @param type The VehicleType wanted.
+ * @param locationId The location.
+ * @return The handle of the vehicle. If there is none, returns INVALID_MOBILITY_HANDLE.
+ */
+MobilityHandle FindBestMobility(const MobilityTable* table, VehicleType type, int locationId);
+
+/**
+ * @brief Finds the k vehicles of a type with the most battery in a location, best first.
+ *
+ * @param table The table.
+ * @param type The VehicleType wanted.
+ * @param locationId The location.
+ * @param k The number of vehicles wanted.
+ * @param handles Output array with room for k handles.
+ * @return The number of vehicles found, at most k.
+ */
+int FindTopMobilities(const MobilityTable* table, VehicleType type, int locationId, int k, MobilityHandle* handles);
+
+/**
+ * @brief Checks whether a handle refers to a live vehicle.
+ *
+ * @param table The table.
+ * @param handle The handle to check.
+ * @return 1 if the handle is valid, 0 otherwise.
+ */
+int IsValidMobilityHandle(const MobilityTable* table, MobilityHandle handle);
+
+/**
+ * @brief Gets the record of a vehicle.
+ *
+ * The pointer is only valid until the next call to AddMobility, which may grow
+ * the table; keep the handle instead of the pointer across insertions.
+ *
+ * @param table The table.
+ * @param handle The handle of the vehicle.
+ * @return A pointer to the Mobility data. If the handle is not valid, returns NULL.
+ */
+const Mobility* GetMobility(const MobilityTable* table, MobilityHandle handle);
+
+/**
+ * @brief Loads mobility data from a text file into a table.
  *
  * @param filename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the created table. If the file is missing or empty, returns NULL.
  */
-MobilityNode* LoadMobilitiesFromTextFile(const char* filename);
+MobilityTable* LoadMobilitiesFromTextFile(const char* filename);
 
 /**
- * @brief Saves mobility data from a linked list into a binary file.
+ * @brief Saves mobility data from a table into a binary snapshot file.
  *
- * @param head The head of the list.
+ * @param table The table.
  * @param filename The name of the binary file.
  */
-void SaveMobilitiesToBinaryFile(MobilityNode* head, const char* filename);
+void SaveMobilitiesToBinaryFile(const MobilityTable* table, const char* filename);
 
 /**
- * @brief Loads mobility data from a binary file into a linked list.
+ * @brief Loads mobility data from a binary file into a table.
+ *
+ * Headerless files written by earlier versions are accepted and rewritten in
+ * the snapshot format.
  *
  * @param filename The name of the binary file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the created table. If the file is missing or empty, returns NULL.
  */
-MobilityNode* LoadMobilitiesFromBinaryFile(const char* filename);
+MobilityTable* LoadMobilitiesFromBinaryFile(const char* filename);
 
 /**
- * @brief Loads mobility data either from a binary or a text file into a linked list.
+ * @brief Loads mobility data either from a binary or a text file into a table.
  *
  * @param binFilename The name of the binary file.
  * @param txtFilename The name of the text file.
- * @return A pointer to the head of the created list.
+ * @return A pointer to the created table.
  */
-MobilityNode* LoadMobilities(const char* binFilename, const char* txtFilename);
+MobilityTable* LoadMobilities(const char* binFilename, const char* txtFilename);
 
 /**
- * @brief Frees all the memory allocated for the linked list of Mobility.
+ * @brief Frees all the memory allocated for the table.
  *
- * @param head The head of the list.
+ * @param table The table.
  */
-void FreeMobilities(MobilityNode* head);
+void FreeMobilities(MobilityTable* table);
 
 #endif  // MOBILITY_H
@@ -0,0 +1,414 @@
+#include "nameIndex.h"
+#include "collation.h"
+
+#include <stddef.h>
+
+#define TOWER_SIZE(height) (offsetof(NameIndexNode, next) + (size_t)(height) * sizeof(NameIndexNode*))
+#define BLOCK_HEADER_SIZE ((sizeof(NameIndexBlock) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+#define SORT_SMALL_GROUP 32  // Groups this small are merged instead of sorted by radix
+
+typedef struct SortEntry {
+	unsigned long long chunk;       // Eight bytes of the key from the depth being sorted, big endian
+	const char* key;                // Whole key, so reading more of it does not go through the node
+	void* value;
+} SortEntry;
+
+// Collation keys hold no zero byte, so strcmp orders them byte by byte like memcmp
+static int CompareKeys(const char* key, const char* nif, const char* otherKey, const char* otherNif) {
+	int order = strcmp(key, otherKey);
+	return order != 0 ? order : strncmp(nif, otherNif, NIF_INDEX_KEY_SIZE);
+}
+
+static int CompareTower(const NameIndex* index, const NameIndexNode* tower, const char* key, const char* nif) {
+	const char* towerKey;
+	const char* towerNif;
+	index->keyOf(tower->value, &towerKey, &towerNif);
+	return CompareKeys(towerKey, towerNif, key, nif);
+}
+
+// Walks down from the top level; on return links[0] is the first tower after the key, or at it unless pastEqual is set
+static NameIndexNode** FindLinks(const NameIndex* index, const char* key, const char* nif, int pastEqual, NameIndexNode*** update) {
+	NameIndexNode** links = (NameIndexNode**)index->head;
+	for (int level = index->level - 1; level >= 0; level--) {
+		while (links[level] != NULL) {
+			int order = CompareTower(index, links[level], key, nif);
+			if (order > 0 || (order == 0 && !pastEqual)) {
+				break;
+			}
+			links = links[level]->next;
+		}
+		if (update != NULL) {
+			update[level] = links;
+		}
+	}
+	return links;
+}
+
+// xorshift32, two bits per level for a 1 in 4 chance of growing a level
+static int RandomHeight(NameIndex* index) {
+	unsigned int x = index->random != 0 ? index->random : 2463534242u;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	index->random = x;
+
+	int height = 1;
+	while (height < NAME_INDEX_MAX_LEVEL && (x & 3) == 0) {
+		height++;
+		x >>= 2;
+	}
+	return height;
+}
+
+static NameIndexNode* AllocateTower(NameIndex* index, int height) {
+	NameIndexNode* tower = index->freeTowers[height - 1];
+	if (tower != NULL) {
+		index->freeTowers[height - 1] = tower->next[0];
+		return tower;
+	}
+
+	size_t size = TOWER_SIZE(height);
+	if (index->blocks == NULL || index->blockUsed + size > NAME_INDEX_BLOCK) {
+		NameIndexBlock* block = (NameIndexBlock*)malloc(NAME_INDEX_BLOCK);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->next = index->blocks;
+		index->blocks = block;
+		index->blockUsed = BLOCK_HEADER_SIZE;
+	}
+
+	tower = (NameIndexNode*)((unsigned char*)index->blocks + index->blockUsed);
+	index->blockUsed += size;
+	return tower;
+}
+
+int NameIndexInsert(NameIndex* index, void* value) {
+	const char* key;
+	const char* nif;
+	index->keyOf(value, &key, &nif);
+
+	NameIndexNode** update[NAME_INDEX_MAX_LEVEL];
+	NameIndexNode** links = FindLinks(index, key, nif, 0, update);
+	if (links[0] != NULL && CompareTower(index, links[0], key, nif) == 0) {
+		return 0;
+	}
+
+	int height = RandomHeight(index);
+	NameIndexNode* tower = AllocateTower(index, height);
+	if (tower == NULL) {
+		return 0;
+	}
+	for (int level = index->level; level < height; level++) {
+		update[level] = index->head;
+	}
+	if (height > index->level) {
+		index->level = height;
+	}
+
+	tower->value = value;
+	for (int level = 0; level < height; level++) {
+		tower->next[level] = update[level][level];
+		update[level][level] = tower;
+	}
+	index->count++;
+	return 1;
+}
+
+int NameIndexBuild(NameIndex* index, void* const* values, size_t count) {
+	if (index->count > 0) {
+		for (size_t i = 0; i < count; i++) {
+			NameIndexInsert(index, values[i]);
+		}
+		return 1;
+	}
+
+	// Every tower is appended after the last one of each of its levels
+	NameIndexNode** tails[NAME_INDEX_MAX_LEVEL];
+	for (int level = 0; level < NAME_INDEX_MAX_LEVEL; level++) {
+		tails[level] = index->head;
+	}
+
+	const char* lastKey = NULL;
+	const char* lastNif = NULL;
+	for (size_t i = 0; i < count; i++) {
+		const char* key;
+		const char* nif;
+		index->keyOf(values[i], &key, &nif);
+		int order = lastKey != NULL ? CompareKeys(key, nif, lastKey, lastNif) : 1;
+		if (order == 0) {
+			continue;
+		}
+		if (order < 0) {
+			// Out of order: the tails are no use any more, the rest go through the usual search
+			for (; i < count; i++) {
+				NameIndexInsert(index, values[i]);
+			}
+			return 1;
+		}
+
+		int height = RandomHeight(index);
+		NameIndexNode* tower = AllocateTower(index, height);
+		if (tower == NULL) {
+			return 0;
+		}
+		tower->value = values[i];
+		for (int level = 0; level < height; level++) {
+			tower->next[level] = NULL;
+			tails[level][level] = tower;
+			tails[level] = tower->next;
+		}
+		if (height > index->level) {
+			index->level = height;
+		}
+		index->count++;
+		lastKey = key;
+		lastNif = nif;
+	}
+	return 1;
+}
+
+int NameIndexRemove(NameIndex* index, const void* value) {
+	const char* key;
+	const char* nif;
+	index->keyOf(value, &key, &nif);
+
+	NameIndexNode** update[NAME_INDEX_MAX_LEVEL];
+	NameIndexNode* tower = FindLinks(index, key, nif, 0, update)[0];
+	if (tower == NULL || tower->value != value) {
+		return 0;
+	}
+
+	int height = 0;
+	while (height < index->level && update[height][height] == tower) {
+		update[height][height] = tower->next[height];
+		height++;
+	}
+	while (index->level > 0 && index->head[index->level - 1] == NULL) {
+		index->level--;
+	}
+
+	tower->next[0] = index->freeTowers[height - 1];
+	index->freeTowers[height - 1] = tower;
+	index->count--;
+	return 1;
+}
+
+void* NameIndexPrevious(const NameIndex* index, const char* key, const char* nif) {
+	NameIndexNode** links = FindLinks(index, key, nif, 0, NULL);
+	if (links == (NameIndexNode**)index->head) {
+		return NULL;
+	}
+	NameIndexNode* tower = (NameIndexNode*)((unsigned char*)links - offsetof(NameIndexNode, next));
+	return tower->value;
+}
+
+size_t NameIndexPage(const NameIndex* index, const NameQuery* query, NameCursor* cursor, void** values, size_t maxValues) {
+	static const NameQuery everything = { NULL, NULL, NULL };
+	if (query == NULL) {
+		query = &everything;
+	}
+	if (cursor->done || maxValues == 0) {
+		return 0;
+	}
+
+	// The prefix only keeps the letters, so it matches names whatever their accents and case
+	char prefixBuffer[COLLATION_BUFFER];
+	char fromBuffer[COLLATION_BUFFER];
+	char toBuffer[COLLATION_BUFFER];
+	size_t prefixLength = 0;
+	char* prefix = BuildCollationKey(query->prefix != NULL ? query->prefix : "", COLLATION_PRIMARY, prefixBuffer, sizeof(prefixBuffer), &prefixLength);
+	char* from = query->from != NULL ? BuildCollationKey(query->from, COLLATION_ALL_LEVELS, fromBuffer, sizeof(fromBuffer), NULL) : NULL;
+	char* to = query->to != NULL ? BuildCollationKey(query->to, COLLATION_ALL_LEVELS, toBuffer, sizeof(toBuffer), NULL) : NULL;
+
+	size_t count = 0;
+	if (prefix != NULL && (query->from == NULL || from != NULL) && (query->to == NULL || to != NULL)) {
+		// Keys with the prefix are contiguous, so the page starts at the later of the prefix, from and the cursor
+		const char* start = from != NULL && strcmp(from, prefix) > 0 ? from : prefix;
+		NameIndexNode** links = cursor->key != NULL && CompareKeys(cursor->key, cursor->nif, start, "") >= 0 ?
+			FindLinks(index, cursor->key, cursor->nif, 1, NULL) : FindLinks(index, start, "", 0, NULL);
+
+		for (NameIndexNode* tower = links[0]; tower != NULL && count < maxValues; tower = tower->next[0]) {
+			const char* key;
+			const char* nif;
+			index->keyOf(tower->value, &key, &nif);
+			if (strncmp(key, prefix, prefixLength) != 0 || (to != NULL && strcmp(key, to) >= 0)) {
+				break;
+			}
+
+			values[count++] = tower->value;
+			cursor->key = key;
+			strncpy(cursor->nif, nif, NIF_INDEX_KEY_SIZE - 1);
+			cursor->nif[NIF_INDEX_KEY_SIZE - 1] = '\0';
+		}
+	}
+
+	if (prefix != prefixBuffer) {
+		free(prefix);
+	}
+	if (from != fromBuffer) {
+		free(from);
+	}
+	if (to != toBuffer) {
+		free(to);
+	}
+
+	cursor->done = count < maxValues;
+	return count;
+}
+
+// Reads eight bytes of a key from depth on so that integer order is byte order, zero past its end
+static unsigned long long KeyChunk(const char* key, size_t depth) {
+	const unsigned char* bytes = (const unsigned char*)key + depth;
+	unsigned long long chunk = 0;
+	int i = 0;
+	for (; i < 8 && bytes[i] != '\0'; i++) {
+		chunk = (chunk << 8) | bytes[i];
+	}
+	return i == 0 ? 0 : chunk << (8 * (8 - i));
+}
+
+static int CompareEntries(const NameIndex* index, const SortEntry* a, const SortEntry* b, size_t depth) {
+	int order = strcmp(a->key + depth, b->key + depth);
+	if (order != 0) {
+		return order;
+	}
+	const char* key;
+	const char* nif;
+	const char* otherNif;
+	index->keyOf(a->value, &key, &nif);
+	index->keyOf(b->value, &key, &otherNif);
+	return strncmp(nif, otherNif, NIF_INDEX_KEY_SIZE);
+}
+
+// Stable merge sort of keys that are equal up to depth
+static void MergeEntries(const NameIndex* index, SortEntry* entries, SortEntry* temp, size_t count, size_t depth) {
+	if (count <= 8) {
+		for (size_t i = 1; i < count; i++) {
+			SortEntry entry = entries[i];
+			size_t j = i;
+			for (; j > 0 && CompareEntries(index, &entry, &entries[j - 1], depth) < 0; j--) {
+				entries[j] = entries[j - 1];
+			}
+			entries[j] = entry;
+		}
+		return;
+	}
+
+	size_t middle = count / 2;
+	MergeEntries(index, entries, temp, middle, depth);
+	MergeEntries(index, entries + middle, temp + middle, count - middle, depth);
+
+	size_t i = 0, j = middle, k = 0;
+	while (i < middle && j < count) {
+		temp[k++] = CompareEntries(index, &entries[j], &entries[i], depth) < 0 ? entries[j++] : entries[i++];
+	}
+	while (i < middle) {
+		temp[k++] = entries[i++];
+	}
+	while (j < count) {
+		temp[k++] = entries[j++];
+	}
+	memcpy(entries, temp, count * sizeof(SortEntry));
+}
+
+// Stable least significant digit radix sort on the chunks, skipping the bytes every entry shares
+static void RadixSortChunks(SortEntry* entries, SortEntry* temp, size_t count) {
+	size_t counts[8][256];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < count; i++) {
+		for (int digit = 0; digit < 8; digit++) {
+			counts[digit][(entries[i].chunk >> (8 * digit)) & 0xFF]++;
+		}
+	}
+
+	SortEntry* source = entries;
+	SortEntry* target = temp;
+	for (int digit = 0; digit < 8; digit++) {
+		if (counts[digit][(source[0].chunk >> (8 * digit)) & 0xFF] == count) {
+			continue;
+		}
+		size_t offset = 0;
+		for (int byte = 0; byte < 256; byte++) {
+			size_t bucket = counts[digit][byte];
+			counts[digit][byte] = offset;
+			offset += bucket;
+		}
+		for (size_t i = 0; i < count; i++) {
+			target[counts[digit][(source[i].chunk >> (8 * digit)) & 0xFF]++] = source[i];
+		}
+		SortEntry* swap = source;
+		source = target;
+		target = swap;
+	}
+	if (source != entries) {
+		memcpy(entries, source, count * sizeof(SortEntry));
+	}
+}
+
+// Sorts keys that are equal up to depth on their next eight bytes, then every run that is still equal on the bytes after
+static void SortEntries(const NameIndex* index, SortEntry* entries, SortEntry* temp, size_t count, size_t depth) {
+	if (count <= SORT_SMALL_GROUP) {
+		MergeEntries(index, entries, temp, count, depth);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		entries[i].chunk = KeyChunk(entries[i].key, depth);
+	}
+	RadixSortChunks(entries, temp, count);
+
+	size_t end;
+	for (size_t start = 0; start < count; start = end) {
+		end = start + 1;
+		while (end < count && entries[end].chunk == entries[start].chunk) {
+			end++;
+		}
+		if (end - start < 2) {
+			continue;
+		}
+		// A chunk that ends in a zero byte holds the end of the key: the keys are equal and only the NIF is left
+		if ((entries[start].chunk & 0xFF) != 0) {
+			SortEntries(index, entries + start, temp + start, end - start, depth + 8);
+		}
+		else {
+			MergeEntries(index, entries + start, temp + start, end - start, depth);
+		}
+	}
+}
+
+int NameIndexSort(const NameIndex* index, void** values, size_t count) {
+	if (count < 2) {
+		return 1;
+	}
+	SortEntry* entries = (SortEntry*)malloc(count * 2 * sizeof(SortEntry));
+	if (entries == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		const char* nif;
+		entries[i].value = values[i];
+		index->keyOf(values[i], &entries[i].key, &nif);
+	}
+	SortEntries(index, entries, entries + count, count, 0);
+	for (size_t i = 0; i < count; i++) {
+		values[i] = entries[i].value;
+	}
+
+	free(entries);
+	return 1;
+}
+
+void NameIndexClear(NameIndex* index) {
+	NameIndexBlock* block = index->blocks;
+	while (block != NULL) {
+		NameIndexBlock* next = block->next;
+		free(block);
+		block = next;
+	}
+
+	NameIndexKeyOf keyOf = index->keyOf;
+	memset(index, 0, sizeof(NameIndex));
+	index->keyOf = keyOf;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file   nameIndex.h
+ * @brief  This file includes the skip list that keeps clients and managers ordered by name.
+ *
+ * The index orders the nodes of a list by the collation key of their name
+ * (see collation.h), with the NIF breaking ties, so a record can be placed,
+ * removed or renamed in O(log n) instead of walking the list, and the list
+ * itself stays in the same order. Pages of names can
+ * be read from any point: everything starting with a prefix, a range of
+ * names, or the page that follows a cursor, so a screen can page through
+ * millions of records without walking the ones before.
+ *
+ * The index does not copy the keys: it reads the collation key and NIF of a
+ * node through the function given at initialization, so a node must be
+ * removed before either changes. Towers are carved from blocks owned by the index and
+ * recycled by height.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "nifIndex.h"
+
+#define NAME_INDEX_MAX_LEVEL 16             /**< Highest tower; with a 1 in 4 promotion, enough for billions of names. */
+#define NAME_INDEX_BLOCK (64 * 1024)        /**< Size in bytes of the blocks the towers are carved from. */
+
+/**
+ * @brief Declares the initial value of an index whose keys are read by keyOf.
+ */
+#define NAME_INDEX_INITIALIZER(keyOf) { keyOf, { NULL }, 0, 0, 0, NULL, 0, { NULL } }
+
+/**
+ * @brief Gets the collation key and NIF a node is ordered by.
+ */
+typedef void (*NameIndexKeyOf)(const void* value, const char** key, const char** nif);
+
+/**
+ * @brief Tower of a skip list: the node it stands for and its links, one per level.
+ */
+typedef struct NameIndexNode {
+	void* value;                            /**< Node of the list. */
+	struct NameIndexNode* next[1];          /**< Next tower at every level of this one; the allocation holds as many as its height. */
+} NameIndexNode;
+
+/**
+ * @brief Block the towers are carved from.
+ */
+typedef struct NameIndexBlock {
+	struct NameIndexBlock* next;            /**< Block filled before this one. */
+} NameIndexBlock;
+
+/**
+ * @brief Skip list ordered by collation key and NIF.
+ */
+typedef struct NameIndex {
+	NameIndexKeyOf keyOf;                   /**< Reads the key of a node. */
+	NameIndexNode* head[NAME_INDEX_MAX_LEVEL];  /**< First tower at every level. */
+	int level;                              /**< Number of levels in use. */
+	size_t count;                           /**< Number of nodes. */
+	unsigned int random;                    /**< State of the generator of tower heights. */
+	NameIndexBlock* blocks;                 /**< Blocks of towers, most recent first. */
+	size_t blockUsed;                       /**< Bytes used in the most recent block. */
+	NameIndexNode* freeTowers[NAME_INDEX_MAX_LEVEL];  /**< Released towers by height minus one, linked through next[0]. */
+} NameIndex;
+
+/**
+ * @brief Restricts the names a page is read from.
+ *
+ * The names are plain text; they are compared by collation key, so the
+ * prefix ignores accents and case and the range follows the order of the list.
+ */
+typedef struct NameQuery {
+	const char* prefix;                     /**< Only names that start with it, NULL or empty for any. */
+	const char* from;                       /**< First name, inclusive, NULL to start from the first. */
+	const char* to;                         /**< Names before it, exclusive, NULL to read up to the last. */
+} NameQuery;
+
+/**
+ * @brief Position of a reader between two pages.
+ *
+ * A zeroed cursor starts at the first name of the query. The cursor holds the
+ * key of the last node it returned rather than the node itself, so records
+ * can be added, renamed or deleted between two pages.
+ */
+typedef struct NameCursor {
+	const char* key;                        /**< Collation key of the last node returned, NULL before the first page. */
+	char nif[NIF_INDEX_KEY_SIZE];           /**< NIF of the last node returned. */
+	int done;                               /**< 1 once the last page was read. */
+} NameCursor;
+
+/**
+ * @brief Adds a node to the index.
+ *
+ * @param index The index.
+ * @param value The node; its key is read through the keyOf of the index.
+ * @return 1 on success, 0 if another node has the same key and NIF or memory could not be allocated.
+ */
+int NameIndexInsert(NameIndex* index, void* value);
+
+/**
+ * @brief Sorts nodes in the order of an index, by collation key and NIF, keeping equal nodes in their order.
+ *
+ * The keys are sorted eight bytes at a time by a radix sort over an array that
+ * holds those bytes, so the work is mostly sequential passes over memory
+ * rather than comparisons that follow pointers; a key is read again only
+ * while it is equal to another one so far. The nodes need not be in the index.
+ *
+ * @param index The index, whose keyOf reads the keys.
+ * @param values The nodes.
+ * @param count The number of nodes.
+ * @return 1 on success, 0 if memory could not be allocated, leaving the nodes as they were.
+ */
+int NameIndexSort(const NameIndex* index, void** values, size_t count);
+
+/**
+ * @brief Builds an empty index from nodes already sorted by collation key and NIF, in linear time.
+ *
+ * Nodes with the key of the node before them are left out. If the index is
+ * not empty, or from the first node out of order, the nodes are inserted one
+ * by one.
+ *
+ * @param index The index.
+ * @param values The sorted nodes.
+ * @param count The number of nodes.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int NameIndexBuild(NameIndex* index, void* const* values, size_t count);
+
+/**
+ * @brief Removes a node from the index.
+ *
+ * @param index The index.
+ * @param value The node, whose key must not have changed since it was added.
+ * @return 1 if the node was removed, 0 if it was not in the index.
+ */
+int NameIndexRemove(NameIndex* index, const void* value);
+
+/**
+ * @brief Finds the node ordered right before a key.
+ *
+ * @param index The index.
+ * @param key The collation key.
+ * @param nif The NIF.
+ * @return The last node whose key is lower. If there is none, returns NULL.
+ */
+void* NameIndexPrevious(const NameIndex* index, const char* key, const char* nif);
+
+/**
+ * @brief Reads the next page of nodes matching a query, in order.
+ *
+ * @param index The index.
+ * @param query The names to read, NULL for every name.
+ * @param cursor Where the previous page ended; updated to where this one ends.
+ * @param values Receives the nodes.
+ * @param maxValues The size of the page.
+ * @return The number of nodes read, 0 once there are no more.
+ */
+size_t NameIndexPage(const NameIndex* index, const NameQuery* query, NameCursor* cursor, void** values, size_t maxValues);
+
+/**
+ * @brief Frees the memory used by the index and leaves it empty.
+ *
+ * @param index The index.
+ */
+void NameIndexClear(NameIndex* index);
+
+#endif  // NAME_INDEX_H
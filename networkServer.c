@@ -0,0 +1,782 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "networkServer.h"
+#include "platform.h"
+#include "csvReader.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// One client connection, served by at most one worker at a time
+typedef struct ServerConnection {
+	int fd;                         // Socket of the connection
+	char* input;                    // Bytes received and not yet run as requests
+	size_t inputLength;             // Number of bytes in input
+	char* output;                   // Replies not yet sent
+	size_t outputStart;             // Offset of the first unsent byte of output
+	size_t outputLength;            // Offset one past the last unsent byte of output
+	size_t outputCapacity;          // Size of output
+	int endOfInput;                 // 1 once the client stopped sending
+	int failed;                     // 1 once the connection must be dropped without sending the rest
+	struct ServerConnection* previous;  // Previous open connection
+	struct ServerConnection* next;      // Next open connection
+} ServerConnection;
+
+typedef struct Server {
+	CommandContext* context;        // Stores the commands run against
+	PlatformReadWriteLock* storeLock;   // Shared by queries, exclusive for changes
+	int epoll;                      // Event queue of the listener, the wake-up event and every connection
+	int listener;                   // Listening socket
+	int wakeup;                     // Event signaled to stop the loop
+	PlatformMutex* queueLock;       // Protects the ready queue and stopping
+	PlatformCondition* queueReady;  // Signaled when a connection is queued or the server stops
+	ServerConnection** queue;       // Ring of connections ready to be served
+	int queueHead;                  // Position of the oldest queued connection
+	int queueCount;                 // Number of queued connections
+	int queueCapacity;              // Size of queue
+	int stopping;                   // 1 once the workers must exit after draining the queue
+	PlatformMutex* registryLock;    // Protects connections and the counters
+	ServerConnection* connections;  // Open connections
+	long long accepted;             // Connections accepted
+	long long requests;             // Requests answered
+} Server;
+
+// Address of the epoll data of the listener and the wake-up event, told apart from connections by pointer
+static int listenerTag;
+static int wakeupTag;
+static volatile int wakeupFd = -1;
+
+static void RequestStop(int signal) {
+	(void)signal;
+	unsigned long long one = 1;
+	if (wakeupFd >= 0 && write(wakeupFd, &one, sizeof(one)) < 0) {
+		// Nothing else is safe to do inside a signal handler
+	}
+}
+
+// Fills a socket address from "port", "host:port" or "unix:path"
+static int ResolveAddress(const char* address, struct sockaddr_storage* storage, socklen_t* length) {
+	memset(storage, 0, sizeof(struct sockaddr_storage));
+
+	size_t prefixLength = strlen(SERVER_UNIX_PREFIX);
+	if (strncmp(address, SERVER_UNIX_PREFIX, prefixLength) == 0) {
+		struct sockaddr_un* unixAddress = (struct sockaddr_un*)storage;
+		const char* path = address + prefixLength;
+		if (*path == '\0' || strlen(path) >= sizeof(unixAddress->sun_path)) {
+			return 0;
+		}
+		unixAddress->sun_family = AF_UNIX;
+		strcpy(unixAddress->sun_path, path);
+		*length = sizeof(struct sockaddr_un);
+		return 1;
+	}
+
+	char host[MAX_LENGHT] = "127.0.0.1";
+	const char* port = address;
+	const char* colon = strrchr(address, ':');
+	if (colon != NULL) {
+		if ((size_t)(colon - address) >= sizeof(host)) {
+			return 0;
+		}
+		memcpy(host, address, colon - address);
+		host[colon - address] = '\0';
+		port = colon + 1;
+	}
+
+	struct addrinfo hints;
+	struct addrinfo* found;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(host, port, &hints, &found) != 0) {
+		return 0;
+	}
+	memcpy(storage, found->ai_addr, found->ai_addrlen);
+	*length = found->ai_addrlen;
+	freeaddrinfo(found);
+	return 1;
+}
+
+static int OpenListener(const char* address) {
+	struct sockaddr_storage storage;
+	socklen_t length;
+	if (!ResolveAddress(address, &storage, &length)) {
+		printf("Invalid address %s.\n", address);
+		return -1;
+	}
+
+	int listener = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listener < 0) {
+		return -1;
+	}
+	if (storage.ss_family == AF_UNIX) {
+		unlink(((struct sockaddr_un*)&storage)->sun_path);
+	}
+	else {
+		int enable = 1;
+		setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	}
+	if (bind(listener, (struct sockaddr*)&storage, length) != 0 || listen(listener, SOMAXCONN) != 0) {
+		printf("Could not listen on %s: %s.\n", address, strerror(errno));
+		close(listener);
+		return -1;
+	}
+	return listener;
+}
+
+static void QueueConnection(Server* server, ServerConnection* connection) {
+	PlatformLockMutex(server->queueLock);
+	if (server->queueCount == server->queueCapacity) {
+		// Every connection is queued at most once, so the ring only grows with the number of connections
+		int capacity = server->queueCapacity > 0 ? server->queueCapacity * 2 : 64;
+		ServerConnection** queue = (ServerConnection**)malloc(capacity * sizeof(ServerConnection*));
+		if (queue == NULL) {
+			PlatformUnlockMutex(server->queueLock);
+			connection->failed = 1;
+			shutdown(connection->fd, SHUT_RDWR);
+			return;
+		}
+		for (int i = 0; i < server->queueCount; i++) {
+			queue[i] = server->queue[(server->queueHead + i) % server->queueCapacity];
+		}
+		free(server->queue);
+		server->queue = queue;
+		server->queueHead = 0;
+		server->queueCapacity = capacity;
+	}
+	server->queue[(server->queueHead + server->queueCount) % server->queueCapacity] = connection;
+	server->queueCount++;
+	PlatformSignalCondition(server->queueReady);
+	PlatformUnlockMutex(server->queueLock);
+}
+
+static ServerConnection* TakeConnection(Server* server) {
+	PlatformLockMutex(server->queueLock);
+	while (server->queueCount == 0 && !server->stopping) {
+		PlatformWaitCondition(server->queueReady, server->queueLock);
+	}
+
+	ServerConnection* connection = NULL;
+	if (server->queueCount > 0) {
+		connection = server->queue[server->queueHead];
+		server->queueHead = (server->queueHead + 1) % server->queueCapacity;
+		server->queueCount--;
+	}
+	PlatformUnlockMutex(server->queueLock);
+	return connection;
+}
+
+static void CloseConnection(Server* server, ServerConnection* connection) {
+	PlatformLockMutex(server->registryLock);
+	if (connection->previous != NULL) {
+		connection->previous->next = connection->next;
+	}
+	else {
+		server->connections = connection->next;
+	}
+	if (connection->next != NULL) {
+		connection->next->previous = connection->previous;
+	}
+	PlatformUnlockMutex(server->registryLock);
+
+	// Closing the socket also takes it out of the epoll set
+	close(connection->fd);
+	free(connection->input);
+	free(connection->output);
+	free(connection);
+}
+
+static void AcceptConnections(Server* server) {
+	for (;;) {
+		int fd = accept4(server->listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			// EAGAIN once the backlog is empty; other errors affect only the connection being accepted
+			if (errno == EINTR || errno == ECONNABORTED) {
+				continue;
+			}
+			return;
+		}
+
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+		ServerConnection* connection = (ServerConnection*)calloc(1, sizeof(ServerConnection));
+		char* input = (char*)malloc(SERVER_MAX_REQUEST);
+		if (connection == NULL || input == NULL) {
+			free(connection);
+			free(input);
+			close(fd);
+			continue;
+		}
+		connection->fd = fd;
+		connection->input = input;
+
+		PlatformLockMutex(server->registryLock);
+		connection->next = server->connections;
+		if (server->connections != NULL) {
+			server->connections->previous = connection;
+		}
+		server->connections = connection;
+		server->accepted++;
+		PlatformUnlockMutex(server->registryLock);
+
+		struct epoll_event event;
+		event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+		event.data.ptr = connection;
+		if (epoll_ctl(server->epoll, EPOLL_CTL_ADD, fd, &event) != 0) {
+			CloseConnection(server, connection);
+		}
+	}
+}
+
+static int AppendOutput(ServerConnection* connection, const char* text, size_t length) {
+	if (connection->outputLength + length > connection->outputCapacity) {
+		// Move the unsent bytes to the front before growing
+		if (connection->outputStart > 0) {
+			memmove(connection->output, connection->output + connection->outputStart, connection->outputLength - connection->outputStart);
+			connection->outputLength -= connection->outputStart;
+			connection->outputStart = 0;
+		}
+		if (connection->outputLength + length > connection->outputCapacity) {
+			size_t capacity = connection->outputCapacity > 0 ? connection->outputCapacity : 4096;
+			while (capacity < connection->outputLength + length) {
+				capacity *= 2;
+			}
+			char* output = (char*)realloc(connection->output, capacity);
+			if (output == NULL) {
+				return 0;
+			}
+			connection->output = output;
+			connection->outputCapacity = capacity;
+		}
+	}
+	memcpy(connection->output + connection->outputLength, text, length);
+	connection->outputLength += length;
+	return 1;
+}
+
+static size_t PendingOutput(const ServerConnection* connection) {
+	return connection->outputLength - connection->outputStart;
+}
+
+static void FlushOutput(ServerConnection* connection) {
+	while (PendingOutput(connection) > 0) {
+		ssize_t sent = send(connection->fd, connection->output + connection->outputStart, PendingOutput(connection), MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				connection->failed = 1;
+			}
+			return;
+		}
+		connection->outputStart += (size_t)sent;
+	}
+	connection->outputStart = 0;
+	connection->outputLength = 0;
+}
+
+static void RunRequest(Server* server, ServerConnection* connection, const char* line, size_t length) {
+	char reply[COMMAND_REPLY_SIZE + 1];
+
+	if (length > 0 && line[length - 1] == '\r') {
+		length--;
+	}
+
+	if (IsReadOnlyCommand(GetCommandKind(line, length))) {
+		PlatformLockShared(server->storeLock);
+		ExecuteCommand(server->context, line, length, NULL, reply, COMMAND_REPLY_SIZE);
+		PlatformUnlockShared(server->storeLock);
+	}
+	else {
+		PlatformLockExclusive(server->storeLock);
+		ExecuteCommand(server->context, line, length, NULL, reply, COMMAND_REPLY_SIZE);
+		PlatformUnlockExclusive(server->storeLock);
+	}
+
+	size_t replyLength = strlen(reply);
+	reply[replyLength++] = '\n';
+	if (!AppendOutput(connection, reply, replyLength)) {
+		connection->failed = 1;
+	}
+}
+
+// Runs the complete requests received so far, stopping early while too many replies wait to be sent
+static int RunRequests(Server* server, ServerConnection* connection) {
+	size_t consumed = 0;
+	int count = 0;
+
+	while (!connection->failed && PendingOutput(connection) < SERVER_MAX_PENDING_OUTPUT) {
+		const char* line = connection->input + consumed;
+		const char* newline = (const char*)memchr(line, '\n', connection->inputLength - consumed);
+		if (newline == NULL) {
+			break;
+		}
+		RunRequest(server, connection, line, (size_t)(newline - line));
+		consumed = (size_t)(newline - connection->input) + 1;
+		count++;
+	}
+
+	memmove(connection->input, connection->input + consumed, connection->inputLength - consumed);
+	connection->inputLength -= consumed;
+	return count;
+}
+
+static void ServeConnection(Server* server, ServerConnection* connection) {
+	int served = 0;
+
+	FlushOutput(connection);
+	for (;;) {
+		served += RunRequests(server, connection);
+		if (connection->failed || connection->endOfInput || PendingOutput(connection) >= SERVER_MAX_PENDING_OUTPUT) {
+			break;
+		}
+
+		if (connection->inputLength == SERVER_MAX_REQUEST) {
+			// A request that does not fit the buffer is refused and the connection dropped once the reply is sent
+			AppendOutput(connection, "ERR request too long\n", 21);
+			connection->endOfInput = 1;
+			connection->inputLength = 0;
+			break;
+		}
+
+		ssize_t received = recv(connection->fd, connection->input + connection->inputLength, SERVER_MAX_REQUEST - connection->inputLength, 0);
+		if (received < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				connection->failed = 1;
+			}
+			break;
+		}
+		if (received == 0) {
+			connection->endOfInput = 1;
+			break;
+		}
+		connection->inputLength += (size_t)received;
+	}
+	FlushOutput(connection);
+
+	PlatformLockMutex(server->registryLock);
+	server->requests += served;
+	PlatformUnlockMutex(server->registryLock);
+
+	if (connection->failed || (connection->endOfInput && PendingOutput(connection) == 0)) {
+		CloseConnection(server, connection);
+		return;
+	}
+
+	// Wait for room to send while replies are pending, and only read more once the backlog is small
+	struct epoll_event event;
+	event.events = EPOLLONESHOT | EPOLLRDHUP;
+	if (PendingOutput(connection) > 0) {
+		event.events |= EPOLLOUT;
+	}
+	if (!connection->endOfInput && PendingOutput(connection) < SERVER_MAX_PENDING_OUTPUT) {
+		event.events |= EPOLLIN;
+	}
+	event.data.ptr = connection;
+	if (epoll_ctl(server->epoll, EPOLL_CTL_MOD, connection->fd, &event) != 0) {
+		CloseConnection(server, connection);
+	}
+}
+
+static int RunWorker(void* argument) {
+	Server* server = (Server*)argument;
+	ServerConnection* connection;
+
+	while ((connection = TakeConnection(server)) != NULL) {
+		if (connection->failed) {
+			CloseConnection(server, connection);
+			continue;
+		}
+		ServeConnection(server, connection);
+	}
+	return 0;
+}
+
+static void RunEventLoop(Server* server) {
+	struct epoll_event events[SERVER_MAX_EVENTS];
+
+	for (;;) {
+		int count = epoll_wait(server->epoll, events, SERVER_MAX_EVENTS, -1);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return;
+		}
+
+		for (int i = 0; i < count; i++) {
+			if (events[i].data.ptr == &wakeupTag) {
+				return;
+			}
+			if (events[i].data.ptr == &listenerTag) {
+				AcceptConnections(server);
+			}
+			else {
+				QueueConnection(server, (ServerConnection*)events[i].data.ptr);
+			}
+		}
+	}
+}
+
+static int AddToEpoll(int epoll, int fd, void* tag) {
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = tag;
+	return epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+int RunServer(CommandContext* context, const char* address, int workerCount) {
+	Server server;
+	memset(&server, 0, sizeof(Server));
+	server.context = context;
+	server.epoll = -1;
+	server.wakeup = -1;
+
+	if (workerCount <= 0) {
+		workerCount = PlatformGetProcessorCount();
+	}
+
+	server.listener = OpenListener(address);
+	server.storeLock = PlatformCreateReadWriteLock();
+	server.queueLock = PlatformCreateMutex();
+	server.queueReady = PlatformCreateCondition();
+	server.registryLock = PlatformCreateMutex();
+	PlatformThread** workers = (PlatformThread**)calloc(workerCount, sizeof(PlatformThread*));
+	int started = 0;
+
+	if (server.listener >= 0 && server.storeLock != NULL && server.queueLock != NULL && server.queueReady != NULL &&
+		server.registryLock != NULL && workers != NULL) {
+		server.epoll = epoll_create1(EPOLL_CLOEXEC);
+		server.wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	}
+
+	if (server.epoll >= 0 && server.wakeup >= 0 && AddToEpoll(server.epoll, server.listener, &listenerTag) &&
+		AddToEpoll(server.epoll, server.wakeup, &wakeupTag)) {
+		for (started = 0; started < workerCount; started++) {
+			workers[started] = PlatformStartThread(RunWorker, &server);
+			if (workers[started] == NULL) {
+				break;
+			}
+		}
+	}
+
+	if (started > 0) {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_handler = RequestStop;
+		sigemptyset(&action.sa_mask);
+		wakeupFd = server.wakeup;
+		sigaction(SIGINT, &action, NULL);
+		sigaction(SIGTERM, &action, NULL);
+		signal(SIGPIPE, SIG_IGN);
+
+		printf("Serving on %s with %d workers. Press Ctrl+C to stop.\n", address, started);
+		fflush(stdout);
+		RunEventLoop(&server);
+
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		wakeupFd = -1;
+	}
+	else {
+		printf("Could not start the server on %s.\n", address);
+	}
+
+	// Workers finish the connections already queued before they exit
+	if (server.queueLock != NULL) {
+		PlatformLockMutex(server.queueLock);
+		server.stopping = 1;
+		PlatformBroadcastCondition(server.queueReady);
+		PlatformUnlockMutex(server.queueLock);
+	}
+	for (int i = 0; i < started; i++) {
+		PlatformJoinThread(workers[i]);
+	}
+	while (server.connections != NULL) {
+		CloseConnection(&server, server.connections);
+	}
+
+	if (started > 0) {
+		printf("Served %lld requests on %lld connections.\n", server.requests, server.accepted);
+	}
+
+	if (server.listener >= 0) {
+		close(server.listener);
+		if (strncmp(address, SERVER_UNIX_PREFIX, strlen(SERVER_UNIX_PREFIX)) == 0) {
+			unlink(address + strlen(SERVER_UNIX_PREFIX));
+		}
+	}
+	if (server.epoll >= 0) {
+		close(server.epoll);
+	}
+	if (server.wakeup >= 0) {
+		close(server.wakeup);
+	}
+	free(workers);
+	free(server.queue);
+	PlatformDestroyMutex(server.registryLock);
+	PlatformDestroyCondition(server.queueReady);
+	PlatformDestroyMutex(server.queueLock);
+	PlatformDestroyReadWriteLock(server.storeLock);
+	return started > 0;
+}
+
+// Requests of the load generator, shared read-only by every connection
+typedef struct LoadCommands {
+	char** lines;                   // Commands, each ending with a newline
+	size_t* lengths;                // Length of every command, newline included
+	int count;                      // Number of commands
+} LoadCommands;
+
+typedef struct LoadConnection {
+	const char* address;            // Address of the server
+	const LoadCommands* commands;   // Commands to send
+	int first;                      // Command sent first
+	int requestCount;               // Requests to send
+	double* latencies;              // Latency of every request in seconds
+	int completed;                  // Requests that got a reply
+	int failed;                     // Replies starting with ERR
+} LoadConnection;
+
+static int ConnectTo(const char* address) {
+	struct sockaddr_storage storage;
+	socklen_t length;
+	if (!ResolveAddress(address, &storage, &length)) {
+		return -1;
+	}
+
+	int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	if (connect(fd, (struct sockaddr*)&storage, length) != 0) {
+		close(fd);
+		return -1;
+	}
+	if (storage.ss_family != AF_UNIX) {
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+	}
+	return fd;
+}
+
+static int SendAll(int fd, const char* data, size_t length) {
+	while (length > 0) {
+		ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+		data += sent;
+		length -= (size_t)sent;
+	}
+	return 1;
+}
+
+static int RunLoadConnection(void* argument) {
+	LoadConnection* load = (LoadConnection*)argument;
+	char buffer[COMMAND_REPLY_SIZE * 4];
+	size_t buffered = 0;
+
+	int fd = ConnectTo(load->address);
+	if (fd < 0) {
+		return 0;
+	}
+
+	for (int i = 0; i < load->requestCount; i++) {
+		int command = (load->first + i) % load->commands->count;
+		double started = PlatformGetTime();
+		if (!SendAll(fd, load->commands->lines[command], load->commands->lengths[command])) {
+			break;
+		}
+
+		// Read until the reply line is complete; the server never sends anything unasked
+		char* newline;
+		while ((newline = (char*)memchr(buffer, '\n', buffered)) == NULL) {
+			if (buffered == sizeof(buffer)) {
+				buffered = 0;
+			}
+			ssize_t received = recv(fd, buffer + buffered, sizeof(buffer) - buffered, 0);
+			if (received <= 0) {
+				if (received < 0 && errno == EINTR) {
+					continue;
+				}
+				close(fd);
+				return 0;
+			}
+			buffered += (size_t)received;
+		}
+		load->latencies[load->completed++] = PlatformGetTime() - started;
+		load->failed += strncmp(buffer, "ERR", 3) == 0;
+
+		size_t consumed = (size_t)(newline - buffer) + 1;
+		memmove(buffer, buffer + consumed, buffered - consumed);
+		buffered -= consumed;
+	}
+
+	close(fd);
+	return 1;
+}
+
+static int LoadCommandFile(const char* filename, LoadCommands* commands) {
+	CsvReader reader;
+	const char* line;
+	size_t length;
+	int capacity = 0;
+
+	memset(commands, 0, sizeof(LoadCommands));
+	if (!OpenCsvReader(&reader, filename)) {
+		return 0;
+	}
+	while (ReadCsvLine(&reader, &line, &length)) {
+		if (*line == '#') {
+			continue;
+		}
+		if (commands->count == capacity) {
+			capacity = capacity > 0 ? capacity * 2 : 256;
+			char** lines = (char**)realloc(commands->lines, capacity * sizeof(char*));
+			size_t* lengths = lines != NULL ? (size_t*)realloc(commands->lengths, capacity * sizeof(size_t)) : NULL;
+			if (lines != NULL) {
+				commands->lines = lines;
+			}
+			if (lengths == NULL) {
+				break;
+			}
+			commands->lengths = lengths;
+		}
+		char* copy = (char*)malloc(length + 1);
+		if (copy == NULL) {
+			break;
+		}
+		memcpy(copy, line, length);
+		copy[length] = '\n';
+		commands->lines[commands->count] = copy;
+		commands->lengths[commands->count++] = length + 1;
+	}
+	CloseCsvReader(&reader);
+	return commands->count > 0;
+}
+
+static int CompareLatencies(const void* a, const void* b) {
+	double first = *(const double*)a;
+	double second = *(const double*)b;
+	return (first > second) - (first < second);
+}
+
+int RunLoadGenerator(const char* address, const char* commandFile, int connectionCount, int requestCount) {
+	LoadCommands commands;
+	if (!LoadCommandFile(commandFile, &commands)) {
+		printf("Could not read any command from %s.\n", commandFile);
+		free(commands.lines);
+		free(commands.lengths);
+		return 0;
+	}
+	if (connectionCount < 1) {
+		connectionCount = 1;
+	}
+	if (requestCount < connectionCount) {
+		requestCount = connectionCount;
+	}
+
+	LoadConnection* loads = (LoadConnection*)calloc(connectionCount, sizeof(LoadConnection));
+	PlatformThread** threads = (PlatformThread**)calloc(connectionCount, sizeof(PlatformThread*));
+	double* latencies = (double*)malloc(requestCount * sizeof(double));
+	int ok = loads != NULL && threads != NULL && latencies != NULL;
+
+	// Every connection gets its share of the requests and its own slice of the latency array
+	int assigned = 0;
+	for (int i = 0; ok && i < connectionCount; i++) {
+		loads[i].address = address;
+		loads[i].commands = &commands;
+		loads[i].first = (int)((long long)commands.count * i / connectionCount);
+		loads[i].requestCount = requestCount / connectionCount + (i < requestCount % connectionCount);
+		loads[i].latencies = latencies + assigned;
+		assigned += loads[i].requestCount;
+	}
+
+	double started = PlatformGetTime();
+	int running = 0;
+	for (; ok && running < connectionCount; running++) {
+		threads[running] = PlatformStartThread(RunLoadConnection, &loads[running]);
+		if (threads[running] == NULL) {
+			ok = 0;
+			break;
+		}
+	}
+	int completed = 0;
+	int failed = 0;
+	for (int i = 0; i < running; i++) {
+		ok &= PlatformJoinThread(threads[i]);
+		// Pack the latencies so the completed ones are contiguous
+		memmove(latencies + completed, loads[i].latencies, loads[i].completed * sizeof(double));
+		completed += loads[i].completed;
+		failed += loads[i].failed;
+	}
+	double elapsed = PlatformGetTime() - started;
+
+	if (completed > 0) {
+		qsort(latencies, completed, sizeof(double), CompareLatencies);
+		printf("%d requests over %d connections in %.3f s: %.0f requests/s, %d ERR replies\n",
+			completed, running, elapsed, elapsed > 0 ? completed / elapsed : 0.0, failed);
+		printf("Latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+			latencies[(completed - 1) / 2] * 1e6,
+			latencies[(int)((completed - 1) * 0.9)] * 1e6,
+			latencies[(int)((completed - 1) * 0.99)] * 1e6,
+			latencies[(int)((completed - 1) * 0.999)] * 1e6,
+			latencies[completed - 1] * 1e6);
+	}
+	if (!ok || completed < requestCount) {
+		printf("Only %d of %d requests got a reply from %s.\n", completed, requestCount, address);
+		ok = 0;
+	}
+
+	for (int i = 0; i < commands.count; i++) {
+		free(commands.lines[i]);
+	}
+	free(commands.lines);
+	free(commands.lengths);
+	free(latencies);
+	free(threads);
+	free(loads);
+	return ok;
+}
+
+#else
+
+int RunServer(CommandContext* context, const char* address, int workerCount) {
+	(void)context;
+	(void)address;
+	(void)workerCount;
+	printf("The server uses epoll and is only available on Linux.\n");
+	return 0;
+}
+
+int RunLoadGenerator(const char* address, const char* commandFile, int connectionCount, int requestCount) {
+	(void)address;
+	(void)commandFile;
+	(void)connectionCount;
+	(void)requestCount;
+	printf("The load generator is only available on Linux.\n");
+	return 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ * @file   networkServer.h
+ * @brief  This file includes the network service that answers commands from other programs, and its load generator.
+ *
+ * Clients connect over TCP or a Unix socket and send the same one-line
+ * commands as the batch mode; every request gets one reply line, in order.
+ * A single thread waits on epoll for new connections and readable sockets
+ * and hands each ready connection to a fixed pool of worker threads, which
+ * read its requests, run them and write the replies without blocking. Every
+ * connection is armed one-shot, so only one worker serves it at a time.
+ * Queries run side by side under a shared lock on the stores, changes take it
+ * exclusively. The load generator replays a command file over several
+ * connections and prints the latency percentiles seen by the clients.
+ *
+ * The service uses epoll and is only built on Linux; elsewhere both entry
+ * points report that they are not available.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef NETWORK_SERVER_H
+#define NETWORK_SERVER_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "commandRunner.h"
+
+#define SERVER_DEFAULT_ADDRESS "7070"           /**< Address the server listens on when none is given. */
+#define SERVER_MAX_REQUEST 4096                 /**< Longest request line; a longer one closes the connection. */
+#define SERVER_MAX_PENDING_OUTPUT (256 * 1024)  /**< Replies buffered for a connection before its requests stop being read. */
+#define SERVER_MAX_EVENTS 256                   /**< Events taken from epoll at a time. */
+#define SERVER_UNIX_PREFIX "unix:"              /**< Prefix of the addresses of Unix sockets. */
+
+/**
+ * @brief Serves commands until the process receives SIGINT or SIGTERM.
+ *
+ * @param context The stores the commands run against.
+ * @param address "port", "host:port" or SERVER_UNIX_PREFIX followed by a socket path. A bare port listens on 127.0.0.1.
+ * @param workerCount The number of worker threads, 0 for one per processor.
+ * @return 1 after a clean shutdown, 0 if the server could not start.
+ */
+int RunServer(CommandContext* context, const char* address, int workerCount);
+
+/**
+ * @brief Sends the commands of a file to a server over several connections and prints the latency percentiles.
+ *
+ * Every connection sends one request, waits for its reply and sends the next,
+ * cycling through the commands from its own starting point.
+ *
+ * @param address The address of the server, in the form taken by RunServer.
+ * @param commandFile The file with one command per line.
+ * @param connectionCount The number of connections, each served by its own thread.
+ * @param requestCount The total number of requests sent.
+ * @return 1 if every request got a reply, 0 otherwise.
+ */
+int RunLoadGenerator(const char* address, const char* commandFile, int connectionCount, int requestCount);
+
+#endif  // NETWORK_SERVER_H
@@ -0,0 +1,135 @@
+#include "nifIndex.h"
+
+#define SLOT_EMPTY 0
+#define SLOT_USED 1
+#define SLOT_DELETED 2
+
+static unsigned int HashNif(const char* nif) {
+	unsigned int hash = 2166136261u;
+	for (int i = 0; i < NIF_INDEX_KEY_SIZE && nif[i] != '\0'; i++) {
+		hash ^= (unsigned char)nif[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static size_t FindSlot(const NifIndex* index, const char* nif, unsigned int hash) {
+	size_t mask = index->capacity - 1;
+	size_t slot = hash & mask;
+
+	while (index->entries[slot].state != SLOT_EMPTY) {
+		NifIndexEntry* entry = &index->entries[slot];
+		if (entry->state == SLOT_USED && entry->hash == hash &&
+			strncmp(entry->nif, nif, NIF_INDEX_KEY_SIZE) == 0) {
+			return slot;
+		}
+		slot = (slot + 1) & mask;
+	}
+	return index->capacity;
+}
+
+static int Resize(NifIndex* index, size_t newCapacity) {
+	NifIndexEntry* entries = (NifIndexEntry*)calloc(newCapacity, sizeof(NifIndexEntry));
+	if (entries == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < index->capacity; i++) {
+		NifIndexEntry* entry = &index->entries[i];
+		if (entry->state != SLOT_USED) {
+			continue;
+		}
+		size_t slot = entry->hash & (newCapacity - 1);
+		while (entries[slot].state != SLOT_EMPTY) {
+			slot = (slot + 1) & (newCapacity - 1);
+		}
+		entries[slot] = *entry;
+	}
+
+	free(index->entries);
+	index->entries = entries;
+	index->capacity = newCapacity;
+	index->tombstones = 0;
+	return 1;
+}
+
+int NifIndexInsert(NifIndex* index, const char* nif, void* value) {
+	// Keep the load factor (including tombstones) under 70%
+	if ((index->count + index->tombstones + 1) * 10 > index->capacity * 7) {
+		size_t newCapacity = index->capacity == 0 ? NIF_INDEX_MIN_CAPACITY : index->capacity;
+		while ((index->count + 1) * 10 > newCapacity * 5) {
+			newCapacity *= 2;
+		}
+		if (!Resize(index, newCapacity)) {
+			return 0;
+		}
+	}
+
+	unsigned int hash = HashNif(nif);
+	size_t mask = index->capacity - 1;
+	size_t slot = hash & mask;
+	size_t firstFree = index->capacity;
+
+	while (index->entries[slot].state != SLOT_EMPTY) {
+		NifIndexEntry* entry = &index->entries[slot];
+		if (entry->state == SLOT_DELETED) {
+			if (firstFree == index->capacity) {
+				firstFree = slot;
+			}
+		}
+		else if (entry->hash == hash && strncmp(entry->nif, nif, NIF_INDEX_KEY_SIZE) == 0) {
+			entry->value = value;
+			return 1;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	if (firstFree != index->capacity) {
+		slot = firstFree;
+		index->tombstones--;
+	}
+
+	NifIndexEntry* entry = &index->entries[slot];
+	memset(entry->nif, 0, NIF_INDEX_KEY_SIZE);
+	strncpy(entry->nif, nif, NIF_INDEX_KEY_SIZE - 1);
+	entry->state = SLOT_USED;
+	entry->hash = hash;
+	entry->value = value;
+	index->count++;
+	return 1;
+}
+
+void* NifIndexFind(const NifIndex* index, const char* nif) {
+	if (index->count == 0) {
+		return NULL;
+	}
+
+	size_t slot = FindSlot(index, nif, HashNif(nif));
+	return slot == index->capacity ? NULL : index->entries[slot].value;
+}
+
+void* NifIndexRemove(NifIndex* index, const char* nif) {
+	if (index->count == 0) {
+		return NULL;
+	}
+
+	size_t slot = FindSlot(index, nif, HashNif(nif));
+	if (slot == index->capacity) {
+		return NULL;
+	}
+
+	void* value = index->entries[slot].value;
+	index->entries[slot].state = SLOT_DELETED;
+	index->entries[slot].value = NULL;
+	index->count--;
+	index->tombstones++;
+	return value;
+}
+
+void NifIndexClear(NifIndex* index) {
+	free(index->entries);
+	index->entries = NULL;
+	index->capacity = 0;
+	index->count = 0;
+	index->tombstones = 0;
+}
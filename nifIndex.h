@@ -0,0 +1,78 @@
+/**
+ * @file   nifIndex.h
+ * @brief  This file includes an open-addressing hash index keyed on NIF.
+ *
+ * The index maps a fixed-size NIF to the node that holds it, so clients and
+ * managers can be found in constant time instead of walking their lists.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef NIF_INDEX_H
+#define NIF_INDEX_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define NIF_INDEX_KEY_SIZE 10        /**< Size of the NIF key, matches NIF_SIZE. */
+#define NIF_INDEX_MIN_CAPACITY 16    /**< Initial number of slots of the table. */
+
+/**
+ * @brief Slot of the hash index.
+ */
+typedef struct NifIndexEntry {
+	char nif[NIF_INDEX_KEY_SIZE];     /**< Key of the entry. */
+	unsigned char state;              /**< 0 when empty, 1 when used, 2 when deleted. */
+	unsigned int hash;                /**< Cached hash of the key. */
+	void* value;                      /**< Node associated with the key. */
+} NifIndexEntry;
+
+/**
+ * @brief Open-addressing hash table with linear probing.
+ */
+typedef struct NifIndex {
+	NifIndexEntry* entries;           /**< Slots of the table. */
+	size_t capacity;                  /**< Number of slots, always a power of two. */
+	size_t count;                     /**< Number of used slots. */
+	size_t tombstones;                /**< Number of deleted slots. */
+} NifIndex;
+
+/**
+ * @brief Inserts or replaces the value associated with a NIF.
+ *
+ * @param index The index.
+ * @param nif The NIF key.
+ * @param value The value to associate with the key.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int NifIndexInsert(NifIndex* index, const char* nif, void* value);
+
+/**
+ * @brief Finds the value associated with a NIF.
+ *
+ * @param index The index.
+ * @param nif The NIF key.
+ * @return The associated value. If not found, returns NULL.
+ */
+void* NifIndexFind(const NifIndex* index, const char* nif);
+
+/**
+ * @brief Removes a NIF from the index.
+ *
+ * @param index The index.
+ * @param nif The NIF key.
+ * @return The value that was associated with the key. If not found, returns NULL.
+ */
+void* NifIndexRemove(NifIndex* index, const char* nif);
+
+/**
+ * @brief Frees the memory used by the index and leaves it empty.
+ *
+ * @param index The index.
+ */
+void NifIndexClear(NifIndex* index);
+
+#endif  // NIF_INDEX_H
@@ -0,0 +1,117 @@
+#include "nodePool.h"
+#include "platform.h"
+
+#define SLAB_HEADER_SIZE ((sizeof(NodePoolSlab) + NODE_POOL_ALIGNMENT - 1) & ~(size_t)(NODE_POOL_ALIGNMENT - 1))
+
+static NodePool* registeredPools = NULL;
+static volatile long registryLock = 0;
+
+// Pools of different lists fill on different threads while the stores load; only the registry is shared
+static void LockRegistry(void) {
+	while (PlatformAtomicCompareExchange(&registryLock, 0, 1) != 0) {
+		PlatformSleep(0);
+	}
+}
+
+static void UnlockRegistry(void) {
+	PlatformAtomicCompareExchange(&registryLock, 1, 0);
+}
+
+static int AddSlab(NodePool* pool) {
+	size_t size = pool->nextSlabSize == 0 ? NODE_POOL_FIRST_SLAB : pool->nextSlabSize;
+	while (size < SLAB_HEADER_SIZE + pool->nodeSize) {
+		size *= 2;
+	}
+
+	NodePoolSlab* slab = (NodePoolSlab*)PlatformAllocatePages(size);
+	if (slab == NULL) {
+		return 0;
+	}
+
+	slab->next = pool->slabs;
+	slab->size = size;
+	pool->slabs = slab;
+	pool->cursor = (unsigned char*)slab + SLAB_HEADER_SIZE;
+	pool->limit = (unsigned char*)slab + size;
+	pool->nextSlabSize = size * 2 <= NODE_POOL_MAX_SLAB ? size * 2 : NODE_POOL_MAX_SLAB;
+
+	pool->stats.slabs++;
+	pool->stats.reservedBytes += size;
+
+	if (!pool->registered) {
+		LockRegistry();
+		pool->registered = 1;
+		pool->nextPool = registeredPools;
+		registeredPools = pool;
+		UnlockRegistry();
+	}
+	return 1;
+}
+
+void* PoolAlloc(NodePool* pool) {
+	void* node;
+
+	if (pool->freeList != NULL) {
+		node = pool->freeList;
+		pool->freeList = *(void**)node;
+		pool->stats.reusedNodes++;
+	}
+	else {
+		if (pool->cursor == NULL || (size_t)(pool->limit - pool->cursor) < pool->nodeSize) {
+			if (!AddSlab(pool)) {
+				return NULL;
+			}
+		}
+		node = pool->cursor;
+		pool->cursor += pool->nodeSize;
+	}
+
+	pool->stats.allocations++;
+	pool->stats.liveNodes++;
+	if (pool->stats.liveNodes > pool->stats.peakNodes) {
+		pool->stats.peakNodes = pool->stats.liveNodes;
+	}
+	return node;
+}
+
+void PoolFree(NodePool* pool, void* node) {
+	if (node == NULL) {
+		return;
+	}
+
+	*(void**)node = pool->freeList;
+	pool->freeList = node;
+	pool->stats.frees++;
+	pool->stats.liveNodes--;
+}
+
+void PoolRelease(NodePool* pool) {
+	NodePoolSlab* slab = pool->slabs;
+	while (slab != NULL) {
+		NodePoolSlab* next = slab->next;
+		PlatformFreePages(slab, slab->size);
+		slab = next;
+	}
+
+	pool->slabs = NULL;
+	pool->cursor = NULL;
+	pool->limit = NULL;
+	pool->freeList = NULL;
+	pool->nextSlabSize = 0;
+	pool->stats.liveNodes = 0;
+	pool->stats.slabs = 0;
+	pool->stats.reservedBytes = 0;
+}
+
+void PrintNodePoolStats(FILE* output) {
+	fprintf(output, "%-24s %12s %12s %12s %12s %8s %14s\n",
+		"Pool", "Live", "Peak", "Allocs", "Reused", "Slabs", "Reserved (B)");
+
+	LockRegistry();
+	for (NodePool* pool = registeredPools; pool != NULL; pool = pool->nextPool) {
+		fprintf(output, "%-24s %12zu %12zu %12zu %12zu %8zu %14zu\n",
+			pool->name, pool->stats.liveNodes, pool->stats.peakNodes, pool->stats.allocations,
+			pool->stats.reusedNodes, pool->stats.slabs, pool->stats.reservedBytes);
+	}
+	UnlockRegistry();
+}
@@ -0,0 +1,102 @@
+/**
+ * @file   nodePool.h
+ * @brief  This file includes the slab allocator used for the nodes of every linked list.
+ *
+ * Each entity type owns a pool of fixed-size nodes carved out of large slabs
+ * taken straight from the operating system. Freed nodes go to a per-pool free
+ * list and are reused first, and the whole pool is released at once, so
+ * tearing down millions of nodes costs one page release per slab. A pool
+ * belongs to one thread at a time; different pools may fill on different
+ * threads at once.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define NODE_POOL_ALIGNMENT 16              /**< Alignment of every node. */
+#define NODE_POOL_FIRST_SLAB (64 * 1024)    /**< Size in bytes of the first slab of a pool. */
+#define NODE_POOL_MAX_SLAB (64 * 1024 * 1024)  /**< Slabs double in size up to this limit. */
+
+/**
+ * @brief Declares the initial value of a pool for nodes of a given type.
+ */
+#define NODE_POOL_INITIALIZER(name, type) \
+	{ name, ((sizeof(type) + NODE_POOL_ALIGNMENT - 1) & ~(size_t)(NODE_POOL_ALIGNMENT - 1)), \
+		NULL, NULL, NULL, NULL, 0, 0, NULL, { 0, 0, 0, 0, 0, 0, 0 } }
+
+/**
+ * @brief Header at the start of every slab.
+ */
+typedef struct NodePoolSlab {
+	struct NodePoolSlab* next;      /**< Next slab of the pool. */
+	size_t size;                    /**< Size of the slab in bytes, header included. */
+} NodePoolSlab;
+
+/**
+ * @brief Allocation statistics of a pool.
+ */
+typedef struct NodePoolStats {
+	size_t liveNodes;               /**< Nodes currently allocated. */
+	size_t peakNodes;               /**< Highest number of nodes allocated at the same time. */
+	size_t allocations;             /**< Total number of allocations. */
+	size_t frees;                   /**< Total number of nodes returned to the free list. */
+	size_t reusedNodes;             /**< Allocations served from the free list. */
+	size_t slabs;                   /**< Number of slabs currently held. */
+	size_t reservedBytes;           /**< Bytes held in slabs. */
+} NodePoolStats;
+
+/**
+ * @brief Pool of fixed-size nodes.
+ */
+typedef struct NodePool {
+	const char* name;               /**< Name of the pool, used in reports. */
+	size_t nodeSize;                /**< Size of each node, rounded up to NODE_POOL_ALIGNMENT. */
+	NodePoolSlab* slabs;            /**< Slabs of the pool, most recent first. */
+	unsigned char* cursor;          /**< Next unused byte of the most recent slab. */
+	unsigned char* limit;           /**< End of the most recent slab. */
+	void* freeList;                 /**< Freed nodes, linked through their first bytes. */
+	size_t nextSlabSize;            /**< Size of the next slab to allocate. */
+	int registered;                 /**< 1 once the pool is in the list of PrintNodePoolStats. */
+	struct NodePool* nextPool;      /**< Next registered pool. */
+	NodePoolStats stats;            /**< Allocation statistics. */
+} NodePool;
+
+/**
+ * @brief Allocates a node from a pool.
+ *
+ * @param pool The pool.
+ * @return A pointer to the uninitialized node. If memory could not be allocated, returns NULL.
+ */
+void* PoolAlloc(NodePool* pool);
+
+/**
+ * @brief Returns a node to the free list of its pool.
+ *
+ * @param pool The pool the node was allocated from.
+ * @param node The node.
+ */
+void PoolFree(NodePool* pool, void* node);
+
+/**
+ * @brief Releases every node of a pool at once and returns its slabs to the operating system.
+ *
+ * @param pool The pool.
+ */
+void PoolRelease(NodePool* pool);
+
+/**
+ * @brief Prints the statistics of every pool that has allocated memory.
+ *
+ * @param output The stream to print to.
+ */
+void PrintNodePoolStats(FILE* output);
+
+#endif  // NODE_POOL_H
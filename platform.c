@@ -0,0 +1,709 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include "platform.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+static volatile PlatformThreadExitHandler threadExitHandler;
+
+void PlatformSetThreadExitHandler(PlatformThreadExitHandler handler) {
+	threadExitHandler = handler;
+}
+
+static void FinishThread(void) {
+	PlatformThreadExitHandler handler = threadExitHandler;
+	if (handler != NULL) {
+		handler();
+	}
+}
+
+#ifdef _WIN32
+
+int PlatformMapFile(const char* filename, PlatformFileMapping* mapping) {
+	memset(mapping, 0, sizeof(PlatformFileMapping));
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return 0;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return 0;
+	}
+
+	mapping->fileHandle = file;
+	mapping->size = (size_t)size.QuadPart;
+	if (mapping->size == 0) {
+		return 1;
+	}
+
+	HANDLE view = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (view == NULL) {
+		PlatformUnmapFile(mapping);
+		return 0;
+	}
+	mapping->mappingHandle = view;
+
+	mapping->data = (const unsigned char*)MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (mapping->data == NULL) {
+		PlatformUnmapFile(mapping);
+		return 0;
+	}
+	return 1;
+}
+
+void PlatformUnmapFile(PlatformFileMapping* mapping) {
+	if (mapping->data != NULL) {
+		UnmapViewOfFile(mapping->data);
+	}
+	if (mapping->mappingHandle != NULL) {
+		CloseHandle((HANDLE)mapping->mappingHandle);
+	}
+	if (mapping->fileHandle != NULL) {
+		CloseHandle((HANDLE)mapping->fileHandle);
+	}
+	memset(mapping, 0, sizeof(PlatformFileMapping));
+}
+
+int PlatformReplaceFile(const char* source, const char* target) {
+	return MoveFileExA(source, target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+int PlatformCreateDirectory(const char* path) {
+	return CreateDirectoryA(path, NULL) != 0 || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+int PlatformRemoveDirectory(const char* path) {
+	return RemoveDirectoryA(path) != 0;
+}
+
+void* PlatformAllocatePages(size_t size) {
+	return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void PlatformFreePages(void* pages, size_t size) {
+	(void)size;
+	VirtualFree(pages, 0, MEM_RELEASE);
+}
+
+int PlatformSyncFile(FILE* file) {
+	if (fflush(file) != 0) {
+		return 0;
+	}
+	return FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(file))) != 0;
+}
+
+int PlatformIsStream(FILE* file) {
+	return GetFileType((HANDLE)_get_osfhandle(_fileno(file))) != FILE_TYPE_DISK;
+}
+
+int PlatformWaitForInput(FILE* file, double seconds) {
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+	if (GetFileType(handle) != FILE_TYPE_PIPE) {
+		DWORD milliseconds = seconds < 0 || seconds > 86400.0 ? INFINITE : (DWORD)(seconds * 1000.0 + 0.999);
+		return WaitForSingleObject(handle, milliseconds) != WAIT_TIMEOUT;
+	}
+
+	// Pipes cannot be waited on, so they are polled; a pipe whose writer left reads as its end
+	double deadline = PlatformGetTime() + seconds;
+	for (;;) {
+		DWORD available = 0;
+		if (!PeekNamedPipe(handle, NULL, 0, NULL, &available, NULL) || available > 0) {
+			return 1;
+		}
+		if (seconds >= 0 && PlatformGetTime() >= deadline) {
+			return 0;
+		}
+		Sleep(1);
+	}
+}
+
+size_t PlatformReadStream(FILE* file, void* buffer, size_t size) {
+	int bytes = _read(_fileno(file), buffer, size > (1u << 30) ? (1u << 30) : (unsigned int)size);
+	return bytes > 0 ? (size_t)bytes : 0;
+}
+
+int PlatformCreatePipe(FILE** readEnd, FILE** writeEnd) {
+	int ends[2];
+	if (_pipe(ends, 64 * 1024, _O_BINARY) != 0) {
+		return 0;
+	}
+	*readEnd = _fdopen(ends[0], "rb");
+	*writeEnd = _fdopen(ends[1], "wb");
+	if (*readEnd == NULL || *writeEnd == NULL) {
+		if (*readEnd != NULL) {
+			fclose(*readEnd);
+		}
+		else {
+			_close(ends[0]);
+		}
+		if (*writeEnd != NULL) {
+			fclose(*writeEnd);
+		}
+		else {
+			_close(ends[1]);
+		}
+		return 0;
+	}
+	return 1;
+}
+
+struct PlatformThread {
+	HANDLE handle;
+	PlatformThreadEntry entry;
+	void* argument;
+	int result;
+};
+
+struct PlatformMutex {
+	SRWLOCK lock;
+};
+
+struct PlatformCondition {
+	CONDITION_VARIABLE variable;
+};
+
+struct PlatformReadWriteLock {
+	SRWLOCK lock;
+};
+
+static DWORD WINAPI RunThread(LPVOID parameter) {
+	PlatformThread* thread = (PlatformThread*)parameter;
+	thread->result = thread->entry(thread->argument);
+	FinishThread();
+	return 0;
+}
+
+PlatformThread* PlatformStartThread(PlatformThreadEntry entry, void* argument) {
+	PlatformThread* thread = (PlatformThread*)calloc(1, sizeof(PlatformThread));
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	thread->entry = entry;
+	thread->argument = argument;
+	thread->handle = CreateThread(NULL, 0, RunThread, thread, 0, NULL);
+	if (thread->handle == NULL) {
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+int PlatformJoinThread(PlatformThread* thread) {
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+
+	int result = thread->result;
+	free(thread);
+	return result;
+}
+
+PlatformMutex* PlatformCreateMutex(void) {
+	PlatformMutex* mutex = (PlatformMutex*)malloc(sizeof(PlatformMutex));
+	if (mutex != NULL) {
+		InitializeSRWLock(&mutex->lock);
+	}
+	return mutex;
+}
+
+void PlatformDestroyMutex(PlatformMutex* mutex) {
+	free(mutex);
+}
+
+void PlatformLockMutex(PlatformMutex* mutex) {
+	AcquireSRWLockExclusive(&mutex->lock);
+}
+
+void PlatformUnlockMutex(PlatformMutex* mutex) {
+	ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+PlatformCondition* PlatformCreateCondition(void) {
+	PlatformCondition* condition = (PlatformCondition*)malloc(sizeof(PlatformCondition));
+	if (condition != NULL) {
+		InitializeConditionVariable(&condition->variable);
+	}
+	return condition;
+}
+
+void PlatformDestroyCondition(PlatformCondition* condition) {
+	free(condition);
+}
+
+void PlatformWaitCondition(PlatformCondition* condition, PlatformMutex* mutex) {
+	SleepConditionVariableSRW(&condition->variable, &mutex->lock, INFINITE, 0);
+}
+
+void PlatformSignalCondition(PlatformCondition* condition) {
+	WakeConditionVariable(&condition->variable);
+}
+
+void PlatformBroadcastCondition(PlatformCondition* condition) {
+	WakeAllConditionVariable(&condition->variable);
+}
+
+PlatformReadWriteLock* PlatformCreateReadWriteLock(void) {
+	PlatformReadWriteLock* lock = (PlatformReadWriteLock*)malloc(sizeof(PlatformReadWriteLock));
+	if (lock != NULL) {
+		InitializeSRWLock(&lock->lock);
+	}
+	return lock;
+}
+
+void PlatformDestroyReadWriteLock(PlatformReadWriteLock* lock) {
+	free(lock);
+}
+
+void PlatformLockShared(PlatformReadWriteLock* lock) {
+	AcquireSRWLockShared(&lock->lock);
+}
+
+void PlatformUnlockShared(PlatformReadWriteLock* lock) {
+	ReleaseSRWLockShared(&lock->lock);
+}
+
+void PlatformLockExclusive(PlatformReadWriteLock* lock) {
+	AcquireSRWLockExclusive(&lock->lock);
+}
+
+void PlatformUnlockExclusive(PlatformReadWriteLock* lock) {
+	ReleaseSRWLockExclusive(&lock->lock);
+}
+
+long PlatformAtomicCompareExchange(volatile long* target, long expected, long desired) {
+	return InterlockedCompareExchange(target, desired, expected);
+}
+
+long long PlatformAtomicCompareExchange64(volatile long long* target, long long expected, long long desired) {
+	return InterlockedCompareExchange64(target, desired, expected);
+}
+
+long PlatformAtomicAdd(volatile long* target, long value) {
+	return InterlockedExchangeAdd(target, value) + value;
+}
+
+long long PlatformAtomicAdd64(volatile long long* target, long long value) {
+	return InterlockedExchangeAdd64(target, value) + value;
+}
+
+long long PlatformAtomicLoad64(volatile long long* target) {
+	// Aligned 64-bit reads are atomic on x64; the CAS keeps 32-bit builds correct
+	return InterlockedCompareExchange64(target, 0, 0);
+}
+
+void* PlatformAtomicLoadPointer(void* volatile* target) {
+	return ReadPointerAcquire((PVOID const volatile*)target);
+}
+
+void* PlatformAtomicCompareExchangePointer(void* volatile* target, void* expected, void* desired) {
+	return InterlockedCompareExchangePointer(target, desired, expected);
+}
+
+double PlatformGetTime(void) {
+	static LARGE_INTEGER frequency;
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+}
+
+void PlatformSleep(int milliseconds) {
+	Sleep((DWORD)milliseconds);
+}
+
+int PlatformGetProcessorCount(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+int PlatformMapFile(const char* filename, PlatformFileMapping* mapping) {
+	memset(mapping, 0, sizeof(PlatformFileMapping));
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return 0;
+	}
+
+	// The descriptor is stored biased by one so that a zeroed mapping means "no file"
+	mapping->fileHandle = (void*)(intptr_t)(fd + 1);
+	mapping->size = (size_t)info.st_size;
+	if (mapping->size == 0) {
+		return 1;
+	}
+
+	void* data = mmap(NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		PlatformUnmapFile(mapping);
+		return 0;
+	}
+	mapping->data = (const unsigned char*)data;
+	return 1;
+}
+
+void PlatformUnmapFile(PlatformFileMapping* mapping) {
+	if (mapping->data != NULL) {
+		munmap((void*)mapping->data, mapping->size);
+	}
+	if (mapping->fileHandle != NULL) {
+		close((int)(intptr_t)mapping->fileHandle - 1);
+	}
+	memset(mapping, 0, sizeof(PlatformFileMapping));
+}
+
+int PlatformReplaceFile(const char* source, const char* target) {
+	return rename(source, target) == 0;
+}
+
+int PlatformCreateDirectory(const char* path) {
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+int PlatformRemoveDirectory(const char* path) {
+	return rmdir(path) == 0;
+}
+
+void* PlatformAllocatePages(size_t size) {
+	void* pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return pages == MAP_FAILED ? NULL : pages;
+}
+
+void PlatformFreePages(void* pages, size_t size) {
+	munmap(pages, size);
+}
+
+int PlatformSyncFile(FILE* file) {
+	if (fflush(file) != 0) {
+		return 0;
+	}
+	return fsync(fileno(file)) == 0;
+}
+
+int PlatformIsStream(FILE* file) {
+	struct stat status;
+	return fstat(fileno(file), &status) != 0 || !S_ISREG(status.st_mode);
+}
+
+int PlatformWaitForInput(FILE* file, double seconds) {
+	struct pollfd request = { fileno(file), POLLIN, 0 };
+	int milliseconds = seconds < 0 || seconds > 86400.0 ? -1 : (int)(seconds * 1000.0 + 0.999);
+	int ready;
+	do {
+		ready = poll(&request, 1, milliseconds);
+	} while (ready < 0 && errno == EINTR);
+	// Errors are left for the read to report
+	return ready != 0;
+}
+
+size_t PlatformReadStream(FILE* file, void* buffer, size_t size) {
+	ssize_t bytes;
+	do {
+		bytes = read(fileno(file), buffer, size);
+	} while (bytes < 0 && errno == EINTR);
+	return bytes > 0 ? (size_t)bytes : 0;
+}
+
+int PlatformCreatePipe(FILE** readEnd, FILE** writeEnd) {
+	int ends[2];
+	if (pipe(ends) != 0) {
+		return 0;
+	}
+	*readEnd = fdopen(ends[0], "rb");
+	*writeEnd = fdopen(ends[1], "wb");
+	if (*readEnd == NULL || *writeEnd == NULL) {
+		if (*readEnd != NULL) {
+			fclose(*readEnd);
+		}
+		else {
+			close(ends[0]);
+		}
+		if (*writeEnd != NULL) {
+			fclose(*writeEnd);
+		}
+		else {
+			close(ends[1]);
+		}
+		return 0;
+	}
+	return 1;
+}
+
+struct PlatformThread {
+	pthread_t handle;
+	PlatformThreadEntry entry;
+	void* argument;
+	int result;
+};
+
+struct PlatformMutex {
+	pthread_mutex_t lock;
+};
+
+struct PlatformCondition {
+	pthread_cond_t variable;
+};
+
+struct PlatformReadWriteLock {
+	pthread_rwlock_t lock;
+};
+
+static void* RunThread(void* parameter) {
+	PlatformThread* thread = (PlatformThread*)parameter;
+	thread->result = thread->entry(thread->argument);
+	FinishThread();
+	return NULL;
+}
+
+PlatformThread* PlatformStartThread(PlatformThreadEntry entry, void* argument) {
+	PlatformThread* thread = (PlatformThread*)calloc(1, sizeof(PlatformThread));
+	if (thread == NULL) {
+		return NULL;
+	}
+
+	thread->entry = entry;
+	thread->argument = argument;
+	if (pthread_create(&thread->handle, NULL, RunThread, thread) != 0) {
+		free(thread);
+		return NULL;
+	}
+	return thread;
+}
+
+int PlatformJoinThread(PlatformThread* thread) {
+	pthread_join(thread->handle, NULL);
+
+	int result = thread->result;
+	free(thread);
+	return result;
+}
+
+PlatformMutex* PlatformCreateMutex(void) {
+	PlatformMutex* mutex = (PlatformMutex*)malloc(sizeof(PlatformMutex));
+	if (mutex != NULL && pthread_mutex_init(&mutex->lock, NULL) != 0) {
+		free(mutex);
+		return NULL;
+	}
+	return mutex;
+}
+
+void PlatformDestroyMutex(PlatformMutex* mutex) {
+	if (mutex != NULL) {
+		pthread_mutex_destroy(&mutex->lock);
+		free(mutex);
+	}
+}
+
+void PlatformLockMutex(PlatformMutex* mutex) {
+	pthread_mutex_lock(&mutex->lock);
+}
+
+void PlatformUnlockMutex(PlatformMutex* mutex) {
+	pthread_mutex_unlock(&mutex->lock);
+}
+
+PlatformCondition* PlatformCreateCondition(void) {
+	PlatformCondition* condition = (PlatformCondition*)malloc(sizeof(PlatformCondition));
+	if (condition != NULL && pthread_cond_init(&condition->variable, NULL) != 0) {
+		free(condition);
+		return NULL;
+	}
+	return condition;
+}
+
+void PlatformDestroyCondition(PlatformCondition* condition) {
+	if (condition != NULL) {
+		pthread_cond_destroy(&condition->variable);
+		free(condition);
+	}
+}
+
+void PlatformWaitCondition(PlatformCondition* condition, PlatformMutex* mutex) {
+	pthread_cond_wait(&condition->variable, &mutex->lock);
+}
+
+void PlatformSignalCondition(PlatformCondition* condition) {
+	pthread_cond_signal(&condition->variable);
+}
+
+void PlatformBroadcastCondition(PlatformCondition* condition) {
+	pthread_cond_broadcast(&condition->variable);
+}
+
+PlatformReadWriteLock* PlatformCreateReadWriteLock(void) {
+	PlatformReadWriteLock* lock = (PlatformReadWriteLock*)malloc(sizeof(PlatformReadWriteLock));
+	if (lock != NULL && pthread_rwlock_init(&lock->lock, NULL) != 0) {
+		free(lock);
+		return NULL;
+	}
+	return lock;
+}
+
+void PlatformDestroyReadWriteLock(PlatformReadWriteLock* lock) {
+	if (lock != NULL) {
+		pthread_rwlock_destroy(&lock->lock);
+		free(lock);
+	}
+}
+
+void PlatformLockShared(PlatformReadWriteLock* lock) {
+	pthread_rwlock_rdlock(&lock->lock);
+}
+
+void PlatformUnlockShared(PlatformReadWriteLock* lock) {
+	pthread_rwlock_unlock(&lock->lock);
+}
+
+void PlatformLockExclusive(PlatformReadWriteLock* lock) {
+	pthread_rwlock_wrlock(&lock->lock);
+}
+
+void PlatformUnlockExclusive(PlatformReadWriteLock* lock) {
+	pthread_rwlock_unlock(&lock->lock);
+}
+
+long PlatformAtomicCompareExchange(volatile long* target, long expected, long desired) {
+	__atomic_compare_exchange_n(target, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+
+long long PlatformAtomicCompareExchange64(volatile long long* target, long long expected, long long desired) {
+	__atomic_compare_exchange_n(target, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+
+long PlatformAtomicAdd(volatile long* target, long value) {
+	return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+}
+
+long long PlatformAtomicAdd64(volatile long long* target, long long value) {
+	return __atomic_add_fetch(target, value, __ATOMIC_SEQ_CST);
+}
+
+long long PlatformAtomicLoad64(volatile long long* target) {
+	return __atomic_load_n(target, __ATOMIC_SEQ_CST);
+}
+
+void* PlatformAtomicLoadPointer(void* volatile* target) {
+	return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+}
+
+void* PlatformAtomicCompareExchangePointer(void* volatile* target, void* expected, void* desired) {
+	__atomic_compare_exchange_n(target, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return expected;
+}
+
+double PlatformGetTime(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
+void PlatformSleep(int milliseconds) {
+	struct timespec duration;
+	duration.tv_sec = milliseconds / 1000;
+	duration.tv_nsec = (long)(milliseconds % 1000) * 1000000L;
+	while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+	}
+}
+
+int PlatformGetProcessorCount(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int)count : 1;
+}
+
+#endif
+
+typedef struct ParallelLoop {
+	int count;
+	int stride;
+	int first;
+	PlatformLoopBody body;
+	void* context;
+} ParallelLoop;
+
+static int RunLoopShare(void* argument) {
+	ParallelLoop* share = (ParallelLoop*)argument;
+	for (int index = share->first; index < share->count; index += share->stride) {
+		share->body(index, share->context);
+	}
+	return 0;
+}
+
+void PlatformParallelFor(int count, PlatformLoopBody body, void* context) {
+	int threads = PlatformGetProcessorCount();
+	if (threads > count) {
+		threads = count;
+	}
+	if (threads <= 1) {
+		for (int index = 0; index < count; index++) {
+			body(index, context);
+		}
+		return;
+	}
+
+	ParallelLoop* shares = (ParallelLoop*)malloc(threads * sizeof(ParallelLoop));
+	PlatformThread** workers = (PlatformThread**)calloc(threads, sizeof(PlatformThread*));
+	if (shares == NULL || workers == NULL) {
+		free(shares);
+		free(workers);
+		for (int index = 0; index < count; index++) {
+			body(index, context);
+		}
+		return;
+	}
+
+	for (int t = 0; t < threads; t++) {
+		shares[t].count = count;
+		shares[t].stride = threads;
+		shares[t].first = t;
+		shares[t].body = body;
+		shares[t].context = context;
+	}
+
+	// Share 0 runs on the calling thread, as do the shares of workers that could not be started
+	for (int t = 1; t < threads; t++) {
+		workers[t] = PlatformStartThread(RunLoopShare, &shares[t]);
+	}
+	RunLoopShare(&shares[0]);
+	for (int t = 1; t < threads; t++) {
+		if (workers[t] != NULL) {
+			PlatformJoinThread(workers[t]);
+		}
+		else {
+			RunLoopShare(&shares[t]);
+		}
+	}
+
+	free(shares);
+	free(workers);
+}
@@ -0,0 +1,407 @@
+/**
+ * @file   platform.h
+ * @brief  This file includes the operating system services used by the storage layer.
+ *
+ * Windows and POSIX implementations live side by side in platform.c so the
+ * rest of the code never includes system headers directly.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#define PLATFORM_THREAD_LOCAL __declspec(thread)    /**< Gives every thread its own copy of a static variable. */
+#define PLATFORM_PREFETCH(address) _mm_prefetch((const char*)(address), _MM_HINT_T0)  /**< Starts loading a cache line that is read soon. */
+#else
+#define PLATFORM_THREAD_LOCAL __thread              /**< Gives every thread its own copy of a static variable. */
+#define PLATFORM_PREFETCH(address) __builtin_prefetch(address)                    /**< Starts loading a cache line that is read soon. */
+#endif
+
+/**
+ * @brief Read-only view of a whole file mapped into memory.
+ */
+typedef struct PlatformFileMapping {
+	const unsigned char* data;      /**< First byte of the file, NULL for empty files. */
+	size_t size;                    /**< Size of the file in bytes. */
+	void* fileHandle;               /**< Operating system handle of the file. */
+	void* mappingHandle;            /**< Operating system handle of the mapping (Windows only). */
+} PlatformFileMapping;
+
+/**
+ * @brief Maps a file into memory for reading.
+ *
+ * @param filename The name of the file.
+ * @param mapping The mapping to fill.
+ * @return 1 on success, 0 if the file could not be opened or mapped.
+ */
+int PlatformMapFile(const char* filename, PlatformFileMapping* mapping);
+
+/**
+ * @brief Unmaps a file mapped with PlatformMapFile.
+ *
+ * @param mapping The mapping.
+ */
+void PlatformUnmapFile(PlatformFileMapping* mapping);
+
+/**
+ * @brief Atomically replaces a file with another one.
+ *
+ * @param source The name of the new file.
+ * @param target The name of the file to replace.
+ * @return 1 on success, 0 on failure.
+ */
+int PlatformReplaceFile(const char* source, const char* target);
+
+/**
+ * @brief Creates a directory unless it already exists.
+ *
+ * @param path The name of the directory; its parent must exist.
+ * @return 1 if the directory exists afterwards, 0 otherwise.
+ */
+int PlatformCreateDirectory(const char* path);
+
+/**
+ * @brief Removes a directory if it is empty.
+ *
+ * @param path The name of the directory.
+ * @return 1 if the directory was removed, 0 otherwise.
+ */
+int PlatformRemoveDirectory(const char* path);
+
+/**
+ * @brief Allocates zeroed memory pages directly from the operating system.
+ *
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the pages. If they could not be allocated, returns NULL.
+ */
+void* PlatformAllocatePages(size_t size);
+
+/**
+ * @brief Returns pages allocated with PlatformAllocatePages to the operating system.
+ *
+ * @param pages The pages.
+ * @param size The number of bytes that were allocated.
+ */
+void PlatformFreePages(void* pages, size_t size);
+
+/**
+ * @brief Flushes a file and waits until its contents reach the disk.
+ *
+ * @param file The file.
+ * @return 1 on success, 0 on failure.
+ */
+int PlatformSyncFile(FILE* file);
+
+/**
+ * @brief Tells whether a file is a pipe, socket or terminal rather than a file on disk.
+ *
+ * @param file The file.
+ * @return 1 for a stream whose bytes arrive over time, 0 for a file on disk.
+ */
+int PlatformIsStream(FILE* file);
+
+/**
+ * @brief Waits until a stream has bytes to read or was closed by its writer.
+ *
+ * @param file The stream, only ever read with PlatformReadStream.
+ * @param seconds Longest wait, negative to wait for ever.
+ * @return 1 if a read would not block, 0 if the wait timed out.
+ */
+int PlatformWaitForInput(FILE* file, double seconds);
+
+/**
+ * @brief Reads the bytes a stream has, waiting only while it has none.
+ *
+ * Bypasses the buffer of the FILE, so a stream must not be read with both.
+ *
+ * @param file The stream.
+ * @param buffer Receives the bytes.
+ * @param size The size of the buffer.
+ * @return The number of bytes read, 0 at the end of the stream or on an error.
+ */
+size_t PlatformReadStream(FILE* file, void* buffer, size_t size);
+
+/**
+ * @brief Creates an anonymous pipe.
+ *
+ * @param readEnd Receives the end to read from.
+ * @param writeEnd Receives the end to write to.
+ * @return 1 on success, 0 on failure.
+ */
+int PlatformCreatePipe(FILE** readEnd, FILE** writeEnd);
+
+/**
+ * @brief Thread started with PlatformStartThread.
+ */
+typedef struct PlatformThread PlatformThread;
+
+/**
+ * @brief Mutual exclusion lock.
+ */
+typedef struct PlatformMutex PlatformMutex;
+
+/**
+ * @brief Condition variable used together with a PlatformMutex.
+ */
+typedef struct PlatformCondition PlatformCondition;
+
+/**
+ * @brief Lock held either by many readers at once or by a single writer.
+ */
+typedef struct PlatformReadWriteLock PlatformReadWriteLock;
+
+/**
+ * @brief Function run by a thread.
+ */
+typedef int (*PlatformThreadEntry)(void* argument);
+
+/**
+ * @brief Function run on a thread that is about to finish.
+ */
+typedef void (*PlatformThreadExitHandler)(void);
+
+/**
+ * @brief Sets the function run by every thread started with PlatformStartThread once its entry returns.
+ *
+ * @param handler The function, or NULL for none.
+ */
+void PlatformSetThreadExitHandler(PlatformThreadExitHandler handler);
+
+/**
+ * @brief Starts a new thread.
+ *
+ * @param entry The function the thread runs.
+ * @param argument The argument passed to entry.
+ * @return The new thread. If it could not be started, returns NULL.
+ */
+PlatformThread* PlatformStartThread(PlatformThreadEntry entry, void* argument);
+
+/**
+ * @brief Waits for a thread to finish and releases it.
+ *
+ * @param thread The thread.
+ * @return The value returned by the entry function of the thread.
+ */
+int PlatformJoinThread(PlatformThread* thread);
+
+/**
+ * @brief Creates a mutex.
+ *
+ * @return The new mutex. If it could not be created, returns NULL.
+ */
+PlatformMutex* PlatformCreateMutex(void);
+
+/**
+ * @brief Destroys a mutex.
+ *
+ * @param mutex The mutex, which must not be locked.
+ */
+void PlatformDestroyMutex(PlatformMutex* mutex);
+
+/**
+ * @brief Locks a mutex, waiting until it is available.
+ *
+ * @param mutex The mutex.
+ */
+void PlatformLockMutex(PlatformMutex* mutex);
+
+/**
+ * @brief Unlocks a mutex locked by the calling thread.
+ *
+ * @param mutex The mutex.
+ */
+void PlatformUnlockMutex(PlatformMutex* mutex);
+
+/**
+ * @brief Creates a condition variable.
+ *
+ * @return The new condition variable. If it could not be created, returns NULL.
+ */
+PlatformCondition* PlatformCreateCondition(void);
+
+/**
+ * @brief Destroys a condition variable.
+ *
+ * @param condition The condition variable, which must have no waiters.
+ */
+void PlatformDestroyCondition(PlatformCondition* condition);
+
+/**
+ * @brief Unlocks a mutex, waits for the condition to be signaled and locks the mutex again.
+ *
+ * Wake-ups may be spurious, so callers must wait in a loop that checks their predicate.
+ *
+ * @param condition The condition variable.
+ * @param mutex The mutex, locked by the calling thread.
+ */
+void PlatformWaitCondition(PlatformCondition* condition, PlatformMutex* mutex);
+
+/**
+ * @brief Wakes up one thread waiting on a condition variable.
+ *
+ * @param condition The condition variable.
+ */
+void PlatformSignalCondition(PlatformCondition* condition);
+
+/**
+ * @brief Wakes up every thread waiting on a condition variable.
+ *
+ * @param condition The condition variable.
+ */
+void PlatformBroadcastCondition(PlatformCondition* condition);
+
+/**
+ * @brief Creates a read-write lock.
+ *
+ * @return The new lock. If it could not be created, returns NULL.
+ */
+PlatformReadWriteLock* PlatformCreateReadWriteLock(void);
+
+/**
+ * @brief Destroys a read-write lock.
+ *
+ * @param lock The lock, which must not be held.
+ */
+void PlatformDestroyReadWriteLock(PlatformReadWriteLock* lock);
+
+/**
+ * @brief Takes a read-write lock for reading, waiting while a writer holds it.
+ *
+ * @param lock The lock.
+ */
+void PlatformLockShared(PlatformReadWriteLock* lock);
+
+/**
+ * @brief Releases a read-write lock taken for reading by the calling thread.
+ *
+ * @param lock The lock.
+ */
+void PlatformUnlockShared(PlatformReadWriteLock* lock);
+
+/**
+ * @brief Takes a read-write lock for writing, waiting until no other thread holds it.
+ *
+ * @param lock The lock.
+ */
+void PlatformLockExclusive(PlatformReadWriteLock* lock);
+
+/**
+ * @brief Releases a read-write lock taken for writing by the calling thread.
+ *
+ * @param lock The lock.
+ */
+void PlatformUnlockExclusive(PlatformReadWriteLock* lock);
+
+/**
+ * @brief Atomically replaces a value if it still holds the expected one.
+ *
+ * @param target The value, aligned to its size.
+ * @param expected The value target must hold.
+ * @param desired The new value.
+ * @return The value target held before the call; the swap happened if it equals expected.
+ */
+long PlatformAtomicCompareExchange(volatile long* target, long expected, long desired);
+
+/**
+ * @brief 64-bit version of PlatformAtomicCompareExchange.
+ *
+ * @param target The value, aligned to 8 bytes.
+ * @param expected The value target must hold.
+ * @param desired The new value.
+ * @return The value target held before the call.
+ */
+long long PlatformAtomicCompareExchange64(volatile long long* target, long long expected, long long desired);
+
+/**
+ * @brief Atomically adds to a value.
+ *
+ * @param target The value.
+ * @param value The amount to add.
+ * @return The new value.
+ */
+long PlatformAtomicAdd(volatile long* target, long value);
+
+/**
+ * @brief 64-bit version of PlatformAtomicAdd.
+ *
+ * @param target The value, aligned to 8 bytes.
+ * @param value The amount to add.
+ * @return The new value.
+ */
+long long PlatformAtomicAdd64(volatile long long* target, long long value);
+
+/**
+ * @brief Atomically reads a 64-bit value.
+ *
+ * @param target The value, aligned to 8 bytes.
+ * @return The value.
+ */
+long long PlatformAtomicLoad64(volatile long long* target);
+
+/**
+ * @brief Reads a pointer with acquire ordering, without writing to its cache line.
+ *
+ * @param target The pointer.
+ * @return The pointer.
+ */
+void* PlatformAtomicLoadPointer(void* volatile* target);
+
+/**
+ * @brief Pointer version of PlatformAtomicCompareExchange.
+ *
+ * @param target The pointer.
+ * @param expected The pointer target must hold.
+ * @param desired The new pointer.
+ * @return The pointer target held before the call.
+ */
+void* PlatformAtomicCompareExchangePointer(void* volatile* target, void* expected, void* desired);
+
+/**
+ * @brief Reads a monotonic clock.
+ *
+ * @return Seconds since an arbitrary fixed point, only meaningful as a difference.
+ */
+double PlatformGetTime(void);
+
+/**
+ * @brief Suspends the calling thread.
+ *
+ * @param milliseconds The time to sleep.
+ */
+void PlatformSleep(int milliseconds);
+
+/**
+ * @brief Function run for every index of PlatformParallelFor.
+ */
+typedef void (*PlatformLoopBody)(int index, void* context);
+
+/**
+ * @brief Gets the number of processors available to the program.
+ *
+ * @return The number of processors, at least 1.
+ */
+int PlatformGetProcessorCount(void);
+
+/**
+ * @brief Runs a loop body for every index in [0, count) on all processors.
+ *
+ * Indices are dealt out round-robin, one thread per processor, and the
+ * calling thread takes part. Returns once every index has run. If no thread
+ * can be started, the whole loop runs on the calling thread.
+ *
+ * @param count The number of indices.
+ * @param body The function run for every index; calls must be independent of each other.
+ * @param context Context passed to body.
+ */
+void PlatformParallelFor(int count, PlatformLoopBody body, void* context);
+
+#endif  // PLATFORM_H
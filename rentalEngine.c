@@ -0,0 +1,527 @@
+#include "rentalEngine.h"
+#include "dataStore.h"
+
+#define RENTAL_STATE_MASK ((1L << RENTAL_STATE_BITS) - 1)
+
+static long StateWord(int account, RentalState state) {
+	return ((long)account << RENTAL_STATE_BITS) | state;
+}
+
+static long long ToCents(double amount) {
+	return (long long)(amount * 100.0 + (amount < 0 ? -0.5 : 0.5));
+}
+
+// Grows the slot arrays to hold a vehicle handle; new slots cannot be rented until a vehicle is set in them
+static int ReserveRentalVehicles(RentalEngine* engine, int vehicleCount) {
+	if (vehicleCount > engine->vehicleCapacity) {
+		int capacity = engine->vehicleCapacity > 0 ? engine->vehicleCapacity : 64;
+		while (capacity < vehicleCount) {
+			capacity *= 2;
+		}
+		volatile long* states = (volatile long*)realloc((void*)engine->states, capacity * sizeof(long));
+		if (states == NULL) {
+			return 0;
+		}
+		engine->states = states;
+		long long* fares = (long long*)realloc(engine->fares, capacity * sizeof(long long));
+		if (fares == NULL) {
+			return 0;
+		}
+		engine->fares = fares;
+		long long* paid = (long long*)realloc(engine->paid, capacity * sizeof(long long));
+		if (paid == NULL) {
+			return 0;
+		}
+		engine->paid = paid;
+		engine->vehicleCapacity = capacity;
+	}
+	for (int handle = engine->vehicleCount; handle < vehicleCount; handle++) {
+		engine->states[handle] = RentalAvailable;
+		engine->fares[handle] = RENTAL_NOT_RENTABLE;
+		engine->paid[handle] = 0;
+	}
+	if (vehicleCount > engine->vehicleCount) {
+		engine->vehicleCount = vehicleCount;
+	}
+	return 1;
+}
+
+static int ReserveRentalAccounts(RentalEngine* engine, int accountCount) {
+	if (accountCount <= engine->accountCapacity) {
+		return 1;
+	}
+	int capacity = engine->accountCapacity > 0 ? engine->accountCapacity : 64;
+	while (capacity < accountCount) {
+		capacity *= 2;
+	}
+	RentalAccount* accounts = (RentalAccount*)realloc(engine->accounts, capacity * sizeof(RentalAccount));
+	if (accounts == NULL) {
+		return 0;
+	}
+	engine->accounts = accounts;
+	engine->accountCapacity = capacity;
+	return 1;
+}
+
+RentalEngine* CreateRentalEngine(const MobilityTable* vehicles, ClientNode* clients) {
+	int accountCount = 0;
+	for (ClientNode* current = clients; current != NULL; current = current->next) {
+		accountCount++;
+	}
+
+	RentalEngine* engine = (RentalEngine*)calloc(1, sizeof(RentalEngine));
+	if (engine == NULL) {
+		return NULL;
+	}
+	if (!ReserveRentalVehicles(engine, vehicles != NULL ? vehicles->slotCount : 0) || !ReserveRentalAccounts(engine, accountCount)) {
+		FreeRentalEngine(engine);
+		return NULL;
+	}
+
+	for (int handle = 0; handle < engine->vehicleCount; handle++) {
+		const Mobility* mobility = GetMobility(vehicles, handle);
+		engine->fares[handle] = mobility != NULL && mobility->type != Trucks ? ToCents(mobility->cost) : RENTAL_NOT_RENTABLE;
+	}
+
+	for (ClientNode* current = clients; current != NULL; current = current->next) {
+		if (!AddRentalAccount(engine, &current->client)) {
+			FreeRentalEngine(engine);
+			return NULL;
+		}
+	}
+	return engine;
+}
+
+// Frees a vehicle that can no longer be rented; a reservation gets its fare back, a ride already taken keeps it
+static void ReleaseRentalVehicle(RentalEngine* engine, MobilityHandle vehicle) {
+	int holder;
+	if (GetRentalState(engine, vehicle, &holder) == RentalReserved) {
+		engine->accounts[holder].balance += engine->paid[vehicle];
+	}
+	engine->states[vehicle] = RentalAvailable;
+	engine->paid[vehicle] = 0;
+}
+
+int SetRentalVehicle(RentalEngine* engine, MobilityHandle vehicle, const Mobility* mobility) {
+	if (vehicle < 0 || !ReserveRentalVehicles(engine, vehicle + 1)) {
+		return 0;
+	}
+	engine->fares[vehicle] = mobility->type != Trucks ? ToCents(mobility->cost) : RENTAL_NOT_RENTABLE;
+	if (engine->fares[vehicle] == RENTAL_NOT_RENTABLE) {
+		ReleaseRentalVehicle(engine, vehicle);
+	}
+	return 1;
+}
+
+void RetireRentalVehicle(RentalEngine* engine, MobilityHandle vehicle) {
+	if (vehicle < 0 || vehicle >= engine->vehicleCount) {
+		return;
+	}
+	ReleaseRentalVehicle(engine, vehicle);
+	engine->fares[vehicle] = RENTAL_NOT_RENTABLE;
+}
+
+int AddRentalAccount(RentalEngine* engine, const Client* client) {
+	int account = engine->accountCount;
+	if (FindRentalAccount(engine, client->nif) >= 0 || !ReserveRentalAccounts(engine, account + 1) ||
+		!NifIndexInsert(&engine->accountsByNif, client->nif, (void*)(size_t)(account + 1))) {
+		return 0;
+	}
+	RentalAccount* target = &engine->accounts[account];
+	memset(target, 0, sizeof(RentalAccount));
+	memcpy(target->nif, client->nif, NIF_SIZE);
+	target->balance = ToCents(client->balance);
+	target->settledBalance = target->balance;
+	engine->accountCount++;
+	return 1;
+}
+
+int UpdateRentalAccount(RentalEngine* engine, const char* nif, const Client* client) {
+	int account = FindRentalAccount(engine, nif);
+	if (account < 0) {
+		return 0;
+	}
+	// The new NIF goes in first, so running out of memory leaves the account as it was
+	RentalAccount* target = &engine->accounts[account];
+	if (strncmp(nif, client->nif, NIF_SIZE) != 0) {
+		if (!NifIndexInsert(&engine->accountsByNif, client->nif, (void*)(size_t)(account + 1))) {
+			return 0;
+		}
+		NifIndexRemove(&engine->accountsByNif, nif);
+		memcpy(target->nif, client->nif, NIF_SIZE);
+	}
+	target->balance = ToCents(client->balance);
+	target->settledBalance = target->balance;
+	return 1;
+}
+
+void RemoveRentalAccount(RentalEngine* engine, const char* nif) {
+	int account = (int)(size_t)NifIndexRemove(&engine->accountsByNif, nif) - 1;
+	if (account >= 0) {
+		engine->accounts[account].retired = 1;
+	}
+}
+
+int FindRentalAccount(const RentalEngine* engine, const char* nif) {
+	return (int)(size_t)NifIndexFind(&engine->accountsByNif, nif) - 1;
+}
+
+static int IsValidRental(const RentalEngine* engine, int account, MobilityHandle vehicle) {
+	return account >= 0 && account < engine->accountCount && vehicle >= 0 && vehicle < engine->vehicleCount &&
+		engine->fares[vehicle] != RENTAL_NOT_RENTABLE;
+}
+
+static int IsRetiredHolder(const RentalEngine* engine, long word) {
+	return (word & RENTAL_STATE_MASK) != RentalAvailable && engine->accounts[word >> RENTAL_STATE_BITS].retired;
+}
+
+// Moves a vehicle from one state of an account to another; tells apart a vehicle held by someone else
+static RentalResult Transition(RentalEngine* engine, int account, MobilityHandle vehicle, RentalState from, long desired) {
+	if (!IsValidRental(engine, account, vehicle)) {
+		return RentalInvalid;
+	}
+	long expected = StateWord(account, from);
+	long previous = PlatformAtomicCompareExchange(&engine->states[vehicle], expected, desired);
+	if (previous == expected) {
+		return RentalOk;
+	}
+	if ((previous & RENTAL_STATE_MASK) != RentalAvailable && (previous >> RENTAL_STATE_BITS) != account) {
+		return RentalNotHolder;
+	}
+	return RentalUnavailable;
+}
+
+// Takes an amount from a balance unless it would go below zero
+static int Debit(volatile long long* balance, long long amount) {
+	long long current = PlatformAtomicLoad64(balance);
+	for (;;) {
+		if (current < amount) {
+			return 0;
+		}
+		long long previous = PlatformAtomicCompareExchange64(balance, current, current - amount);
+		if (previous == current) {
+			return 1;
+		}
+		current = previous;
+	}
+}
+
+RentalResult ReserveVehicle(RentalEngine* engine, int account, MobilityHandle vehicle) {
+	if (!IsValidRental(engine, account, vehicle)) {
+		return RentalInvalid;
+	}
+
+	// The vehicle is claimed first: a lost race then never touches the balance. A vehicle still held by a
+	// removed client is claimed the same way, from the word that client left.
+	long reserved = StateWord(account, RentalReserved);
+	long previous = PlatformAtomicCompareExchange(&engine->states[vehicle], RentalAvailable, reserved);
+	if (previous != RentalAvailable && (!IsRetiredHolder(engine, previous) ||
+		PlatformAtomicCompareExchange(&engine->states[vehicle], previous, reserved) != previous)) {
+		return RentalUnavailable;
+	}
+	engine->paid[vehicle] = engine->fares[vehicle];
+	if (!Debit(&engine->accounts[account].balance, engine->paid[vehicle])) {
+		PlatformAtomicCompareExchange(&engine->states[vehicle], reserved, RentalAvailable);
+		return RentalInsufficientFunds;
+	}
+	return RentalOk;
+}
+
+RentalResult CancelReservation(RentalEngine* engine, int account, MobilityHandle vehicle) {
+	// Read while the vehicle is still held: once it is available the next holder overwrites it
+	long long paid = IsValidRental(engine, account, vehicle) ? engine->paid[vehicle] : 0;
+	RentalResult result = Transition(engine, account, vehicle, RentalReserved, RentalAvailable);
+	if (result == RentalOk) {
+		PlatformAtomicAdd64(&engine->accounts[account].balance, paid);
+	}
+	return result;
+}
+
+RentalResult StartRental(RentalEngine* engine, int account, MobilityHandle vehicle) {
+	return Transition(engine, account, vehicle, RentalReserved, StateWord(account, RentalInUse));
+}
+
+RentalResult EndRental(RentalEngine* engine, int account, MobilityHandle vehicle) {
+	return Transition(engine, account, vehicle, RentalInUse, RentalAvailable);
+}
+
+RentalState GetRentalState(const RentalEngine* engine, MobilityHandle vehicle, int* account) {
+	long word = vehicle >= 0 && vehicle < engine->vehicleCount ? engine->states[vehicle] : RentalAvailable;
+	if (IsRetiredHolder(engine, word)) {
+		word = RentalAvailable;
+	}
+	RentalState state = (RentalState)(word & RENTAL_STATE_MASK);
+	if (account != NULL) {
+		*account = state == RentalAvailable ? -1 : (int)(word >> RENTAL_STATE_BITS);
+	}
+	return state;
+}
+
+double GetRentalBalance(const RentalEngine* engine, int account) {
+	if (account < 0 || account >= engine->accountCount) {
+		return 0;
+	}
+	return PlatformAtomicLoad64(&engine->accounts[account].balance) / 100.0;
+}
+
+// Appends the balance of an account to the journal without waiting for it; returns its sequence, 0 if there was nothing
+// to save and -1 if it could not be saved
+static long long AppendRentalBalance(DataStore* store, RentalAccount* account) {
+	long long balance = PlatformAtomicLoad64(&account->balance);
+	ClientNode* client = account->retired || balance == account->settledBalance ? NULL : FindClientByNif(store->clients, account->nif);
+	if (client == NULL) {
+		return 0;
+	}
+	Client settled = client->client;
+	settled.balance = balance / 100.0;
+	unsigned long long sequence = StoreUpdateClientNoWait(store, account->nif, settled);
+	if (sequence == 0) {
+		return -1;
+	}
+	account->settledBalance = balance;
+	return (long long)sequence;
+}
+
+int SettleRentalBalances(RentalEngine* engine, DataStore* store) {
+	int updated = 0;
+	long long last = 0;
+	for (int account = 0; account < engine->accountCount && updated >= 0; account++) {
+		long long sequence = AppendRentalBalance(store, &engine->accounts[account]);
+		if (sequence < 0) {
+			updated = -1;
+		}
+		else if (sequence > 0) {
+			last = sequence;
+			updated++;
+		}
+	}
+	// The journal is written in order, so the last balance on disk means every one before it is too
+	if (last > 0 && !StoreWaitForChanges(store, (unsigned long long)last)) {
+		return -1;
+	}
+	return updated;
+}
+
+int SettleRentalAccount(RentalEngine* engine, DataStore* store, const char* nif) {
+	int account = FindRentalAccount(engine, nif);
+	long long sequence = account >= 0 ? AppendRentalBalance(store, &engine->accounts[account]) : 0;
+	return sequence == 0 || (sequence > 0 && StoreWaitForChanges(store, (unsigned long long)sequence));
+}
+
+void FreeRentalEngine(RentalEngine* engine) {
+	if (engine == NULL) {
+		return;
+	}
+	free((void*)engine->states);
+	free(engine->fares);
+	free(engine->paid);
+	free(engine->accounts);
+	NifIndexClear(&engine->accountsByNif);
+	free(engine);
+}
+
+typedef struct RentalWorker {
+	RentalEngine* engine;
+	volatile long* holders;         // Threads currently holding each vehicle, never above 1
+	unsigned int seed;
+	int operations;
+	long long reserved;
+	long long contended;
+	long long declined;
+	long long spent;                // Fares of the rides finished by this thread, in cents
+	long long doubleBookings;
+	char padding[64];               // Keeps the counters of neighbouring workers off each other's cache line
+} RentalWorker;
+
+static unsigned int NextRandom(unsigned int* seed) {
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+static int RunRentalWorker(void* argument) {
+	RentalWorker* worker = (RentalWorker*)argument;
+	RentalEngine* engine = worker->engine;
+
+	for (int i = 0; i < worker->operations; i++) {
+		int account = NextRandom(&worker->seed) % engine->accountCount;
+		MobilityHandle vehicle = NextRandom(&worker->seed) % engine->vehicleCount;
+
+		RentalResult result = ReserveVehicle(engine, account, vehicle);
+		if (result == RentalUnavailable) {
+			worker->contended++;
+			continue;
+		}
+		if (result != RentalOk) {
+			worker->declined++;
+			continue;
+		}
+
+		worker->reserved++;
+		if (PlatformAtomicAdd(&worker->holders[vehicle], 1) != 1) {
+			worker->doubleBookings++;
+		}
+
+		if (NextRandom(&worker->seed) % 4 != 0) {
+			result = StartRental(engine, account, vehicle);
+			long long paid = engine->paid[vehicle];
+			PlatformAtomicAdd(&worker->holders[vehicle], -1);
+			if (result == RentalOk && EndRental(engine, account, vehicle) == RentalOk) {
+				worker->spent += paid;
+			}
+			else {
+				worker->doubleBookings++;
+			}
+		}
+		else {
+			PlatformAtomicAdd(&worker->holders[vehicle], -1);
+			if (CancelReservation(engine, account, vehicle) != RentalOk) {
+				worker->doubleBookings++;
+			}
+		}
+	}
+	return 0;
+}
+
+// Fills a table and a client list the way the stores would, so the rounds go through CreateRentalEngine
+static MobilityTable* CreateStressData(int vehicleCount, int accountCount, ClientNode** clients) {
+	MobilityTable* vehicles = CreateMobilityTable(vehicleCount);
+	if (vehicles == NULL) {
+		return NULL;
+	}
+	for (int vehicle = 0; vehicle < vehicleCount; vehicle++) {
+		Mobility mobility;
+		memset(&mobility, 0, sizeof(Mobility));
+		mobility.id = vehicle + 1;
+		mobility.type = vehicle % 2 == 0 ? Scooters : Bicycles;
+		mobility.cost = (100 + vehicle % 900) / 100.0f;
+		if (AddMobility(vehicles, mobility) == INVALID_MOBILITY_HANDLE) {
+			FreeMobilities(vehicles);
+			return NULL;
+		}
+	}
+
+	// Every tenth account starts empty so declined reservations are exercised too
+	*clients = NULL;
+	for (int account = 0; account < accountCount; account++) {
+		Client client;
+		char name[MIN_LENGHT];
+		memset(&client, 0, sizeof(Client));
+		snprintf(client.nif, NIF_SIZE, "%09u", (unsigned int)(account + 1) % 1000000000u);
+		snprintf(name, sizeof(name), "Stress %d", account + 1);
+		client.name = name;
+		client.address = "";
+		client.balance = account % 10 == 0 ? 0.0 : 10000000.0;
+		*clients = AddClient(*clients, client);
+	}
+	return vehicles;
+}
+
+static int RunStressRound(const MobilityTable* vehicles, ClientNode* clients, int operations, int threads, double* seconds, long long* reserved) {
+	RentalEngine* engine = CreateRentalEngine(vehicles, clients);
+	int vehicleCount = engine != NULL ? engine->vehicleCount : 0;
+	int accountCount = engine != NULL ? engine->accountCount : 0;
+	RentalWorker* workers = (RentalWorker*)calloc(threads, sizeof(RentalWorker));
+	PlatformThread** handles = (PlatformThread**)calloc(threads, sizeof(PlatformThread*));
+	volatile long* holders = (volatile long*)calloc(vehicleCount, sizeof(long));
+	if (engine == NULL || accountCount == 0 || workers == NULL || handles == NULL || holders == NULL) {
+		FreeRentalEngine(engine);
+		free(workers);
+		free(handles);
+		free((void*)holders);
+		return 0;
+	}
+
+	long long before = 0;
+	for (int account = 0; account < accountCount; account++) {
+		before += engine->accounts[account].balance;
+	}
+
+	double start = PlatformGetTime();
+	for (int t = 0; t < threads; t++) {
+		workers[t].engine = engine;
+		workers[t].holders = holders;
+		workers[t].seed = 2463534242u + 7919u * t;
+		workers[t].operations = operations;
+		handles[t] = PlatformStartThread(RunRentalWorker, &workers[t]);
+		if (handles[t] == NULL) {
+			RunRentalWorker(&workers[t]);
+		}
+	}
+	for (int t = 0; t < threads; t++) {
+		if (handles[t] != NULL) {
+			PlatformJoinThread(handles[t]);
+		}
+	}
+	*seconds = PlatformGetTime() - start;
+
+	long long after = 0;
+	for (int account = 0; account < accountCount; account++) {
+		after += engine->accounts[account].balance;
+	}
+	long long spent = 0;
+	long long doubleBookings = 0;
+	*reserved = 0;
+	for (int t = 0; t < threads; t++) {
+		spent += workers[t].spent;
+		doubleBookings += workers[t].doubleBookings;
+		*reserved += workers[t].reserved;
+	}
+	int leftHeld = 0;
+	for (int vehicle = 0; vehicle < vehicleCount; vehicle++) {
+		leftHeld += engine->states[vehicle] != RentalAvailable;
+	}
+
+	int consistent = doubleBookings == 0 && leftHeld == 0 && before - after == spent;
+	if (!consistent) {
+		printf("  %d double bookings, %d vehicles left held, %lld cents missing\n", (int)doubleBookings, leftHeld, before - after - spent);
+	}
+
+	FreeRentalEngine(engine);
+	free(workers);
+	free(handles);
+	free((void*)holders);
+	return consistent;
+}
+
+int RunRentalStress(int vehicleCount, int accountCount, int operations) {
+	if (vehicleCount <= 0 || accountCount <= 0 || operations <= 0) {
+		return 0;
+	}
+
+	int processors = PlatformGetProcessorCount();
+	printf("Rental stress: %d vehicles, %d accounts, %d reservations per thread, %d processors\n",
+		vehicleCount, accountCount, operations, processors);
+	printf("%8s %14s %14s %9s %6s\n", "threads", "attempts/s", "reserved/s", "speedup", "check");
+
+	ClientNode* clients = NULL;
+	MobilityTable* vehicles = CreateStressData(vehicleCount, accountCount, &clients);
+	if (vehicles == NULL) {
+		printf("Could not create the vehicles.\n");
+		return 0;
+	}
+
+	int consistent = 1;
+	double baseline = 0;
+	for (int threads = 1; threads <= 2 * processors; threads *= 2) {
+		double seconds = 0;
+		long long reserved = 0;
+		int ok = RunStressRound(vehicles, clients, operations, threads, &seconds, &reserved);
+		if (seconds <= 0) {
+			printf("%8d could not start the round\n", threads);
+			consistent = 0;
+			continue;
+		}
+		double rate = (double)operations * threads / seconds;
+		if (threads == 1) {
+			baseline = rate;
+		}
+		printf("%8d %14.0f %14.0f %8.2fx %6s\n", threads, rate, reserved / seconds, rate / baseline, ok ? "ok" : "FAIL");
+		consistent = consistent && ok;
+	}
+
+	FreeMobilities(vehicles);
+	FreeClients(clients);
+	return consistent;
+}
@@ -0,0 +1,270 @@
+/**
+ * @file   rentalEngine.h
+ * @brief  This file includes the engine that reserves, starts and ends vehicle rentals from many threads at once.
+ *
+ * Every vehicle has one availability word holding its state and the account
+ * that holds it. Every transition is a single compare-and-swap on that word,
+ * so two clients racing for the same vehicle can never both win. The fare is
+ * taken from the client's balance with a compare-and-swap loop that refuses
+ * to go below zero. It is taken when the vehicle is reserved and given back
+ * if the reservation is cancelled. No locks are taken anywhere; threads only
+ * contend when they touch the same vehicle or the same account.
+ *
+ * The engine copies the fares, balances and NIFs of the vehicles and clients
+ * it was created from and keeps no pointer into the table or the list. A
+ * vehicle or client that is added, changed or removed afterwards is passed on
+ * one at a time, which touches only its own slot or account. The account of
+ * a removed client is retired rather than renumbered, so no vehicle has to be
+ * visited; the vehicles it still held are taken over by the next reservation.
+ * Balances are written back with SettleRentalBalances.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef RENTAL_ENGINE_H
+#define RENTAL_ENGINE_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "platform.h"
+#include "clients.h"
+#include "mobility.h"
+#include "nifIndex.h"
+
+#define RENTAL_STATE_BITS 2             /**< Low bits of the availability word that hold the state. */
+#define RENTAL_NOT_RENTABLE (-1)        /**< Fare of the slots that cannot be rented. */
+
+struct DataStore;
+
+/**
+ * @brief State of a vehicle in the rental engine.
+ */
+typedef enum {
+	RentalAvailable = 0,            /**< Free to be reserved. */
+	RentalReserved = 1,             /**< Held for an account, fare already paid. */
+	RentalInUse = 2                 /**< Being ridden by the account that reserved it. */
+} RentalState;
+
+/**
+ * @brief Outcome of a rental operation.
+ */
+typedef enum {
+	RentalOk = 0,                   /**< The transition happened. */
+	RentalUnavailable,              /**< The vehicle was not in the state the operation needs. */
+	RentalNotHolder,                /**< The vehicle is held by another account. */
+	RentalInsufficientFunds,        /**< The balance does not cover the fare. */
+	RentalInvalid                   /**< Unknown account or vehicle, or a vehicle that cannot be rented. */
+} RentalResult;
+
+/**
+ * @brief Balance of one client inside the engine.
+ */
+typedef struct RentalAccount {
+	char nif[NIF_SIZE];             /**< NIF of the client. */
+	volatile long long balance;     /**< Current balance in cents. */
+	long long settledBalance;       /**< Balance in cents last written back to the client. */
+	int retired;                    /**< 1 once the client was removed; its number is never reused. */
+} RentalAccount;
+
+/**
+ * @brief Availability of every vehicle and balance of every client.
+ */
+typedef struct RentalEngine {
+	int vehicleCount;               /**< Number of vehicle slots, indexed by MobilityHandle. */
+	int vehicleCapacity;            /**< Slots allocated. */
+	volatile long* states;          /**< Availability word of each slot: account << RENTAL_STATE_BITS | RentalState. */
+	long long* fares;               /**< Fare of each slot in cents, RENTAL_NOT_RENTABLE for trucks and free slots. */
+	long long* paid;                /**< Fare taken for the hold of each slot, given back if the reservation is cancelled. */
+	int accountCount;               /**< Number of accounts, retired ones included. */
+	int accountCapacity;            /**< Accounts allocated. */
+	RentalAccount* accounts;        /**< Accounts indexed by account number. */
+	NifIndex accountsByNif;         /**< Account number + 1 of every NIF. */
+} RentalEngine;
+
+/**
+ * @brief Creates an engine for the vehicles of a table and the clients of a list.
+ *
+ * The fares and balances are copied; later changes to the table or the list must be passed on with
+ * SetRentalVehicle, RetireRentalVehicle, AddRentalAccount, UpdateRentalAccount and RemoveRentalAccount.
+ *
+ * @param vehicles The table of vehicles.
+ * @param clients The head of the client list.
+ * @return The engine. If memory could not be allocated, returns NULL.
+ */
+RentalEngine* CreateRentalEngine(const MobilityTable* vehicles, ClientNode* clients);
+
+/**
+ * @brief Copies the fare of a vehicle that was added or changed into its slot.
+ *
+ * A vehicle that stays rentable keeps its holder and the fare that was paid.
+ * One that can no longer be rented is released like RetireRentalVehicle does.
+ * Must not run while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param vehicle The handle of the vehicle.
+ * @param mobility The vehicle.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int SetRentalVehicle(RentalEngine* engine, MobilityHandle vehicle, const Mobility* mobility);
+
+/**
+ * @brief Makes the slot of a removed vehicle unrentable, giving back the fare of a reservation.
+ *
+ * Must not run while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param vehicle The handle the vehicle had.
+ */
+void RetireRentalVehicle(RentalEngine* engine, MobilityHandle vehicle);
+
+/**
+ * @brief Opens an account for a client that was added.
+ *
+ * Must not run while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param client The client.
+ * @return 1 on success, 0 if the NIF already has an account or memory could not be allocated.
+ */
+int AddRentalAccount(RentalEngine* engine, const Client* client);
+
+/**
+ * @brief Copies the NIF and balance of a client that was changed into its account.
+ *
+ * The balance of the client replaces whatever the rentals left. Must not run
+ * while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param nif The NIF the client had.
+ * @param client The client.
+ * @return 1 on success, 0 if the NIF has no account or memory could not be allocated.
+ */
+int UpdateRentalAccount(RentalEngine* engine, const char* nif, const Client* client);
+
+/**
+ * @brief Retires the account of a client that was removed.
+ *
+ * Must not run while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param nif The NIF of the client.
+ */
+void RemoveRentalAccount(RentalEngine* engine, const char* nif);
+
+/**
+ * @brief Gets the account number of a client.
+ *
+ * @param engine The engine.
+ * @param nif The NIF of the client.
+ * @return The account number, -1 if the client is unknown.
+ */
+int FindRentalAccount(const RentalEngine* engine, const char* nif);
+
+/**
+ * @brief Reserves an available vehicle and takes its fare from the balance.
+ *
+ * @param engine The engine.
+ * @param account The account number.
+ * @param vehicle The handle of the vehicle.
+ * @return RentalOk, RentalUnavailable, RentalInsufficientFunds or RentalInvalid.
+ */
+RentalResult ReserveVehicle(RentalEngine* engine, int account, MobilityHandle vehicle);
+
+/**
+ * @brief Cancels a reservation and gives back the fare that was paid.
+ *
+ * @param engine The engine.
+ * @param account The account that made the reservation.
+ * @param vehicle The handle of the vehicle.
+ * @return RentalOk, RentalUnavailable, RentalNotHolder or RentalInvalid.
+ */
+RentalResult CancelReservation(RentalEngine* engine, int account, MobilityHandle vehicle);
+
+/**
+ * @brief Starts the rental of a reserved vehicle.
+ *
+ * @param engine The engine.
+ * @param account The account that made the reservation.
+ * @param vehicle The handle of the vehicle.
+ * @return RentalOk, RentalUnavailable, RentalNotHolder or RentalInvalid.
+ */
+RentalResult StartRental(RentalEngine* engine, int account, MobilityHandle vehicle);
+
+/**
+ * @brief Ends a rental and makes the vehicle available again.
+ *
+ * @param engine The engine.
+ * @param account The account riding the vehicle.
+ * @param vehicle The handle of the vehicle.
+ * @return RentalOk, RentalUnavailable, RentalNotHolder or RentalInvalid.
+ */
+RentalResult EndRental(RentalEngine* engine, int account, MobilityHandle vehicle);
+
+/**
+ * @brief Gets the state of a vehicle.
+ *
+ * @param engine The engine.
+ * @param vehicle The handle of the vehicle.
+ * @param account Receives the account holding the vehicle, -1 when it is available. May be NULL.
+ * @return The state.
+ */
+RentalState GetRentalState(const RentalEngine* engine, MobilityHandle vehicle, int* account);
+
+/**
+ * @brief Gets the balance of an account.
+ *
+ * @param engine The engine.
+ * @param account The account number.
+ * @return The balance in euros.
+ */
+double GetRentalBalance(const RentalEngine* engine, int account);
+
+/**
+ * @brief Writes the balances that changed back to the clients and to the journal.
+ *
+ * Every balance is appended to the journal before the disk is waited on,
+ * once. Must not run while other threads use the engine.
+ *
+ * @param engine The engine.
+ * @param store The store holding the clients.
+ * @return The number of clients updated, -1 if a change could not be saved.
+ */
+int SettleRentalBalances(RentalEngine* engine, struct DataStore* store);
+
+/**
+ * @brief Writes the balance of one client back like SettleRentalBalances.
+ *
+ * @param engine The engine.
+ * @param store The store holding the clients.
+ * @param nif The NIF of the client.
+ * @return 1 if the balance was saved or needed no saving, 0 if it could not be saved.
+ */
+int SettleRentalAccount(RentalEngine* engine, struct DataStore* store, const char* nif);
+
+/**
+ * @brief Frees an engine.
+ *
+ * @param engine The engine.
+ */
+void FreeRentalEngine(RentalEngine* engine);
+
+/**
+ * @brief Hammers an engine from 1 thread up to twice the processor count and prints the throughput.
+ *
+ * The engine is created with CreateRentalEngine from a synthetic table and
+ * client list. Every thread reserves random vehicles for random accounts and
+ * then rides or cancels them. Afterwards every vehicle must be available again and the
+ * money taken from the balances must equal the fares of the finished rides.
+ * Each vehicle also counts its holders, so a double booking is caught.
+ *
+ * @param vehicleCount The number of vehicles.
+ * @param accountCount The number of accounts.
+ * @param operations The number of reservations tried by each thread.
+ * @return 1 if every run kept the invariants, 0 otherwise.
+ */
+int RunRentalStress(int vehicleCount, int accountCount, int operations);
+
+#endif  // RENTAL_ENGINE_H
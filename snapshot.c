@@ -0,0 +1,199 @@
+#include "snapshot.h"
+
+#define SNAPSHOT_WRITE_BUFFER (1 << 20)
+#define CHECKSUM_MODULUS 0xFFFFFFFFull
+#define CHECKSUM_BLOCK_WORDS 4096
+
+typedef struct Checksum {
+	unsigned long long sum1;
+	unsigned long long sum2;
+} Checksum;
+
+// Fletcher-64 over little-endian 32-bit words, reduced once per block to stay fast
+static void UpdateChecksum(Checksum* checksum, const unsigned char* data, size_t length) {
+	size_t words = length / 4;
+
+	while (words > 0) {
+		size_t block = words < CHECKSUM_BLOCK_WORDS ? words : CHECKSUM_BLOCK_WORDS;
+		for (size_t i = 0; i < block; i++) {
+			unsigned int word;
+			memcpy(&word, data, sizeof(word));
+			checksum->sum1 += word;
+			checksum->sum2 += checksum->sum1;
+			data += 4;
+		}
+		checksum->sum1 %= CHECKSUM_MODULUS;
+		checksum->sum2 %= CHECKSUM_MODULUS;
+		words -= block;
+	}
+}
+
+static unsigned long long FinishChecksum(const Checksum* checksum) {
+	return (checksum->sum2 << 32) | checksum->sum1;
+}
+
+static size_t RecordStride(size_t recordSize) {
+	return (recordSize + SNAPSHOT_RECORD_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_RECORD_ALIGNMENT - 1);
+}
+
+SnapshotStatus OpenSnapshot(Snapshot* snapshot, const char* filename, SnapshotRecordType recordType, size_t recordSize) {
+	memset(snapshot, 0, sizeof(Snapshot));
+
+	if (!PlatformMapFile(filename, &snapshot->mapping)) {
+		return SnapshotMissing;
+	}
+
+	const unsigned char* data = snapshot->mapping.data;
+	size_t size = snapshot->mapping.size;
+
+	if (size < SNAPSHOT_HEADER_SIZE || memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0) {
+		if (size % recordSize != 0) {
+			return SnapshotInvalid;
+		}
+		snapshot->records = data;
+		snapshot->recordCount = size / recordSize;
+		snapshot->recordStride = recordSize;
+		return SnapshotLegacy;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if (header.version < SNAPSHOT_MIN_VERSION || header.version > SNAPSHOT_VERSION || header.recordType != (unsigned int)recordType ||
+		header.recordSize != recordSize || header.recordStride < recordSize ||
+		header.headerSize < SNAPSHOT_HEADER_SIZE || header.headerSize > size) {
+		return SnapshotInvalid;
+	}
+
+	// Version 1 left these bytes as padding
+	unsigned long long stringSize = header.version >= 2 ? header.stringSize : 0;
+	size_t available = (size - header.headerSize) / header.recordStride;
+	if (header.recordCount > available ||
+		stringSize > size - header.headerSize - header.recordCount * header.recordStride ||
+		stringSize % SNAPSHOT_RECORD_ALIGNMENT != 0) {
+		return SnapshotInvalid;
+	}
+
+	snapshot->records = data + header.headerSize;
+	snapshot->recordCount = (size_t)header.recordCount;
+	snapshot->recordStride = header.recordStride;
+	snapshot->journalSequence = header.journalSequence;
+	snapshot->version = header.version;
+	if (stringSize > 0) {
+		snapshot->strings = (const char*)snapshot->records + snapshot->recordCount * snapshot->recordStride;
+		snapshot->stringSize = (size_t)stringSize;
+	}
+
+	Checksum checksum = { 0, 0 };
+	UpdateChecksum(&checksum, snapshot->records, snapshot->recordCount * snapshot->recordStride + snapshot->stringSize);
+	if (FinishChecksum(&checksum) != header.checksum) {
+		return SnapshotInvalid;
+	}
+
+	return SnapshotOk;
+}
+
+const void* GetSnapshotRecord(const Snapshot* snapshot, size_t index) {
+	return snapshot->records + index * snapshot->recordStride;
+}
+
+void CloseSnapshot(Snapshot* snapshot) {
+	PlatformUnmapFile(&snapshot->mapping);
+	memset(snapshot, 0, sizeof(Snapshot));
+}
+
+unsigned long long ReadSnapshotSequence(const char* filename, SnapshotRecordType recordType) {
+	FILE* file = fopen(filename, "rb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	SnapshotHeader header;
+	size_t read = fread(&header, sizeof(header), 1, file);
+	fclose(file);
+
+	if (read != 1 || memcmp(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0 ||
+		header.version < SNAPSHOT_MIN_VERSION || header.version > SNAPSHOT_VERSION ||
+		header.recordType != (unsigned int)recordType) {
+		return 0;
+	}
+	return header.journalSequence;
+}
+
+int WriteSnapshot(const char* filename, SnapshotRecordType recordType, size_t recordSize, unsigned long long journalSequence, SnapshotNextRecord nextRecord, void* context, const StringTable* strings) {
+	char tempFilename[FILENAME_MAX];
+	if (snprintf(tempFilename, sizeof(tempFilename), "%s.tmp", filename) >= (int)sizeof(tempFilename)) {
+		return 0;
+	}
+
+	FILE* file = fopen(tempFilename, "wb");
+	if (file == NULL) {
+		return 0;
+	}
+
+	unsigned char* buffer = (unsigned char*)malloc(SNAPSHOT_WRITE_BUFFER);
+	if (buffer == NULL) {
+		fclose(file);
+		remove(tempFilename);
+		return 0;
+	}
+
+	SnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+	header.version = SNAPSHOT_VERSION;
+	header.headerSize = SNAPSHOT_HEADER_SIZE;
+	header.recordType = (unsigned int)recordType;
+	header.recordSize = (unsigned int)recordSize;
+	header.recordStride = (unsigned int)RecordStride(recordSize);
+	header.journalSequence = journalSequence;
+
+	// Reserve the header, it is rewritten once the count and checksum are known
+	int ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+	Checksum checksum = { 0, 0 };
+	size_t used = 0;
+	const void* record;
+
+	while (ok && (record = nextRecord(context)) != NULL) {
+		if (used + header.recordStride > SNAPSHOT_WRITE_BUFFER) {
+			UpdateChecksum(&checksum, buffer, used);
+			ok = fwrite(buffer, 1, used, file) == used;
+			used = 0;
+		}
+		memcpy(buffer + used, record, recordSize);
+		memset(buffer + used + recordSize, 0, header.recordStride - recordSize);
+		used += header.recordStride;
+		header.recordCount++;
+	}
+
+	if (ok && used > 0) {
+		UpdateChecksum(&checksum, buffer, used);
+		ok = fwrite(buffer, 1, used, file) == used;
+	}
+	free(buffer);
+
+	// The string block is zero-padded to whole records so the checksum, which reads whole words, covers all of it
+	if (ok && strings != NULL && strings->size > 0) {
+		size_t whole = strings->size - strings->size % SNAPSHOT_RECORD_ALIGNMENT;
+		unsigned char tail[SNAPSHOT_RECORD_ALIGNMENT] = { 0 };
+		memcpy(tail, strings->data + whole, strings->size - whole);
+		size_t tailSize = whole < strings->size ? SNAPSHOT_RECORD_ALIGNMENT : 0;
+
+		UpdateChecksum(&checksum, (const unsigned char*)strings->data, whole);
+		UpdateChecksum(&checksum, tail, tailSize);
+		ok = fwrite(strings->data, 1, whole, file) == whole && fwrite(tail, 1, tailSize, file) == tailSize;
+		header.stringSize = whole + tailSize;
+	}
+
+	header.checksum = FinishChecksum(&checksum);
+	ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && PlatformSyncFile(file);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok || !PlatformReplaceFile(tempFilename, filename)) {
+		remove(tempFilename);
+		return 0;
+	}
+	return 1;
+}
@@ -0,0 +1,154 @@
+/**
+ * @file   snapshot.h
+ * @brief  This file includes the versioned binary snapshot format of the data files.
+ *
+ * A snapshot is a 64-byte header followed by fixed-stride records and, since
+ * version 2, by the block of strings the records reference by offset and
+ * length. The header holds a magic string, the schema version, the record
+ * type, size, stride and count, the size of the string block and a checksum
+ * of both. Snapshots are opened with a
+ * read-only memory mapping, so the loaders consume the records in place
+ * without an intermediate read buffer. The header also records the last
+ * journal sequence number the snapshot includes, so replaying the journal on
+ * top of it can skip the operations that are already in the file.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "platform.h"
+#include "stringArena.h"
+
+#define SNAPSHOT_MAGIC "MMSNAPSH"       /**< Magic string at the start of every snapshot. */
+#define SNAPSHOT_MAGIC_SIZE 8           /**< Size of the magic string, without terminator. */
+#define SNAPSHOT_VERSION 2              /**< Current schema version, the one written. */
+#define SNAPSHOT_MIN_VERSION 1          /**< Oldest schema version still read. */
+#define SNAPSHOT_HEADER_SIZE 64         /**< Size of the header, also the offset of the first record. */
+#define SNAPSHOT_RECORD_ALIGNMENT 8     /**< Every record starts at a multiple of this value. */
+
+/**
+ * @brief Kind of records stored in a snapshot.
+ */
+typedef enum {
+	SnapshotClients = 1,            /**< Client records. */
+	SnapshotManagers = 2,           /**< Manager records. */
+	SnapshotMobilities = 3          /**< Mobility records. */
+} SnapshotRecordType;
+
+/**
+ * @brief Result of opening a snapshot.
+ */
+typedef enum {
+	SnapshotOk,                     /**< The file is a valid snapshot. */
+	SnapshotLegacy,                 /**< The file is a headerless array of raw records. */
+	SnapshotMissing,                /**< The file does not exist or could not be mapped. */
+	SnapshotInvalid                 /**< The file is corrupt or of another type or version. */
+} SnapshotStatus;
+
+/**
+ * @brief Header at the start of every snapshot file.
+ */
+typedef struct SnapshotHeader {
+	char magic[SNAPSHOT_MAGIC_SIZE];  /**< SNAPSHOT_MAGIC. */
+	unsigned int version;             /**< Schema version of the file. */
+	unsigned int headerSize;          /**< Offset of the first record. */
+	unsigned int recordType;          /**< SnapshotRecordType of the records. */
+	unsigned int recordSize;          /**< Size of each record in bytes. */
+	unsigned int recordStride;        /**< Distance between consecutive records in bytes. */
+	unsigned int reserved;            /**< Always zero. */
+	unsigned long long recordCount;   /**< Number of records. */
+	unsigned long long checksum;      /**< Fletcher-64 checksum of the record area and string block. */
+	unsigned long long journalSequence;  /**< Last journal operation included, 0 if none. */
+	unsigned long long stringSize;    /**< Size of the string block after the records, 0 in version 1. */
+} SnapshotHeader;
+
+/**
+ * @brief Snapshot opened for reading.
+ */
+typedef struct Snapshot {
+	PlatformFileMapping mapping;    /**< Memory mapping of the file. */
+	const unsigned char* records;   /**< First record. */
+	size_t recordCount;             /**< Number of records. */
+	size_t recordStride;            /**< Distance between consecutive records in bytes. */
+	unsigned long long journalSequence;  /**< Last journal operation included, 0 if none. */
+	unsigned int version;           /**< Schema version of the file, 0 for headerless files. */
+	const char* strings;            /**< Block of strings referenced by the records, NULL if there is none. */
+	size_t stringSize;              /**< Size of the string block, padding included. */
+} Snapshot;
+
+/**
+ * @brief Returns the next record to write, or NULL when there are no more.
+ */
+typedef const void* (*SnapshotNextRecord)(void* context);
+
+/**
+ * @brief Opens and validates a snapshot file.
+ *
+ * Files without a header whose size is a multiple of recordSize are accepted
+ * as SnapshotLegacy, so the raw .bin files written by earlier versions can be
+ * read once and migrated by saving them again. Files of an older version are
+ * accepted as long as their records have the expected size; the caller tells
+ * the layouts apart by the version.
+ *
+ * @param snapshot The snapshot to fill.
+ * @param filename The name of the file.
+ * @param recordType The expected type of the records.
+ * @param recordSize The expected size of each record.
+ * @return The status of the file. The snapshot must be closed unless SnapshotMissing is returned.
+ */
+SnapshotStatus OpenSnapshot(Snapshot* snapshot, const char* filename, SnapshotRecordType recordType, size_t recordSize);
+
+/**
+ * @brief Gets a record of an open snapshot.
+ *
+ * @param snapshot The snapshot.
+ * @param index The index of the record.
+ * @return A pointer to the record inside the mapping.
+ */
+const void* GetSnapshotRecord(const Snapshot* snapshot, size_t index);
+
+/**
+ * @brief Closes a snapshot and unmaps its file.
+ *
+ * @param snapshot The snapshot.
+ */
+void CloseSnapshot(Snapshot* snapshot);
+
+/**
+ * @brief Reads the journal sequence number recorded in a snapshot header.
+ *
+ * Only the header is read, the records are not validated.
+ *
+ * @param filename The name of the file.
+ * @param recordType The expected type of the records.
+ * @return The sequence number, or 0 if the file is missing, headerless or of another type.
+ */
+unsigned long long ReadSnapshotSequence(const char* filename, SnapshotRecordType recordType);
+
+/**
+ * @brief Writes a snapshot file.
+ *
+ * The records are written to a temporary file which is flushed to disk and
+ * then replaces the target, so a crash never leaves a half-written snapshot
+ * behind. The strings are written after the last record, so nextRecord can
+ * keep adding the strings of the records it returns until it returns NULL.
+ *
+ * @param filename The name of the file.
+ * @param recordType The type of the records.
+ * @param recordSize The size of each record.
+ * @param journalSequence The last journal operation included in the records, 0 if unknown.
+ * @param nextRecord Function that returns the records one by one.
+ * @param context Context passed to nextRecord.
+ * @param strings The strings the records reference, NULL if they hold none.
+ * @return 1 on success, 0 on failure.
+ */
+int WriteSnapshot(const char* filename, SnapshotRecordType recordType, size_t recordSize, unsigned long long journalSequence, SnapshotNextRecord nextRecord, void* context, const StringTable* strings);
+
+#endif  // SNAPSHOT_H
@@ -0,0 +1,213 @@
+#include "stringArena.h"
+
+#define CHUNK_HEADER_SIZE ((sizeof(StringArenaChunk) + 15) & ~(size_t)15)
+
+static unsigned int HashString(const char* text, size_t length) {
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)text[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+// Keeps the load factor under 70%, growing to half full so a burst of new strings does not resize again at once
+static size_t GrownSlotCount(size_t slotCount, size_t stringCount) {
+	if ((stringCount + 1) * 10 <= slotCount * 7) {
+		return slotCount;
+	}
+	size_t newCount = slotCount == 0 ? STRING_ARENA_MIN_SLOTS : slotCount;
+	while ((stringCount + 1) * 10 > newCount * 5) {
+		newCount *= 2;
+	}
+	return newCount;
+}
+
+// Moves every string to a larger table; the strings themselves stay where they are
+static int GrowArenaSlots(StringArena* arena) {
+	size_t newCount = GrownSlotCount(arena->slotCount, arena->stringCount);
+	if (newCount == arena->slotCount) {
+		return 1;
+	}
+	StringSlot* grown = (StringSlot*)calloc(newCount, sizeof(StringSlot));
+	if (grown == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < arena->slotCount; i++) {
+		if (arena->slots[i].text == NULL) {
+			continue;
+		}
+		size_t slot = arena->slots[i].hash & (newCount - 1);
+		while (grown[slot].text != NULL) {
+			slot = (slot + 1) & (newCount - 1);
+		}
+		grown[slot] = arena->slots[i];
+	}
+
+	free(arena->slots);
+	arena->slots = grown;
+	arena->slotCount = newCount;
+	return 1;
+}
+
+static int GrowTableSlots(StringTable* table) {
+	size_t newCount = GrownSlotCount(table->slotCount, table->stringCount);
+	if (newCount == table->slotCount) {
+		return 1;
+	}
+	StringTableSlot* grown = (StringTableSlot*)calloc(newCount, sizeof(StringTableSlot));
+	if (grown == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < table->slotCount; i++) {
+		if (!table->slots[i].used) {
+			continue;
+		}
+		size_t slot = table->slots[i].hash & (newCount - 1);
+		while (grown[slot].used) {
+			slot = (slot + 1) & (newCount - 1);
+		}
+		grown[slot] = table->slots[i];
+	}
+
+	free(table->slots);
+	table->slots = grown;
+	table->slotCount = newCount;
+	return 1;
+}
+
+static char* AllocateInArena(StringArena* arena, size_t size) {
+	StringArenaChunk* chunk = arena->chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t chunkSize = size > STRING_ARENA_CHUNK ? size : STRING_ARENA_CHUNK;
+		chunk = (StringArenaChunk*)malloc(CHUNK_HEADER_SIZE + chunkSize);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = arena->chunks;
+		chunk->size = chunkSize;
+		chunk->used = 0;
+		arena->chunks = chunk;
+	}
+
+	char* target = (char*)chunk + CHUNK_HEADER_SIZE + chunk->used;
+	chunk->used += size;
+	return target;
+}
+
+const char* InternString(StringArena* arena, const char* text, size_t length) {
+	if (!GrowArenaSlots(arena)) {
+		return NULL;
+	}
+
+	unsigned int hash = HashString(text, length);
+	size_t mask = arena->slotCount - 1;
+	size_t slot = hash & mask;
+	while (arena->slots[slot].text != NULL) {
+		StringSlot* current = &arena->slots[slot];
+		if (current->hash == hash && current->length == length && memcmp(current->text, text, length) == 0) {
+			arena->references++;
+			return current->text;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	char* copy = AllocateInArena(arena, length + 1);
+	if (copy == NULL) {
+		return NULL;
+	}
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+
+	StringSlot* target = &arena->slots[slot];
+	target->text = copy;
+	target->length = (unsigned int)length;
+	target->hash = hash;
+	arena->stringCount++;
+	arena->references++;
+	arena->bytes += length + 1;
+	return copy;
+}
+
+const char* CopyString(StringArena* arena, const char* text, size_t length) {
+	char* copy = AllocateInArena(arena, length + 1);
+	if (copy == NULL) {
+		return NULL;
+	}
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+	arena->bytes += length + 1;
+	return copy;
+}
+
+void ReleaseStringArena(StringArena* arena) {
+	StringArenaChunk* chunk = arena->chunks;
+	while (chunk != NULL) {
+		StringArenaChunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	free(arena->slots);
+	memset(arena, 0, sizeof(StringArena));
+}
+
+int AddTableString(StringTable* table, const char* text, StringRef* ref) {
+	if (!GrowTableSlots(table)) {
+		return 0;
+	}
+
+	size_t length = strlen(text);
+	unsigned int hash = HashString(text, length);
+	size_t mask = table->slotCount - 1;
+	size_t slot = hash & mask;
+	while (table->slots[slot].used) {
+		StringTableSlot* current = &table->slots[slot];
+		if (current->hash == hash && current->length == length && memcmp(table->data + current->offset, text, length) == 0) {
+			ref->offset = current->offset;
+			ref->length = current->length;
+			return 1;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	if (table->size + length + 1 > table->capacity) {
+		size_t capacity = table->capacity == 0 ? STRING_ARENA_CHUNK : table->capacity;
+		while (table->size + length + 1 > capacity) {
+			capacity *= 2;
+		}
+		char* data = (char*)realloc(table->data, capacity);
+		if (data == NULL) {
+			return 0;
+		}
+		table->data = data;
+		table->capacity = capacity;
+	}
+
+	StringTableSlot* target = &table->slots[slot];
+	target->offset = (unsigned int)table->size;
+	target->length = (unsigned int)length;
+	target->hash = hash;
+	target->used = 1;
+	memcpy(table->data + table->size, text, length + 1);
+	table->size += length + 1;
+	table->stringCount++;
+
+	ref->offset = target->offset;
+	ref->length = target->length;
+	return 1;
+}
+
+void FreeStringTable(StringTable* table) {
+	free(table->data);
+	free(table->slots);
+	memset(table, 0, sizeof(StringTable));
+}
+
+const char* ResolveStringRef(const char* strings, size_t size, StringRef ref) {
+	if ((size_t)ref.offset + ref.length >= size || strings[ref.offset + ref.length] != '\0') {
+		return NULL;
+	}
+	return strings + ref.offset;
+}
@@ -0,0 +1,153 @@
+/**
+ * @file   stringArena.h
+ * @brief  This file includes the interned string storage shared by the records of a list.
+ *
+ * Names, addresses and districts used to be fixed-size arrays inside every
+ * record, mostly zero padding, and the same district was stored once per
+ * manager or location. A StringArena keeps every distinct string once, in
+ * large append-only chunks, so the records only hold a pointer and equal
+ * strings share their bytes. Strings never move or go away until the whole
+ * arena is released, so the pointers stay valid while records are copied or
+ * written in the background.
+ *
+ * A StringTable is the on-disk counterpart: one contiguous block of interned
+ * strings, referenced by offset and length, that follows the records of a
+ * snapshot or of a journal entry.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+
+#define STRING_ARENA_CHUNK (64 * 1024)      /**< Size in bytes of a chunk; longer strings get a chunk of their own. */
+#define STRING_ARENA_MIN_SLOTS 256          /**< Slots of the lookup table when the first string is added. */
+
+/**
+ * @brief Block of strings of an arena.
+ */
+typedef struct StringArenaChunk {
+	struct StringArenaChunk* next;  /**< Chunk filled before this one. */
+	size_t size;                    /**< Bytes available after the header. */
+	size_t used;                    /**< Bytes already holding strings. */
+} StringArenaChunk;
+
+/**
+ * @brief Slot of the lookup table of an arena.
+ */
+typedef struct StringSlot {
+	const char* text;               /**< String in the arena, NULL for an empty slot. */
+	unsigned int length;            /**< Length of the string. */
+	unsigned int hash;              /**< Hash of the string. */
+} StringSlot;
+
+/**
+ * @brief Slot of the lookup table of a string table.
+ */
+typedef struct StringTableSlot {
+	unsigned int offset;            /**< Offset of the string in the table. */
+	unsigned int length;            /**< Length of the string. */
+	unsigned int hash;              /**< Hash of the string. */
+	unsigned int used;              /**< 1 if the slot holds a string. */
+} StringTableSlot;
+
+/**
+ * @brief Interned, null-terminated strings that live as long as the arena.
+ *
+ * A zeroed arena is empty and ready to use.
+ */
+typedef struct StringArena {
+	StringArenaChunk* chunks;       /**< Chunks, most recent first. */
+	StringSlot* slots;              /**< Open-addressing table of the strings. */
+	size_t slotCount;               /**< Number of slots, a power of two. */
+	size_t stringCount;             /**< Number of distinct strings. */
+	size_t bytes;                   /**< Bytes taken by the strings, copies and terminators included. */
+	size_t references;              /**< Number of strings interned, duplicates included. */
+} StringArena;
+
+/**
+ * @brief Reference to a string of a string table.
+ */
+typedef struct StringRef {
+	unsigned int offset;            /**< Offset of the first character in the table. */
+	unsigned int length;            /**< Number of characters, without the terminator stored after them. */
+} StringRef;
+
+/**
+ * @brief Contiguous block of distinct null-terminated strings, built to be written to disk.
+ *
+ * A zeroed table is empty and ready to use.
+ */
+typedef struct StringTable {
+	char* data;                     /**< The strings, each followed by its terminator. */
+	size_t size;                    /**< Bytes used in data. */
+	size_t capacity;                /**< Bytes allocated for data. */
+	StringTableSlot* slots;              /**< Open-addressing table of the strings. */
+	size_t slotCount;               /**< Number of slots, a power of two. */
+	size_t stringCount;             /**< Number of distinct strings. */
+} StringTable;
+
+/**
+ * @brief Gets the copy of a string kept by an arena, adding it the first time.
+ *
+ * @param arena The arena.
+ * @param text The string (need not be null-terminated).
+ * @param length The number of characters of the string.
+ * @return A null-terminated copy that lives as long as the arena; equal strings get the same pointer. NULL if memory could not be allocated.
+ */
+const char* InternString(StringArena* arena, const char* text, size_t length);
+
+/**
+ * @brief Copies a string into an arena without looking for an equal one.
+ *
+ * For strings that are seldom shared, where the lookup would cost more than
+ * the bytes it saves. The copy is never returned by InternString.
+ *
+ * @param arena The arena.
+ * @param text The string (need not be null-terminated).
+ * @param length The number of characters of the string.
+ * @return A null-terminated copy that lives as long as the arena. NULL if memory could not be allocated.
+ */
+const char* CopyString(StringArena* arena, const char* text, size_t length);
+
+/**
+ * @brief Releases every string of an arena at once and leaves it empty.
+ *
+ * @param arena The arena.
+ */
+void ReleaseStringArena(StringArena* arena);
+
+/**
+ * @brief Adds a string to a table unless it already holds it.
+ *
+ * @param table The table.
+ * @param text The null-terminated string.
+ * @param ref Receives the reference to the string in the table.
+ * @return 1 on success, 0 if memory could not be allocated.
+ */
+int AddTableString(StringTable* table, const char* text, StringRef* ref);
+
+/**
+ * @brief Frees the memory of a table and leaves it empty.
+ *
+ * @param table The table.
+ */
+void FreeStringTable(StringTable* table);
+
+/**
+ * @brief Finds the string a reference points to in a block read from disk.
+ *
+ * @param strings The block of strings.
+ * @param size The size of the block in bytes.
+ * @param ref The reference.
+ * @return The null-terminated string, NULL if the reference falls outside the block or the string is not terminated.
+ */
+const char* ResolveStringRef(const char* strings, size_t size, StringRef ref);
+
+#endif  // STRING_ARENA_H
@@ -0,0 +1,405 @@
+#include "telemetry.h"
+#include "csvReader.h"
+#include "platform.h"
+#include <float.h>
+
+#define NOT_PENDING (-1)
+#define UPDATE_GROUP 64                 // Updates looked up together so their cache misses overlap
+#define RADIX_BITS 16
+#define RADIX_SIZE (1 << RADIX_BITS)
+
+// What the ingestion knows of a vehicle, indexed by handle
+typedef struct TelemetryVehicle {
+	double batteryTime;             // Timestamp of the battery level held, -DBL_MAX before the first report
+	double locationTime;            // Timestamp of the location held
+	int pending;                    // Position of the vehicle in the open batch, NOT_PENDING if it is not there
+} TelemetryVehicle;
+
+typedef struct TelemetryBatch {
+	const MobilityTable* table;
+	TelemetryVehicle* vehicles;
+	MobilityStatus* statuses;
+	MobilityStatus* sorted;         // Room for a batch in handle order
+	int* starts;                    // Counts of the radix sort
+	int count;
+	int capacity;
+	double opened;                  // Time the first update of the batch was read
+	TelemetrySink sink;
+	void* context;
+	TelemetryStats* stats;
+} TelemetryBatch;
+
+void InitTelemetryOptions(TelemetryOptions* options) {
+	options->batchSize = TELEMETRY_DEFAULT_BATCH_SIZE;
+	options->windowSeconds = TELEMETRY_DEFAULT_WINDOW;
+}
+
+// Reads "id,battery,location[,timestamp]"; lines without a timestamp take the latest one read
+static int ParseTelemetryUpdate(const CsvReader* reader, double latest, TelemetryUpdate* update) {
+	if (reader->fieldCount < 3 || !ParseCsvInt(&reader->fields[0], &update->id)) {
+		return 0;
+	}
+
+	update->fields = 0;
+	if (reader->fields[1].length > 0) {
+		if (!ParseCsvFloat(&reader->fields[1], &update->battery)) {
+			return 0;
+		}
+		update->fields |= TELEMETRY_BATTERY;
+	}
+	if (reader->fields[2].length > 0) {
+		if (!ParseCsvInt(&reader->fields[2], &update->locationId)) {
+			return 0;
+		}
+		update->fields |= TELEMETRY_LOCATION;
+	}
+
+	update->timestamp = latest;
+	if (reader->fieldCount > 3 && reader->fields[3].length > 0 && !ParseCsvDouble(&reader->fields[3], &update->timestamp)) {
+		return 0;
+	}
+	return update->fields != 0;
+}
+
+// Radix sort on the two halves of the handles, so the batch walks the per-vehicle arrays of the table in order
+static const MobilityStatus* SortByHandle(MobilityStatus* statuses, MobilityStatus* buffer, int* starts, int count) {
+	MobilityStatus* from = statuses;
+	MobilityStatus* to = buffer;
+	for (int shift = 0; shift < 32; shift += RADIX_BITS) {
+		memset(starts, 0, RADIX_SIZE * sizeof(int));
+		for (int i = 0; i < count; i++) {
+			starts[((unsigned int)from[i].handle >> shift) & (RADIX_SIZE - 1)]++;
+		}
+		if (starts[((unsigned int)from[0].handle >> shift) & (RADIX_SIZE - 1)] == count) {
+			continue;
+		}
+
+		int position = 0;
+		for (int digit = 0; digit < RADIX_SIZE; digit++) {
+			int digitCount = starts[digit];
+			starts[digit] = position;
+			position += digitCount;
+		}
+		for (int i = 0; i < count; i++) {
+			to[starts[((unsigned int)from[i].handle >> shift) & (RADIX_SIZE - 1)]++] = from[i];
+		}
+		MobilityStatus* swap = from;
+		from = to;
+		to = swap;
+	}
+	return from;
+}
+
+// Hands the vehicles whose status changed to the sink and empties the batch
+static int CloseBatch(TelemetryBatch* batch) {
+	int kept = 0;
+	for (int i = 0; i < batch->count; i++) {
+		MobilityStatus* status = &batch->statuses[i];
+		const Mobility* mobility = &batch->table->records[status->handle];
+		batch->vehicles[status->handle].pending = NOT_PENDING;
+		if (status->battery != mobility->battery_level || status->locationId != mobility->locationId) {
+			batch->statuses[kept++] = *status;
+		}
+	}
+	batch->stats->unchanged += batch->count - kept;
+	batch->count = 0;
+
+	if (kept == 0) {
+		return 1;
+	}
+	batch->stats->applied += kept;
+	batch->stats->batches++;
+	return batch->sink(SortByHandle(batch->statuses, batch->sorted, batch->starts, kept), kept, batch->context);
+}
+
+// Merges an update into the status the batch holds for its vehicle
+static int AddToBatch(TelemetryBatch* batch, const TelemetryUpdate* update, int handle) {
+	if (handle == ID_INDEX_MISSING) {
+		batch->stats->unknown++;
+		return 1;
+	}
+
+	TelemetryVehicle* vehicle = &batch->vehicles[handle];
+	int fields = 0;
+	if ((update->fields & TELEMETRY_BATTERY) && update->timestamp >= vehicle->batteryTime) {
+		fields |= TELEMETRY_BATTERY;
+	}
+	if ((update->fields & TELEMETRY_LOCATION) && update->timestamp >= vehicle->locationTime) {
+		fields |= TELEMETRY_LOCATION;
+	}
+	if (fields == 0) {
+		batch->stats->stale++;
+		return 1;
+	}
+
+	MobilityStatus* status;
+	if (vehicle->pending == NOT_PENDING) {
+		const Mobility* mobility = &batch->table->records[handle];
+		vehicle->pending = batch->count;
+		status = &batch->statuses[batch->count++];
+		status->handle = handle;
+		status->battery = mobility->battery_level;
+		status->locationId = mobility->locationId;
+	}
+	else {
+		status = &batch->statuses[vehicle->pending];
+		batch->stats->coalesced++;
+	}
+
+	if (fields & TELEMETRY_BATTERY) {
+		status->battery = update->battery;
+		vehicle->batteryTime = update->timestamp;
+	}
+	if (fields & TELEMETRY_LOCATION) {
+		status->locationId = update->locationId;
+		vehicle->locationTime = update->timestamp;
+	}
+	return batch->count < batch->capacity || CloseBatch(batch);
+}
+
+// Reads the updates of an open reader until its end and closes it
+static int IngestFromReader(const MobilityTable* table, CsvReader* reader, const TelemetryOptions* options,
+	TelemetrySink sink, void* context, TelemetryStats* stats) {
+	double started = PlatformGetTime();
+	memset(stats, 0, sizeof(TelemetryStats));
+
+	TelemetryBatch batch;
+	memset(&batch, 0, sizeof(TelemetryBatch));
+	batch.table = table;
+	batch.capacity = options->batchSize > 0 ? options->batchSize : TELEMETRY_DEFAULT_BATCH_SIZE;
+	batch.sink = sink;
+	batch.context = context;
+	batch.stats = stats;
+
+	int slotCount = table != NULL ? table->slotCount : 0;
+	batch.vehicles = (TelemetryVehicle*)malloc(((size_t)slotCount + 1) * sizeof(TelemetryVehicle));
+	batch.statuses = (MobilityStatus*)malloc((size_t)batch.capacity * sizeof(MobilityStatus));
+	batch.sorted = (MobilityStatus*)malloc((size_t)batch.capacity * sizeof(MobilityStatus));
+	batch.starts = (int*)malloc(RADIX_SIZE * sizeof(int));
+	if (batch.vehicles == NULL || batch.statuses == NULL || batch.sorted == NULL || batch.starts == NULL) {
+		free(batch.vehicles);
+		free(batch.statuses);
+		free(batch.sorted);
+		free(batch.starts);
+		CloseCsvReader(reader);
+		return 0;
+	}
+	for (int handle = 0; handle < slotCount; handle++) {
+		batch.vehicles[handle].batteryTime = -DBL_MAX;
+		batch.vehicles[handle].locationTime = -DBL_MAX;
+		batch.vehicles[handle].pending = NOT_PENDING;
+	}
+
+	int ok = 1;
+	int ended = 0;
+	int sinceClock = 0;
+	double latest = 0.0;
+	TelemetryUpdate updates[UPDATE_GROUP];
+	int handles[UPDATE_GROUP];
+	while (ok && !ended) {
+		int count = 0;
+		int expired = 0;
+		while (count < UPDATE_GROUP) {
+			// A quiet pipe is only waited on until the open batch is due
+			double deadline = count > 0 || batch.count > 0 ? batch.opened + options->windowSeconds : CSV_NO_DEADLINE;
+			int fieldCount = ReadCsvRecordBefore(reader, 4, deadline);
+			if (fieldCount == CSV_TIMED_OUT) {
+				expired = 1;
+				break;
+			}
+			if (fieldCount <= 0) {
+				ended = 1;
+				break;
+			}
+			if (count == 0 && batch.count == 0) {
+				batch.opened = PlatformGetTime();
+			}
+			stats->read++;
+			if (!ParseTelemetryUpdate(reader, latest, &updates[count])) {
+				ReportCsvError(reader, "expected id, battery, location and an optional timestamp");
+				stats->rejected++;
+				continue;
+			}
+			if (updates[count].timestamp > latest) {
+				latest = updates[count].timestamp;
+			}
+			count++;
+		}
+		if (table == NULL) {
+			stats->unknown += count;
+			continue;
+		}
+
+		// Every step first asks for the memory of the whole group, so a group waits about as long as one update would.
+		// FindMobilityById would record a histogram entry per update, which costs more than the lookup itself.
+		for (int i = 0; i < count; i++) {
+			IdIndexPrefetch(&table->ids, updates[i].id);
+		}
+		for (int i = 0; i < count; i++) {
+			handles[i] = IdIndexFind(&table->ids, updates[i].id);
+			if (handles[i] != ID_INDEX_MISSING) {
+				PLATFORM_PREFETCH(&batch.vehicles[handles[i]]);
+				PLATFORM_PREFETCH(&table->records[handles[i]]);
+			}
+		}
+		for (int i = 0; i < count && ok; i++) {
+			ok = AddToBatch(&batch, &updates[i], handles[i]);
+		}
+
+		// A busy stream looks at the clock every TELEMETRY_CLOCK_INTERVAL updates, a quiet one when its read times out
+		sinceClock += count;
+		if (ok && batch.count > 0 && (expired || sinceClock >= TELEMETRY_CLOCK_INTERVAL)) {
+			sinceClock = 0;
+			if (expired || PlatformGetTime() - batch.opened >= options->windowSeconds) {
+				ok = CloseBatch(&batch);
+			}
+		}
+	}
+	if (ok && batch.count > 0) {
+		ok = CloseBatch(&batch);
+	}
+
+	CloseCsvReader(reader);
+	free(batch.vehicles);
+	free(batch.statuses);
+	free(batch.sorted);
+	free(batch.starts);
+	stats->seconds = PlatformGetTime() - started;
+	return ok;
+}
+
+int IngestTelemetry(const MobilityTable* table, const char* filename, const TelemetryOptions* options,
+	TelemetrySink sink, void* context, TelemetryStats* stats) {
+	CsvReader reader;
+	if (!OpenCsvReader(&reader, filename)) {
+		memset(stats, 0, sizeof(TelemetryStats));
+		return 0;
+	}
+	return IngestFromReader(table, &reader, options, sink, context, stats);
+}
+
+// Feeds the check: a burst of updates, then a pause of a few windows before the pipe closes
+typedef struct TelemetryCheckWriter {
+	FILE* file;
+	int vehicleCount;
+	int updates;
+	int pauseMilliseconds;
+	double written;                 // Time the burst was flushed
+	double closed;                  // Time the pause ended
+} TelemetryCheckWriter;
+
+typedef struct TelemetryCheckSink {
+	double firstApplied;            // Time the first batch reached the sink, 0 if none did
+	long long applied;
+} TelemetryCheckSink;
+
+static int WriteCheckUpdates(void* argument) {
+	TelemetryCheckWriter* writer = (TelemetryCheckWriter*)argument;
+	for (int i = 0; i < writer->updates; i++) {
+		fprintf(writer->file, "%d,%.1f,%d\n", i % writer->vehicleCount + 1, 50.0 + i % 50, i % 100 + 1);
+	}
+	int ok = fflush(writer->file) == 0;
+	writer->written = PlatformGetTime();
+	PlatformSleep(writer->pauseMilliseconds);
+	writer->closed = PlatformGetTime();
+	fclose(writer->file);
+	return ok;
+}
+
+static int RecordCheckBatch(const MobilityStatus* statuses, int count, void* context) {
+	TelemetryCheckSink* sink = (TelemetryCheckSink*)context;
+	(void)statuses;
+	if (sink->firstApplied == 0.0) {
+		sink->firstApplied = PlatformGetTime();
+	}
+	sink->applied += count;
+	return 1;
+}
+
+int RunTelemetryCheck(double windowSeconds) {
+	const int vehicleCount = 1000;
+	if (windowSeconds <= 0.0) {
+		return 0;
+	}
+
+	MobilityTable* table = CreateMobilityTable(vehicleCount);
+	if (table == NULL) {
+		printf("Could not create the vehicles.\n");
+		return 0;
+	}
+	for (int vehicle = 0; vehicle < vehicleCount; vehicle++) {
+		Mobility mobility;
+		memset(&mobility, 0, sizeof(Mobility));
+		mobility.id = vehicle + 1;
+		mobility.type = Scooters;
+		if (AddMobility(table, mobility) == INVALID_MOBILITY_HANDLE) {
+			FreeMobilities(table);
+			printf("Could not create the vehicles.\n");
+			return 0;
+		}
+	}
+
+	FILE* readEnd;
+	TelemetryCheckWriter writer;
+	memset(&writer, 0, sizeof(TelemetryCheckWriter));
+	writer.vehicleCount = vehicleCount;
+	writer.updates = 3 * vehicleCount;
+	writer.pauseMilliseconds = (int)(4000.0 * windowSeconds);
+	CsvReader reader;
+	if (!PlatformCreatePipe(&readEnd, &writer.file)) {
+		FreeMobilities(table);
+		printf("Could not create a pipe.\n");
+		return 0;
+	}
+	if (!OpenCsvStream(&reader, readEnd, "telemetry check")) {
+		fclose(readEnd);
+		fclose(writer.file);
+		FreeMobilities(table);
+		return 0;
+	}
+
+	PlatformThread* thread = PlatformStartThread(WriteCheckUpdates, &writer);
+	if (thread == NULL) {
+		CloseCsvReader(&reader);
+		fclose(writer.file);
+		FreeMobilities(table);
+		printf("Could not start the writer.\n");
+		return 0;
+	}
+
+	TelemetryOptions options;
+	InitTelemetryOptions(&options);
+	options.windowSeconds = windowSeconds;
+	TelemetryCheckSink check = { 0.0, 0 };
+	TelemetryStats stats;
+	int ok = IngestFromReader(table, &reader, &options, RecordCheckBatch, &check, &stats);
+	ok = PlatformJoinThread(thread) && ok;
+	FreeMobilities(table);
+
+	// The burst fills no batch, so only the window can close it, and that must not wait for the end of the pipe
+	double delay = check.firstApplied - writer.written;
+	int onTime = check.firstApplied > 0.0 && delay <= windowSeconds + 0.25 && check.firstApplied < writer.closed;
+	printf("Telemetry check: %d updates of %d vehicles, then %.2f s of silence, %.2f s window\n",
+		writer.updates, vehicleCount, writer.pauseMilliseconds / 1000.0, windowSeconds);
+	if (check.firstApplied > 0.0) {
+		printf("%-28s %12.1f ms after the burst\n", "First batch applied", delay * 1000.0);
+	}
+	else {
+		printf("%-28s %12s\n", "First batch applied", "never");
+	}
+	printf("%-28s %12lld in %lld batches\n", "Statuses applied", stats.applied, stats.batches);
+	printf("%-28s %12s\n", "Check", ok && onTime ? "ok" : "FAIL");
+	return ok && onTime;
+}
+
+void PrintTelemetryStats(const TelemetryStats* stats, FILE* output) {
+	double seconds = stats->seconds > 0.0 ? stats->seconds : 1e-9;
+	fprintf(output, "%-28s %12lld\n", "Updates read", stats->read);
+	fprintf(output, "%-28s %12lld\n", "Rejected", stats->rejected);
+	fprintf(output, "%-28s %12lld\n", "Unknown vehicles", stats->unknown);
+	fprintf(output, "%-28s %12lld\n", "Stale", stats->stale);
+	fprintf(output, "%-28s %12lld\n", "Coalesced", stats->coalesced);
+	fprintf(output, "%-28s %12lld\n", "Unchanged", stats->unchanged);
+	fprintf(output, "%-28s %12lld in %lld batches\n", "Statuses applied", stats->applied, stats->batches);
+	fprintf(output, "%-28s %12.1f ms, %.0f updates/s\n", "Ingestion", stats->seconds * 1000.0, stats->read / seconds);
+}
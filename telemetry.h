@@ -0,0 +1,127 @@
+/**
+ * @file   telemetry.h
+ * @brief  This file includes the ingestion of battery and location reports sent by the vehicles.
+ *
+ * Vehicles report their battery level and location far more often than
+ * anything reads them, and a busy vehicle reports several times before a
+ * change could usefully be applied. Reports are read as text lines of
+ * "id,battery,location[,timestamp]" from a file or a pipe, where an empty
+ * battery or location means the vehicle did not report it. They are gathered
+ * in a batch with at most one status per vehicle, keeping for every field the
+ * value with the latest timestamp, so a report that arrives late never undoes
+ * a newer one. A batch is closed once it holds a given number of vehicles or
+ * has been open for a given time, and is handed whole and in handle order to
+ * a sink that applies it, usually with a single journal record. A pipe that
+ * goes quiet is only waited on until the open batch is due, so its updates
+ * are still applied within the window.
+ *
+ * IDs are looked up in the ID index of the table and the pending status of a
+ * vehicle is found through an array indexed by handle, so coalescing an
+ * update costs one hash lookup and one array read.
+ *
+ * @author Nuno Fernandes
+ * @date   October 2026
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#pragma once
+#pragma warning(disable:4996)
+
+#include "headers.h"
+#include "mobility.h"
+
+#define TELEMETRY_BATTERY 1                 /**< The update reports the battery level. */
+#define TELEMETRY_LOCATION 2                /**< The update reports the location. */
+#define TELEMETRY_DEFAULT_BATCH_SIZE 65536  /**< Vehicles in a batch before it is applied. */
+#define TELEMETRY_DEFAULT_WINDOW 0.5        /**< Seconds a batch stays open at most. */
+#define TELEMETRY_CLOCK_INTERVAL 1024       /**< Updates read between two looks at the clock while they keep arriving. */
+
+/**
+ * @brief One report of a vehicle.
+ */
+typedef struct TelemetryUpdate {
+	int id;                         /**< ID of the vehicle. */
+	int fields;                     /**< TELEMETRY_BATTERY and TELEMETRY_LOCATION bits of the fields reported. */
+	float battery;                  /**< Battery level, if reported. */
+	int locationId;                 /**< Location, if reported. */
+	double timestamp;               /**< Time of the report; the latest one read so far if the line has none. */
+} TelemetryUpdate;
+
+/**
+ * @brief Size and age of the batches.
+ */
+typedef struct TelemetryOptions {
+	int batchSize;                  /**< Vehicles in a batch before it is applied. */
+	double windowSeconds;           /**< Seconds a batch stays open at most. */
+} TelemetryOptions;
+
+/**
+ * @brief Counters of an ingestion.
+ */
+typedef struct TelemetryStats {
+	long long read;                 /**< Lines read. */
+	long long rejected;             /**< Lines that were not a valid update. */
+	long long unknown;              /**< Updates of IDs that are not in the table. */
+	long long stale;                /**< Updates older than the values already held for every field they report. */
+	long long coalesced;            /**< Updates merged into a vehicle already in the batch. */
+	long long unchanged;            /**< Vehicles left out of a batch because their status ended up as it was. */
+	long long applied;              /**< Statuses handed to the sink. */
+	long long batches;              /**< Batches handed to the sink. */
+	double seconds;                 /**< Time the ingestion took. */
+} TelemetryStats;
+
+/**
+ * @brief Applies a closed batch.
+ *
+ * @param statuses The new statuses, at most one per vehicle, in handle order.
+ * @param count The number of statuses.
+ * @param context The context given to IngestTelemetry.
+ * @return 1 on success, 0 to stop the ingestion.
+ */
+typedef int (*TelemetrySink)(const MobilityStatus* statuses, int count, void* context);
+
+/**
+ * @brief Fills the options with TELEMETRY_DEFAULT_BATCH_SIZE and TELEMETRY_DEFAULT_WINDOW.
+ *
+ * @param options The options.
+ */
+void InitTelemetryOptions(TelemetryOptions* options);
+
+/**
+ * @brief Reads updates until the end of a file and applies them in batches.
+ *
+ * The table must only change through the sink while the ingestion runs.
+ *
+ * @param table The vehicles the updates refer to.
+ * @param filename The file to read, CSV_STANDARD_INPUT for the standard input.
+ * @param options Size and age of the batches.
+ * @param sink The function that applies every batch.
+ * @param context Context passed to sink.
+ * @param stats Receives the counters.
+ * @return 1 if every update was read and every batch applied, 0 if the file could not be opened, memory could not be allocated or the sink failed.
+ */
+int IngestTelemetry(const MobilityTable* table, const char* filename, const TelemetryOptions* options,
+	TelemetrySink sink, void* context, TelemetryStats* stats);
+
+/**
+ * @brief Feeds a burst of updates through a pipe that then stays quiet for a few windows and prints when they were applied.
+ *
+ * The burst is too small to fill a batch, so it must be applied once the
+ * window has passed and before the pipe is closed.
+ *
+ * @param windowSeconds The window of the batches.
+ * @return 1 if the first batch was applied within the window and a quarter of a second, 0 otherwise.
+ */
+int RunTelemetryCheck(double windowSeconds);
+
+/**
+ * @brief Prints the counters of an ingestion.
+ *
+ * @param stats The counters.
+ * @param output The stream to print to.
+ */
+void PrintTelemetryStats(const TelemetryStats* stats, FILE* output);
+
+#endif  // TELEMETRY_H